@@ -28,7 +28,7 @@
  * @param format_request Requested output audio format, or defaults where fields are unset
  * @param config Audio stream configuration; the buffer size and sync thresholds are copied
  *        from it (the pointer is not retained)
- * @param thread_count FFmpeg codec thread count, 0 for autodetect
+ * @param thread_count FFmpeg codec thread count, 0 for autodetect; used if config does not set its own
  * @param sync_timer Sync timer to attach to the decoder (ownership transferred to this call)
  * @param stream_index Index of the audio stream to decode
  * @return New decoder on success, NULL on error (see Kit_GetError())
@@ -0,0 +1,81 @@
+#ifndef KITBUFFEREVENT_H
+#define KITBUFFEREVENT_H
+
+/**
+ * @brief Wake-up event shared by the pipeline of a player. The buffers signal it when a write brings them up to
+ * the level a thread is waiting for (see Kit_SetPacketBufferWakeLevel()), and the pipeline threads when they exit,
+ * so that a thread waiting for buffer fill levels can block until something actually changes instead of polling.
+ *
+ * @file kitbufferevent.h
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include "kitchensink3/kitconfig.h"
+#include <stdbool.h>
+
+/**
+ * @brief Opaque buffer event. See Kit_CreateBufferEvent().
+ */
+typedef struct Kit_BufferEvent Kit_BufferEvent;
+
+/**
+ * @brief Creates a new buffer event with no waiters.
+ *
+ * @return New buffer event, or NULL on allocation failure (see Kit_GetError())
+ */
+KIT_LOCAL Kit_BufferEvent *Kit_CreateBufferEvent(void);
+
+/**
+ * @brief Frees a buffer event. Nobody may be waiting on or signaling it anymore.
+ *
+ * @param ref Pointer to the event pointer; set to NULL on return. No-op if NULL or *ref is NULL.
+ */
+KIT_LOCAL void Kit_CloseBufferEvent(Kit_BufferEvent **ref);
+
+/**
+ * @brief Wakes up everyone waiting on the event. Only does an atomic read if nobody is waiting, so this is
+ * cheap enough to call after every buffer write.
+ *
+ * @param event Event to signal; no-op if NULL
+ */
+KIT_LOCAL void Kit_SignalBufferEvent(Kit_BufferEvent *event);
+
+/**
+ * @brief Registers the calling thread as a waiter. Must be paired with Kit_EndBufferEventWait().
+ *
+ * Signals are only delivered while someone is registered, so the waiter must register before it first
+ * checks the condition it is waiting for.
+ *
+ * @param event Event to wait on
+ */
+KIT_LOCAL void Kit_BeginBufferEventWait(Kit_BufferEvent *event);
+
+/**
+ * @brief Unregisters a waiter registered with Kit_BeginBufferEventWait().
+ *
+ * @param event Event that was waited on
+ */
+KIT_LOCAL void Kit_EndBufferEventWait(Kit_BufferEvent *event);
+
+/**
+ * @brief Gets the current signal serial of the event, to be passed to Kit_WaitBufferEvent().
+ *
+ * Read the serial before checking the waited-for condition; a signal sent after that is then never missed.
+ *
+ * @param event Event to query
+ * @return Current serial
+ */
+KIT_LOCAL int Kit_GetBufferEventSerial(Kit_BufferEvent *event);
+
+/**
+ * @brief Blocks until the event is signaled after serial was read, or timeout runs out.
+ *
+ * @param event Event to wait on; the caller must be registered with Kit_BeginBufferEventWait()
+ * @param serial Serial returned by Kit_GetBufferEventSerial()
+ * @param timeout Max time to wait, in milliseconds
+ * @return true if the event was signaled, false on timeout
+ */
+KIT_LOCAL bool Kit_WaitBufferEvent(Kit_BufferEvent *event, int serial, int timeout);
+
+#endif // KITBUFFEREVENT_H
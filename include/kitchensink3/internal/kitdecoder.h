@@ -15,6 +15,7 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
+#include "kitchensink3/internal/kitpacketbuffer.h"
 #include "kitchensink3/kitcodec.h"
 #include "kitchensink3/kitconfig.h"
 #include "kittimer.h"
@@ -34,6 +35,14 @@ typedef enum Kit_DecoderInputResult
     KIT_DEC_INPUT_EOF,    ///< Decoder has reached end of stream (e.g. avcodec_send_packet returned EOF).
 } Kit_DecoderInputResult;
 
+/**
+ * @brief Timing information of a decoded frame, copied out of an output buffer by Kit_PeekDecodedFrame().
+ */
+typedef struct Kit_DecodedFrameInfo {
+    int64_t pts;         ///< Best effort timestamp, in stream time base units
+    unsigned int serial; ///< Seek serial of the frame
+} Kit_DecodedFrameInfo;
+
 /** @brief Feeds one packet (or NULL to flush/drain) into the underlying codec. */
 typedef Kit_DecoderInputResult (*dec_input_cb)(const Kit_Decoder *decoder, const AVPacket *packet);
 /** @brief Pulls one decoded frame out of the underlying codec and stores its pts in @p pts. */
@@ -46,25 +55,29 @@ typedef void (*dec_abort_cb)(Kit_Decoder *decoder);
 typedef void (*dec_close_cb)(Kit_Decoder *decoder);
 /** @brief Reports current output buffer fill level and capacity for the decoder. */
 typedef void (*dec_get_buffers_cb)(const Kit_Decoder *decoder, unsigned int *length, unsigned int *capacity);
+/** @brief Gets the packet buffer the decoder writes its output into. */
+typedef Kit_PacketBuffer *(*dec_get_output_buffer_cb)(const Kit_Decoder *decoder);
 
 /**
  * @brief Generic decoder state: libavcodec context plus type-specific callbacks and userdata.
  */
 struct Kit_Decoder {
-    Kit_Timer *sync_timer;              ///< Playback synchronization timer (also carries the seek serial)
-    unsigned int output_serial;         ///< Latest seek serial seen by this decoder's thread.
-    AVRational aspect_ratio;            ///< Aspect ratio for the current frame (may change frame-to-frame)
-    AVCodecContext *codec_ctx;          ///< FFMpeg internal: Codec context
-    AVStream *stream;                   ///< FFMpeg internal: Data stream
-    enum AVPixelFormat hw_fmt;          ///< FFMpeg internal: Hardware pixel format (if in use)
-    enum AVHWDeviceType hw_type;        ///< FFMpeg internal: Hardware device type (if in use)
-    void *userdata;                     ///< Decoder specific information (Audio, video, subtitle context)
-    dec_input_cb dec_input;             ///< Decoder packet input function callback
-    dec_decode_cb dec_decode;           ///< Decoder decoding function callback
-    dec_flush_cb dec_flush;             ///< Decoder buffer flusher function callback
-    dec_abort_cb dec_abort;             ///< Decoder abort callback; unblocks buffer waits before thread shutdown
-    dec_close_cb dec_close;             ///< Decoder close function callback
-    dec_get_buffers_cb dec_get_buffers; ///< Decoder buffer status getter callback
+    Kit_Timer *sync_timer;                          ///< Playback synchronization timer (also carries the seek serial)
+    unsigned int output_serial;                     ///< Latest seek serial seen by this decoder's thread.
+    AVRational aspect_ratio;                        ///< Aspect ratio for the current frame (may change frame-to-frame)
+    AVCodecContext *codec_ctx;                      ///< FFMpeg internal: Codec context
+    AVStream *stream;                               ///< FFMpeg internal: Data stream
+    enum AVPixelFormat hw_fmt;                      ///< FFMpeg internal: Hardware pixel format (if in use)
+    enum AVHWDeviceType hw_type;                    ///< FFMpeg internal: Hardware device type (if in use)
+    int reserved_threads;                           ///< Threads taken from the library-wide decoder thread budget
+    void *userdata;                                 ///< Decoder specific information (Audio, video, subtitle context)
+    dec_input_cb dec_input;                         ///< Decoder packet input function callback
+    dec_decode_cb dec_decode;                       ///< Decoder decoding function callback
+    dec_flush_cb dec_flush;                         ///< Decoder buffer flusher function callback
+    dec_abort_cb dec_abort;                         ///< Decoder abort callback; unblocks buffer waits on shutdown
+    dec_close_cb dec_close;                         ///< Decoder close function callback
+    dec_get_buffers_cb dec_get_buffers;             ///< Decoder buffer status getter callback
+    dec_get_output_buffer_cb dec_get_output_buffer; ///< Decoder output packet buffer getter (may be NULL)
 };
 
 /**
@@ -77,7 +90,9 @@ struct Kit_Decoder {
  * @param stream Stream to decode; must not be NULL.
  * @param sync_timer Playback sync timer; the decoder takes ownership and closes it in Kit_CloseDecoder().
  * @param thread_count Requested libavcodec thread count (0 lets ffmpeg pick); disabled if codec has no
- *     frame/slice threading support.
+ *     frame/slice threading support, and capped by the library-wide budget if Kit_InitWithOptions() set one.
+ * @param thread_type Threading mode; if the codec does not support the requested mode, it runs single threaded.
+ * @param low_delay Set AV_CODEC_FLAG_LOW_DELAY, so that the codec outputs frames without reordering delay.
  *
  * @param hw_device_types Bitmask of Kit_HardwareDeviceType values allowed for hardware decode.
  * @param dec_input Packet input callback.
@@ -86,6 +101,7 @@ struct Kit_Decoder {
  * @param dec_abort Buffer wait abort callback.
  * @param dec_close Resource close callback.
  * @param dec_get_buffers Buffer state getter callback.
+ * @param dec_get_output_buffer Output packet buffer getter, or NULL if the decoder has no output packet buffer.
  * @param userdata Decoder-type-specific context, stored as-is and passed back to all callbacks.
  * @return New decoder, or NULL on allocation/codec-open failure (Kit_SetError() is called).
  */
@@ -93,6 +109,8 @@ KIT_LOCAL Kit_Decoder *Kit_CreateDecoder(
     AVStream *stream,
     Kit_Timer *sync_timer,
     int thread_count,
+    Kit_ThreadType thread_type,
+    bool low_delay,
     unsigned int hw_device_types,
     dec_input_cb dec_input,
     dec_decode_cb dec_decode,
@@ -100,6 +118,7 @@ KIT_LOCAL Kit_Decoder *Kit_CreateDecoder(
     dec_abort_cb dec_abort,
     dec_close_cb dec_close,
     dec_get_buffers_cb dec_get_buffers,
+    dec_get_output_buffer_cb dec_get_output_buffer,
     void *userdata
 );
 
@@ -172,4 +191,24 @@ KIT_LOCAL void Kit_AbortDecoder(Kit_Decoder *decoder);
  */
 KIT_LOCAL int Kit_GetDecoderBufferState(const Kit_Decoder *decoder, unsigned int *length, unsigned int *capacity);
 
+/**
+ * @brief Gets the packet buffer the decoder writes its output into, via dec_get_output_buffer.
+ *
+ * Used for operations that apply to any decoder output buffer, such as resizing it.
+ *
+ * @param decoder Decoder to query.
+ * @return Output buffer, or NULL if @p decoder is NULL or has no output packet buffer.
+ */
+KIT_LOCAL Kit_PacketBuffer *Kit_GetDecoderOutputBuffer(const Kit_Decoder *decoder);
+
+/**
+ * @brief Peek callback for output buffers holding decoded AVFrames, for use with Kit_PeekPacketBuffer().
+ *
+ * Lets the reading side judge a frame's timing without taking it out of the buffer first.
+ *
+ * @param dst Kit_DecodedFrameInfo to fill.
+ * @param obj AVFrame in the buffer.
+ */
+KIT_LOCAL void Kit_PeekDecodedFrame(void *dst, const void *obj);
+
 #endif // KITDECODER_H
@@ -10,21 +10,27 @@
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
  */
 
+#include "kitchensink3/internal/kitbufferevent.h"
 #include "kitchensink3/internal/kitdecoder.h"
 #include "kitchensink3/internal/kitpacketbuffer.h"
 #include "kitchensink3/kitconfig.h"
 #include <SDL3/SDL_thread.h>
 #include <stdbool.h>
 
+#define KIT_DECODER_THREAD_BATCH 16 ///< Max number of packets taken from the input buffer at once; less if it is small
+
 /**
  * @brief Decoder thread state: the input packet buffer, target decoder, SDL thread handle and run flag.
  */
 typedef struct Kit_DecoderThread {
-    Kit_PacketBuffer *input;  ///< Packet buffer this thread reads from (owned elsewhere, e.g. the demuxer).
-    Kit_Decoder *decoder;     ///< Decoder this thread drives.
-    SDL_Thread *thread;       ///< Underlying SDL thread handle; NULL while not running.
-    AVPacket *scratch_packet; ///< Reusable packet used to read from the input buffer.
-    SDL_AtomicInt run;        ///< Run flag; 0 requests/marks stop.
+    Kit_PacketBuffer *input;                     ///< Packet buffer this thread reads from (owned elsewhere).
+    Kit_Decoder *decoder;                        ///< Decoder this thread drives.
+    Kit_BufferEvent *event;                      ///< Signaled on exit; may be NULL.
+    SDL_Thread *thread;                          ///< Underlying SDL thread handle; NULL while not running.
+    AVPacket *packets[KIT_DECODER_THREAD_BATCH]; ///< Packets read from the input buffer in one batch.
+    size_t packet_pos;                           ///< Next packet in packets to feed to the decoder.
+    size_t packet_count;                         ///< Number of packets read into packets.
+    SDL_AtomicInt run;                           ///< Run flag; 0 requests/marks stop.
 } Kit_DecoderThread;
 
 /**
@@ -32,9 +38,11 @@ typedef struct Kit_DecoderThread {
  *
  * @param input Packet buffer to read input packets from.
  * @param decoder Decoder to drive; not closed or owned by the thread.
+ * @param event Event to signal when the thread exits; may be NULL.
  * @return New decoder thread (not started), or NULL on allocation failure.
  */
-KIT_LOCAL Kit_DecoderThread *Kit_CreateDecoderThread(Kit_PacketBuffer *input, Kit_Decoder *decoder);
+KIT_LOCAL Kit_DecoderThread *
+Kit_CreateDecoderThread(Kit_PacketBuffer *input, Kit_Decoder *decoder, Kit_BufferEvent *event);
 
 /**
  * @brief Starts the decoder thread's SDL thread. No-op if already running or @p decoder_thread is NULL.
@@ -47,6 +55,9 @@ KIT_LOCAL void Kit_StartDecoderThread(Kit_DecoderThread *decoder_thread, const c
 /**
  * @brief Clears the run flag, asking the decoder thread to exit at its next loop check.
  *
+ * Input packets the thread has already taken from its buffer but not yet fed to the decoder are dropped when it
+ * exits, so a stopped thread should only be restarted after its input buffer has been flushed.
+ *
  * This only clears the flag; it does not wake up a thread blocked reading from an empty/full packet buffer.
  * If the thread may be blocked, call Kit_AbortDecoder() (on its decoder) as well, or Kit_WaitDecoderThread()
  * can deadlock.
@@ -66,7 +77,7 @@ KIT_LOCAL void Kit_StopDecoderThread(Kit_DecoderThread *decoder_thread);
 KIT_LOCAL void Kit_WaitDecoderThread(Kit_DecoderThread *decoder_thread);
 
 /**
- * @brief Stops, waits for, and frees a decoder thread (including its scratch packet).
+ * @brief Stops, waits for, and frees a decoder thread (including its input packets).
  *
  * @param ref Pointer to the decoder thread pointer; set to NULL after closing. No-op if NULL or already-NULL.
  */
@@ -18,26 +18,64 @@
 #include "kitchensink3/kitsource.h"
 
 #include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_mutex.h>
 #include <libavcodec/avcodec.h>
 #include <stdbool.h>
 
+#define KIT_DEMUXER_MAX_BATCH 32     ///< Upper limit for Kit_PlayerDemuxerConfig packet_batch_size
+#define KIT_DEMUXER_MAX_OVERFLOW 256 ///< Upper limit for Kit_PlayerDemuxerConfig overflow_size
+#define KIT_DEMUXER_MAX_TAPS 64      ///< Upper limit for taps on one demuxer; see Kit_CreateDemuxerTap()
+
 /**
- * @brief Demuxer state: source, one packet buffer and stream index per stream type, and a scratch packet.
+ * @brief Side queue for the packets of one stream type that did not fit into its full packet buffer.
+ *
+ * A ring of preallocated packets, owned by the demuxer thread.
+ */
+typedef struct Kit_DemuxerOverflow {
+    AVPacket **packets; ///< Ring of packets; NULL if the side queue is off.
+    int capacity;       ///< Number of packets in the ring.
+    int head;           ///< Ring position of the oldest queued packet.
+    int count;          ///< Number of queued packets.
+    size_t bytes;       ///< Total size of the queued packets.
+} Kit_DemuxerOverflow;
+
+/**
+ * @brief Demuxer state: source, one packet buffer, side queue and stream index per stream type, and a scratch
+ * packet.
+ *
+ * A demuxer can also be a tap of another one: it then never reads its source itself, but gets references to the
+ * packets its leader reads, for the streams it has selected.
  */
 typedef struct Kit_Demuxer {
-    const Kit_Source *src;                         ///< Source being demuxed; not owned.
-    Kit_PacketBuffer *buffers[KIT_INDEX_COUNT];    ///< Per-stream-type output packet buffers; NULL if unused.
-    SDL_AtomicInt stream_indexes[KIT_INDEX_COUNT]; ///< Per-stream-type source stream index; -1 if unused.
-    SDL_AtomicInt abort_requested;                 ///< Breaks the read-retry delay in Kit_RunDemuxer() on abort.
-    AVPacket *scratch_packet;                      ///< Reusable packet used for reading/writing.
-    int read_attempts;                             ///< Read attempts before a failure is treated as EOF.
-    int read_retry_delay;                          ///< Delay between read attempts, in milliseconds.
-    Kit_Timer *timer;                              ///< Non-writeable timer handle. This is used for the serial stuff.
+    const Kit_Source *src;                          ///< Source being demuxed; not owned.
+    Kit_PacketBuffer *buffers[KIT_INDEX_COUNT];     ///< Per-stream-type output packet buffers; NULL if unused.
+    SDL_AtomicInt stream_indexes[KIT_INDEX_COUNT];  ///< Per-stream-type source stream index; -1 if unused.
+    SDL_AtomicInt abort_requested;                  ///< Breaks the read-retry delay in Kit_RunDemuxer() on abort.
+    SDL_AtomicInt discard_changed;                  ///< Stream selection changed; Kit_RunDemuxer() updates discards.
+    AVPacket *scratch_packet;                       ///< Reusable packet used for writing seek packets.
+    AVPacket **batch;                               ///< Packets read in Kit_RunDemuxer(), written as one batch.
+    int batch_size;                                 ///< Number of packets in batch.
+    int read_attempts;                              ///< Read attempts before a failure is treated as EOF.
+    int read_retry_delay;                           ///< Delay between read attempts, in milliseconds.
+    Kit_Timer *timer;                               ///< Non-writeable timer handle. This is used for the serial stuff.
+    SDL_Mutex *eof_locks[KIT_INDEX_COUNT];          ///< Serializes EOF packet writers; see Kit_SendDemuxerEOFPacket().
+    Kit_DemuxerOverflow overflow[KIT_INDEX_COUNT];  ///< Per-stream-type side queues for full packet buffers.
+    bool draining;                                  ///< Source is at EOF; only the side queues are left to write.
+    int follow_serial;                              ///< Serial of the last Kit_FollowDemuxerSeek(); -1 if none.
+    struct Kit_Demuxer *leader;                     ///< Demuxer this one is a tap of; NULL if it reads by itself.
+    struct Kit_Demuxer *taps[KIT_DEMUXER_MAX_TAPS]; ///< Taps fed from the reads of this demuxer.
+    int tap_count;                                  ///< Number of taps in use.
+    SDL_Mutex *tap_lock;                            ///< Guards taps, tap_count and closed.
+    bool closed;                                    ///< Closed with taps left; the last tap to close frees it.
+    SDL_AtomicInt tap_open;                         ///< Tap is being fed; see Kit_SetDemuxerTapOpen().
+    SDL_AtomicInt open_taps;                        ///< Number of open taps; read without tap_lock to skip it.
 } Kit_Demuxer;
 
 /**
  * @brief Creates a demuxer for a source, allocating a packet buffer for each requested stream index.
  *
+ * All other streams of the source are set to AVDISCARD_ALL, so that the container can skip them.
+ *
  * @param src Source to demux from; must stay valid for the demuxer's lifetime.
  * @param video_index Video stream index to demux, or -1 to skip video.
  * @param audio_index Audio stream index to demux, or -1 to skip audio.
@@ -55,22 +93,84 @@ KIT_LOCAL Kit_Demuxer *Kit_CreateDemuxer(
     const Kit_Timer *timer
 );
 
+/**
+ * @brief Creates a tap on a demuxer: a demuxer with packet buffers of its own, which is fed from the reads of the
+ * leader instead of reading the source itself. This way several players can decode the same source while it is
+ * read and parsed only once.
+ *
+ * The tap is fed only while it is open, see Kit_SetDemuxerTapOpen(). Packets are tagged with the serial of the
+ * tap's own timer, and a seek of the leader bumps that serial and sends the tap a seek packet, so the decoders of
+ * the tap follow the seeks of the leader. A full tap buffer holds up the leader, so all taps and the leader are
+ * read at the pace of the slowest one.
+ *
+ * If the leader is closed first, it sends the open taps an EOF packet and stays allocated until the last tap is
+ * closed. Source streams selected by a tap are not discarded at the container level, even if the leader has not
+ * selected them.
+ *
+ * @param leader Demuxer to tap; must not be a tap itself.
+ * @param video_index Video stream index to take, or -1 to skip video.
+ * @param audio_index Audio stream index to take, or -1 to skip audio.
+ * @param subtitle_index Subtitle stream index to take, or -1 to skip subtitles.
+ * @param config Player configuration to copy buffer sizes from; not retained.
+ * @param timer Primary sync timer of the player that decodes from the tap.
+ * @return New tap, or NULL on failure or if the leader has KIT_DEMUXER_MAX_TAPS taps already (Kit_SetError() is
+ * called).
+ */
+KIT_LOCAL Kit_Demuxer *Kit_CreateDemuxerTap(
+    Kit_Demuxer *leader,
+    int video_index,
+    int audio_index,
+    int subtitle_index,
+    const Kit_PlayerConfig *config,
+    const Kit_Timer *timer
+);
+
+/**
+ * @brief Starts or stops feeding a tap. A closed tap gets no packets, so that a stopped player does not hold up
+ * its leader. No-op if the demuxer is not a tap.
+ *
+ * @param demuxer Tap to open or close; may be NULL.
+ * @param open True to start feeding the tap.
+ */
+KIT_LOCAL void Kit_SetDemuxerTapOpen(Kit_Demuxer *demuxer, bool open);
+
+/**
+ * @brief Writes an EOF-tagged sentinel packet into every buffer of every open tap. Called by the demuxer thread of
+ * the leader once the source is at EOF.
+ *
+ * @param demuxer Leader whose taps to send to.
+ */
+KIT_LOCAL void Kit_SendDemuxerTapEOFPackets(Kit_Demuxer *demuxer);
+
 /**
  * @brief Frees a demuxer's packet buffers, scratch packet and the struct itself.
  *
+ * Resets the discard state of all source streams back to AVDISCARD_DEFAULT. A tap is instead detached from its
+ * leader, which updates the discard state on its next run. A demuxer that still has taps sends them an EOF packet
+ * and is only freed along with the last of them; its source must stay valid until then.
+ *
  * @param demuxer Pointer to the demuxer pointer; set to NULL after closing. No-op if NULL or already-NULL.
  */
 KIT_LOCAL void Kit_CloseDemuxer(Kit_Demuxer **demuxer);
 
 /**
- * @brief Reads and routes one packet from the source into the matching stream-type buffer.
+ * @brief Reads and routes packets from the source into the matching stream-type buffers.
  *
- * Transient read errors are retried (with a delay) up to the configured attempt limit, per the
- * demuxer_read_* fields of Kit_PlayerConfig. A genuine AVERROR_EOF is never retried. Packets for streams that
- * are not selected are dropped. Writing into a buffer may block if that buffer is currently full.
+ * Consecutive packets that go to the same buffer are collected and written as one batch, up to the configured
+ * packet_batch_size of Kit_PlayerDemuxerConfig. Transient read errors are retried (with a delay) up to the
+ * configured attempt limit, per the demuxer_read_* fields of Kit_PlayerConfig. A genuine AVERROR_EOF is never
+ * retried. Unselected streams are discarded at the container level, and any of their packets that the
+ * container still hands out are dropped. Discard changes from Kit_SetDemuxerStreamIndex() are applied here.
+ *
+ * A buffer that is full, either by packet count or by its byte budget (packet_buffer_bytes of the stream config),
+ * does not stop the other streams: packets for it are held back in its side queue (overflow_size of
+ * Kit_PlayerDemuxerConfig), and written in order on later calls as room frees up. Writing only blocks once the
+ * side queue of the full buffer is full as well, or right away if the side queue is off. On EOF, the remaining
+ * side queue packets are written out before this reports EOF.
  *
  * @param demuxer Demuxer to run.
- * @return true if a packet was read (whether routed or dropped); false on EOF or after exhausting retries.
+ * @return true if packets were read (whether routed or dropped) or are still queued; false on EOF or after
+ * exhausting retries.
  */
 KIT_LOCAL bool Kit_RunDemuxer(Kit_Demuxer *demuxer);
 
@@ -84,7 +184,9 @@ KIT_LOCAL bool Kit_RunDemuxer(Kit_Demuxer *demuxer);
 KIT_LOCAL Kit_PacketBuffer *Kit_GetDemuxerPacketBuffer(const Kit_Demuxer *demuxer, Kit_BufferIndex buffer_index);
 
 /**
- * @brief Flushes all of the demuxer's packet buffers and clears the demuxer's abort state.
+ * @brief Flushes all of the demuxer's packet buffers and side queues, and clears the demuxer's abort state.
+ *
+ * The side queues belong to the demuxer thread, so this must only be called while it is stopped, or from it.
  *
  * @param demuxer Demuxer whose buffers to flush; no-op if NULL.
  */
@@ -104,9 +206,13 @@ KIT_LOCAL void Kit_AbortDemuxer(Kit_Demuxer *demuxer);
 /**
  * @brief Seeks the underlying format context and, on success, flushes buffers and injects a seek marker packet.
  *
+ * If the source has a keyframe index, the entries found so far are added to the format context first, so that
+ * libavformat can seek straight to the nearest keyframe.
+ *
  * On success, flushes all packet buffers, bumps the demuxer's sync timer handle's clock serial via
  * Kit_IncreaseTimerSerial(), and writes a seek-tagged packet (carrying the new serial) into every active
- * buffer so decoder threads can detect the seek and re-base their clocks. On failure, no state is changed
+ * buffer so decoder threads can detect the seek and re-base their clocks. Open taps get a seek packet under a
+ * bumped serial of their own timers as well. On failure, no state is changed
  * and playback continues from the old position; the clock serial is only bumped when the seek succeeds.
  *
  * @param demuxer Demuxer to seek.
@@ -115,9 +221,38 @@ KIT_LOCAL void Kit_AbortDemuxer(Kit_Demuxer *demuxer);
  */
 KIT_LOCAL bool Kit_DemuxerSeek(Kit_Demuxer *demuxer, int64_t seek_target);
 
+/**
+ * @brief Seeks like Kit_DemuxerSeek(), but for a demuxer that follows the seeks of another one on the same timer,
+ * such as the demuxer of an external audio or subtitle source.
+ *
+ * Instead of bumping the clock serial, the seek packet and all packets read after it are tagged with the given
+ * serial: the one the leading demuxer installed for the same seek. If the seek fails, no state is changed, and
+ * the packets keep the serial they had, so that data from the old position is never passed off as coming from
+ * the new one.
+ *
+ * @param demuxer Demuxer to seek.
+ * @param seek_target Target position, in AV_TIME_BASE units (passed through to avformat_seek_file()).
+ * @param serial Clock serial for the seek.
+ * @return true if avformat_seek_file() succeeded, false otherwise.
+ */
+KIT_LOCAL bool Kit_FollowDemuxerSeek(Kit_Demuxer *demuxer, int64_t seek_target, unsigned int serial);
+
+/**
+ * @brief Keeps tagging packets with the serial they are tagged with now, even if the clock serial changes, until
+ * the next successful Kit_FollowDemuxerSeek().
+ *
+ * May only be called while the demuxer is not being run.
+ *
+ * @param demuxer Demuxer to pin the serial of.
+ */
+KIT_LOCAL void Kit_HoldDemuxerSerial(Kit_Demuxer *demuxer);
+
 /**
  * @brief Flushes and reassigns the source stream index used for one stream type (e.g. on an audio track switch).
  *
+ * The container level discard state of the streams is updated on the next Kit_RunDemuxer() call, from the
+ * demuxer thread.
+ *
  * @param demuxer Demuxer to update.
  * @param index Stream type whose index to change.
  * @param stream_index New source stream index to demux for that type.
@@ -127,11 +262,25 @@ KIT_LOCAL void Kit_SetDemuxerStreamIndex(Kit_Demuxer *demuxer, Kit_BufferIndex i
 /**
  * @brief Writes an EOF-tagged sentinel packet into one stream type's buffer, signaling its decoder to drain.
  *
+ * Safe to call from another thread while the demuxer thread is sending its own EOF packets on exit, but not
+ * while it is still running Kit_RunDemuxer() or Kit_DemuxerSeek().
+ *
  * @param demuxer Demuxer to send from.
  * @param index Stream type whose buffer receives the EOF packet; no-op if that buffer doesn't exist.
  */
 KIT_LOCAL void Kit_SendDemuxerEOFPacket(Kit_Demuxer *demuxer, Kit_BufferIndex index);
 
+/**
+ * @brief Gets the usage counters of one stream type's packet buffer.
+ *
+ * @param demuxer Demuxer to query; may be NULL.
+ * @param buffer_index Stream type to query.
+ * @param stats Receives the counters; left untouched if the buffer doesn't exist.
+ * @return true if the buffer exists, false otherwise.
+ */
+KIT_LOCAL bool
+Kit_GetDemuxerBufferStats(const Kit_Demuxer *demuxer, Kit_BufferIndex buffer_index, Kit_PacketBufferStats *stats);
+
 /**
  * @brief Gets the current fill level and capacity of one stream type's packet buffer.
  *
@@ -3,38 +3,58 @@
 
 /**
  * @brief Background thread that repeatedly runs a Kit_Demuxer until stopped or EOF, and applies a pending seek at
- * the start of its next run. On EOF, it sends an EOF sentinel packet to every active stream buffer.
+ * the start of its next run. On EOF, it sends an EOF sentinel packet to every active stream buffer, including
+ * those of the demuxer's taps.
  *
  * @file kitdemuxerthread.h
  * @author Tuomas Virtanen
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
  */
 
+#include "kitchensink3/internal/kitbufferevent.h"
 #include "kitchensink3/internal/kitbufferindex.h"
 #include "kitchensink3/internal/kitdemuxer.h"
 #include "kitchensink3/internal/kitpacketbuffer.h"
 #include "kitchensink3/kitconfig.h"
+#include <SDL3/SDL_mutex.h>
 #include <SDL3/SDL_thread.h>
 #include <stdbool.h>
 
+/**
+ * @brief Outcome of the last seek a demuxer thread was asked to run, for the threads that follow it.
+ */
+typedef enum Kit_DemuxerSeekState {
+    KIT_DEMUXER_SEEK_NONE = 0, ///< No seek has been requested
+    KIT_DEMUXER_SEEK_PENDING,  ///< Seek requested, but not run yet
+    KIT_DEMUXER_SEEK_DONE,     ///< Seek succeeded, and installed seek_serial on the clock
+    KIT_DEMUXER_SEEK_FAILED,   ///< Seek failed; the demuxer goes on from its old position
+} Kit_DemuxerSeekState;
+
 /**
  * @brief Demuxer thread state: the demuxer it drives, SDL thread handle, run flag and pending seek request.
  */
 typedef struct Kit_DemuxerThread {
     Kit_Demuxer *demuxer;
+    Kit_BufferEvent *event;           ///< Signaled on exit; may be NULL
     SDL_Thread *thread;
     SDL_AtomicInt run;
-    bool seek;           ///< Seek request flag; may only be set while the thread is not running
-    int64_t seek_target; ///< Seek target position; may only be set while the thread is not running
+    bool seek;                        ///< Seek request flag; may only be set while the thread is not running
+    int64_t seek_target;              ///< Seek target position; may only be set while the thread is not running
+    struct Kit_DemuxerThread *leader; ///< Thread whose pending seek this one follows; NULL for a leading seek
+    SDL_Mutex *seek_lock;             ///< Guards seek_state and seek_serial
+    SDL_Condition *seek_done;         ///< Broadcast when the pending seek has run, and when a follower stops
+    Kit_DemuxerSeekState seek_state;  ///< Outcome of the last seek, for the followers
+    unsigned int seek_serial;         ///< Clock serial installed by the last successful seek
 } Kit_DemuxerThread;
 
 /**
  * @brief Creates a demuxer thread bound to a demuxer, but does not start it.
  *
  * @param demuxer Demuxer this thread will drive; not owned by the thread.
+ * @param event Event to signal when the thread exits; may be NULL.
  * @return New demuxer thread (not started), or NULL on allocation failure.
  */
-KIT_LOCAL Kit_DemuxerThread *Kit_CreateDemuxerThread(Kit_Demuxer *demuxer);
+KIT_LOCAL Kit_DemuxerThread *Kit_CreateDemuxerThread(Kit_Demuxer *demuxer, Kit_BufferEvent *event);
 
 /**
  * @brief Stops, waits for, and frees a demuxer thread.
@@ -54,6 +74,27 @@ KIT_LOCAL void Kit_CloseDemuxerThread(Kit_DemuxerThread **demuxer);
  */
 KIT_LOCAL void Kit_SeekDemuxerThread(Kit_DemuxerThread *demuxer_thread, int64_t seek_target);
 
+/**
+ * @brief Queues a following seek, see Kit_FollowDemuxerSeek(), to be performed as soon as the demuxer thread is
+ * (re)started.
+ *
+ * With a leader, the thread does not demux at all until the leader has run the seek queued on it with
+ * Kit_SeekDemuxerThread(). If that seek succeeded, this thread seeks under the clock serial the leader installed;
+ * if it failed, the seek is dropped, and both go on from where they were. Without a leader, the thread seeks
+ * right away, under the current clock serial. Either way, the packets keep the serial they had until a seek of
+ * this demuxer succeeds.
+ *
+ * May only be called while both threads are stopped, like Kit_SeekDemuxerThread(). The leader must outlive the
+ * follower, or at least its pending follow.
+ *
+ * @param demuxer_thread Thread to queue the seek on; must currently be stopped.
+ * @param leader Thread with a seek queued for the same position, or NULL.
+ * @param seek_target Target position, in AV_TIME_BASE units, forwarded to Kit_FollowDemuxerSeek().
+ */
+KIT_LOCAL void Kit_FollowDemuxerThreadSeek(
+    Kit_DemuxerThread *demuxer_thread, Kit_DemuxerThread *leader, int64_t seek_target
+);
+
 /**
  * @brief Gets the underlying demuxer's packet buffer for a given stream type.
  *
@@ -74,7 +115,8 @@ KIT_LOCAL void Kit_StartDemuxerThread(Kit_DemuxerThread *demuxer_thread);
 /**
  * @brief Clears the run flag, asking the demuxer thread to exit at its next loop check.
  *
- * This only clears the flag; it does not wake up a thread blocked writing into a full packet buffer. If the
+ * A thread waiting for the seek of its leader (see Kit_FollowDemuxerThreadSeek()) is woken up. Otherwise this
+ * only clears the flag; it does not wake up a thread blocked writing into a full packet buffer. If the
  * thread may be blocked, call Kit_AbortDemuxer() as well, or Kit_WaitDemuxerThread() can deadlock.
  *
  * @param demuxer_thread Thread to stop; no-op if NULL or not running.
@@ -94,7 +136,7 @@ KIT_LOCAL void Kit_WaitDemuxerThread(Kit_DemuxerThread *demuxer_thread);
 /**
  * @brief Checks whether the demuxer thread's run flag is still set.
  *
- * @param demuxer_thread Thread to query.
+ * @param demuxer_thread Thread to query; may be NULL.
  * @return true if the run flag is set (thread is running or about to exit on next check), false otherwise.
  */
 KIT_LOCAL bool Kit_IsDemuxerThreadAlive(Kit_DemuxerThread *demuxer_thread);
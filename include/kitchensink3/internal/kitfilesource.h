@@ -0,0 +1,83 @@
+#ifndef KITFILESOURCE_H
+#define KITFILESOURCE_H
+
+/**
+ * @brief Local file I/O for Kit_CreateSourceFromFile(). Where the platform supports it, the file is memory mapped
+ * and reads are served straight from the mapping, with read-ahead hints given to the kernel as the demuxer moves
+ * through the file. Elsewhere, or if mapping fails, the file is read through an SDL_IOStream. Also serves
+ * Kit_CreateSourceFromMemory(), the same way as a mapped file, but from the caller's memory.
+ *
+ * @file kitfilesource.h
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kitchensink3/kitconfig.h"
+#include "kitchensink3/kitsource.h"
+
+#define KIT_FILE_ADVISE_WINDOW (4 * 1024 * 1024) ///< Bytes ahead of the read position to hint the kernel about
+
+/**
+ * @brief Opaque local file. See Kit_OpenFileSource().
+ */
+typedef struct Kit_FileSource Kit_FileSource;
+
+/**
+ * @brief Opens a local file for reading.
+ *
+ * @param path File path
+ * @param flags Kit_SourceFileFlags
+ * @return New file, or NULL on failure (see Kit_GetError())
+ */
+KIT_LOCAL Kit_FileSource *Kit_OpenFileSource(const char *path, unsigned int flags);
+
+/**
+ * @brief Opens a block of memory for reading like a file.
+ *
+ * @param data Memory to read; must stay valid until the file is closed
+ * @param size Size of data in bytes
+ * @param free_cb Called with data when the file is closed, or right away if this fails. May be NULL.
+ * @return New file, or NULL on failure (see Kit_GetError())
+ */
+KIT_LOCAL Kit_FileSource *Kit_OpenMemorySource(const void *data, size_t size, Kit_FreeCallback free_cb);
+
+/**
+ * @brief Unmaps or closes the file (or releases the memory, with the free callback), and frees it.
+ *
+ * @param ref Pointer to the file pointer; set to NULL on return. No-op if NULL or *ref is NULL.
+ */
+KIT_LOCAL void Kit_CloseFileSource(Kit_FileSource **ref);
+
+/**
+ * @brief Tells whether the file is being read from memory (a mapping, or memory given by the caller).
+ *
+ * @param file File to query
+ * @return True if in memory, false if read through an SDL_IOStream
+ */
+KIT_LOCAL bool Kit_IsFileSourceInMemory(const Kit_FileSource *file);
+
+/**
+ * @brief Reads from the file. Has the Kit_ReadCallback signature, so it can be handed to AVIO as-is.
+ *
+ * @param opaque Kit_FileSource to read from
+ * @param buf Buffer to copy the data into
+ * @param size Max bytes to read
+ * @return Bytes read, AVERROR_EOF at the end of file, or another negative AVERROR code on error
+ */
+KIT_LOCAL int Kit_ReadFileSource(void *opaque, uint8_t *buf, int size);
+
+/**
+ * @brief Seeks the file. Has the Kit_SeekCallback signature, so it can be handed to AVIO as-is.
+ *
+ * @param opaque Kit_FileSource to seek
+ * @param offset Seek offset in bytes
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END, optionally with AVSEEK_FORCE; or AVSEEK_SIZE
+ * @return New position (or the size, for AVSEEK_SIZE), or <0 on error
+ */
+KIT_LOCAL int64_t Kit_SeekFileSource(void *opaque, int64_t offset, int whence);
+
+#endif // KITFILESOURCE_H
@@ -2,7 +2,7 @@
 #define KITLIBSTATE_H
 
 /**
- * @brief Process-wide singleton holding SDL_kitchensink's init flags and libass handles.
+ * @brief Process-wide singleton holding SDL_kitchensink's init flags, libass handles and decoder thread budget.
  *
  * @file kitlibstate.h
  * @author Tuomas Virtanen
@@ -12,17 +12,19 @@
 #include "kitchensink3/internal/libass.h"
 #include "kitchensink3/kitconfig.h"
 
+#include <SDL3/SDL_atomic.h>
 #include <SDL3/SDL_loadso.h>
 
 /**
- * @brief Global library state: init flags and libass handles. All tuning lives in the
- * per-player Kit_PlayerConfig. There is exactly one static instance, accessed via
- * Kit_GetLibraryState().
+ * @brief Global library state: init flags, libass handles and the decoder thread budget. All other tuning lives
+ * in the per-player Kit_PlayerConfig. There is exactly one static instance, accessed via Kit_GetLibraryState().
  */
 typedef struct Kit_LibraryState {
     unsigned int init_flags;
     ASS_Library *libass_handle;
     SDL_SharedObject *ass_so_handle;
+    int decoder_thread_limit;      ///< Max libavcodec threads of all decoders together, 0 for no limit
+    SDL_AtomicInt decoder_threads; ///< libavcodec threads currently reserved by open decoders
 } Kit_LibraryState;
 
 /**
@@ -32,4 +34,24 @@ typedef struct Kit_LibraryState {
  */
 KIT_LOCAL Kit_LibraryState *Kit_GetLibraryState(void);
 
+/**
+ * @brief Reserves libavcodec threads for a decoder from the process-wide budget set with Kit_InitWithOptions().
+ *
+ * Without a limit, this returns thread_count as-is and reserves nothing. With a limit, the decoder gets as many of
+ * the threads it wants as are left (0 wants one per logical CPU core). If that is fewer than two, the decoder
+ * should run single threaded, and nothing is reserved. Safe to call from any thread.
+ *
+ * @param thread_count Requested thread count, 0 for autodetect
+ * @param reserved Number of threads reserved; must be given back with Kit_ReleaseDecoderThreads()
+ * @return Thread count to set on the codec context
+ */
+KIT_LOCAL int Kit_ReserveDecoderThreads(int thread_count, int *reserved);
+
+/**
+ * @brief Gives threads reserved with Kit_ReserveDecoderThreads() back to the budget.
+ *
+ * @param reserved Number of threads reserved; 0 is a no-op
+ */
+KIT_LOCAL void Kit_ReleaseDecoderThreads(int reserved);
+
 #endif // KITLIBSTATE_H
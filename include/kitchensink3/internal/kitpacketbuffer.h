@@ -10,20 +10,50 @@
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
  */
 
+#include "kitchensink3/internal/kitbufferevent.h"
 #include "kitchensink3/kitconfig.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KIT_PACKET_BUFFER_MAX_SPIN 1000 ///< Upper limit for Kit_SetPacketBufferSpin(), in microseconds
+#define KIT_PACKET_BUFFER_WAKE_ANY -1   ///< Wake level that signals the wake event on every write
+#define KIT_PACKET_BUFFER_WAKE_NONE 101 ///< Wake level that is never reached
 
 typedef void *(*buf_obj_alloc)();
 typedef void (*buf_obj_unref)(void *obj);
 typedef void (*buf_obj_free)(void **obj);
 typedef void (*buf_obj_move)(void *dst, void *src);
 typedef void (*buf_obj_ref)(void *dst, void *src);
+typedef size_t (*buf_obj_size)(const void *obj);
+typedef void (*buf_obj_peek)(void *dst, const void *obj);
+typedef void (*buf_watermark_cb)(void *userdata, bool high);
 
 /**
  * @brief Opaque thread-safe circular buffer of pre-allocated objects. See Kit_CreatePacketBuffer().
  */
 typedef struct Kit_PacketBuffer Kit_PacketBuffer;
 
+/**
+ * @brief Usage counters of a packet buffer, see Kit_GetPacketBufferStats(). Counted since buffer creation.
+ */
+typedef struct Kit_PacketBufferStats {
+    uint64_t writes;        ///< Items written
+    uint64_t reads;         ///< Items read (flushed items are not counted)
+    uint64_t write_wait_ns; ///< Total time writers spent blocked on a full buffer, in nanoseconds
+    uint64_t read_wait_ns;  ///< Total time readers spent blocked on an empty buffer, in nanoseconds
+    uint64_t aborts;        ///< Number of Kit_AbortPacketBuffer() calls
+    size_t peak_length;     ///< Highest number of items queued at once
+} Kit_PacketBufferStats;
+
+/**
+ * @brief Flags for Kit_CreatePacketBuffer().
+ */
+enum
+{
+    KIT_PACKET_BUFFER_SPSC = 0x1, ///< Single producer: writes do not take the buffer mutex unless they must block
+};
+
 /**
  * @brief Allocates a packet buffer and pre-allocates `capacity` slot objects via alloc_cb.
  *
@@ -34,6 +64,10 @@ typedef struct Kit_PacketBuffer Kit_PacketBuffer;
  * @param move_cb Callback used to move an object's contents from src into dst
  * @param ref_cb Callback used to take a reference from src into dst (may be NULL if the buffer is
  * never read via Kit_BeginPacketBufferRead())
+ * @param flags Zero, or KIT_PACKET_BUFFER_SPSC if only one thread ever writes to the buffer at a time. In
+ * that mode the writer and the readers never contend for the buffer mutex on the hot path; the writer only
+ * locks it when it has to block on a full buffer or wake up a reader blocked on an empty one. Reads, flushes
+ * and aborts may still come from any thread.
  *
  * @return New packet buffer, or NULL on allocation failure (see Kit_GetError())
  */
@@ -43,7 +77,8 @@ KIT_LOCAL Kit_PacketBuffer *Kit_CreatePacketBuffer(
     buf_obj_unref unref_cb,
     buf_obj_free free_cb,
     buf_obj_move move_cb,
-    buf_obj_ref ref_cb
+    buf_obj_ref ref_cb,
+    unsigned int flags
 );
 /**
  * @brief Frees all slot objects and destroys the buffer. All reader/writer threads must have
@@ -53,6 +88,97 @@ KIT_LOCAL Kit_PacketBuffer *Kit_CreatePacketBuffer(
  */
 KIT_LOCAL void Kit_FreePacketBuffer(Kit_PacketBuffer **buffer);
 
+/**
+ * @brief Limits the amount of data queued in the buffer, in addition to the slot capacity.
+ *
+ * Writers block while at least byte_limit bytes are queued, so the limit may be overshot by the last
+ * item written. An empty buffer always accepts an item, however large. Must be called before the buffer
+ * is used by any other thread.
+ *
+ * @param buffer Buffer to configure
+ * @param size_cb Callback returning the payload size of a slot object, in bytes; may be NULL if byte_limit is 0
+ * @param byte_limit Byte limit; 0 for no limit
+ */
+KIT_LOCAL void Kit_SetPacketBufferByteLimit(Kit_PacketBuffer *buffer, buf_obj_size size_cb, int byte_limit);
+
+/**
+ * @brief Sets the callback that reports the fill level crossing the watermarks set with
+ * Kit_SetPacketBufferWatermarks(). Must be called before the buffer is used by any other thread.
+ *
+ * The callback runs on the thread that moved the fill level: the writer for the high watermark, a reader or a
+ * flush for the low one. It is run outside the buffer mutex (except for writes in locked mode), but the
+ * thread it runs on is stalled until it returns, so it must be quick.
+ *
+ * @param buffer Buffer to configure
+ * @param cb Callback; high is true when the high watermark was reached, false for the low one. NULL disables.
+ * @param userdata Passed to the callback as-is
+ */
+KIT_LOCAL void Kit_SetPacketBufferWatermarkCallback(Kit_PacketBuffer *buffer, buf_watermark_cb cb, void *userdata);
+
+/**
+ * @brief Sets the low and high watermarks of the buffer. Thread-safe; may be called at any time.
+ *
+ * The high watermark is reported when the fill level reaches it, and the low one when the level drops to it.
+ * Each is only reported once until the other one has been, so that a level hovering around one watermark
+ * does not produce a stream of callbacks. A fresh buffer starts out low.
+ *
+ * @param buffer Buffer to configure
+ * @param low Low watermark, in percent of the capacity; -1 to disable both
+ * @param high High watermark, in percent of the capacity (must be over low); -1 to disable both
+ */
+KIT_LOCAL void Kit_SetPacketBufferWatermarks(Kit_PacketBuffer *buffer, int low, int high);
+
+/**
+ * @brief Sets the event that is signaled when a write brings the fill level up to the wake level (see
+ * Kit_SetPacketBufferWakeLevel()), and on resizes. Must be called before the buffer is used by any other thread.
+ *
+ * @param buffer Buffer to configure
+ * @param event Event to signal; NULL disables
+ */
+KIT_LOCAL void Kit_SetPacketBufferWakeEvent(Kit_PacketBuffer *buffer, Kit_BufferEvent *event);
+
+/**
+ * @brief Sets the fill level at which writes signal the wake event. Thread-safe; may be called at any time.
+ *
+ * Only the write that takes the fill level from under the wake level to at or over it signals the event, so that a
+ * thread waiting for the buffer to fill up is not woken up for every item. A fresh buffer signals on every write.
+ *
+ * @param buffer Buffer to configure
+ * @param percent Wake level, in percent of the capacity; KIT_PACKET_BUFFER_WAKE_ANY to signal on every write, or
+ * KIT_PACKET_BUFFER_WAKE_NONE to never signal on writes
+ */
+KIT_LOCAL void Kit_SetPacketBufferWakeLevel(Kit_PacketBuffer *buffer, int percent);
+
+/**
+ * @brief Sets how long a thread busy-waits on the buffer before going to sleep. Thread-safe; may be called at
+ * any time.
+ *
+ * Waking up a sleeping thread can take longer than it takes the other side to make progress, which adds up
+ * when the buffers are kept very short. With spinning enabled, a reader waiting for data (with a timeout) and
+ * a KIT_PACKET_BUFFER_SPSC writer waiting for room first poll the buffer for up to spin_us, without holding
+ * the mutex, and only block if nothing changes in that time. This costs CPU time on every wait that runs out.
+ *
+ * @param buffer Buffer to configure
+ * @param spin_us Max time to spin, in microseconds (0 to KIT_PACKET_BUFFER_MAX_SPIN); 0 disables spinning
+ */
+KIT_LOCAL void Kit_SetPacketBufferSpin(Kit_PacketBuffer *buffer, int spin_us);
+
+/**
+ * @brief Changes the capacity and byte limit of a buffer that is in use, keeping the queued items in order.
+ *
+ * Blocks readers and the writer for the duration of the resize, which allocates or frees slot objects as
+ * needed. If more items are queued than the new capacity allows, they are all kept and the writer is held off
+ * until the readers have brought the buffer below the new capacity. At most one thread may resize a buffer at
+ * a time.
+ *
+ * @param buffer Buffer to resize
+ * @param capacity New capacity in slots (must be > 0)
+ * @param byte_limit New byte limit, 0 for no limit. Must be 0 unless a size callback was set with
+ * Kit_SetPacketBufferByteLimit().
+ * @return true on success, false on allocation failure (see Kit_GetError()), in which case the buffer is unchanged
+ */
+KIT_LOCAL bool Kit_ResizePacketBuffer(Kit_PacketBuffer *buffer, size_t capacity, int byte_limit);
+
 /**
  * @brief Gets the total slot capacity of the buffer.
  *
@@ -61,12 +187,40 @@ KIT_LOCAL void Kit_FreePacketBuffer(Kit_PacketBuffer **buffer);
  */
 KIT_LOCAL size_t Kit_GetPacketBufferCapacity(const Kit_PacketBuffer *buffer);
 /**
- * @brief Gets the number of currently filled slots. Thread-safe (locks the buffer mutex).
+ * @brief Gets the number of currently filled slots. Thread-safe (locks the buffer mutex). May exceed the
+ * capacity for a while after the buffer was shrunk with Kit_ResizePacketBuffer().
  *
  * @param buffer Buffer to query
  * @return Number of filled slots
  */
 KIT_LOCAL size_t Kit_GetPacketBufferLength(const Kit_PacketBuffer *buffer);
+/**
+ * @brief Gets the byte limit set with Kit_SetPacketBufferByteLimit() or Kit_ResizePacketBuffer().
+ *
+ * @param buffer Buffer to query
+ * @return Byte limit; 0 for no limit
+ */
+KIT_LOCAL int Kit_GetPacketBufferByteLimit(const Kit_PacketBuffer *buffer);
+/**
+ * @brief Gets the number of bytes currently queued, as reported by the size callback given to
+ * Kit_SetPacketBufferByteLimit(). Always 0 if no size callback is set.
+ *
+ * @param buffer Buffer to query
+ * @return Queued bytes
+ */
+KIT_LOCAL size_t Kit_GetPacketBufferBytes(const Kit_PacketBuffer *buffer);
+
+/**
+ * @brief Gets the usage counters of the buffer. Thread-safe (locks the buffer mutex).
+ *
+ * The counters are maintained under the buffer mutex, which readers and blocking writers hold anyway, so a
+ * KIT_PACKET_BUFFER_SPSC writer still publishes items without touching any shared state; its write count is
+ * derived from the read, flush and fill counts instead.
+ *
+ * @param buffer Buffer to query
+ * @param stats Receives the counters
+ */
+KIT_LOCAL void Kit_GetPacketBufferStats(const Kit_PacketBuffer *buffer, Kit_PacketBufferStats *stats);
 
 /**
  * @brief Marks the buffer as aborted and wakes all readers/writers waiting on it, causing their
@@ -78,7 +232,8 @@ KIT_LOCAL size_t Kit_GetPacketBufferLength(const Kit_PacketBuffer *buffer);
 KIT_LOCAL void Kit_AbortPacketBuffer(Kit_PacketBuffer *buffer);
 /**
  * @brief Releases all slot contents, resets the buffer to empty, and clears the aborted flag.
- * Wakes up any writers waiting for free space.
+ * Wakes up any writers waiting for free space. Safe to call while a KIT_PACKET_BUFFER_SPSC writer is
+ * running; an item it publishes concurrently either gets flushed or stays in the buffer.
  *
  * @param buffer Buffer to flush; no-op if NULL
  */
@@ -92,6 +247,29 @@ KIT_LOCAL void Kit_FlushPacketBuffer(Kit_PacketBuffer *buffer);
  * @return true on success, false if the buffer is or becomes aborted
  */
 KIT_LOCAL bool Kit_WritePacketBuffer(Kit_PacketBuffer *buffer, void *src);
+/**
+ * @brief Moves up to count objects into the buffer in order, publishing as many as fit at a time and waking
+ * the reader once per publish. Blocks while the buffer is full; a blocked writer is only woken up once there is
+ * room for the rest of the batch (or half of the buffer, whichever is smaller).
+ *
+ * @param buffer Buffer to write to
+ * @param src Array of count objects whose contents are moved into the buffer via the move callback
+ * @param count Number of objects in src
+ * @return Number of objects written; less than count only if the buffer is or becomes aborted. Objects that
+ * were not written are left untouched in src.
+ */
+KIT_LOCAL size_t Kit_WritePacketBufferBatch(Kit_PacketBuffer *buffer, void **src, size_t count);
+/**
+ * @brief Like Kit_WritePacketBufferBatch(), but never blocks: moves as many objects as there is room for right
+ * now (by slot count and byte budget), in order, and returns.
+ *
+ * @param buffer Buffer to write to
+ * @param src Array of count objects whose contents are moved into the buffer via the move callback
+ * @param count Number of objects in src
+ * @return Number of objects written; 0 if the buffer is full or aborted. Objects that were not written are left
+ * untouched in src.
+ */
+KIT_LOCAL size_t Kit_TryWritePacketBufferBatch(Kit_PacketBuffer *buffer, void **src, size_t count);
 /**
  * @brief Moves the oldest slot's contents into dst, blocking up to timeout ms if the buffer is
  * empty.
@@ -102,11 +280,28 @@ KIT_LOCAL bool Kit_WritePacketBuffer(Kit_PacketBuffer *buffer, void *src);
  * @return true on success, false on timeout, abort, or empty buffer with no wait
  */
 KIT_LOCAL bool Kit_ReadPacketBuffer(Kit_PacketBuffer *buffer, void *dst, int timeout);
+/**
+ * @brief Moves up to count of the oldest objects into dst under a single lock, blocking up to timeout ms if
+ * the buffer is empty. Wakes up a waiting writer at most once.
+ *
+ * With max_bytes, the read stops once the objects taken add up to at least that many bytes, as reported by the
+ * size callback given to Kit_SetPacketBufferByteLimit(). The first object is always taken.
+ *
+ * @param buffer Buffer to read from
+ * @param dst Array of count destinations receiving the moved-out contents via the move callback, oldest first
+ * @param count Maximum number of objects to read
+ * @param max_bytes Byte count to stop reading at; 0 for no limit
+ * @param timeout Max time to wait for data, in milliseconds; <= 0 fails immediately if empty
+ * @return Number of objects read; 0 on timeout, abort, or empty buffer with no wait
+ */
+KIT_LOCAL size_t
+Kit_ReadPacketBufferBatch(Kit_PacketBuffer *buffer, void **dst, size_t count, size_t max_bytes, int timeout);
 
 /**
  * @brief Begins a reference-based read of the oldest slot, blocking up to timeout ms if the
  * buffer is empty. On success, the buffer mutex remains held until Kit_FinishPacketBufferRead()
- * or Kit_CancelPacketBufferRead() is called; the slot is not yet advanced.
+ * or Kit_CancelPacketBufferRead() is called; the slot is not yet advanced. A KIT_PACKET_BUFFER_SPSC
+ * writer keeps filling free slots meanwhile.
  *
  * @param buffer Buffer to read from
  * @param dst Destination receiving a reference to the slot's contents via the ref callback
@@ -129,4 +324,30 @@ KIT_LOCAL void Kit_FinishPacketBufferRead(Kit_PacketBuffer *buffer);
  */
 KIT_LOCAL void Kit_CancelPacketBufferRead(Kit_PacketBuffer *buffer);
 
+/**
+ * @brief Copies a summary of the oldest object out of the buffer without consuming it, blocking up to timeout ms
+ * if the buffer is empty. The buffer mutex is only held while peek_cb runs, so the reader can decide what to do
+ * with the object without holding up the writer, and then consume it with Kit_TakePacketBuffer().
+ *
+ * @param buffer Buffer to read from
+ * @param peek_cb Callback that copies whatever the reader needs from the object into dst; must not modify it
+ * @param dst Destination passed to peek_cb
+ * @param ticket Receives a ticket identifying the peeked object, for Kit_TakePacketBuffer()
+ * @param timeout Max time to wait for data, in milliseconds; <= 0 fails immediately if empty
+ * @return true on success, false on timeout, abort, or empty buffer with no wait
+ */
+KIT_LOCAL bool Kit_PeekPacketBuffer(
+    Kit_PacketBuffer *buffer, buf_obj_peek peek_cb, void *dst, uint64_t *ticket, int timeout
+);
+/**
+ * @brief Consumes the object returned by an earlier Kit_PeekPacketBuffer(), if it is still the oldest one. It is
+ * not if it has been read or flushed by someone else in the meantime; in that case nothing is consumed.
+ *
+ * @param buffer Buffer to read from
+ * @param dst Destination receiving the moved-out contents via the move callback, or NULL to just drop the object
+ * @param ticket Ticket returned by Kit_PeekPacketBuffer()
+ * @return true if the object was consumed, false if it was no longer in the buffer
+ */
+KIT_LOCAL bool Kit_TakePacketBuffer(Kit_PacketBuffer *buffer, void *dst, uint64_t ticket);
+
 #endif // KITFRAMESTREAM_H
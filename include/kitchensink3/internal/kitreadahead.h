@@ -0,0 +1,90 @@
+#ifndef KITREADAHEAD_H
+#define KITREADAHEAD_H
+
+/**
+ * @brief I/O read-ahead stage for sources. A background thread keeps a byte ring filled from the source's read
+ * callback, and the demuxer reads from the ring instead, so that it only has to wait on slow storage or network
+ * reads when the read-ahead window has run dry.
+ *
+ * @file kitreadahead.h
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kitchensink3/kitconfig.h"
+#include "kitchensink3/kitsource.h"
+
+#define KIT_READ_AHEAD_MIN_WINDOW 65536 ///< Smallest read-ahead window, in bytes
+#define KIT_READ_AHEAD_MAX_READ 262144  ///< Largest single read the read-ahead thread makes, in bytes
+
+/**
+ * @brief Callback for releasing the upstream I/O when the read-ahead stage is closed.
+ */
+typedef void (*Kit_ReadAheadCloseCallback)(void *userdata);
+
+/**
+ * @brief Opaque read-ahead stage. See Kit_CreateReadAhead().
+ */
+typedef struct Kit_ReadAhead Kit_ReadAhead;
+
+/**
+ * @brief Creates a read-ahead stage over the given upstream callbacks, and starts its thread.
+ *
+ * From here on the upstream callbacks are called from the read-ahead thread, and from whichever thread calls
+ * Kit_ReadAheadSeek(), but never concurrently.
+ *
+ * @param read_cb Upstream read callback. Must not be NULL.
+ * @param seek_cb Upstream seek callback, or NULL if the upstream cannot seek.
+ * @param close_cb Called with userdata from Kit_CloseReadAhead(), or NULL. Not called if creation fails.
+ * @param userdata Passed to the upstream callbacks as-is.
+ * @param window Read-ahead window in bytes (at least KIT_READ_AHEAD_MIN_WINDOW)
+ * @return New read-ahead stage, or NULL on failure (see Kit_GetError())
+ */
+KIT_LOCAL Kit_ReadAhead *Kit_CreateReadAhead(
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    Kit_ReadAheadCloseCallback close_cb,
+    void *userdata,
+    size_t window
+);
+
+/**
+ * @brief Stops the read-ahead thread, releases the upstream via the close callback, and frees the stage.
+ *
+ * Waits for a read that is in progress upstream to finish. Nothing may be reading from the stage anymore.
+ *
+ * @param ref Pointer to the stage pointer; set to NULL on return. No-op if NULL or *ref is NULL.
+ */
+KIT_LOCAL void Kit_CloseReadAhead(Kit_ReadAhead **ref);
+
+/**
+ * @brief Reads queued data from the stage. Has the Kit_ReadCallback signature, so it can be handed to AVIO as-is.
+ *
+ * Blocks while nothing is queued. Upstream errors and the end of stream are passed on once the data read before
+ * them has been consumed; after that, the upstream is read again.
+ *
+ * @param opaque Kit_ReadAhead to read from
+ * @param buf Buffer to copy the data into
+ * @param size Max bytes to read
+ * @return Bytes read, AVERROR_EOF at the end of stream, or another negative AVERROR code on error
+ */
+KIT_LOCAL int Kit_ReadAheadRead(void *opaque, uint8_t *buf, int size);
+
+/**
+ * @brief Seeks the stage. Has the Kit_SeekCallback signature, so it can be handed to AVIO as-is.
+ *
+ * Seeks that land inside the queued data are served from the ring without touching the upstream. Others wait
+ * for a read that is in progress upstream to finish, then seek the upstream and drop the queued data. Must not
+ * be used if the stage was created without an upstream seek callback.
+ *
+ * @param opaque Kit_ReadAhead to seek
+ * @param offset Seek offset in bytes
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END, optionally with AVSEEK_FORCE; or AVSEEK_SIZE
+ * @return New position (or the size, for AVSEEK_SIZE), or <0 on error
+ */
+KIT_LOCAL int64_t Kit_ReadAheadSeek(void *opaque, int64_t offset, int whence);
+
+#endif // KITREADAHEAD_H
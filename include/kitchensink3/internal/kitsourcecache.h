@@ -0,0 +1,42 @@
+#ifndef KITSOURCECACHE_H
+#define KITSOURCECACHE_H
+
+/**
+ * @brief Lookups and stores for the stream information cache (Kit_SourceCache), used by source creation to skip
+ * avformat_find_stream_info() for media it has already analyzed.
+ *
+ * @file kitsourcecache.h
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include "kitchensink3/kitconfig.h"
+#include "kitchensink3/kitsource.h"
+
+#include <libavformat/avformat.h>
+#include <stdbool.h>
+
+/**
+ * @brief Fills in the stream information of a freshly opened format context from the cache.
+ *
+ * The entry is only used if the streams found from the container headers match it in number, type, codec and
+ * time base. Counts a hit or a miss.
+ *
+ * @param cache Cache to look up from
+ * @param key Cache key
+ * @param format_ctx Format context, opened with avformat_open_input() but not analyzed yet
+ * @return True if the stream information was filled in, false if the streams must be analyzed
+ */
+KIT_LOCAL bool Kit_LoadSourceCache(Kit_SourceCache *cache, const char *key, AVFormatContext *format_ctx);
+
+/**
+ * @brief Stores the stream information of an analyzed format context into the cache, replacing any entry with the
+ * same key. Failures are not reported; the source just won't be cached.
+ *
+ * @param cache Cache to store into
+ * @param key Cache key
+ * @param format_ctx Format context, after avformat_find_stream_info()
+ */
+KIT_LOCAL void Kit_StoreSourceCache(Kit_SourceCache *cache, const char *key, const AVFormatContext *format_ctx);
+
+#endif // KITSOURCECACHE_H
@@ -0,0 +1,85 @@
+#ifndef KITSOURCEINDEX_H
+#define KITSOURCEINDEX_H
+
+/**
+ * @brief Background keyframe indexer for sources whose containers have no seek index of their own (eg. raw
+ * elementary streams and MPEG-TS). A thread reads through a second, independent source on the same media, and
+ * records the byte position and timestamp of every keyframe of the best video stream. Before each seek, the
+ * demuxer adds the entries found so far to the AVStream index of the source, where both the generic and the
+ * binary search seeks of libavformat find them, so a seek only needs to read from the nearest keyframe on.
+ *
+ * The index can be saved to and loaded from a sidecar file, so that the media only needs to be scanned once.
+ *
+ * @file kitsourceindex.h
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include "kitchensink3/kitconfig.h"
+#include "kitchensink3/kitsource.h"
+
+#include <libavformat/avformat.h>
+#include <stdbool.h>
+
+/**
+ * @brief Opaque keyframe index. See Kit_CreateSourceIndex().
+ */
+typedef struct Kit_SourceIndex Kit_SourceIndex;
+
+/**
+ * @brief Creates a keyframe index for the best video stream of an opened source.
+ *
+ * If path is given and holds an index made from the same stream of a source with the same size (and modification
+ * time, for local files), it is loaded, and the index is complete right away. Otherwise the index starts out
+ * empty, and must be filled by starting a scan with Kit_StartSourceIndex().
+ *
+ * @param format_ctx Format context of the source, after stream analysis
+ * @param path Sidecar file to load from, and to save the finished index to; may be NULL
+ * @return New index, or NULL if the source has no video stream or no known size, or on failure
+ */
+KIT_LOCAL Kit_SourceIndex *Kit_CreateSourceIndex(const AVFormatContext *format_ctx, const char *path);
+
+/**
+ * @brief Starts the indexer thread.
+ *
+ * @param index Index to fill; must not be complete or already started
+ * @param scan Second source opened on the same media, for the thread to read through. Always taken over by the
+ * index, and closed with it (or right away, on failure). May be NULL, in which case this just fails.
+ * @return True if the thread was started
+ */
+KIT_LOCAL bool Kit_StartSourceIndex(Kit_SourceIndex *index, Kit_Source *scan);
+
+/**
+ * @brief Stops the indexer thread if it is running, closes the scan source, and frees the index.
+ *
+ * @param ref Pointer to the index pointer; set to NULL on return. No-op if NULL or *ref is NULL.
+ */
+KIT_LOCAL void Kit_CloseSourceIndex(Kit_SourceIndex **ref);
+
+/**
+ * @brief Tells whether the whole source has been indexed (or the index was loaded from a sidecar).
+ *
+ * @param index Index to query
+ * @return True if complete
+ */
+KIT_LOCAL bool Kit_IsSourceIndexComplete(Kit_SourceIndex *index);
+
+/**
+ * @brief Adds the entries found since the last call to the AVStream index of the demuxed format context.
+ *
+ * Must be called from the thread that reads the format context, ie. the demuxer thread.
+ *
+ * @param index Index to take the entries from
+ * @param format_ctx Format context of the source the index was created for
+ */
+KIT_LOCAL void Kit_ApplySourceIndex(Kit_SourceIndex *index, AVFormatContext *format_ctx);
+
+/**
+ * @brief Gets the index counters.
+ *
+ * @param index Index to query
+ * @param stats Counters are written here
+ */
+KIT_LOCAL void Kit_GetSourceIndexState(Kit_SourceIndex *index, Kit_SourceIndexStats *stats);
+
+#endif // KITSOURCEINDEX_H
@@ -18,6 +18,19 @@
 #include "kitchensink3/kitplayer.h"
 #include "kitchensink3/kitsource.h"
 
+/**
+ * @brief Decode quality steps of the adaptive skipping, from full quality down. Each step skips more decoding work,
+ * so that a decoder that can't keep up gets back in time, instead of decoding frames that get dropped as late.
+ */
+typedef enum Kit_VideoSkipLevel
+{
+    KIT_VIDEO_SKIP_NONE = 0,    ///< Full quality
+    KIT_VIDEO_SKIP_LOOP_FILTER, ///< Skip the deblocking loop filter
+    KIT_VIDEO_SKIP_NONREF,      ///< Also skip frames that no other frame references
+    KIT_VIDEO_SKIP_NONKEY,      ///< Decode keyframes only
+    KIT_VIDEO_SKIP_COUNT
+} Kit_VideoSkipLevel;
+
 /**
  * @brief Creates and initializes a video decoder for the given stream.
  *
@@ -30,7 +43,7 @@
  * @param format_request Requested output video format, or defaults where fields are unset
  * @param config Video stream configuration; the buffer size and sync thresholds are copied
  *        from it (the pointer is not retained)
- * @param thread_count FFmpeg codec thread count, 0 for autodetect
+ * @param thread_count FFmpeg codec thread count, 0 for autodetect; used if config does not set its own
  * @param sync_timer Sync timer to attach to the decoder (ownership transferred to this call)
  * @param stream_index Index of the video stream to decode
  * @return New decoder on success, NULL on error (see Kit_GetError())
@@ -93,4 +106,16 @@ KIT_LOCAL void Kit_UnlockVideoDecoderRaw(Kit_Decoder *decoder);
  */
 KIT_LOCAL int Kit_GetVideoDecoderOutputFormat(const Kit_Decoder *dec, Kit_VideoOutputFormat *output);
 
+/**
+ * @brief Gets the current decode quality step of the adaptive skipping.
+ *
+ * The reader counts the frames it drops as late, and the frames it shows on time. Every few packets, the decoder
+ * thread goes a step down in quality if any frames were late, and a step back up after a while of frames being
+ * on time. Seeks restore full quality. Safe to call from any thread.
+ *
+ * @param dec Video decoder instance
+ * @return Current Kit_VideoSkipLevel; always KIT_VIDEO_SKIP_NONE if adaptive skipping is disabled
+ */
+KIT_LOCAL Kit_VideoSkipLevel Kit_GetVideoDecoderSkipLevel(const Kit_Decoder *dec);
+
 #endif // KITVIDEO_H
@@ -17,6 +17,21 @@ extern "C" {
 #define KIT_CODEC_NAME_MAX 8
 #define KIT_CODEC_DESC_MAX 48
 
+/**
+ * @brief Decoder threading modes. Used as values for Kit_PlayerConfig video.thread_type and audio.thread_type.
+ *
+ * Frame threads decode several frames in parallel, and hold back up to one frame per thread before output. Slice
+ * threads decode the parts of a single frame in parallel, and add no latency, but only help if the codec supports
+ * them and the stream is encoded with several slices (or tiles, for VP9).
+ */
+typedef enum Kit_ThreadType
+{
+    KIT_THREAD_TYPE_AUTO = 0, ///< Frame threads if the codec has them, otherwise slice threads
+    KIT_THREAD_TYPE_FRAME,    ///< Frame threads only; single threaded if the codec has none
+    KIT_THREAD_TYPE_SLICE,    ///< Slice threads only; single threaded if the codec has none
+    KIT_THREAD_TYPE_COUNT
+} Kit_ThreadType;
+
 /**
  * @brief Contains information about the used codec for playback
  */
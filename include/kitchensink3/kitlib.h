@@ -35,6 +35,13 @@ enum
     KIT_INIT_HW_DECODE = 0x4, ///< Enable hardware decoding
 };
 
+/**
+ * @brief Library wide tuning, please see Kit_InitWithOptions()
+ */
+typedef struct Kit_LibraryOptions {
+    int decoder_threads; ///< Max libavcodec threads for the decoders of all players together, 0 = no limit (default 0)
+} Kit_LibraryOptions;
+
 /**
  * @brief Initialize SDL_kitchensink library.
  *
@@ -63,6 +70,44 @@ enum
  */
 KIT_API int Kit_Init(unsigned int flags);
 
+/**
+ * @brief Resets library options to their default values.
+ *
+ * Call this before setting any fields, so that fields added in later versions get sane values.
+ *
+ * @param options Options struct to reset
+ */
+KIT_API void Kit_ResetLibraryOptions(Kit_LibraryOptions *options);
+
+/**
+ * @brief Initialize SDL_kitchensink library with library wide options.
+ *
+ * Works like Kit_Init(), but also takes options that apply to every player of the process.
+ *
+ * `decoder_threads` caps the libavcodec threads used by all decoders of all players together. Each Kit_PlayerConfig
+ * thread_count is then only a request: a decoder gets as many of the threads it asks for as are still left in the
+ * budget (a thread_count of 0 asks for one per logical CPU core), and gives them back when it is closed. Once fewer
+ * than two are left, decoders run single threaded. The budget is first come, first served; players opened early
+ * keep their threads. This keeps many concurrent players (eg. a grid of previews) from each starting a full set of
+ * threads for every core.
+ *
+ * For example:
+ * ```
+ * Kit_LibraryOptions options;
+ * Kit_ResetLibraryOptions(&options);
+ * options.decoder_threads = 8;
+ * if(Kit_InitWithOptions(KIT_INIT_HW_DECODE, &options) != 0) {
+ *     fprintf(stderr, "Error: %s\n", Kit_GetError());
+ *     return 1;
+ * }
+ * ```
+ *
+ * @param flags Library initialization flags, see Kit_Init()
+ * @param options Library options, or NULL for the defaults
+ * @return Returns 0 on success, 1 on failure.
+ */
+KIT_API int Kit_InitWithOptions(unsigned int flags, const Kit_LibraryOptions *options);
+
 /**
  * @brief Deinitializes SDL_kitchensink
  *
@@ -18,6 +18,7 @@
 
 #include <SDL3/SDL_render.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,20 +56,28 @@ typedef struct Kit_PlayerInfo {
  * @brief Video stream configuration, see Kit_PlayerConfig.
  */
 typedef struct Kit_PlayerVideoConfig {
-    int packet_buffer_size; ///< Input buffer, packets (default 64)
-    int frame_buffer_size;  ///< Output buffer, frames (default 3)
-    int early_threshold;    ///< Early sync threshold, ms (default 5)
-    int late_threshold;     ///< Late sync threshold, ms (default 50)
+    int packet_buffer_size;     ///< Input buffer, packets (default 64)
+    int packet_buffer_bytes;    ///< Input buffer byte budget; 0 = unlimited (default 0)
+    int frame_buffer_size;      ///< Output buffer, frames (default 3)
+    int early_threshold;        ///< Early sync threshold, ms (default 5)
+    int late_threshold;         ///< Late sync threshold, ms (default 50)
+    int thread_count;           ///< FFmpeg threads; 0 = autodetect, -1 = use the player wide thread_count (default -1)
+    Kit_ThreadType thread_type; ///< Decoder threading mode (default KIT_THREAD_TYPE_AUTO)
+    int low_delay;              ///< 1 to have the codec skip its output delay (AV_CODEC_FLAG_LOW_DELAY) (default 0)
+    int adaptive_skip;          ///< 1 to skip decoding work while frames are late, until back on time (default 0)
 } Kit_PlayerVideoConfig;
 
 /**
  * @brief Audio stream configuration, see Kit_PlayerConfig.
  */
 typedef struct Kit_PlayerAudioConfig {
-    int packet_buffer_size; ///< Input buffer, packets (default 64)
-    int frame_buffer_size;  ///< Output buffer, frames (default 64)
-    int early_threshold;    ///< Early sync threshold, ms (default 30)
-    int late_threshold;     ///< Late sync threshold, ms (default 50)
+    int packet_buffer_size;     ///< Input buffer, packets (default 64)
+    int packet_buffer_bytes;    ///< Input buffer byte budget; 0 = unlimited (default 0)
+    int frame_buffer_size;      ///< Output buffer, frames (default 64)
+    int early_threshold;        ///< Early sync threshold, ms (default 30)
+    int late_threshold;         ///< Late sync threshold, ms (default 50)
+    int thread_count;           ///< FFmpeg threads; 0 = autodetect, -1 = use the player wide thread_count (default -1)
+    Kit_ThreadType thread_type; ///< Decoder threading mode (default KIT_THREAD_TYPE_AUTO)
 } Kit_PlayerAudioConfig;
 
 /**
@@ -88,6 +97,7 @@ typedef enum Kit_FontHinting
  */
 typedef struct Kit_PlayerSubtitleConfig {
     int packet_buffer_size;       ///< Input buffer, packets (default 64)
+    int packet_buffer_bytes;      ///< Input buffer byte budget; 0 = unlimited (default 0)
     int frame_buffer_size;        ///< Output buffer, frames (default 64; bitmap subtitles only)
     Kit_FontHinting font_hinting; ///< Font hinting mode for libass (default KIT_FONT_HINTING_NONE)
 } Kit_PlayerSubtitleConfig;
@@ -96,15 +106,82 @@ typedef struct Kit_PlayerSubtitleConfig {
  * @brief Demuxer configuration, see Kit_PlayerConfig.
  */
 typedef struct Kit_PlayerDemuxerConfig {
-    int read_attempts;    ///< Read attempts before treating a failure as EOF (default 3)
-    int read_retry_delay; ///< Delay between read attempts, ms (default 10)
+    int read_attempts;     ///< Read attempts before treating a failure as EOF (default 3)
+    int read_retry_delay;  ///< Delay between read attempts, ms (default 10)
+    int packet_batch_size; ///< Max consecutive packets of a stream queued at once (default 1 = off, max 32)
+    int overflow_size;     ///< Extra packets a stream may hold past a full buffer (default 32, max 256; 0 = off)
 } Kit_PlayerDemuxerConfig;
 
+/**
+ * @brief Input packet buffer usage counters, see Kit_GetPlayerBufferStats().
+ *
+ * The counters accumulate over the whole lifetime of the player. Sample them periodically and look at the
+ * differences: a growing write_wait_ns means the demuxer is stalled on a full buffer (the decoder is not
+ * keeping up), a growing read_wait_ns means the decoder is starved for packets (I/O or demuxing is not
+ * keeping up).
+ */
+typedef struct Kit_PlayerBufferStats {
+    uint64_t writes;          ///< Packets written into the buffer by the demuxer
+    uint64_t reads;           ///< Packets read from the buffer by the decoder
+    uint64_t write_wait_ns;   ///< Total time the demuxer spent blocked on a full buffer, in nanoseconds
+    uint64_t read_wait_ns;    ///< Total time the decoder spent blocked on an empty buffer, in nanoseconds
+    uint64_t aborts;          ///< Number of times pending waits were aborted (stop, seek, stream switch)
+    unsigned int peak_length; ///< Highest number of packets queued at once
+} Kit_PlayerBufferStats;
+
+/**
+ * @brief Buffer of a stream, see Kit_PlayerBufferCallback.
+ */
+typedef enum Kit_BufferSide
+{
+    KIT_BUFFER_INPUT = 0, ///< Input packet buffer, filled by the demuxer and drained by the decoder
+    KIT_BUFFER_OUTPUT,    ///< Output frame buffer, filled by the decoder and drained by the application
+} Kit_BufferSide;
+
+/**
+ * @brief Buffer fill level crossings, see Kit_PlayerBufferCallback.
+ */
+typedef enum Kit_BufferLevel
+{
+    KIT_BUFFER_LOW = 0, ///< Fill level dropped to the low watermark
+    KIT_BUFFER_HIGH,    ///< Fill level rose to the high watermark
+} Kit_BufferLevel;
+
+/**
+ * @brief Watermarks of the buffers of a stream, see Kit_SetPlayerBufferWatermarks().
+ *
+ * Watermarks are given in percent of the buffer capacity (0-100). Each low/high pair must either be
+ * disabled with -1 for both, or have the low watermark under the high one.
+ */
+typedef struct Kit_PlayerBufferWatermarks {
+    int input_low;   ///< Input packet buffer low watermark, or -1
+    int input_high;  ///< Input packet buffer high watermark, or -1
+    int output_low;  ///< Output frame buffer low watermark, or -1 (video and audio only)
+    int output_high; ///< Output frame buffer high watermark, or -1 (video and audio only)
+} Kit_PlayerBufferWatermarks;
+
+/**
+ * @brief Callback for buffer watermark crossings, see Kit_SetPlayerBufferCallback().
+ *
+ * @param player Player whose buffer crossed a watermark
+ * @param type Stream type of the buffer
+ * @param side Which buffer of the stream crossed the watermark
+ * @param level Watermark that was crossed
+ * @param userdata Userdata given to Kit_SetPlayerBufferCallback()
+ */
+typedef void (*Kit_PlayerBufferCallback)(
+    Kit_Player *player, Kit_StreamType type, Kit_BufferSide side, Kit_BufferLevel level, void *userdata
+);
+
 /**
  * @brief Per-player configuration for Kit_CreatePlayer().
  *
- * Initialize with Kit_ResetPlayerConfig(), then override the fields you need.
- * All values are fixed at player creation; out-of-range values are clamped.
+ * Initialize with Kit_ResetPlayerConfig(), then override the fields you need. Out-of-range values are clamped.
+ *
+ * The buffer sizes (packet_buffer_size, packet_buffer_bytes and frame_buffer_size of each stream) and
+ * buffer_spin_time can be changed on a running player with Kit_SetPlayerConfig(). All other fields, such as the
+ * thread counts and thread types, the sync thresholds, and the demuxer packet_batch_size and overflow_size, are
+ * fixed at player creation.
  *
  * CAUTION on the buffer sizes: the defaults are chosen so that the pipeline can re-prime
  * itself after a seek. Very small audio buffer sizes (a few packets/frames) can deadlock
@@ -112,9 +189,55 @@ typedef struct Kit_PlayerDemuxerConfig {
  * clock, and with too little audio buffer slack that backpressure stalls the shared demuxer
  * thread before video can decode its first frame. Prefer the defaults; if you must shrink,
  * keep the audio buffers at a couple dozen packets/frames or more.
+ *
+ * The packet buffers are limited by packet count, and optionally by the total size of the queued packets
+ * (packet_buffer_bytes). The byte budget bounds the memory held by the input side regardless of the stream
+ * bitrate: the demuxer stops reading while a buffer holds at least that many bytes, so a buffer may go over
+ * the budget by at most one packet.
+ *
+ * While the buffer of a stream is full, the demuxer keeps up to overflow_size more packets of that stream in a
+ * side queue, so that the other streams are not held up. A stream may thus hold up to packet_buffer_size plus
+ * overflow_size packets. The side queue counts against the byte budget as well: it only takes packets while the
+ * buffer and the queue together are under the budget, so they go over it by at most one packet between them.
+ *
+ * The caution above applies to the byte budget too -- a budget too small for the audio stream to
+ * cover the video decoder's startup can stall post-seek playback.
+ *
+ * With very small buffers (a frame_buffer_size of 1-2), waking up a pipeline thread that sleeps on a buffer
+ * can make up a good part of the decode-to-present latency. Setting buffer_spin_time makes the pipeline threads
+ * busy-wait for up to that long before they go to sleep on a buffer. This lowers the latency when the other
+ * side catches up within the spin time, at the cost of burning CPU time on every wait that does not.
+ *
+ * A demuxer.packet_batch_size above 1 makes the demuxer hold back the packets it reads until it has that many
+ * consecutive packets of one stream, or a packet of some other stream turns up, and then queue them with one
+ * wake-up of the decoder. This saves some locking and wake-ups on local files with high packet rates, but a
+ * packet read from a live or network source may then wait for the next reads to arrive, which can take a while.
+ * Batching is off by default; only turn it on for sources that can always be read without waiting.
+ *
+ * The thread_count applies to all decoders, unless the video or audio config sets a thread_count of its own. The
+ * default threading mode (KIT_THREAD_TYPE_AUTO) prefers frame threads, which give the best throughput but delay
+ * the output by up to one frame per thread. For interactive use, set video.thread_type to KIT_THREAD_TYPE_SLICE,
+ * or use a low video.thread_count. If the library was initialized with a decoder thread limit (see
+ * Kit_InitWithOptions()), the thread counts are only requests, and the decoders get as many threads as are left
+ * of the library-wide budget.
+ *
+ * video.low_delay asks the codec to output every frame as soon as it is decoded, instead of holding frames back
+ * to put them into presentation order. This is only correct for streams without reordered frames (eg. camera
+ * feeds and most live streams, which are encoded without B-frames); on other streams the frames may come out
+ * in the wrong order. Kit_SetPlayerConfigLowLatency() sets up the whole pipeline for low latency.
+ *
+ * Video frames that are already more than video.late_threshold behind the clock when the codec outputs them are
+ * dropped right away on the decoder thread, without converting or buffering them.
+ *
+ * With video.adaptive_skip, a video decoder that falls behind the clock so that half of its frames or more get
+ * dropped as late lowers its decode quality step by step: first it skips the deblocking loop filter, then the
+ * frames that no other frame references, and, if it still keeps falling behind, it decodes keyframes only. Once
+ * no frame has been late for a second, it steps back up, a step per second. Seeks always restore full quality.
+ * This is off by default, as the skipped work shows up as artifacts and dropped frames.
  */
 typedef struct Kit_PlayerConfig {
-    int thread_count;            ///< FFmpeg threads per codec; 0 = autodetect (default 0). Applies to all decoders.
+    int thread_count;            ///< FFmpeg threads per codec; 0 = autodetect (default 0). See also video/audio.
+    int buffer_spin_time;        ///< Spin before blocking on a buffer, microseconds; 0 = off (default 0, max 1000)
     Kit_PlayerVideoConfig video; ///< Video stream configuration
     Kit_PlayerAudioConfig audio; ///< Audio stream configuration
     Kit_PlayerSubtitleConfig subtitle; ///< Subtitle stream configuration
@@ -128,6 +251,35 @@ typedef struct Kit_PlayerConfig {
  */
 KIT_API void Kit_ResetPlayerConfig(Kit_PlayerConfig *config);
 
+/**
+ * @brief Sets the player configuration up for the lowest delay from a decoded frame to the screen.
+ *
+ * Meant for live sources such as camera previews and live streams, where the latency matters more than
+ * smoothness. This does the following:
+ * - The video codec skips its output delay (video.low_delay) and uses slice threads only, so that frames come
+ *   out of the decoder as soon as their packet goes in. See the notes in Kit_PlayerConfig about streams with
+ *   reordered frames.
+ * - The video frame buffer holds a single frame, and the video packet buffer only a few packets.
+ * - The sync thresholds are tightened, so that frames that are late are dropped sooner instead of shown.
+ * - The demuxer passes every packet on as soon as it is read, and the pipeline threads spin briefly before they
+ *   sleep on a buffer.
+ *
+ * The audio buffers are kept large enough to not stall the demuxer after seeks (see Kit_PlayerConfig). Other
+ * fields are left as they are. The stream analysis done when opening the source also delays the start of live
+ * sources; to keep it short, open the source with the options from Kit_SetSourceOptionsFastOpen().
+ *
+ * For example:
+ * ```
+ * Kit_PlayerConfig config;
+ * Kit_ResetPlayerConfig(&config);
+ * Kit_SetPlayerConfigLowLatency(&config);
+ * player = Kit_CreatePlayer(src, video_index, -1, -1, NULL, NULL, w, h, &config);
+ * ```
+ *
+ * @param config Configuration to modify. Must not be NULL.
+ */
+KIT_API void Kit_SetPlayerConfigLowLatency(Kit_PlayerConfig *config);
+
 /**
  * @brief Creates a new player from a source.
  *
@@ -214,6 +366,54 @@ KIT_API Kit_Player *Kit_CreatePlayer(
     const Kit_PlayerConfig *config
 );
 
+/**
+ * @brief Create a player that shares the demuxer of another player
+ *
+ * Creates a player for the source of another player, which decodes the packets that the other player's demuxer
+ * reads, instead of reading and parsing the source once more. This is useful for showing the same media on several
+ * screens at once. The shared player has decoders, output formats, buffers and a playback clock of its own, and is
+ * otherwise used just like any other player.
+ *
+ * Since there is just one read position, the players move along together:
+ * - Packets are handed to a shared player only while it is playing or paused, and only while the other player
+ *   is playing. A stopped shared player gets nothing, and a player that starts playing mid-way joins in from
+ *   wherever the other player is reading.
+ * - Seeks are done on the other player, and all players sharing its demuxer follow them. Kit_PlayerSeek() fails
+ *   on a shared player.
+ * - The source is read at the pace of the slowest player. A paused shared player holds up the others once its
+ *   packet buffers are full.
+ *
+ * The stream indexes are for the source of the other player, and may differ from the ones the other player uses;
+ * streams selected by either player are read from the source. Streams can be switched and closed as usual, but
+ * not taken from external sources with Kit_SetPlayerExternalStream().
+ *
+ * The player whose demuxer is shared may be closed first. The shared players then get no more packets and play out
+ * what they have buffered; the source must stay open until they are closed as well. A shared player can't be
+ * shared again.
+ *
+ * @param player Player whose demuxer to share
+ * @param video_stream_index Video stream index or -1 if not wanted
+ * @param audio_stream_index Audio stream index or -1 if not wanted
+ * @param subtitle_stream_index Subtitle stream index or -1 if not wanted
+ * @param video_format_request Video format request object or NULL.
+ * @param audio_format_request Audio format request object or NULL.
+ * @param screen_w Screen width in pixels
+ * @param screen_h Screen height in pixels
+ * @param config Player configuration or NULL for defaults. The demuxer settings are taken from the other player.
+ * @return Initialized Kit_Player or NULL
+ */
+KIT_API Kit_Player *Kit_CreateSharedPlayer(
+    Kit_Player *player,
+    int video_stream_index,
+    int audio_stream_index,
+    int subtitle_stream_index,
+    const Kit_VideoFormatRequest *video_format_request,
+    const Kit_AudioFormatRequest *audio_format_request,
+    int screen_w,
+    int screen_h,
+    const Kit_PlayerConfig *config
+);
+
 /**
  * @brief Close previously initialized player
  *
@@ -242,6 +442,50 @@ KIT_API void Kit_ClosePlayer(Kit_Player *player);
  */
 KIT_API void Kit_SetPlayerScreenSize(Kit_Player *player, int w, int h);
 
+/**
+ * @brief Gets the configuration the player is currently running with
+ *
+ * This is the clamped copy of the creation-time configuration, including any buffer size
+ * changes made later with Kit_SetPlayerConfig().
+ *
+ * @param player Player instance
+ * @param config Receives the configuration. Must not be NULL.
+ */
+KIT_API void Kit_GetPlayerConfig(const Kit_Player *player, Kit_PlayerConfig *config);
+
+/**
+ * @brief Changes the buffer sizes of a running player
+ *
+ * Resizes the packet buffers (packet_buffer_size, packet_buffer_bytes) of all streams and the
+ * video and audio frame buffers (frame_buffer_size) in place, without stopping or flushing
+ * the pipeline. Packets and frames that are already queued are kept. If a buffer currently
+ * holds more than its new size, it just stops accepting data until it has drained below it.
+ *
+ * The buffer_spin_time is applied to all buffers right away as well.
+ *
+ * The new sizes are also used by decoders created later with Kit_SetPlayerStream(); the
+ * subtitle frame_buffer_size only takes effect then. All other config fields are fixed at
+ * player creation and are ignored here. Values are clamped like in Kit_CreatePlayer().
+ *
+ * The same caution about small buffer sizes applies as with Kit_PlayerConfig.
+ *
+ * For example, to grow the video input buffer for a network stream:
+ * ```
+ * Kit_PlayerConfig config;
+ * Kit_GetPlayerConfig(player, &config);
+ * config.video.packet_buffer_size = 256;
+ * if(Kit_SetPlayerConfig(player, &config) != 0) {
+ *     fprintf(stderr, "Unable to resize buffers: %s\n", Kit_GetError());
+ * }
+ * ```
+ *
+ * @param player Player instance
+ * @param config New configuration. Must not be NULL.
+ * @return 0 on success, 1 on error. On error, some of the buffers may already have been resized;
+ *     Kit_GetPlayerConfig() reports the sizes actually in use.
+ */
+KIT_API int Kit_SetPlayerConfig(Kit_Player *player, const Kit_PlayerConfig *config);
+
 /**
  * @brief Gets the current video stream index
  *
@@ -732,6 +976,64 @@ KIT_API int Kit_GetPlayerAspectRatio(const Kit_Player *player, int *num, int *de
  */
 KIT_API int Kit_ClosePlayerStream(Kit_Player *player, Kit_StreamType type);
 
+/**
+ * @brief Gets the usage counters of the input packet buffer of a stream type
+ *
+ * Useful for telling apart stalls caused by the demuxer blocking on a full buffer from stalls caused by a
+ * decoder starving on an empty one. The counters are maintained at all times and cost next to nothing.
+ * Fetching them takes the buffer lock briefly, so avoid calling this in a tight loop.
+ *
+ * @param player Player instance
+ * @param type Stream type to query (video, audio or subtitle)
+ * @param stats Receives the counters. Zeroed if the player has no buffer for the stream type.
+ * @return true if the player has a packet buffer for the stream type, false otherwise
+ */
+KIT_API bool Kit_GetPlayerBufferStats(const Kit_Player *player, Kit_StreamType type, Kit_PlayerBufferStats *stats);
+
+/**
+ * @brief Sets the callback that reports buffer watermark crossings
+ *
+ * Instead of polling the buffer state getters, an application can set low/high watermarks on the
+ * buffers with Kit_SetPlayerBufferWatermarks() and get notified when the fill level crosses them.
+ * A high watermark is reported when the fill level rises to it, and a low watermark when the level
+ * drops to it; after that, the same watermark is not reported again until the other one has been.
+ * Buffers start out low, so the first report of a buffer is always KIT_BUFFER_HIGH.
+ *
+ * The callback runs on whichever thread moved the fill level: the demuxer or decoder threads, or
+ * the thread reading audio/video data from the player. It stalls that thread, so keep it short --
+ * for example set a flag or post an event -- and do not call any other player functions from it.
+ * Callbacks from different threads may arrive concurrently, and in a different order than the
+ * crossings happened; use the buffer state getters if the exact current state is needed.
+ *
+ * Once this returns, the previously set callback is no longer running and will not be called again.
+ *
+ * @param player Player instance
+ * @param callback Callback, or NULL to disable callbacks
+ * @param userdata Passed to the callback as-is
+ */
+KIT_API void Kit_SetPlayerBufferCallback(Kit_Player *player, Kit_PlayerBufferCallback callback, void *userdata);
+
+/**
+ * @brief Sets the watermarks of the buffers of a stream type
+ *
+ * The watermarks stay in effect over stream switches. All watermarks are disabled by default. Output
+ * watermarks are ignored for subtitles.
+ *
+ * For example, to drive a buffering indicator from the video input buffer:
+ * ```
+ * Kit_PlayerBufferWatermarks marks = {.input_low = 10, .input_high = 90, .output_low = -1, .output_high = -1};
+ * Kit_SetPlayerBufferCallback(player, on_buffer_level, &ui_state);
+ * Kit_SetPlayerBufferWatermarks(player, KIT_STREAMTYPE_VIDEO, &marks);
+ * ```
+ *
+ * @param player Player instance
+ * @param type Stream type (video, audio or subtitle)
+ * @param watermarks New watermarks. Must not be NULL.
+ * @return 0 on success, 1 on invalid stream type or watermarks (see Kit_GetError()).
+ */
+KIT_API int
+Kit_SetPlayerBufferWatermarks(Kit_Player *player, Kit_StreamType type, const Kit_PlayerBufferWatermarks *watermarks);
+
 /**
  * @brief Selects stream index for specified stream type.
  *
@@ -749,6 +1051,31 @@ KIT_API int Kit_ClosePlayerStream(Kit_Player *player, Kit_StreamType type);
  */
 KIT_API int Kit_SetPlayerStream(Kit_Player *player, Kit_StreamType type, int index);
 
+/**
+ * @brief Selects an audio or subtitle stream from another source, such as a separate audio track or an
+ * external .srt/.ass subtitle file.
+ *
+ * The external source is read by its own demuxer thread, but shares the playback clock and the seeks of the
+ * player: Kit_PlayerSeek() seeks it to the same position once the seek of the main source has succeeded, and its
+ * packets are timed against the same clock as the streams of the main source. If the player is already playing,
+ * the external source is first seeked to the current playback position. The stream can be switched away again
+ * with Kit_SetPlayerStream(), or closed with Kit_ClosePlayerStream().
+ *
+ * The source must stay open until the stream is switched away or the player is closed, and must not be used by
+ * any other player in the meanwhile. Timestamps are taken as is, so the source should start at the same time as
+ * the main source. If switching fails, 1 is returned and the old stream continues to be used.
+ *
+ * Kit_GetPlayerStream() reports the stream index within the external source.
+ *
+ * @param player Player instance
+ * @param type Stream to switch; KIT_STREAMTYPE_AUDIO or KIT_STREAMTYPE_SUBTITLE
+ * @param src External source to take the stream from. If NULL or the main source, this is the same as
+ * Kit_SetPlayerStream().
+ * @param index Stream index within src (list can be queried from the source); -1 closes the stream
+ * @return 0 on success, 1 on failure.
+ */
+KIT_API int Kit_SetPlayerExternalStream(Kit_Player *player, Kit_StreamType type, const Kit_Source *src, int index);
+
 /**
  * @brief Returns the current index of the specified stream type
  *
@@ -33,6 +33,15 @@ typedef enum Kit_StreamType
     KIT_STREAMTYPE_ATTACHMENT ///< Attachment stream (images, etc)
 } Kit_StreamType;
 
+/**
+ * @brief Source file options, please see Kit_CreateSourceFromFile()
+ */
+enum
+{
+    KIT_SOURCE_FILE_NO_MMAP = 0x1,   ///< Read the file through SDL I/O instead of mapping it to memory
+    KIT_SOURCE_FILE_NO_ADVISE = 0x2, ///< Don't give the OS read-ahead hints for the mapped file
+};
+
 /**
  * @brief Audio/video source.
  *
@@ -45,8 +54,91 @@ typedef enum Kit_StreamType
 typedef struct Kit_Source {
     void *format_ctx; ///< FFmpeg: Videostream format context
     void *avio_ctx;   ///< FFmpeg: AVIO context
+    void *read_ahead; ///< Read-ahead stage, if enabled with Kit_SourceOptions
+    void *file;       ///< Local file, if created with Kit_CreateSourceFromFile() or Kit_CreateSourceFromMemory()
+    void *index;      ///< Keyframe index, if enabled with Kit_SourceOptions
 } Kit_Source;
 
+/**
+ * @brief Stream information cache, shared between sources.
+ *
+ * Opening a source normally analyzes its streams by reading and decoding a part of it. A cache remembers the
+ * results by key, so that when the same media is opened again, only the container headers need to be read. See
+ * Kit_CreateSourceCache() and Kit_SourceOptions.
+ */
+typedef struct Kit_SourceCache Kit_SourceCache;
+
+/**
+ * @brief Stream information cache counters, see Kit_GetSourceCacheStats().
+ */
+typedef struct Kit_SourceCacheStats {
+    uint64_t hits;        ///< Opens that used cached stream information
+    uint64_t misses;      ///< Opens that looked up the cache, but had to analyze the streams
+    unsigned int entries; ///< Entries currently in the cache
+} Kit_SourceCacheStats;
+
+/**
+ * @brief Keyframe index counters, see Kit_GetSourceIndexStats().
+ */
+typedef struct Kit_SourceIndexStats {
+    unsigned int entries; ///< Keyframes indexed so far
+    int complete;         ///< 1 if the whole source has been indexed, 0 if still in progress or stopped on an error
+} Kit_SourceIndexStats;
+
+/**
+ * @brief Options for opening a source.
+ *
+ * Initialize with Kit_ResetSourceOptions(), then override the fields you need, and pass to one of the
+ * Kit_CreateSourceFrom*WithOptions() functions.
+ *
+ * read_ahead enables a background thread that reads the source ahead of the demuxer into a window of the given
+ * size. This keeps slow reads (network, optical or spinning disks) off the demuxer thread, so they only stall
+ * playback when the whole window has been consumed. Note that with read-ahead enabled, the read and seek callbacks
+ * of a custom or IOStream source are called from the read-ahead thread too (never concurrently), so they must not
+ * depend on running on the thread that created the source. Sources opened from a URL that ffmpeg does not open
+ * as a plain byte stream (eg. RTSP) are opened without read-ahead.
+ *
+ * io_buffer_size and io_direct tune how ffmpeg reads from custom, IOStream and read-ahead sources. The read
+ * callback is called at least once per io_buffer_size bytes, so high bitrate sources on storage that has a
+ * per-call cost benefit from a larger buffer. With io_direct set, reads that are at least as large as the buffer
+ * (eg. big video packets) bypass it, and go to the read callback as a single call straight into the demuxer's
+ * memory. Direct mode also passes every seek to the seek callback, so leave it off if seeking is expensive.
+ *
+ * probe_size, probe_duration and trust_headers bound the stream analysis done while opening. By default, the
+ * analysis is unbounded, which gives the most accurate stream information, but may read through a lot of data on
+ * large or damaged files before the source is ready. With trust_headers set, the analysis is skipped completely if
+ * the container headers already tell the codec and basic format of every stream. Kit_SetSourceOptionsFastOpen()
+ * sets all three to values that favor a fast start.
+ *
+ * cache enables the stream information cache. Entries are looked up by cache_key if it is set; otherwise, for
+ * sources opened from a local file path, by the path, file size and modification time. Custom and IOStream
+ * sources without a cache_key are not cached. Use a cache_key that changes whenever the media does. A cached
+ * entry is only used if the container headers agree with it on the streams and their codecs; otherwise the
+ * streams are analyzed and the entry is replaced. Formats that only find their streams while reading packets
+ * (eg. MPEG-TS) are always analyzed.
+ *
+ * build_index starts a background thread that reads through the media once, and records the position of every
+ * keyframe of the best video stream. Seeks then start reading from the nearest recorded keyframe, instead of
+ * searching for it in the file. This makes seeking much faster and more accurate for media that has no seek
+ * index of its own, like raw elementary streams (eg. .h264) and MPEG-TS; other formats gain little from it.
+ * Indexing only works for sources created from a URL, a local file or memory, since it needs to read the media
+ * independently of the demuxer. It is best effort; if the source can't be indexed, it is opened without. With
+ * index_path set, the finished index is saved to that file, and loaded from it the next time the same media is
+ * opened, skipping the scan.
+ */
+typedef struct Kit_SourceOptions {
+    int read_ahead;         ///< Read-ahead window in bytes, 0 to disable; min 65536 (default 0)
+    int io_buffer_size;     ///< AVIO buffer size in bytes; 4096 - 16777216 (default 32768)
+    int io_direct;          ///< 1 to read large requests past the AVIO buffer, 0 to always buffer (default 0)
+    int probe_size;         ///< Max bytes to read for stream analysis, 0 for no limit (default 0)
+    int probe_duration;     ///< Max milliseconds of media to analyze, 0 for no limit (default 0)
+    int trust_headers;      ///< 1 to skip stream analysis if the headers describe all streams (default 0)
+    Kit_SourceCache *cache; ///< Stream information cache, or NULL to not use one (default NULL)
+    const char *cache_key;  ///< Cache key, or NULL to derive one from the file (default NULL)
+    int build_index;        ///< 1 to build a keyframe index in the background for faster seeking (default 0)
+    const char *index_path; ///< Index sidecar file to load and save, or NULL to not use one (default NULL)
+} Kit_SourceOptions;
+
 /**
  * @brief Information for a source stream.
  *
@@ -101,6 +193,69 @@ typedef int (*Kit_ReadCallback)(void *userdata, uint8_t *buf, int size);
  */
 typedef int64_t (*Kit_SeekCallback)(void *userdata, int64_t offset, int whence);
 
+/**
+ * @brief Callback function type for releasing memory
+ *
+ * Used by Kit_CreateSourceFromMemory() to hand the memory back to the application once the source no longer
+ * needs it. Receives the same data pointer that was given to Kit_CreateSourceFromMemory(). For memory from
+ * malloc(), this can simply be free.
+ */
+typedef void (*Kit_FreeCallback)(void *data);
+
+/**
+ * @brief Resets source options to library defaults.
+ *
+ * @param options Options struct to reset
+ */
+KIT_API void Kit_ResetSourceOptions(Kit_SourceOptions *options);
+
+/**
+ * @brief Sets the stream analysis options to values that favor a fast start over exact stream information.
+ *
+ * Trusts the container headers when they are complete, and otherwise analyzes at most 256 KiB or 500 ms of
+ * the source. Other options are left as they are. For streams whose headers are incomplete (eg. raw elementary
+ * streams or MPEG-TS), the reported duration and stream formats may then be less accurate.
+ *
+ * @param options Options struct to modify
+ */
+KIT_API void Kit_SetSourceOptionsFastOpen(Kit_SourceOptions *options);
+
+/**
+ * @brief Creates a stream information cache.
+ *
+ * The cache lives in memory, and can be used by any number of sources, from any thread. When full, the least
+ * recently used entry is dropped to make room. The cache must outlive the Kit_CreateSourceFrom*WithOptions()
+ * calls that use it, but not the sources.
+ *
+ * @param max_entries Maximum number of entries to keep (at least 1)
+ * @return New cache, or NULL on failure (see Kit_GetError())
+ */
+KIT_API Kit_SourceCache *Kit_CreateSourceCache(int max_entries);
+
+/**
+ * @brief Closes a stream information cache and frees all its entries.
+ *
+ * Passing NULL as argument is valid, and will do nothing.
+ *
+ * @param cache Cache to close
+ */
+KIT_API void Kit_CloseSourceCache(Kit_SourceCache *cache);
+
+/**
+ * @brief Drops all entries from a stream information cache. Counters are not reset.
+ *
+ * @param cache Cache to clear
+ */
+KIT_API void Kit_ClearSourceCache(Kit_SourceCache *cache);
+
+/**
+ * @brief Gets the counters of a stream information cache.
+ *
+ * @param cache Cache to query from
+ * @param stats Counters are written here
+ */
+KIT_API void Kit_GetSourceCacheStats(Kit_SourceCache *cache, Kit_SourceCacheStats *stats);
+
 /**
  * @brief Create a new source from a given url
  *
@@ -126,6 +281,18 @@ typedef int64_t (*Kit_SeekCallback)(void *userdata, int64_t offset, int whence);
  */
 KIT_API Kit_Source *Kit_CreateSourceFromUrl(const char *url);
 
+/**
+ * @brief Create a new source from a given url, with options
+ *
+ * Same as Kit_CreateSourceFromUrl(), but with the given options. Passing NULL options is the same as
+ * passing options reset with Kit_ResetSourceOptions().
+ *
+ * @param url File path or URL to a video/audio resource
+ * @param options Source options, or NULL for defaults
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromUrlWithOptions(const char *url, const Kit_SourceOptions *options);
+
 /**
  * @brief Create a new source from custom data
  *
@@ -152,6 +319,25 @@ KIT_API Kit_Source *Kit_CreateSourceFromUrl(const char *url);
  */
 KIT_API Kit_Source *Kit_CreateSourceFromCustom(Kit_ReadCallback read_cb, Kit_SeekCallback seek_cb, void *userdata);
 
+/**
+ * @brief Create a new source from custom data, with options
+ *
+ * Same as Kit_CreateSourceFromCustom(), but with the given options. Passing NULL options is the same as
+ * passing options reset with Kit_ResetSourceOptions().
+ *
+ * @param read_cb Read function callback. Must not be NULL.
+ * @param seek_cb Seek function callback, or NULL if the source does not support seeking.
+ * @param userdata Any data (or NULL). Will be passed to read_cb and/or seek_cb functions as-is.
+ * @param options Source options, or NULL for defaults
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromCustomWithOptions(
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    void *userdata,
+    const Kit_SourceOptions *options
+);
+
 /**
  * @brief Create a new source from SDL IOStream struct
  *
@@ -180,6 +366,120 @@ KIT_API Kit_Source *Kit_CreateSourceFromCustom(Kit_ReadCallback read_cb, Kit_See
  */
 KIT_API Kit_Source *Kit_CreateSourceFromIO(SDL_IOStream *io_stream);
 
+/**
+ * @brief Create a new source from SDL IOStream struct, with options
+ *
+ * Same as Kit_CreateSourceFromIO(), but with the given options. Passing NULL options is the same as
+ * passing options reset with Kit_ResetSourceOptions().
+ *
+ * @param io_stream Initialized SDL_IOStream
+ * @param options Source options, or NULL for defaults
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromIOWithOptions(SDL_IOStream *io_stream, const Kit_SourceOptions *options);
+
+/**
+ * @brief Create a new source from a local file
+ *
+ * Like Kit_CreateSourceFromUrl() for a file path, but on platforms that support it (Linux, BSDs, macOS), the file
+ * is memory mapped, and the demuxer reads it straight from the mapping instead of through read system calls. As
+ * the demuxer moves through the file, the OS is hinted to read the next few megabytes in ahead of time. Packets
+ * are copied once, from the mapping into their own buffers; direct reads (see Kit_SourceOptions io_direct) are
+ * turned on for mapped files to keep it at that.
+ *
+ * Files that can't be mapped (empty files, pipes, or any file on other platforms) are read through an
+ * SDL_IOStream instead. The file is kept open until the source is closed.
+ *
+ * Note that if the file is truncated by someone else while it is mapped, reading it may crash the process.
+ * Use KIT_SOURCE_FILE_NO_MMAP for files that may be modified while playing.
+ *
+ * For example:
+ * ```
+ * Kit_Source *src = Kit_CreateSourceFromFile("myvideo.mkv", 0);
+ * if(src == NULL) {
+ *     fprintf(stderr, "Error: %s\n", Kit_GetError());
+ *     return 1;
+ * }
+ * ```
+ *
+ * @param path Path to a local video/audio file
+ * @param flags Zero or more of KIT_SOURCE_FILE_NO_MMAP and KIT_SOURCE_FILE_NO_ADVISE
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromFile(const char *path, unsigned int flags);
+
+/**
+ * @brief Create a new source from a local file, with options
+ *
+ * Same as Kit_CreateSourceFromFile(), but with the given options. Passing NULL options is the same as
+ * passing options reset with Kit_ResetSourceOptions().
+ *
+ * @param path Path to a local video/audio file
+ * @param flags Zero or more of KIT_SOURCE_FILE_NO_MMAP and KIT_SOURCE_FILE_NO_ADVISE
+ * @param options Source options, or NULL for defaults
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *
+Kit_CreateSourceFromFileWithOptions(const char *path, unsigned int flags, const Kit_SourceOptions *options);
+
+/**
+ * @brief Create a new source from a block of memory
+ *
+ * For media that is already in memory (eg. unpacked from an archive, or downloaded). The demuxer reads straight
+ * from the given memory; it is not copied to a buffer of the source's own first, and direct reads (see
+ * Kit_SourceOptions io_direct) are always on, so packets are copied once, from the memory into their own buffers.
+ *
+ * The memory must stay valid and unchanged until the source is closed. If free_cb is given, the source takes
+ * ownership of the memory, and calls free_cb with data when it is closed. Note that it is also called if creating
+ * the source fails, so the caller should not touch the memory after this call either way. If free_cb is NULL,
+ * the memory stays with the caller.
+ *
+ * For example:
+ * ```
+ * Kit_Source *src = Kit_CreateSourceFromMemory(data, size, free);
+ * if(src == NULL) {
+ *     fprintf(stderr, "Error: %s\n", Kit_GetError());
+ *     return 1;
+ * }
+ * ```
+ *
+ * @param data Media file contents
+ * @param size Size of data in bytes
+ * @param free_cb Function for releasing data, or NULL to keep it with the caller
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromMemory(const void *data, size_t size, Kit_FreeCallback free_cb);
+
+/**
+ * @brief Create a new source from a block of memory, with options
+ *
+ * Same as Kit_CreateSourceFromMemory(), but with the given options. Passing NULL options is the same as
+ * passing options reset with Kit_ResetSourceOptions(). The io_direct and read_ahead options are ignored.
+ *
+ * @param data Media file contents
+ * @param size Size of data in bytes
+ * @param free_cb Function for releasing data, or NULL to keep it with the caller
+ * @param options Source options, or NULL for defaults
+ * @return Returns an initialized Kit_Source* on success or NULL on failure
+ */
+KIT_API Kit_Source *Kit_CreateSourceFromMemoryWithOptions(
+    const void *data,
+    size_t size,
+    Kit_FreeCallback free_cb,
+    const Kit_SourceOptions *options
+);
+
+/**
+ * @brief Gets the keyframe index counters of a source.
+ *
+ * Can be used to eg. show indexing progress, or to wait until seeking is fast.
+ *
+ * @param src Source to query
+ * @param stats Counters are written here
+ * @return 0 on success, 1 if the source has no keyframe index (see Kit_SourceOptions build_index)
+ */
+KIT_API int Kit_GetSourceIndexStats(const Kit_Source *src, Kit_SourceIndexStats *stats);
+
 /**
  * @brief Closes a previously initialized source
  *
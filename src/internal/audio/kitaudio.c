@@ -153,6 +153,13 @@ static void dec_get_audio_buffers_cb(const Kit_Decoder *ref, unsigned int *lengt
         *capacity = Kit_GetPacketBufferCapacity(audio_decoder->buffer);
 }
 
+static Kit_PacketBuffer *dec_get_audio_output_buffer_cb(const Kit_Decoder *ref) {
+    assert(ref);
+    assert(ref->userdata);
+    const Kit_AudioDecoder *audio_decoder = ref->userdata;
+    return audio_decoder->buffer;
+}
+
 static Kit_DecoderInputResult dec_input_audio_cb(const Kit_Decoder *decoder, const AVPacket *in_packet) {
     assert(decoder != NULL);
     int ret = KIT_FAULT_WRAP_CODE("decode_send", avcodec_send_packet(decoder->codec_ctx, in_packet));
@@ -243,7 +250,9 @@ Kit_Decoder *Kit_CreateAudioDecoder(
     if((decoder = Kit_CreateDecoder(
             stream,
             sync_timer,
-            thread_count,
+            config->thread_count >= 0 ? config->thread_count : thread_count,
+            config->thread_type,
+            false,
             KIT_HWDEVICE_TYPE_ALL,
             dec_input_audio_cb,
             dec_decode_audio_cb,
@@ -251,6 +260,7 @@ Kit_Decoder *Kit_CreateAudioDecoder(
             dec_abort_audio_cb,
             dec_close_audio_cb,
             dec_get_audio_buffers_cb,
+            dec_get_audio_output_buffer_cb,
             audio_decoder
         )) == NULL) {
         // No need to Kit_SetError, it will be set in Kit_CreateDecoder.
@@ -285,7 +295,8 @@ Kit_Decoder *Kit_CreateAudioDecoder(
             (buf_obj_unref)av_frame_unref,
             (buf_obj_free)av_frame_free,
             (buf_obj_move)av_frame_move_ref,
-            (buf_obj_ref)av_frame_ref
+            (buf_obj_ref)av_frame_ref,
+            KIT_PACKET_BUFFER_SPSC
         )) == NULL) {
         Kit_SetError("Unable to create an output buffer for stream %d", stream_index);
         goto exit_current;
@@ -365,15 +376,16 @@ exit_none:
     return NULL;
 }
 
-static double Kit_GetCurrentPTS(const Kit_Decoder *decoder) {
-    Kit_AudioDecoder *audio_decoder = decoder->userdata;
-    return audio_decoder->current->best_effort_timestamp * av_q2d(decoder->stream->time_base);
+static double Kit_GetFramePTS(const Kit_Decoder *decoder, const Kit_DecodedFrameInfo *info) {
+    return info->pts * av_q2d(decoder->stream->time_base);
 }
 
 int Kit_GetAudioDecoderData(Kit_Decoder *decoder, size_t backend_buffer_size, unsigned char *buf, size_t len) {
     assert(decoder != NULL);
 
     Kit_AudioDecoder *audio_decoder = decoder->userdata;
+    Kit_DecodedFrameInfo info;
+    uint64_t ticket;
     int ret = 0;
 
     if(len <= 0)
@@ -386,24 +398,22 @@ int Kit_GetAudioDecoderData(Kit_Decoder *decoder, size_t backend_buffer_size, un
     if(audio_decoder->current_left > 0)
         goto serve;
 
-    if(!Kit_BeginPacketBufferRead(audio_decoder->buffer, audio_decoder->current, 0))
+    // Frames are judged by their timing info only, and are left in the buffer until we know what to do with them.
+    // This way the buffer is never held locked while we are busy here, and the decoder thread can keep writing.
+    if(!Kit_PeekPacketBuffer(audio_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
         goto no_data;
 
     // Discard any frames that were decoded before the latest seek request.
-    while(Kit_GetPacketSerial(audio_decoder->current->opaque) != Kit_GetTimerSerial(decoder->sync_timer)) {
-        // LOG("[AUDIO] DISCARD BY SERIAL: %d != %d\n", Kit_GetPacketSerial(audio_decoder->current->opaque),
-        // Kit_GetTimerSerial(decoder->sync_timer));
-        av_frame_unref(audio_decoder->current);
-        Kit_FinishPacketBufferRead(audio_decoder->buffer);
-        if(!Kit_BeginPacketBufferRead(audio_decoder->buffer, audio_decoder->current, 0))
+    while(info.serial != Kit_GetTimerSerial(decoder->sync_timer)) {
+        // LOG("[AUDIO] DISCARD BY SERIAL: %d != %d\n", info.serial, Kit_GetTimerSerial(decoder->sync_timer));
+        Kit_TakePacketBuffer(audio_decoder->buffer, NULL, ticket);
+        if(!Kit_PeekPacketBuffer(audio_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
             goto no_data;
     }
 
     // If the clock has not yet been re-based for the current seek, it still reflects the pre-seek position.
     // Hold on to the frame instead of judging it against a stale clock -- the primary stream will re-base soon.
     if(!Kit_IsTimerPrimary(decoder->sync_timer) && !Kit_IsTimerSynced(decoder->sync_timer)) {
-        av_frame_unref(audio_decoder->current);
-        Kit_CancelPacketBufferRead(audio_decoder->buffer);
         goto no_data;
     }
 
@@ -411,12 +421,10 @@ int Kit_GetAudioDecoderData(Kit_Decoder *decoder, size_t backend_buffer_size, un
     Kit_InitTimerBase(decoder->sync_timer);
     if(!Kit_IsTimerInitialized(decoder->sync_timer)) {
         // If this was not the sync source and timer is not set, wait for another stream to set it.
-        av_frame_unref(audio_decoder->current);
-        Kit_CancelPacketBufferRead(audio_decoder->buffer);
         return 0;
     }
 
-    double pts = Kit_GetCurrentPTS(decoder);
+    double pts = Kit_GetFramePTS(decoder, &info);
     double sync_ts = Kit_GetTimerElapsed(decoder->sync_timer);
     const double early_threshold = audio_decoder->early_threshold / 1000.0;
     const double late_threshold = audio_decoder->late_threshold / 1000.0;
@@ -434,34 +442,32 @@ int Kit_GetAudioDecoderData(Kit_Decoder *decoder, size_t backend_buffer_size, un
         // If this stream is NOT the sync source, try to skip packets until we see something reasonable.
         while(pts > sync_ts + KIT_AUDIO_EARLY_FAIL) {
             // LOG("[AUDIO] FAIL-EARLY: pts = %lf < %lf + %lf\n", pts, sync_ts, KIT_AUDIO_EARLY_FAIL);
-            av_frame_unref(audio_decoder->current);
-            Kit_FinishPacketBufferRead(audio_decoder->buffer);
-            if(!Kit_BeginPacketBufferRead(audio_decoder->buffer, audio_decoder->current, 0))
+            Kit_TakePacketBuffer(audio_decoder->buffer, NULL, ticket);
+            if(!Kit_PeekPacketBuffer(audio_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
                 goto no_data;
-            pts = Kit_GetCurrentPTS(decoder);
+            pts = Kit_GetFramePTS(decoder, &info);
         }
     }
 
     // Packet is too early, wait.
     if(pts > sync_ts + early_threshold) {
         // LOG("[AUDIO] EARLY pts = %lf > %lf + %lf\n", pts, sync_ts, early_threshold);
-        av_frame_unref(audio_decoder->current);
-        Kit_CancelPacketBufferRead(audio_decoder->buffer);
         goto no_data;
     }
 
     // Packet is too late, skip packets until we see something reasonable.
     while(pts < sync_ts - late_threshold) {
         // LOG("[AUDIO] LATE: pts = %lf < %lf - %lf\n", pts, sync_ts, late_threshold);
-        av_frame_unref(audio_decoder->current);
-        Kit_FinishPacketBufferRead(audio_decoder->buffer);
-        if(!Kit_BeginPacketBufferRead(audio_decoder->buffer, audio_decoder->current, 0))
+        Kit_TakePacketBuffer(audio_decoder->buffer, NULL, ticket);
+        if(!Kit_PeekPacketBuffer(audio_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
             goto no_data;
-        pts = Kit_GetCurrentPTS(decoder);
+        pts = Kit_GetFramePTS(decoder, &info);
     }
     // LOG("[AUDIO] >>> SYNC!: pts = %lf, sync = %lf\n", pts, sync_ts);
 
-    Kit_FinishPacketBufferRead(audio_decoder->buffer);
+    // This only fails if a seek flushed the buffer after we peeked, so the frame would have been stale anyway.
+    if(!Kit_TakePacketBuffer(audio_decoder->buffer, audio_decoder->current, ticket))
+        goto no_data;
     audio_decoder->current_size = SAMPLE_BYTES(audio_decoder) * audio_decoder->current->nb_samples;
     audio_decoder->current_left = audio_decoder->current_size;
 
@@ -0,0 +1,90 @@
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_mutex.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "kitchensink3/internal/kitbufferevent.h"
+#include "kitchensink3/internal/kitfaultinject.h"
+#include "kitchensink3/internal/utils/kitalloc.h"
+#include "kitchensink3/kiterror.h"
+
+struct Kit_BufferEvent {
+    SDL_Mutex *mutex;
+    SDL_Condition *cond;
+    SDL_AtomicInt waiters; ///< Number of registered waiters; signalers skip the mutex while this is 0
+    SDL_AtomicInt serial;  ///< Bumped on every delivered signal
+};
+
+Kit_BufferEvent *Kit_CreateBufferEvent(void) {
+    Kit_BufferEvent *event;
+
+    if((event = Kit_Calloc(1, sizeof(Kit_BufferEvent))) == NULL) {
+        Kit_SetError("Unable to allocate buffer event");
+        goto exit_0;
+    }
+    if((event->mutex = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate buffer event mutex: %s", SDL_GetError());
+        goto exit_1;
+    }
+    if((event->cond = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateCondition())) == NULL) {
+        Kit_SetError("Unable to allocate buffer event conditional variable: %s", SDL_GetError());
+        goto exit_2;
+    }
+
+    SDL_SetAtomicInt(&event->waiters, 0);
+    SDL_SetAtomicInt(&event->serial, 0);
+    return event;
+
+exit_2:
+    SDL_DestroyMutex(event->mutex);
+exit_1:
+    free(event);
+exit_0:
+    return NULL;
+}
+
+void Kit_CloseBufferEvent(Kit_BufferEvent **ref) {
+    if(!ref || !*ref)
+        return;
+    Kit_BufferEvent *event = *ref;
+    SDL_DestroyCondition(event->cond);
+    SDL_DestroyMutex(event->mutex);
+    free(event);
+    *ref = NULL;
+}
+
+void Kit_SignalBufferEvent(Kit_BufferEvent *event) {
+    if(event == NULL || SDL_GetAtomicInt(&event->waiters) == 0)
+        return;
+    // The serial is bumped before taking the mutex, and the waiter compares it under the mutex before
+    // sleeping, so the broadcast below cannot fall between the waiter's check and its wait.
+    SDL_AddAtomicInt(&event->serial, 1);
+    SDL_LockMutex(event->mutex);
+    SDL_BroadcastCondition(event->cond);
+    SDL_UnlockMutex(event->mutex);
+}
+
+void Kit_BeginBufferEventWait(Kit_BufferEvent *event) {
+    assert(event);
+    SDL_AddAtomicInt(&event->waiters, 1);
+}
+
+void Kit_EndBufferEventWait(Kit_BufferEvent *event) {
+    assert(event);
+    SDL_AddAtomicInt(&event->waiters, -1);
+}
+
+int Kit_GetBufferEventSerial(Kit_BufferEvent *event) {
+    assert(event);
+    return SDL_GetAtomicInt(&event->serial);
+}
+
+bool Kit_WaitBufferEvent(Kit_BufferEvent *event, int serial, int timeout) {
+    assert(event);
+    SDL_LockMutex(event->mutex);
+    if(SDL_GetAtomicInt(&event->serial) == serial && timeout > 0)
+        SDL_WaitConditionTimeout(event->cond, event->mutex, timeout);
+    const bool signaled = SDL_GetAtomicInt(&event->serial) != serial;
+    SDL_UnlockMutex(event->mutex);
+    return signaled;
+}
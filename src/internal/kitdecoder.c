@@ -10,6 +10,7 @@
 
 #include "kitchensink3/internal/kitdecoder.h"
 #include "kitchensink3/internal/kitlibstate.h"
+#include "kitchensink3/internal/kitpackettag.h"
 #include "kitchensink3/internal/utils/kitalloc.h"
 #include "kitchensink3/internal/utils/kitlog.h"
 #include "kitchensink3/internal/video/kitvideoutils.h"
@@ -113,10 +114,29 @@ static enum AVPixelFormat Kit_GetHardwarePixelFormat(AVCodecContext *ctx, const
     return prev;
 }
 
+/**
+ * Picks the libavcodec thread type for the requested mode, or 0 if the codec can't do it and should run single
+ * threaded.
+ */
+static int Kit_GetCodecThreadType(const AVCodec *codec, Kit_ThreadType thread_type) {
+    const bool has_frame = codec->capabilities & AV_CODEC_CAP_FRAME_THREADS;
+    const bool has_slice = codec->capabilities & AV_CODEC_CAP_SLICE_THREADS;
+    switch(thread_type) {
+        case KIT_THREAD_TYPE_FRAME:
+            return has_frame ? FF_THREAD_FRAME : 0;
+        case KIT_THREAD_TYPE_SLICE:
+            return has_slice ? FF_THREAD_SLICE : 0;
+        default:
+            return has_frame ? FF_THREAD_FRAME : has_slice ? FF_THREAD_SLICE : 0;
+    }
+}
+
 Kit_Decoder *Kit_CreateDecoder(
     AVStream *stream,
     Kit_Timer *sync_timer,
     int thread_count,
+    Kit_ThreadType thread_type,
+    bool low_delay,
     unsigned int hw_device_types,
     dec_input_cb dec_input,
     dec_decode_cb dec_decode,
@@ -124,6 +144,7 @@ Kit_Decoder *Kit_CreateDecoder(
     dec_abort_cb dec_abort,
     dec_close_cb dec_close,
     dec_get_buffers_cb dec_get_buffers,
+    dec_get_output_buffer_cb dec_get_output_buffer,
     void *userdata
 ) {
     assert(stream != NULL);
@@ -156,13 +177,14 @@ Kit_Decoder *Kit_CreateDecoder(
     codec_ctx->pkt_timebase = stream->time_base;
     codec_ctx->opaque = decoder;                   // Used by Kit_GetHardwarePixelFormat()
     codec_ctx->flags |= AV_CODEC_FLAG_COPY_OPAQUE; // Make sure the opaque handle gets copied!
+    if(low_delay)
+        codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
 
-    // Attempt to set up threading, if supported.
-    codec_ctx->thread_count = thread_count;
-    if(codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) {
-        codec_ctx->thread_type = FF_THREAD_FRAME;
-    } else if(codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) {
-        codec_ctx->thread_type = FF_THREAD_SLICE;
+    // Attempt to set up threading, if supported. The threads come out of the library-wide budget, if one is set.
+    const int codec_thread_type = Kit_GetCodecThreadType(codec, thread_type);
+    if(codec_thread_type != 0) {
+        codec_ctx->thread_count = Kit_ReserveDecoderThreads(thread_count, &decoder->reserved_threads);
+        codec_ctx->thread_type = codec_thread_type;
     } else {
         codec_ctx->thread_count = 1; // Disable threading
     }
@@ -200,12 +222,14 @@ Kit_Decoder *Kit_CreateDecoder(
     decoder->dec_abort = dec_abort;
     decoder->dec_close = dec_close;
     decoder->dec_get_buffers = dec_get_buffers;
+    decoder->dec_get_output_buffer = dec_get_output_buffer;
     decoder->userdata = userdata;
     return decoder;
 
 exit_2:
     av_dict_free(&codec_opts);
     avcodec_free_context(&codec_ctx);
+    Kit_ReleaseDecoderThreads(decoder->reserved_threads);
 exit_1:
     free(decoder);
 exit_0:
@@ -219,6 +243,7 @@ void Kit_CloseDecoder(Kit_Decoder **ref) {
     if(decoder->dec_close)
         decoder->dec_close(decoder);
     avcodec_free_context(&decoder->codec_ctx);
+    Kit_ReleaseDecoderThreads(decoder->reserved_threads);
     Kit_CloseTimer(&decoder->sync_timer);
     free(decoder);
     *ref = NULL;
@@ -268,6 +293,19 @@ int Kit_GetDecoderBufferState(const Kit_Decoder *decoder, unsigned int *length,
     return 1;
 }
 
+Kit_PacketBuffer *Kit_GetDecoderOutputBuffer(const Kit_Decoder *decoder) {
+    if(decoder && decoder->dec_get_output_buffer)
+        return decoder->dec_get_output_buffer(decoder);
+    return NULL;
+}
+
+void Kit_PeekDecodedFrame(void *dst, const void *obj) {
+    Kit_DecodedFrameInfo *info = dst;
+    const AVFrame *frame = obj;
+    info->pts = frame->best_effort_timestamp;
+    info->serial = Kit_GetPacketSerial(frame->opaque);
+}
+
 int Kit_GetDecoderStreamIndex(const Kit_Decoder *decoder) {
     if(!decoder)
         return -1;
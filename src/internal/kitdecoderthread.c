@@ -7,31 +7,69 @@
 #include "kitchensink3/internal/utils/kitlog.h"
 #include "kitchensink3/kiterror.h"
 
+/**
+ * Drops the packets that were read from the input buffer but not fed to the decoder yet. The thread is only
+ * ever stopped for a flush (stop, seek or stream switch), so they would be stale by the time it restarts.
+ */
+static void Kit_DropPendingPackets(Kit_DecoderThread *thread) {
+    for(size_t i = thread->packet_pos; i < thread->packet_count; i++)
+        av_packet_unref(thread->packets[i]);
+    thread->packet_pos = 0;
+    thread->packet_count = 0;
+}
+
+/**
+ * Reads the next batch of packets from the input buffer. Packets taken out of the buffer no longer count towards
+ * its fill level or byte budget, so a batch is kept to a quarter of the buffer, by count and by bytes; otherwise
+ * the packets held here could add up to more than the buffer itself is allowed to hold.
+ */
+static size_t Kit_ReadPacketBatch(Kit_DecoderThread *thread, int timeout) {
+    const size_t capacity = Kit_GetPacketBufferCapacity(thread->input);
+    const int byte_limit = Kit_GetPacketBufferByteLimit(thread->input);
+    size_t count = capacity / 4;
+    if(count < 1)
+        count = 1;
+    if(count > KIT_DECODER_THREAD_BATCH)
+        count = KIT_DECODER_THREAD_BATCH;
+    size_t max_bytes = 0;
+    if(byte_limit > 0)
+        max_bytes = byte_limit >= 4 ? (size_t)byte_limit / 4 : 1;
+    return Kit_ReadPacketBufferBatch(thread->input, (void **)thread->packets, count, max_bytes, timeout);
+}
+
 static bool
 Kit_ProcessPacket(Kit_DecoderThread *thread, bool *pts_jumped, bool *draining, bool *eof_received, const int timeout) {
     Kit_DecoderInputResult ret;
+    AVPacket *packet;
     bool is_eof;
     bool can_feed_more = false;
 
-    if(!Kit_BeginPacketBufferRead(thread->input, thread->scratch_packet, timeout))
-        return false;
+    // Take several packets from the input buffer in one go, and then feed the decoder from the local batch.
+    // This keeps the demuxer from being woken up for every single packet on high packet rate streams.
+    if(thread->packet_pos == thread->packet_count) {
+        thread->packet_pos = 0;
+        thread->packet_count = Kit_ReadPacketBatch(thread, timeout);
+        if(thread->packet_count == 0)
+            return false;
+    }
+    packet = thread->packets[thread->packet_pos];
 
     // If a valid packet was found, first check if it's a control packet.
     // Seek packet is created in the demuxer, and is sent after avformat_seek_file() is called. It carries
     // the seek serial, which we track for clock re-basing; data frames carry their own serial, propagated
     // from the source packet by the codec.
-    if(Kit_GetPacketType(thread->scratch_packet->opaque) == KIT_PACKET_TYPE_SEEK) {
+    if(Kit_GetPacketType(packet->opaque) == KIT_PACKET_TYPE_SEEK) {
         Kit_ClearDecoderBuffers(thread->decoder);
-        thread->decoder->output_serial = Kit_GetPacketSerial(thread->scratch_packet->opaque);
+        thread->decoder->output_serial = Kit_GetPacketSerial(packet->opaque);
         *pts_jumped = true;
         *draining = false;
         can_feed_more = true;
         goto finish;
     }
-    is_eof = Kit_GetPacketType(thread->scratch_packet->opaque) == KIT_PACKET_TYPE_EOF;
+    is_eof = Kit_GetPacketType(packet->opaque) == KIT_PACKET_TYPE_EOF;
 
     // A stream switch can leave in-flight packets from the previous stream in the buffer.
-    if(!is_eof && thread->scratch_packet->stream_index != Kit_GetDecoderStreamIndex(thread->decoder)) {
+    if(!is_eof && packet->stream_index != Kit_GetDecoderStreamIndex(thread->decoder)) {
         can_feed_more = true;
         goto finish;
     }
@@ -50,10 +88,10 @@ Kit_ProcessPacket(Kit_DecoderThread *thread, bool *pts_jumped, bool *draining, b
 
     // If valid packet was found and it is not a control packet, it must contain stream data.
     // Attempt to add it to the ffmpeg decoder internal queue. Note that the queue may be full, in which case
-    // we try again later.
-    ret = Kit_AddDecoderPacket(thread->decoder, is_eof ? NULL : thread->scratch_packet);
+    // the packet is kept in the local batch and we try again later.
+    ret = Kit_AddDecoderPacket(thread->decoder, is_eof ? NULL : packet);
     if(ret == KIT_DEC_INPUT_RETRY)
-        goto cancel;
+        return false;
     if(is_eof) {
         *eof_received = true;
     } else if(ret == KIT_DEC_INPUT_EOF) {
@@ -64,14 +102,9 @@ Kit_ProcessPacket(Kit_DecoderThread *thread, bool *pts_jumped, bool *draining, b
     }
 
 finish:
-    Kit_FinishPacketBufferRead(thread->input);
-    av_packet_unref(thread->scratch_packet);
+    av_packet_unref(packet);
+    thread->packet_pos++;
     return can_feed_more;
-
-cancel:
-    Kit_CancelPacketBufferRead(thread->input);
-    av_packet_unref(thread->scratch_packet);
-    return false;
 }
 
 static int Kit_DecodeMain(void *ptr) {
@@ -111,31 +144,38 @@ static int Kit_DecodeMain(void *ptr) {
         }
     }
 
+    Kit_DropPendingPackets(thread);
     SDL_SetAtomicInt(&thread->run, 0);
+    Kit_SignalBufferEvent(thread->event);
     return 0;
 }
 
-Kit_DecoderThread *Kit_CreateDecoderThread(Kit_PacketBuffer *input, Kit_Decoder *decoder) {
+Kit_DecoderThread *Kit_CreateDecoderThread(Kit_PacketBuffer *input, Kit_Decoder *decoder, Kit_BufferEvent *event) {
     Kit_DecoderThread *decoder_thread;
-    AVPacket *packet;
 
-    if((packet = av_packet_alloc()) == NULL) {
-        Kit_SetError("Unable to allocate decoder scratch packet");
-        goto error_0;
-    }
     if((decoder_thread = Kit_Calloc(1, sizeof(Kit_DecoderThread))) == NULL) {
         Kit_SetError("Unable to allocate decoder thread");
-        goto error_1;
+        goto error_0;
+    }
+    for(int i = 0; i < KIT_DECODER_THREAD_BATCH; i++) {
+        if((decoder_thread->packets[i] = av_packet_alloc()) == NULL) {
+            Kit_SetError("Unable to allocate decoder input packets");
+            goto error_1;
+        }
     }
 
     decoder_thread->input = input;
     decoder_thread->decoder = decoder;
-    decoder_thread->scratch_packet = packet;
+    decoder_thread->event = event;
+    decoder_thread->packet_pos = 0;
+    decoder_thread->packet_count = 0;
     SDL_SetAtomicInt(&decoder_thread->run, 0);
     return decoder_thread;
 
 error_1:
-    av_packet_free(&packet);
+    for(int i = 0; i < KIT_DECODER_THREAD_BATCH; i++)
+        av_packet_free(&decoder_thread->packets[i]);
+    free(decoder_thread);
 error_0:
     return NULL;
 }
@@ -170,7 +210,8 @@ void Kit_CloseDecoderThread(Kit_DecoderThread **ref) {
     Kit_DecoderThread *decoder_thread = *ref;
     Kit_StopDecoderThread(decoder_thread);
     Kit_WaitDecoderThread(decoder_thread);
-    av_packet_free(&decoder_thread->scratch_packet);
+    for(int i = 0; i < KIT_DECODER_THREAD_BATCH; i++)
+        av_packet_free(&decoder_thread->packets[i]);
     free(decoder_thread);
     *ref = NULL;
 }
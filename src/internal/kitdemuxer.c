@@ -1,5 +1,6 @@
 #include <assert.h>
 
+#include <SDL3/SDL_mutex.h>
 #include <SDL3/SDL_timer.h>
 #include <libavformat/avformat.h>
 
@@ -7,6 +8,7 @@
 #include "kitchensink3/internal/kitfaultinject.h"
 #include "kitchensink3/internal/kitpacketbuffer.h"
 #include "kitchensink3/internal/kitpackettag.h"
+#include "kitchensink3/internal/kitsourceindex.h"
 #include "kitchensink3/internal/utils/kitalloc.h"
 #include "kitchensink3/kiterror.h"
 
@@ -15,11 +17,14 @@ void Kit_SendDemuxerEOFPacket(Kit_Demuxer *demuxer, Kit_BufferIndex index) {
     if(!demuxer->buffers[index])
         return;
     // Use a local packet instead of the shared scratch packet -- this may get called from the API thread
-    // (stream switch) while the demuxer thread is still sending its own EOF packets on exit.
+    // (stream switch) while the demuxer thread is still sending its own EOF packets on exit. The buffers
+    // only allow a single writer at a time, hence the per-buffer lock for these two.
     if((packet = av_packet_alloc()) == NULL)
         return;
     packet->opaque = Kit_CreatePacketTag(KIT_PACKET_TYPE_EOF, 0);
+    SDL_LockMutex(demuxer->eof_locks[index]);
     Kit_WritePacketBuffer(demuxer->buffers[index], packet);
+    SDL_UnlockMutex(demuxer->eof_locks[index]);
     av_packet_free(&packet);
 }
 
@@ -39,12 +44,31 @@ static bool Kit_DemuxerRetryDelay(Kit_Demuxer *demuxer, unsigned int delay_ms) {
     return !SDL_GetAtomicInt(&demuxer->abort_requested);
 }
 
-bool Kit_RunDemuxer(Kit_Demuxer *demuxer) {
+static size_t Kit_GetDemuxerPacketSize(const void *packet) {
+    const int size = ((const AVPacket *)packet)->size;
+    return size > 0 ? (size_t)size : 0;
+}
+
+static Kit_PacketBuffer *Kit_CreateDemuxerPacketBuffer(int capacity, int byte_limit) {
+    Kit_PacketBuffer *buffer = Kit_CreatePacketBuffer(
+        capacity,
+        (buf_obj_alloc)av_packet_alloc,
+        (buf_obj_unref)av_packet_unref,
+        (buf_obj_free)av_packet_free,
+        (buf_obj_move)av_packet_move_ref,
+        (buf_obj_ref)av_packet_ref,
+        KIT_PACKET_BUFFER_SPSC
+    );
+    if(buffer != NULL)
+        Kit_SetPacketBufferByteLimit(buffer, Kit_GetDemuxerPacketSize, byte_limit);
+    return buffer;
+}
+
+static bool Kit_ReadDemuxerPacket(Kit_Demuxer *demuxer, AVPacket *packet) {
     for(unsigned int attempt = 0;; attempt++) {
-        const int ret =
-            KIT_FAULT_WRAP_CODE("demux_read", av_read_frame(demuxer->src->format_ctx, demuxer->scratch_packet));
+        const int ret = KIT_FAULT_WRAP_CODE("demux_read", av_read_frame(demuxer->src->format_ctx, packet));
         if(ret >= 0)
-            break;
+            return true;
         if(ret == AVERROR_EOF)
             return false;
         if(attempt >= (unsigned int)demuxer->read_attempts - 1)
@@ -54,27 +78,307 @@ bool Kit_RunDemuxer(Kit_Demuxer *demuxer) {
         if(!Kit_DemuxerRetryDelay(demuxer, demuxer->read_retry_delay))
             return false;
     }
+}
+
+static int Kit_FindDemuxerBufferIndex(Kit_Demuxer *demuxer, int stream_index) {
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        if(stream_index == SDL_GetAtomicInt(&demuxer->stream_indexes[i]))
+            return i;
+    }
+    return -1;
+}
+
+static unsigned int Kit_GetDemuxerSerial(const Kit_Demuxer *demuxer) {
+    if(demuxer->follow_serial >= 0)
+        return (unsigned int)demuxer->follow_serial;
+    return Kit_GetTimerSerial(demuxer->timer);
+}
+
+/**
+ * Tells the container to skip all streams that are not selected. Demuxers that can skip data then don't read
+ * or allocate packets for those streams at all; others still hand them out, and Kit_RunDemuxer() drops them.
+ */
+static void Kit_UpdateDemuxerDiscard(Kit_Demuxer *demuxer) {
+    AVFormatContext *format_ctx = demuxer->src->format_ctx;
+    SDL_LockMutex(demuxer->tap_lock);
+    for(unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+        bool selected = Kit_FindDemuxerBufferIndex(demuxer, (int)i) >= 0;
+        for(int t = 0; !selected && t < demuxer->tap_count; t++)
+            selected = Kit_FindDemuxerBufferIndex(demuxer->taps[t], (int)i) >= 0;
+        format_ctx->streams[i]->discard = selected ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    SDL_UnlockMutex(demuxer->tap_lock);
+}
+
+/**
+ * Writes a packet into a buffer of a tap, moving the reference. A full tap buffer is polled instead of waited on,
+ * so that aborting either the leader or the tap gets the reader out. The packet is dropped if the tap is closed
+ * or aborted meanwhile.
+ */
+static void Kit_WriteDemuxerTap(Kit_Demuxer *demuxer, Kit_Demuxer *tap, int index, AVPacket *packet) {
+    void *src = packet;
+    while(Kit_TryWritePacketBufferBatch(tap->buffers[index], &src, 1) == 0) {
+        if(!SDL_GetAtomicInt(&tap->tap_open) || SDL_GetAtomicInt(&tap->abort_requested))
+            break;
+        if(!Kit_DemuxerRetryDelay(demuxer, 1))
+            break;
+    }
+    av_packet_unref(packet);
+}
+
+/**
+ * Hands a reference to a freshly read packet to every open tap that has its stream selected, tagged with the
+ * serial of the tap's own timer.
+ */
+static void Kit_FeedDemuxerTaps(Kit_Demuxer *demuxer, const AVPacket *packet) {
+    // Most demuxers have no open taps; don't take the lock on every packet for them. A tap opened right after
+    // this check just joins in from the next packet.
+    if(SDL_GetAtomicInt(&demuxer->open_taps) == 0)
+        return;
+    SDL_LockMutex(demuxer->tap_lock);
+    for(int i = 0; i < demuxer->tap_count; i++) {
+        Kit_Demuxer *tap = demuxer->taps[i];
+        const int index = Kit_FindDemuxerBufferIndex(tap, packet->stream_index);
+        if(index < 0 || !SDL_GetAtomicInt(&tap->tap_open))
+            continue;
+        if(av_packet_ref(tap->scratch_packet, packet) < 0)
+            continue;
+        tap->scratch_packet->opaque = Kit_CreatePacketTag(KIT_PACKET_TYPE_DATA, Kit_GetTimerSerial(tap->timer));
+        Kit_WriteDemuxerTap(demuxer, tap, index, tap->scratch_packet);
+    }
+    SDL_UnlockMutex(demuxer->tap_lock);
+}
+
+/**
+ * Writes a sentinel packet of the given type into every buffer of every open tap. Seek packets go out under a
+ * freshly bumped serial of each tap's timer.
+ */
+static void Kit_SendDemuxerTapPackets(Kit_Demuxer *demuxer, Kit_PacketType type) {
+    if(SDL_GetAtomicInt(&demuxer->open_taps) == 0)
+        return;
+    SDL_LockMutex(demuxer->tap_lock);
+    for(int i = 0; i < demuxer->tap_count; i++) {
+        Kit_Demuxer *tap = demuxer->taps[i];
+        if(!SDL_GetAtomicInt(&tap->tap_open))
+            continue;
+        const unsigned int serial = type == KIT_PACKET_TYPE_SEEK ? Kit_IncreaseTimerSerial(tap->timer) : 0;
+        for(int index = 0; index < KIT_INDEX_COUNT; index++) {
+            if(!tap->buffers[index])
+                continue;
+            tap->scratch_packet->opaque = Kit_CreatePacketTag(type, serial);
+            Kit_WriteDemuxerTap(demuxer, tap, index, tap->scratch_packet);
+        }
+    }
+    SDL_UnlockMutex(demuxer->tap_lock);
+}
+
+void Kit_SendDemuxerTapEOFPackets(Kit_Demuxer *demuxer) {
+    Kit_SendDemuxerTapPackets(demuxer, KIT_PACKET_TYPE_EOF);
+}
+
+static void Kit_CountDemuxerOverflowBytes(Kit_DemuxerOverflow *overflow) {
+    overflow->bytes = 0;
+    for(int i = 0; i < overflow->count; i++)
+        overflow->bytes += Kit_GetDemuxerPacketSize(overflow->packets[(overflow->head + i) % overflow->capacity]);
+}
+
+/**
+ * Writes queued side queue packets into the buffer, oldest first. If wait is set, blocks until all of them are
+ * written; otherwise only writes what fits right away. Returns true if the side queue is now empty.
+ */
+static bool Kit_DrainDemuxerOverflow(Kit_Demuxer *demuxer, int index, bool wait) {
+    Kit_DemuxerOverflow *overflow = &demuxer->overflow[index];
+    while(overflow->count > 0) {
+        // The queued packets may wrap around the end of the ring; write them one contiguous run at a time.
+        const int run = SDL_min(overflow->count, overflow->capacity - overflow->head);
+        void **packets = (void **)(overflow->packets + overflow->head);
+        const size_t written = wait ? Kit_WritePacketBufferBatch(demuxer->buffers[index], packets, run)
+                                    : Kit_TryWritePacketBufferBatch(demuxer->buffers[index], packets, run);
+        overflow->head = (overflow->head + (int)written) % overflow->capacity;
+        overflow->count -= (int)written;
+        Kit_CountDemuxerOverflowBytes(overflow);
+        if(written < (size_t)run)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Drops side queue packets that are no longer for the selected stream, after a stream switch.
+ */
+static void Kit_FilterDemuxerOverflow(Kit_Demuxer *demuxer, int index) {
+    Kit_DemuxerOverflow *overflow = &demuxer->overflow[index];
+    const int stream_index = SDL_GetAtomicInt(&demuxer->stream_indexes[index]);
+    int kept = 0;
+    for(int i = 0; i < overflow->count; i++) {
+        AVPacket *packet = overflow->packets[(overflow->head + i) % overflow->capacity];
+        if(packet->stream_index != stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        if(kept != i)
+            av_packet_move_ref(overflow->packets[(overflow->head + kept) % overflow->capacity], packet);
+        kept++;
+    }
+    overflow->count = kept;
+    Kit_CountDemuxerOverflowBytes(overflow);
+}
+
+static void Kit_ClearDemuxerOverflow(Kit_Demuxer *demuxer, int index) {
+    Kit_DemuxerOverflow *overflow = &demuxer->overflow[index];
+    for(int i = 0; i < overflow->count; i++)
+        av_packet_unref(overflow->packets[(overflow->head + i) % overflow->capacity]);
+    overflow->head = 0;
+    overflow->count = 0;
+    overflow->bytes = 0;
+}
+
+/**
+ * The side queue is full when it holds overflow_size packets, or when its packets and the ones in the buffer
+ * together reach the byte budget of the buffer. Otherwise the side queue would let a stream go over its budget by
+ * up to overflow_size packets.
+ */
+static bool Kit_IsDemuxerOverflowFull(const Kit_Demuxer *demuxer, int index, int byte_limit) {
+    const Kit_DemuxerOverflow *overflow = &demuxer->overflow[index];
+    if(overflow->count == overflow->capacity)
+        return true;
+    return byte_limit > 0 &&
+           Kit_GetPacketBufferBytes(demuxer->buffers[index]) + overflow->bytes >= (size_t)byte_limit;
+}
 
-    // Figure out if we are interested in this stream. If we are, write the packet to a buffer for decoder to pick up.
-    // Note that Kit_WritePacketBuffer() may block if the buffer is full. It will also move the scratch_packet
-    // references to its own buffer, leaving the scratch_buffer in a clean state.
+/**
+ * Writes the first count batch packets into a buffer. The packet references are moved to the buffer, leaving the
+ * batch packets in a clean state.
+ *
+ * If the buffer is full, the packets are moved to its side queue instead, so that the other streams can go on.
+ * Once the side queue is full as well (by packet count or by bytes), this blocks until the buffer has taken all of
+ * the queued packets and the rest of the batch.
+ */
+static void Kit_WriteDemuxerBatch(Kit_Demuxer *demuxer, int index, size_t count, size_t offset) {
+    AVPacket **packets = demuxer->batch + offset;
+    Kit_DemuxerOverflow *overflow = &demuxer->overflow[index];
+    size_t written = 0;
+    if(overflow->capacity == 0) {
+        written = Kit_WritePacketBufferBatch(demuxer->buffers[index], (void **)packets, count);
+        goto exit;
+    }
+
+    // Queued packets go first, so only bypass the side queue if it is empty.
+    if(overflow->count == 0)
+        written = Kit_TryWritePacketBufferBatch(demuxer->buffers[index], (void **)packets, count);
+    const int byte_limit = written < count ? Kit_GetPacketBufferByteLimit(demuxer->buffers[index]) : 0;
+    while(written < count) {
+        if(Kit_IsDemuxerOverflowFull(demuxer, index, byte_limit)) {
+            // Wait until the buffer has taken the side queue, then write the rest of the batch right after it.
+            if(Kit_DrainDemuxerOverflow(demuxer, index, true))
+                written += Kit_WritePacketBufferBatch(demuxer->buffers[index], (void **)(packets + written),
+                                                      count - written);
+            break;
+        }
+        const int tail = (overflow->head + overflow->count) % overflow->capacity;
+        overflow->bytes += Kit_GetDemuxerPacketSize(packets[written]);
+        av_packet_move_ref(overflow->packets[tail], packets[written++]);
+        overflow->count++;
+    }
+
+exit:
+    for(size_t i = written; i < count; i++)
+        av_packet_unref(packets[i]);
+}
+
+/**
+ * Writes out as much of the side queues as fits without waiting. Returns true if they are all empty.
+ */
+static bool Kit_DrainDemuxerOverflows(Kit_Demuxer *demuxer) {
+    bool empty = true;
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
-        if(demuxer->scratch_packet->stream_index == SDL_GetAtomicInt(&demuxer->stream_indexes[i])) {
-            demuxer->scratch_packet->opaque =
-                Kit_CreatePacketTag(KIT_PACKET_TYPE_DATA, Kit_GetTimerSerial(demuxer->timer));
-            if(!Kit_WritePacketBuffer(demuxer->buffers[i], demuxer->scratch_packet))
-                av_packet_unref(demuxer->scratch_packet);
+        if(demuxer->overflow[i].count > 0 && !Kit_DrainDemuxerOverflow(demuxer, i, false))
+            empty = false;
+    }
+    return empty;
+}
+
+/**
+ * Source is at EOF, but the side queues may still hold packets. Writing them out waits on the decoders, which
+ * may in turn be waiting on the packets of some other side queue, so none of them can be waited on alone.
+ * Instead, keep polling all of them until they are empty.
+ */
+static bool Kit_DrainDemuxerAtEOF(Kit_Demuxer *demuxer) {
+    demuxer->draining = true;
+    if(Kit_DrainDemuxerOverflows(demuxer))
+        return false;
+    return Kit_DemuxerRetryDelay(demuxer, 1);
+}
+
+bool Kit_RunDemuxer(Kit_Demuxer *demuxer) {
+    int batch_index = -1;
+    size_t count = 0;
+
+    // The format context is only touched from the demuxer thread, so stream switches are applied here.
+    if(SDL_CompareAndSwapAtomicInt(&demuxer->discard_changed, 1, 0)) {
+        Kit_UpdateDemuxerDiscard(demuxer);
+        for(int i = 0; i < KIT_INDEX_COUNT; i++)
+            Kit_FilterDemuxerOverflow(demuxer, i);
+    }
+    if(demuxer->draining)
+        return Kit_DrainDemuxerAtEOF(demuxer);
+    Kit_DrainDemuxerOverflows(demuxer);
+
+    // Collect consecutive packets that go to the same buffer, and write them in one go. The batch ends when
+    // it is full, or when a packet for some other buffer turns up. That packet is then written on its own.
+    while(count < (size_t)demuxer->batch_size) {
+        AVPacket *packet = demuxer->batch[count];
+        if(!Kit_ReadDemuxerPacket(demuxer, packet)) {
+            if(count > 0)
+                Kit_WriteDemuxerBatch(demuxer, batch_index, count, 0);
+            return Kit_DrainDemuxerAtEOF(demuxer);
+        }
+        Kit_FeedDemuxerTaps(demuxer, packet);
+
+        // Figure out if we are interested in this stream. If not, get rid of the packet.
+        const int index = Kit_FindDemuxerBufferIndex(demuxer, packet->stream_index);
+        if(index < 0) {
+            av_packet_unref(packet);
+            break;
+        }
+        packet->opaque = Kit_CreatePacketTag(KIT_PACKET_TYPE_DATA, Kit_GetDemuxerSerial(demuxer));
+        if(count > 0 && index != batch_index) {
+            Kit_WriteDemuxerBatch(demuxer, batch_index, count, 0);
+            Kit_WriteDemuxerBatch(demuxer, index, 1, count);
             return true;
         }
+        batch_index = index;
+        count++;
     }
 
-    // Packet does not belong to any stream we are interested in, so get rid of it.
-    av_packet_unref(demuxer->scratch_packet);
+    if(count > 0)
+        Kit_WriteDemuxerBatch(demuxer, batch_index, count, 0);
     return true;
 }
 
-Kit_Demuxer *Kit_CreateDemuxer(
+static bool Kit_CreateDemuxerOverflow(Kit_DemuxerOverflow *overflow, int capacity) {
+    if(capacity <= 0)
+        return true;
+    if((overflow->packets = Kit_Calloc(capacity, sizeof(AVPacket *))) == NULL)
+        return false;
+    overflow->capacity = capacity;
+    for(int i = 0; i < capacity; i++) {
+        if((overflow->packets[i] = av_packet_alloc()) == NULL)
+            return false;
+    }
+    return true;
+}
+
+static void Kit_FreeDemuxerOverflow(Kit_DemuxerOverflow *overflow) {
+    for(int i = 0; i < overflow->capacity; i++)
+        av_packet_free(&overflow->packets[i]);
+    free(overflow->packets);
+    *overflow = (Kit_DemuxerOverflow){0};
+}
+
+static Kit_Demuxer *Kit_NewDemuxer(
     const Kit_Source *src,
+    Kit_Demuxer *leader,
     int video_index,
     int audio_index,
     int subtitle_index,
@@ -86,7 +390,13 @@ Kit_Demuxer *Kit_CreateDemuxer(
     Kit_PacketBuffer *audio_buf = NULL;
     Kit_PacketBuffer *subtitle_buf = NULL;
     AVPacket *scratch_packet;
+    AVPacket **batch = NULL;
     Kit_Timer *demuxer_timer = NULL;
+    SDL_Mutex *eof_locks[KIT_INDEX_COUNT] = {NULL};
+    SDL_Mutex *tap_lock = NULL;
+    Kit_DemuxerOverflow overflow[KIT_INDEX_COUNT] = {{0}};
+    // Taps are written to by the demuxer thread of the leader, which never blocks on them; no side queues needed.
+    const int overflow_size = leader == NULL ? config->demuxer.overflow_size : 0;
 
     if((demuxer = Kit_Calloc(1, sizeof(Kit_Demuxer))) == NULL) {
         Kit_SetError("Unable to allocate demuxer");
@@ -100,61 +410,92 @@ Kit_Demuxer *Kit_CreateDemuxer(
         goto error_2;
     }
     if(video_index >= 0) {
-        video_buf = Kit_CreatePacketBuffer(
-            config->video.packet_buffer_size,
-            (buf_obj_alloc)av_packet_alloc,
-            (buf_obj_unref)av_packet_unref,
-            (buf_obj_free)av_packet_free,
-            (buf_obj_move)av_packet_move_ref,
-            (buf_obj_ref)av_packet_ref
-        );
+        video_buf = Kit_CreateDemuxerPacketBuffer(config->video.packet_buffer_size, config->video.packet_buffer_bytes);
         if(video_buf == NULL) {
             Kit_SetError("Unable to allocate video packet buffer");
             goto error_3;
         }
     }
     if(audio_index >= 0) {
-        audio_buf = Kit_CreatePacketBuffer(
-            config->audio.packet_buffer_size,
-            (buf_obj_alloc)av_packet_alloc,
-            (buf_obj_unref)av_packet_unref,
-            (buf_obj_free)av_packet_free,
-            (buf_obj_move)av_packet_move_ref,
-            (buf_obj_ref)av_packet_ref
-        );
+        audio_buf = Kit_CreateDemuxerPacketBuffer(config->audio.packet_buffer_size, config->audio.packet_buffer_bytes);
         if(audio_buf == NULL) {
             Kit_SetError("Unable to allocate audio packet buffer");
             goto error_4;
         }
     }
     if(subtitle_index >= 0) {
-        subtitle_buf = Kit_CreatePacketBuffer(
-            config->subtitle.packet_buffer_size,
-            (buf_obj_alloc)av_packet_alloc,
-            (buf_obj_unref)av_packet_unref,
-            (buf_obj_free)av_packet_free,
-            (buf_obj_move)av_packet_move_ref,
-            (buf_obj_ref)av_packet_ref
+        subtitle_buf = Kit_CreateDemuxerPacketBuffer(
+            config->subtitle.packet_buffer_size, config->subtitle.packet_buffer_bytes
         );
         if(subtitle_buf == NULL) {
             Kit_SetError("Unable to allocate subtitle packet buffer");
             goto error_5;
         }
     }
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        if((eof_locks[i] = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+            Kit_SetError("Unable to allocate demuxer EOF lock: %s", SDL_GetError());
+            goto error_6;
+        }
+    }
+    if((tap_lock = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate demuxer tap lock: %s", SDL_GetError());
+        goto error_6;
+    }
+    if((batch = Kit_Calloc(config->demuxer.packet_batch_size, sizeof(AVPacket *))) == NULL) {
+        Kit_SetError("Unable to allocate demuxer packet batch");
+        goto error_6;
+    }
+    for(int i = 0; i < config->demuxer.packet_batch_size; i++) {
+        if((batch[i] = av_packet_alloc()) == NULL) {
+            Kit_SetError("Unable to allocate demuxer packet batch");
+            goto error_7;
+        }
+    }
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        const Kit_PacketBuffer *buffers[KIT_INDEX_COUNT] = {video_buf, audio_buf, subtitle_buf};
+        if(buffers[i] != NULL && !Kit_CreateDemuxerOverflow(&overflow[i], overflow_size)) {
+            Kit_SetError("Unable to allocate demuxer overflow queue");
+            goto error_8;
+        }
+    }
 
     demuxer->src = src;
     demuxer->scratch_packet = scratch_packet;
     demuxer->timer = demuxer_timer;
     demuxer->read_attempts = config->demuxer.read_attempts;
     demuxer->read_retry_delay = config->demuxer.read_retry_delay;
+    demuxer->batch = batch;
+    demuxer->batch_size = config->demuxer.packet_batch_size;
+    demuxer->follow_serial = -1;
+    demuxer->leader = leader;
+    demuxer->tap_lock = tap_lock;
     demuxer->buffers[KIT_VIDEO_INDEX] = video_buf;
     demuxer->buffers[KIT_AUDIO_INDEX] = audio_buf;
     demuxer->buffers[KIT_SUBTITLE_INDEX] = subtitle_buf;
     SDL_SetAtomicInt(&demuxer->stream_indexes[KIT_VIDEO_INDEX], video_index);
     SDL_SetAtomicInt(&demuxer->stream_indexes[KIT_AUDIO_INDEX], audio_index);
     SDL_SetAtomicInt(&demuxer->stream_indexes[KIT_SUBTITLE_INDEX], subtitle_index);
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        demuxer->eof_locks[i] = eof_locks[i];
+        demuxer->overflow[i] = overflow[i];
+    }
+    if(leader == NULL)
+        Kit_UpdateDemuxerDiscard(demuxer);
     return demuxer;
 
+error_8:
+    for(int i = 0; i < KIT_INDEX_COUNT; i++)
+        Kit_FreeDemuxerOverflow(&overflow[i]);
+error_7:
+    for(int i = 0; i < config->demuxer.packet_batch_size; i++)
+        av_packet_free(&batch[i]);
+    free(batch);
+error_6:
+    SDL_DestroyMutex(tap_lock);
+    for(int i = 0; i < KIT_INDEX_COUNT; i++)
+        SDL_DestroyMutex(eof_locks[i]);
+    Kit_FreePacketBuffer(&subtitle_buf);
 error_5:
     Kit_FreePacketBuffer(&audio_buf);
 error_4:
@@ -169,17 +510,82 @@ error_0:
     return NULL;
 }
 
+Kit_Demuxer *Kit_CreateDemuxer(
+    const Kit_Source *src,
+    int video_index,
+    int audio_index,
+    int subtitle_index,
+    const Kit_PlayerConfig *config,
+    const Kit_Timer *timer
+) {
+    return Kit_NewDemuxer(src, NULL, video_index, audio_index, subtitle_index, config, timer);
+}
+
+static void Kit_FreeDemuxer(Kit_Demuxer *demuxer) {
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_FreeDemuxerOverflow(&demuxer->overflow[i]);
+        Kit_FreePacketBuffer(&demuxer->buffers[i]);
+        SDL_DestroyMutex(demuxer->eof_locks[i]);
+        SDL_SetAtomicInt(&demuxer->stream_indexes[i], -1);
+    }
+    for(int i = 0; i < demuxer->batch_size; i++)
+        av_packet_free(&demuxer->batch[i]);
+    free(demuxer->batch);
+    av_packet_free(&demuxer->scratch_packet);
+    Kit_CloseTimer(&demuxer->timer);
+    SDL_DestroyMutex(demuxer->tap_lock);
+    free(demuxer);
+}
+
+Kit_Demuxer *Kit_CreateDemuxerTap(
+    Kit_Demuxer *leader,
+    int video_index,
+    int audio_index,
+    int subtitle_index,
+    const Kit_PlayerConfig *config,
+    const Kit_Timer *timer
+) {
+    assert(leader != NULL);
+    assert(leader->leader == NULL);
+    Kit_Demuxer *tap = Kit_NewDemuxer(leader->src, leader, video_index, audio_index, subtitle_index, config, timer);
+    if(tap == NULL)
+        return NULL;
+    SDL_LockMutex(leader->tap_lock);
+    if(leader->tap_count == KIT_DEMUXER_MAX_TAPS) {
+        SDL_UnlockMutex(leader->tap_lock);
+        Kit_SetError("Too many taps on demuxer");
+        Kit_FreeDemuxer(tap);
+        return NULL;
+    }
+    leader->taps[leader->tap_count++] = tap;
+    SDL_UnlockMutex(leader->tap_lock);
+    SDL_SetAtomicInt(&leader->discard_changed, 1);
+    return tap;
+}
+
+void Kit_SetDemuxerTapOpen(Kit_Demuxer *demuxer, bool open) {
+    if(!demuxer || !demuxer->leader)
+        return;
+    if(SDL_SetAtomicInt(&demuxer->tap_open, open ? 1 : 0) != (open ? 1 : 0))
+        SDL_AddAtomicInt(&demuxer->leader->open_taps, open ? 1 : -1);
+}
+
 void Kit_ClearDemuxerBuffers(Kit_Demuxer *demuxer) {
     if(!demuxer)
         return;
     SDL_SetAtomicInt(&demuxer->abort_requested, 0);
-    for(int i = 0; i < KIT_INDEX_COUNT; i++)
+    demuxer->draining = false;
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_ClearDemuxerOverflow(demuxer, i);
         Kit_FlushPacketBuffer(demuxer->buffers[i]);
+    }
 }
 
 void Kit_SetDemuxerStreamIndex(Kit_Demuxer *demuxer, Kit_BufferIndex index, int stream_index) {
     Kit_FlushPacketBuffer(demuxer->buffers[index]);
     SDL_SetAtomicInt(&demuxer->stream_indexes[index], stream_index);
+    // Taps don't read; the container discards are kept up to date by the leader.
+    SDL_SetAtomicInt(demuxer->leader != NULL ? &demuxer->leader->discard_changed : &demuxer->discard_changed, 1);
 }
 
 void Kit_AbortDemuxer(Kit_Demuxer *demuxer) {
@@ -195,19 +601,56 @@ Kit_PacketBuffer *Kit_GetDemuxerPacketBuffer(const Kit_Demuxer *demuxer, Kit_Buf
     return demuxer->buffers[buffer_index];
 }
 
+/**
+ * Frees a demuxer that reads by itself, leaving the source as we found it so that it can be demuxed again with
+ * some other selection.
+ */
+static void Kit_ReleaseDemuxer(Kit_Demuxer *demuxer) {
+    AVFormatContext *format_ctx = demuxer->src->format_ctx;
+    for(unsigned int i = 0; i < format_ctx->nb_streams; i++)
+        format_ctx->streams[i]->discard = AVDISCARD_DEFAULT;
+    Kit_FreeDemuxer(demuxer);
+}
+
 void Kit_CloseDemuxer(Kit_Demuxer **ref) {
     if(!ref || !*ref)
         return;
 
     Kit_Demuxer *demuxer = *ref;
-    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
-        Kit_FreePacketBuffer(&demuxer->buffers[i]);
-        SDL_SetAtomicInt(&demuxer->stream_indexes[i], -1);
-    }
-    av_packet_free(&demuxer->scratch_packet);
-    Kit_CloseTimer(&demuxer->timer);
-    free(demuxer);
+    Kit_Demuxer *leader = demuxer->leader;
     *ref = NULL;
+    if(leader != NULL) {
+        // Get the demuxer thread of the leader out of any write into this tap, then wait for it to let go of
+        // the tap list before taking the tap off it.
+        Kit_SetDemuxerTapOpen(demuxer, false);
+        Kit_AbortDemuxer(demuxer);
+        SDL_LockMutex(leader->tap_lock);
+        for(int i = 0; i < leader->tap_count; i++) {
+            if(leader->taps[i] == demuxer) {
+                leader->taps[i] = leader->taps[--leader->tap_count];
+                break;
+            }
+        }
+        const bool free_leader = leader->closed && leader->tap_count == 0;
+        SDL_UnlockMutex(leader->tap_lock);
+        Kit_FreeDemuxer(demuxer);
+        if(free_leader)
+            Kit_ReleaseDemuxer(leader);
+        else
+            SDL_SetAtomicInt(&leader->discard_changed, 1);
+        return;
+    }
+
+    // Nobody reads for the taps anymore, so let them run out. With the demuxer aborted, a full tap buffer just
+    // drops the EOF packet instead of waiting for room. The last tap to close frees the demuxer.
+    Kit_AbortDemuxer(demuxer);
+    Kit_SendDemuxerTapPackets(demuxer, KIT_PACKET_TYPE_EOF);
+    SDL_LockMutex(demuxer->tap_lock);
+    demuxer->closed = demuxer->tap_count > 0;
+    const bool has_taps = demuxer->closed;
+    SDL_UnlockMutex(demuxer->tap_lock);
+    if(!has_taps)
+        Kit_ReleaseDemuxer(demuxer);
 }
 
 static void Kit_SendSeekPacket(Kit_Demuxer *demuxer, unsigned int seek_serial) {
@@ -220,18 +663,50 @@ static void Kit_SendSeekPacket(Kit_Demuxer *demuxer, unsigned int seek_serial) {
     }
 }
 
-bool Kit_DemuxerSeek(Kit_Demuxer *demuxer, const int64_t seek_target) {
+static bool Kit_SeekDemuxerSource(Kit_Demuxer *demuxer, const int64_t seek_target) {
+    // Hand the keyframes found by the indexer so far over to libavformat, which seeks using the stream index.
+    if(demuxer->src->index != NULL)
+        Kit_ApplySourceIndex(demuxer->src->index, demuxer->src->format_ctx);
     const int ret = KIT_FAULT_WRAP_CODE(
         "demux_seek", avformat_seek_file(demuxer->src->format_ctx, -1, INT64_MIN, seek_target, INT64_MAX, 0)
     );
-    if(ret >= 0) {
+    return ret >= 0;
+}
+
+bool Kit_DemuxerSeek(Kit_Demuxer *demuxer, const int64_t seek_target) {
+    if(Kit_SeekDemuxerSource(demuxer, seek_target)) {
         Kit_ClearDemuxerBuffers(demuxer);
         Kit_SendSeekPacket(demuxer, Kit_IncreaseTimerSerial(demuxer->timer));
+        Kit_SendDemuxerTapPackets(demuxer, KIT_PACKET_TYPE_SEEK);
         return true;
     }
     return false;
 }
 
+bool Kit_FollowDemuxerSeek(Kit_Demuxer *demuxer, const int64_t seek_target, unsigned int serial) {
+    if(Kit_SeekDemuxerSource(demuxer, seek_target)) {
+        Kit_ClearDemuxerBuffers(demuxer);
+        demuxer->follow_serial = (int)(serial & KIT_PACKET_SERIAL_MASK);
+        Kit_SendSeekPacket(demuxer, (unsigned int)demuxer->follow_serial);
+        return true;
+    }
+    return false;
+}
+
+void Kit_HoldDemuxerSerial(Kit_Demuxer *demuxer) {
+    demuxer->follow_serial = (int)Kit_GetDemuxerSerial(demuxer);
+}
+
+bool Kit_GetDemuxerBufferStats(
+    const Kit_Demuxer *demuxer, Kit_BufferIndex buffer_index, Kit_PacketBufferStats *stats
+) {
+    Kit_PacketBuffer *buffer;
+    if(!demuxer || !(buffer = demuxer->buffers[buffer_index]))
+        return false;
+    Kit_GetPacketBufferStats(buffer, stats);
+    return true;
+}
+
 void Kit_GetDemuxerBufferState(
     const Kit_Demuxer *demuxer, Kit_BufferIndex buffer_index, unsigned int *length, unsigned int *capacity
 ) {
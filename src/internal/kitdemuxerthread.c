@@ -2,18 +2,59 @@
 #include <assert.h>
 
 #include "kitchensink3/internal/kitdemuxerthread.h"
+#include "kitchensink3/internal/kitfaultinject.h"
 #include "kitchensink3/internal/utils/kitalloc.h"
 #include "kitchensink3/kiterror.h"
 
+/**
+ * Runs a leading seek, and tells the threads that follow it how it went.
+ */
+static void Kit_RunLeadingSeek(Kit_DemuxerThread *thread) {
+    const bool ok = Kit_DemuxerSeek(thread->demuxer, thread->seek_target);
+    SDL_LockMutex(thread->seek_lock);
+    thread->seek_state = ok ? KIT_DEMUXER_SEEK_DONE : KIT_DEMUXER_SEEK_FAILED;
+    thread->seek_serial = Kit_GetTimerSerial(thread->demuxer->timer);
+    SDL_BroadcastCondition(thread->seek_done);
+    SDL_UnlockMutex(thread->seek_lock);
+}
+
+/**
+ * Runs a following seek once the leader has run its own. Returns false if the thread was stopped while waiting;
+ * the seek then stays queued for the next start.
+ */
+static bool Kit_RunFollowingSeek(Kit_DemuxerThread *thread) {
+    Kit_DemuxerThread *leader = thread->leader;
+    Kit_DemuxerSeekState state = KIT_DEMUXER_SEEK_DONE;
+    unsigned int serial = Kit_GetTimerSerial(thread->demuxer->timer);
+    if(leader != NULL) {
+        SDL_LockMutex(leader->seek_lock);
+        while(leader->seek_state == KIT_DEMUXER_SEEK_PENDING && SDL_GetAtomicInt(&thread->run))
+            SDL_WaitCondition(leader->seek_done, leader->seek_lock);
+        state = leader->seek_state;
+        serial = leader->seek_serial;
+        SDL_UnlockMutex(leader->seek_lock);
+        if(state == KIT_DEMUXER_SEEK_PENDING)
+            return false;
+    }
+    thread->seek = false;
+    if(state == KIT_DEMUXER_SEEK_DONE)
+        Kit_FollowDemuxerSeek(thread->demuxer, thread->seek_target, serial);
+    return true;
+}
+
 static int Kit_DemuxMain(void *ptr) {
     Kit_DemuxerThread *thread = ptr;
     bool eof = false;
 
     while(SDL_GetAtomicInt(&thread->run)) {
         if(thread->seek) {
-            // Seeks are only requested while the demuxer thread is stopped, no locks needed.
-            thread->seek = false;
-            Kit_DemuxerSeek(thread->demuxer, thread->seek_target);
+            // Seeks are only requested while the demuxer thread is stopped, so the request itself needs no locks.
+            if(thread->seek_state == KIT_DEMUXER_SEEK_PENDING) {
+                thread->seek = false;
+                Kit_RunLeadingSeek(thread);
+            } else if(!Kit_RunFollowingSeek(thread)) {
+                break;
+            }
         }
         if(!Kit_RunDemuxer(thread->demuxer)) {
             eof = true;
@@ -26,11 +67,13 @@ static int Kit_DemuxMain(void *ptr) {
         for(int i = 0; i < KIT_INDEX_COUNT; i++) {
             Kit_SendDemuxerEOFPacket(thread->demuxer, i);
         }
+        Kit_SendDemuxerTapEOFPackets(thread->demuxer);
     }
+    Kit_SignalBufferEvent(thread->event);
     return 0;
 }
 
-Kit_DemuxerThread *Kit_CreateDemuxerThread(Kit_Demuxer *demuxer) {
+Kit_DemuxerThread *Kit_CreateDemuxerThread(Kit_Demuxer *demuxer, Kit_BufferEvent *event) {
     Kit_DemuxerThread *demuxer_thread = NULL;
 
     if((demuxer_thread = Kit_Calloc(1, sizeof(Kit_DemuxerThread))) == NULL) {
@@ -38,13 +81,30 @@ Kit_DemuxerThread *Kit_CreateDemuxerThread(Kit_Demuxer *demuxer) {
         goto exit_0;
     }
 
+    if((demuxer_thread->seek_lock = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate demuxer thread seek mutex: %s", SDL_GetError());
+        goto exit_1;
+    }
+    if((demuxer_thread->seek_done = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateCondition())) == NULL) {
+        Kit_SetError("Unable to allocate demuxer thread seek condition: %s", SDL_GetError());
+        goto exit_2;
+    }
+
     demuxer_thread->thread = NULL;
     demuxer_thread->demuxer = demuxer;
+    demuxer_thread->event = event;
     demuxer_thread->seek = false;
     demuxer_thread->seek_target = 0;
+    demuxer_thread->leader = NULL;
+    demuxer_thread->seek_state = KIT_DEMUXER_SEEK_NONE;
+    demuxer_thread->seek_serial = 0;
     SDL_SetAtomicInt(&demuxer_thread->run, 0);
     return demuxer_thread;
 
+exit_2:
+    SDL_DestroyMutex(demuxer_thread->seek_lock);
+exit_1:
+    free(demuxer_thread);
 exit_0:
     return NULL;
 }
@@ -52,7 +112,26 @@ exit_0:
 void Kit_SeekDemuxerThread(Kit_DemuxerThread *demuxer_thread, int64_t seek_target) {
     assert(demuxer_thread->thread == NULL);
     demuxer_thread->seek_target = seek_target;
+    demuxer_thread->leader = NULL;
     demuxer_thread->seek = true;
+    SDL_LockMutex(demuxer_thread->seek_lock);
+    demuxer_thread->seek_state = KIT_DEMUXER_SEEK_PENDING;
+    SDL_UnlockMutex(demuxer_thread->seek_lock);
+}
+
+void Kit_FollowDemuxerThreadSeek(
+    Kit_DemuxerThread *demuxer_thread, Kit_DemuxerThread *leader, int64_t seek_target
+) {
+    assert(demuxer_thread->thread == NULL);
+    assert(leader == NULL || leader->thread == NULL);
+    // Pin the serial before the leader bumps it, so that a failed seek does not relabel the old packets.
+    Kit_HoldDemuxerSerial(demuxer_thread->demuxer);
+    demuxer_thread->seek_target = seek_target;
+    demuxer_thread->leader = leader;
+    demuxer_thread->seek = true;
+    SDL_LockMutex(demuxer_thread->seek_lock);
+    demuxer_thread->seek_state = KIT_DEMUXER_SEEK_NONE;
+    SDL_UnlockMutex(demuxer_thread->seek_lock);
 }
 
 void Kit_StartDemuxerThread(Kit_DemuxerThread *demuxer_thread) {
@@ -66,6 +145,12 @@ void Kit_StopDemuxerThread(Kit_DemuxerThread *demuxer_thread) {
     if(!demuxer_thread || !demuxer_thread->thread)
         return;
     SDL_SetAtomicInt(&demuxer_thread->run, 0);
+    if(demuxer_thread->leader != NULL) {
+        // Taking the lock makes sure the thread is either not yet checking the run flag, or already waiting.
+        SDL_LockMutex(demuxer_thread->leader->seek_lock);
+        SDL_BroadcastCondition(demuxer_thread->leader->seek_done);
+        SDL_UnlockMutex(demuxer_thread->leader->seek_lock);
+    }
 }
 
 void Kit_WaitDemuxerThread(Kit_DemuxerThread *demuxer_thread) {
@@ -82,6 +167,8 @@ Kit_GetDemuxerThreadPacketBuffer(const Kit_DemuxerThread *demuxer_thread, Kit_Bu
 }
 
 bool Kit_IsDemuxerThreadAlive(Kit_DemuxerThread *demuxer_thread) {
+    if(!demuxer_thread)
+        return false;
     return SDL_GetAtomicInt(&demuxer_thread->run);
 }
 
@@ -92,6 +179,8 @@ void Kit_CloseDemuxerThread(Kit_DemuxerThread **ref) {
     Kit_DemuxerThread *demuxer_thread = *ref;
     Kit_StopDemuxerThread(demuxer_thread);
     Kit_WaitDemuxerThread(demuxer_thread);
+    SDL_DestroyCondition(demuxer_thread->seek_done);
+    SDL_DestroyMutex(demuxer_thread->seek_lock);
     free(demuxer_thread);
     *ref = NULL;
 }
@@ -0,0 +1,193 @@
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_stdinc.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KIT_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+
+#include "kitchensink3/internal/kitfilesource.h"
+#include "kitchensink3/internal/utils/kitalloc.h"
+#include "kitchensink3/internal/utils/kitlog.h"
+#include "kitchensink3/kiterror.h"
+#include "kitchensink3/kitsource.h"
+
+struct Kit_FileSource {
+    SDL_IOStream *io;         ///< File stream, if the file is not in memory
+    const uint8_t *data;      ///< File mapping or caller's memory, if in memory
+    size_t size;              ///< Size of data
+    size_t pos;               ///< Read position in data
+    size_t advised_end;       ///< End of the range last hinted with WILLNEED
+    bool advise;              ///< Give read-ahead hints
+    bool mapped;              ///< Data is our own file mapping
+    Kit_FreeCallback free_cb; ///< Releases the caller's memory, if not mapped
+};
+
+#ifdef KIT_HAS_MMAP
+static bool Kit_MapFileSource(Kit_FileSource *file, const char *path) {
+    struct stat st;
+    const int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    // Empty files and non-regular files (pipes, devices) can't be mapped; these go through SDL I/O.
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if(data == MAP_FAILED)
+        return false;
+    file->data = data;
+    file->size = (size_t)st.st_size;
+    file->mapped = true;
+    return true;
+}
+#endif
+
+/**
+ * Hints the kernel to start reading in the next window once the reader gets halfway through the previous one,
+ * so that page faults on the mapping find the data already in the page cache.
+ */
+static void Kit_AdviseFileSource(Kit_FileSource *file) {
+#ifdef KIT_HAS_MMAP
+    if(!file->advise || file->advised_end >= file->size || file->pos + KIT_FILE_ADVISE_WINDOW / 2 < file->advised_end)
+        return;
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = file->pos - file->pos % page;
+    const size_t end = SDL_min(file->size, file->pos + KIT_FILE_ADVISE_WINDOW);
+    posix_madvise((void *)(file->data + start), end - start, POSIX_MADV_WILLNEED);
+    file->advised_end = end;
+#else
+    (void)file;
+#endif
+}
+
+Kit_FileSource *Kit_OpenFileSource(const char *path, unsigned int flags) {
+    assert(path != NULL);
+    Kit_FileSource *file;
+    if((file = Kit_Calloc(1, sizeof(Kit_FileSource))) == NULL) {
+        Kit_SetError("Unable to allocate file source");
+        return NULL;
+    }
+#ifdef KIT_HAS_MMAP
+    if(!(flags & KIT_SOURCE_FILE_NO_MMAP)) {
+        if(Kit_MapFileSource(file, path)) {
+            file->advise = !(flags & KIT_SOURCE_FILE_NO_ADVISE);
+            Kit_AdviseFileSource(file);
+            return file;
+        }
+        LOG("Unable to map %s, reading it through SDL I/O\n", path);
+    }
+#endif
+    if((file->io = SDL_IOFromFile(path, "rb")) == NULL) {
+        Kit_SetError("Unable to open source file: %s", SDL_GetError());
+        free(file);
+        return NULL;
+    }
+    return file;
+}
+
+Kit_FileSource *Kit_OpenMemorySource(const void *data, size_t size, Kit_FreeCallback free_cb) {
+    assert(data != NULL);
+    Kit_FileSource *file;
+    if((file = Kit_Calloc(1, sizeof(Kit_FileSource))) == NULL) {
+        Kit_SetError("Unable to allocate memory source");
+        if(free_cb != NULL)
+            free_cb((void *)data);
+        return NULL;
+    }
+    file->data = data;
+    file->size = size;
+    file->free_cb = free_cb;
+    return file;
+}
+
+void Kit_CloseFileSource(Kit_FileSource **ref) {
+    if(!ref || !*ref)
+        return;
+    Kit_FileSource *file = *ref;
+#ifdef KIT_HAS_MMAP
+    if(file->mapped)
+        munmap((void *)file->data, file->size);
+#endif
+    if(!file->mapped && file->free_cb != NULL)
+        file->free_cb((void *)file->data);
+    if(file->io != NULL)
+        SDL_CloseIO(file->io);
+    free(file);
+    *ref = NULL;
+}
+
+bool Kit_IsFileSourceInMemory(const Kit_FileSource *file) {
+    return file->data != NULL;
+}
+
+int Kit_ReadFileSource(void *opaque, uint8_t *buf, int size) {
+    Kit_FileSource *file = opaque;
+    if(file->io != NULL) {
+        const size_t bytes_read = SDL_ReadIO(file->io, buf, size);
+        if(bytes_read == 0)
+            return SDL_GetIOStatus(file->io) == SDL_IO_STATUS_EOF ? AVERROR_EOF : AVERROR(EIO);
+        return (int)bytes_read;
+    }
+    if(file->pos >= file->size)
+        return AVERROR_EOF;
+    const size_t count = SDL_min((size_t)size, file->size - file->pos);
+    memcpy(buf, file->data + file->pos, count);
+    file->pos += count;
+    Kit_AdviseFileSource(file);
+    return (int)count;
+}
+
+int64_t Kit_SeekFileSource(void *opaque, int64_t offset, int whence) {
+    Kit_FileSource *file = opaque;
+    if(file->io != NULL) {
+        if(whence & AVSEEK_SIZE)
+            return SDL_GetIOSize(file->io);
+        switch(whence & ~AVSEEK_FORCE) {
+            case SEEK_SET:
+                return SDL_SeekIO(file->io, offset, SDL_IO_SEEK_SET);
+            case SEEK_CUR:
+                return SDL_SeekIO(file->io, offset, SDL_IO_SEEK_CUR);
+            case SEEK_END:
+                return SDL_SeekIO(file->io, offset, SDL_IO_SEEK_END);
+            default:
+                return -1;
+        }
+    }
+    if(whence & AVSEEK_SIZE)
+        return (int64_t)file->size;
+    int64_t pos;
+    switch(whence & ~AVSEEK_FORCE) {
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = (int64_t)file->pos + offset;
+            break;
+        case SEEK_END:
+            pos = (int64_t)file->size + offset;
+            break;
+        default:
+            return -1;
+    }
+    if(pos < 0 || pos > (int64_t)file->size)
+        return -1;
+    file->pos = (size_t)pos;
+    file->advised_end = 0; // Start a new window from here
+    Kit_AdviseFileSource(file);
+    return pos;
+}
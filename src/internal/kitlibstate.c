@@ -1,12 +1,40 @@
 #include "kitchensink3/internal/kitlibstate.h"
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_stdinc.h>
+#include <assert.h>
 #include <stddef.h>
 
 static Kit_LibraryState _library_state = {
     .init_flags = 0,
     .libass_handle = NULL,
     .ass_so_handle = NULL,
+    .decoder_thread_limit = 0,
+    .decoder_threads = {0},
 };
 
 Kit_LibraryState *Kit_GetLibraryState(void) {
     return &_library_state;
 }
+
+int Kit_ReserveDecoderThreads(int thread_count, int *reserved) {
+    const int limit = _library_state.decoder_thread_limit;
+    int wanted, used, granted;
+    *reserved = 0;
+    if(limit <= 0)
+        return thread_count;
+    wanted = thread_count > 0 ? thread_count : SDL_GetNumLogicalCPUCores();
+    do {
+        used = SDL_GetAtomicInt(&_library_state.decoder_threads);
+        granted = SDL_min(wanted, limit - used);
+        if(granted < 2)
+            return 1; // A single thread decodes on the decoder thread itself, so it does not count.
+    } while(!SDL_CompareAndSwapAtomicInt(&_library_state.decoder_threads, used, used + granted));
+    *reserved = granted;
+    return granted;
+}
+
+void Kit_ReleaseDecoderThreads(int reserved) {
+    assert(reserved >= 0);
+    if(reserved > 0)
+        SDL_AddAtomicInt(&_library_state.decoder_threads, -reserved);
+}
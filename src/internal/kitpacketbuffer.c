@@ -1,5 +1,9 @@
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
 #include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_timer.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "kitchensink3/internal/kitfaultinject.h"
 #include "kitchensink3/internal/kitpacketbuffer.h"
@@ -7,20 +11,46 @@
 #include "kitchensink3/internal/utils/kitlog.h"
 #include "kitchensink3/kiterror.h"
 
+// Read and write positions run over [0, 2 * slots) instead of [0, slots), so that a full buffer
+// (head - tail == slots) can be told apart from an empty one (head == tail) without a separate flag
+// that both sides would have to update.
 struct Kit_PacketBuffer {
     void **packets;
     SDL_Mutex *mutex;
     SDL_Condition *can_read;
     SDL_Condition *can_write;
-    size_t head;
-    size_t tail;
-    size_t capacity;
-    bool full;
-    bool aborted;
+    size_t capacity; ///< Max items the writer may queue
+    size_t slots;    ///< Allocated slot objects; more than capacity while a shrunk buffer still holds the excess
+    unsigned int flags;
+    size_t writers_waiting;        ///< Writers parked on can_write; protected by mutex
+    size_t write_wanted;           ///< Free slots the parked writer needs before it is worth waking up
+    SDL_AtomicInt readers_waiting; ///< Readers parked on can_read; polled by lock-free writers
+    SDL_AtomicInt aborted;
+    SDL_AtomicInt writing;  ///< Set while a lock-free writer touches the slots outside the mutex
+    SDL_AtomicInt resizing; ///< Set while Kit_ResizePacketBuffer() holds the writer off
+    int byte_limit;      ///< Writers block while at least this many bytes are queued; 0 = no limit
+    SDL_AtomicInt bytes; ///< Bytes currently queued, as reported by size_cb
+    buf_obj_size size_cb;
+    Kit_PacketBufferStats stats; ///< Counters; protected by mutex, except writes (see Kit_GetPacketBufferStats)
+    uint64_t flushed;            ///< Items dropped by flushes; protected by mutex
+    SDL_AtomicInt low_watermark;   ///< Fill level in percent at or below which the buffer counts as low; -1 = off
+    SDL_AtomicInt high_watermark;  ///< Fill level in percent at or above which the buffer counts as high; -1 = off
+    SDL_AtomicInt watermark_level; ///< 1 if the last watermark crossed was the high one, 0 if the low one
+    buf_watermark_cb watermark_cb;
+    void *watermark_userdata;
+    Kit_BufferEvent *wake_event; ///< Signaled when a write reaches wake_level
+    SDL_AtomicInt wake_level;    ///< Fill level in percent that wakes up the event, or KIT_PACKET_BUFFER_WAKE_ANY/NONE
+    SDL_AtomicInt spin_ns;       ///< Max time to busy-wait before blocking, in nanoseconds; 0 = off
+    buf_obj_alloc alloc_cb;
     buf_obj_unref unref_cb;
     buf_obj_free free_cb;
     buf_obj_move move_cb;
     buf_obj_ref ref_cb;
+    char pad_0[SDL_CACHELINE_SIZE];
+    SDL_AtomicInt head; ///< Next slot to write; only the writer advances this
+    char pad_1[SDL_CACHELINE_SIZE - sizeof(SDL_AtomicInt)];
+    SDL_AtomicInt tail; ///< Next slot to read; only a reader (holding the mutex) advances this
+    char pad_2[SDL_CACHELINE_SIZE - sizeof(SDL_AtomicInt)];
 };
 
 Kit_PacketBuffer *Kit_CreatePacketBuffer(
@@ -29,9 +59,11 @@ Kit_PacketBuffer *Kit_CreatePacketBuffer(
     buf_obj_unref unref_cb,
     buf_obj_free free_cb,
     buf_obj_move move_cb,
-    buf_obj_ref ref_cb
+    buf_obj_ref ref_cb,
+    unsigned int flags
 ) {
     assert(capacity > 0);
+    assert(capacity <= INT_MAX / 2);
     Kit_PacketBuffer *buffer = NULL;
     SDL_Mutex *mutex = NULL;
     SDL_Condition *can_write = NULL;
@@ -60,7 +92,7 @@ Kit_PacketBuffer *Kit_CreatePacketBuffer(
             goto error_4;
         }
     }
-    if((buffer = Kit_Malloc(sizeof(Kit_PacketBuffer))) == NULL) {
+    if((buffer = Kit_Calloc(1, sizeof(Kit_PacketBuffer))) == NULL) {
         Kit_SetError("Unable to allocate packet stream");
         goto error_4;
     }
@@ -70,14 +102,27 @@ Kit_PacketBuffer *Kit_CreatePacketBuffer(
     buffer->can_read = can_read;
     buffer->mutex = mutex;
     buffer->capacity = capacity;
-    buffer->head = 0;
-    buffer->tail = 0;
-    buffer->full = false;
-    buffer->aborted = false;
+    buffer->slots = capacity;
+    buffer->flags = flags;
+    buffer->writers_waiting = 0;
+    buffer->write_wanted = 0;
+    buffer->alloc_cb = alloc_cb;
     buffer->unref_cb = unref_cb;
     buffer->free_cb = free_cb;
     buffer->move_cb = move_cb;
     buffer->ref_cb = ref_cb;
+    SDL_SetAtomicInt(&buffer->readers_waiting, 0);
+    SDL_SetAtomicInt(&buffer->aborted, 0);
+    SDL_SetAtomicInt(&buffer->writing, 0);
+    SDL_SetAtomicInt(&buffer->resizing, 0);
+    SDL_SetAtomicInt(&buffer->bytes, 0);
+    SDL_SetAtomicInt(&buffer->low_watermark, -1);
+    SDL_SetAtomicInt(&buffer->high_watermark, -1);
+    SDL_SetAtomicInt(&buffer->watermark_level, 0);
+    SDL_SetAtomicInt(&buffer->wake_level, KIT_PACKET_BUFFER_WAKE_ANY);
+    SDL_SetAtomicInt(&buffer->spin_ns, 0);
+    SDL_SetAtomicInt(&buffer->head, 0);
+    SDL_SetAtomicInt(&buffer->tail, 0);
     return buffer;
 
 error_4:
@@ -107,7 +152,7 @@ void Kit_FreePacketBuffer(Kit_PacketBuffer **ref) {
     SDL_BroadcastCondition(buffer->can_read);
     SDL_BroadcastCondition(buffer->can_write);
     SDL_LockMutex(buffer->mutex);
-    for(size_t i = 0; i < buffer->capacity; i++) {
+    for(size_t i = 0; i < buffer->slots; i++) {
         buffer->free_cb((void **)&buffer->packets[i]);
     }
     SDL_UnlockMutex(buffer->mutex);
@@ -119,141 +164,593 @@ void Kit_FreePacketBuffer(Kit_PacketBuffer **ref) {
     *ref = NULL;
 }
 
-static bool Kit_IsPacketBufferFull(const Kit_PacketBuffer *buffer) {
-    return buffer->full;
+static bool Kit_IsPacketBufferLockFree(const Kit_PacketBuffer *buffer) {
+    return (buffer->flags & KIT_PACKET_BUFFER_SPSC) != 0;
 }
 
-static bool Kit_IsPacketBufferEmpty(const Kit_PacketBuffer *buffer) {
-    return (!buffer->full && (buffer->head == buffer->tail));
+static bool Kit_IsPacketBufferAborted(Kit_PacketBuffer *buffer) {
+    return SDL_GetAtomicInt(&buffer->aborted) != 0;
+}
+
+static int Kit_NextPacketBufferIndex(const Kit_PacketBuffer *buffer, int index) {
+    return (index + 1 == (int)(buffer->slots * 2)) ? 0 : index + 1;
+}
+
+static void *Kit_GetPacketBufferSlot(const Kit_PacketBuffer *buffer, int index) {
+    const size_t slot = (size_t)index;
+    return buffer->packets[slot < buffer->slots ? slot : slot - buffer->slots];
+}
+
+static size_t Kit_CountPacketBufferItems(const Kit_PacketBuffer *buffer, int head, int tail) {
+    return (head >= tail) ? (size_t)(head - tail) : buffer->slots * 2 + head - tail;
+}
+
+static size_t Kit_GetPacketBufferFreeSlots(Kit_PacketBuffer *buffer) {
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    const int head = SDL_GetAtomicInt(&buffer->head);
+    const size_t length = Kit_CountPacketBufferItems(buffer, head, tail);
+    return length < buffer->capacity ? buffer->capacity - length : 0;
+}
+
+static bool Kit_IsPacketBufferEmpty(Kit_PacketBuffer *buffer) {
+    return SDL_GetAtomicInt(&buffer->head) == SDL_GetAtomicInt(&buffer->tail);
+}
+
+static int Kit_GetPacketBufferObjectSize(const Kit_PacketBuffer *buffer, const void *obj) {
+    if(buffer->size_cb == NULL)
+        return 0;
+    const size_t size = buffer->size_cb(obj);
+    return size < INT_MAX ? (int)size : INT_MAX;
+}
+
+static bool Kit_IsPacketBufferOverBudget(Kit_PacketBuffer *buffer) {
+    // An empty buffer always takes one more item, so that a single item larger than the whole budget
+    // cannot stall the pipeline.
+    return buffer->byte_limit > 0 && SDL_GetAtomicInt(&buffer->bytes) >= buffer->byte_limit &&
+           !Kit_IsPacketBufferEmpty(buffer);
+}
+
+static bool Kit_HasPacketBufferRoom(Kit_PacketBuffer *buffer, size_t wanted) {
+    // The buffer may have been shrunk after the writer decided how much room it wants.
+    if(wanted > buffer->capacity)
+        wanted = buffer->capacity;
+    return Kit_GetPacketBufferFreeSlots(buffer) >= wanted && !Kit_IsPacketBufferOverBudget(buffer);
+}
+
+/**
+ * Raises or lowers a writing/resizing flag. Each side sets its own flag and then reads the other's, which only
+ * works if the store can't be reordered after that read. SDL_SetAtomicInt() is just an acquire barrier, so this
+ * uses a read-modify-write, which is a full barrier. Only the owning side changes a flag, so adding is safe.
+ */
+static void Kit_SetPacketBufferFlag(SDL_AtomicInt *flag, bool value) {
+    SDL_AddAtomicInt(flag, value ? 1 : -1);
+}
+
+/**
+ * Marks a lock-free writer as working on the slots. If a resize is in progress, waits for it to finish first;
+ * the resizer holds the mutex for the whole resize, so locking it is enough to wait.
+ */
+static void Kit_EnterPacketBufferWrite(Kit_PacketBuffer *buffer) {
+    Kit_SetPacketBufferFlag(&buffer->writing, true);
+    while(SDL_GetAtomicInt(&buffer->resizing)) {
+        Kit_SetPacketBufferFlag(&buffer->writing, false);
+        SDL_LockMutex(buffer->mutex);
+        SDL_UnlockMutex(buffer->mutex);
+        Kit_SetPacketBufferFlag(&buffer->writing, true);
+    }
+}
+
+/**
+ * Marks a lock-free writer as done with the slots. Must be called before the writer takes the mutex, since a
+ * resizer may be holding the mutex while it waits for the writer to leave.
+ */
+static void Kit_LeavePacketBufferWrite(Kit_PacketBuffer *buffer) {
+    Kit_SetPacketBufferFlag(&buffer->writing, false);
+}
+
+/**
+ * Busy-waits until the buffer has data (or `wanted` free slots, for a writer), it is aborted, or the spin time or
+ * timeout runs out. Does not touch the mutex. Returns true if there is no point in blocking anymore.
+ */
+static bool Kit_SpinPacketBuffer(Kit_PacketBuffer *buffer, bool write, size_t wanted, int timeout) {
+    const int spin_ns = SDL_GetAtomicInt(&buffer->spin_ns);
+    if(spin_ns <= 0 || timeout <= 0)
+        return false;
+    const Uint64 spin_max = (Uint64)timeout * SDL_NS_PER_MS;
+    const Uint64 deadline = SDL_GetTicksNS() + (spin_max < (Uint64)spin_ns ? spin_max : (Uint64)spin_ns);
+    while(!Kit_IsPacketBufferAborted(buffer)) {
+        if(write ? Kit_HasPacketBufferRoom(buffer, wanted) : !Kit_IsPacketBufferEmpty(buffer))
+            return true;
+        if(SDL_GetTicksNS() >= deadline)
+            return false;
+        SDL_CPUPauseInstruction();
+    }
+    return true;
+}
+
+void Kit_SetPacketBufferSpin(Kit_PacketBuffer *buffer, int spin_us) {
+    assert(buffer);
+    assert(spin_us >= 0 && spin_us <= KIT_PACKET_BUFFER_MAX_SPIN);
+    SDL_SetAtomicInt(&buffer->spin_ns, spin_us * (int)SDL_NS_PER_US);
+}
+
+void Kit_SetPacketBufferByteLimit(Kit_PacketBuffer *buffer, buf_obj_size size_cb, int byte_limit) {
+    assert(buffer);
+    assert(byte_limit >= 0);
+    assert(byte_limit == 0 || size_cb != NULL);
+    SDL_LockMutex(buffer->mutex);
+    assert(Kit_IsPacketBufferEmpty(buffer));
+    buffer->size_cb = size_cb;
+    buffer->byte_limit = byte_limit;
+    SDL_UnlockMutex(buffer->mutex);
+}
+
+int Kit_GetPacketBufferByteLimit(const Kit_PacketBuffer *buffer) {
+    assert(buffer);
+    Kit_PacketBuffer *mut = (Kit_PacketBuffer *)buffer;
+    SDL_LockMutex(mut->mutex);
+    const int byte_limit = mut->byte_limit;
+    SDL_UnlockMutex(mut->mutex);
+    return byte_limit;
+}
+
+size_t Kit_GetPacketBufferBytes(const Kit_PacketBuffer *buffer) {
+    assert(buffer);
+    const int bytes = SDL_GetAtomicInt(&((Kit_PacketBuffer *)buffer)->bytes);
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+void Kit_SetPacketBufferWatermarkCallback(Kit_PacketBuffer *buffer, buf_watermark_cb cb, void *userdata) {
+    assert(buffer);
+    SDL_LockMutex(buffer->mutex);
+    buffer->watermark_cb = cb;
+    buffer->watermark_userdata = userdata;
+    SDL_UnlockMutex(buffer->mutex);
+}
+
+void Kit_SetPacketBufferWatermarks(Kit_PacketBuffer *buffer, int low, int high) {
+    assert(buffer);
+    assert((low < 0 && high < 0) || (low >= 0 && low < high && high <= 100));
+    SDL_SetAtomicInt(&buffer->low_watermark, low < 0 ? -1 : low);
+    SDL_SetAtomicInt(&buffer->high_watermark, high < 0 ? -1 : high);
+}
+
+void Kit_SetPacketBufferWakeEvent(Kit_PacketBuffer *buffer, Kit_BufferEvent *event) {
+    assert(buffer);
+    buffer->wake_event = event;
+}
+
+void Kit_SetPacketBufferWakeLevel(Kit_PacketBuffer *buffer, int percent) {
+    assert(buffer);
+    assert(percent >= KIT_PACKET_BUFFER_WAKE_ANY && percent <= KIT_PACKET_BUFFER_WAKE_NONE);
+    SDL_SetAtomicInt(&buffer->wake_level, percent);
+}
+
+/**
+ * Checks whether the fill level is at or past the high (or low) watermark while the last crossing reported was
+ * the other one, and if so records the new crossing. The caller then runs the callback once it is not holding
+ * anything up. Caller must hold the mutex, or be the writer.
+ */
+static bool Kit_CrossPacketBufferWatermark(Kit_PacketBuffer *buffer, bool high) {
+    if(buffer->watermark_cb == NULL)
+        return false;
+    const int percent = SDL_GetAtomicInt(high ? &buffer->high_watermark : &buffer->low_watermark);
+    if(percent < 0)
+        return false;
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    const size_t level = Kit_CountPacketBufferItems(buffer, SDL_GetAtomicInt(&buffer->head), tail) * 100;
+    const size_t mark = buffer->capacity * (size_t)percent;
+    if(high ? level < mark : level > mark)
+        return false;
+    // The writer and a reader may both get here; only the one that flips the level gets to report it.
+    return SDL_SetAtomicInt(&buffer->watermark_level, high) != (int)high;
+}
+
+/**
+ * Records the current fill level into the peak counter. Caller must hold the mutex. The fill level only ever
+ * drops under the mutex, so sampling it there, before every drop, is enough to catch the real peak.
+ */
+static void Kit_TrackPacketBufferPeak(Kit_PacketBuffer *buffer) {
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    const size_t length = Kit_CountPacketBufferItems(buffer, SDL_GetAtomicInt(&buffer->head), tail);
+    if(length > buffer->stats.peak_length)
+        buffer->stats.peak_length = length;
+}
+
+void Kit_GetPacketBufferStats(const Kit_PacketBuffer *buffer, Kit_PacketBufferStats *stats) {
+    assert(buffer);
+    assert(stats);
+    Kit_PacketBuffer *mut = (Kit_PacketBuffer *)buffer;
+    SDL_LockMutex(mut->mutex);
+    Kit_TrackPacketBufferPeak(mut);
+    *stats = mut->stats;
+    // Everything that was ever written has been read, flushed, or is still in the buffer. Deriving the count
+    // keeps the lock-free writer from having to touch any shared counter.
+    const int tail = SDL_GetAtomicInt(&mut->tail);
+    const size_t length = Kit_CountPacketBufferItems(mut, SDL_GetAtomicInt(&mut->head), tail);
+    stats->writes = stats->reads + mut->flushed + length;
+    SDL_UnlockMutex(mut->mutex);
 }
 
 size_t Kit_GetPacketBufferCapacity(const Kit_PacketBuffer *buffer) {
     assert(buffer);
-    return buffer->capacity;
+    Kit_PacketBuffer *mut = (Kit_PacketBuffer *)buffer;
+    SDL_LockMutex(mut->mutex);
+    const size_t capacity = mut->capacity;
+    SDL_UnlockMutex(mut->mutex);
+    return capacity;
 }
 
 size_t Kit_GetPacketBufferLength(const Kit_PacketBuffer *buffer) {
     assert(buffer);
+    Kit_PacketBuffer *mut = (Kit_PacketBuffer *)buffer;
     size_t length;
-    SDL_LockMutex(buffer->mutex);
-    if(buffer->full)
-        length = buffer->capacity;
-    else
-        length = (buffer->head >= buffer->tail) ? buffer->head - buffer->tail
-                                                : buffer->capacity + buffer->head - buffer->tail;
-    SDL_UnlockMutex(buffer->mutex);
+    // Holding the mutex pins the tail; the head can only move forward, so this never overshoots the slot count.
+    // It may still exceed the capacity for a while after the buffer has been shrunk.
+    SDL_LockMutex(mut->mutex);
+    const int tail = SDL_GetAtomicInt(&mut->tail);
+    const int head = SDL_GetAtomicInt(&mut->head);
+    length = Kit_CountPacketBufferItems(buffer, head, tail);
+    SDL_UnlockMutex(mut->mutex);
     return length;
 }
 
 void Kit_FlushPacketBuffer(Kit_PacketBuffer *buffer) {
     if(buffer == NULL)
         return;
+    // Flushing consumes everything that has been published so far instead of resetting both positions, so
+    // that a lock-free writer that is concurrently filling the head slot is left alone.
     SDL_LockMutex(buffer->mutex);
-    for(size_t i = 0; i < buffer->capacity; i++) {
-        buffer->unref_cb(buffer->packets[i]);
+    Kit_TrackPacketBufferPeak(buffer);
+    const int head = SDL_GetAtomicInt(&buffer->head);
+    int tail = SDL_GetAtomicInt(&buffer->tail);
+    int bytes = 0;
+    while(tail != head) {
+        void *slot = Kit_GetPacketBufferSlot(buffer, tail);
+        bytes += Kit_GetPacketBufferObjectSize(buffer, slot);
+        buffer->unref_cb(slot);
+        buffer->flushed++;
+        tail = Kit_NextPacketBufferIndex(buffer, tail);
     }
-    buffer->head = 0;
-    buffer->tail = 0;
-    buffer->full = false;
-    buffer->aborted = false;
-    SDL_UnlockMutex(buffer->mutex);
+    SDL_AddAtomicInt(&buffer->bytes, -bytes);
+    SDL_SetAtomicInt(&buffer->tail, tail);
+    SDL_SetAtomicInt(&buffer->aborted, 0);
     // Wake up writers, since buffer now has free space.
-    SDL_SignalCondition(buffer->can_write);
+    if(buffer->writers_waiting > 0)
+        SDL_BroadcastCondition(buffer->can_write);
+    const bool crossed = Kit_CrossPacketBufferWatermark(buffer, false);
+    SDL_UnlockMutex(buffer->mutex);
+    if(crossed)
+        buffer->watermark_cb(buffer->watermark_userdata, false);
+}
+
+bool Kit_ResizePacketBuffer(Kit_PacketBuffer *buffer, size_t capacity, int byte_limit) {
+    assert(buffer);
+    assert(capacity > 0);
+    assert(capacity <= INT_MAX / 2);
+    assert(byte_limit >= 0);
+    assert(byte_limit == 0 || buffer->size_cb != NULL);
+
+    // Holding the mutex keeps out readers, flushes and locked writers. A lock-free writer does not take it, so
+    // also wait for it to step out of the slots; it stays out until the resizing flag is cleared.
+    SDL_LockMutex(buffer->mutex);
+    Kit_SetPacketBufferFlag(&buffer->resizing, true);
+    while(SDL_GetAtomicInt(&buffer->writing))
+        SDL_Delay(0);
+
+    Kit_TrackPacketBufferPeak(buffer);
+    const int head = SDL_GetAtomicInt(&buffer->head);
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    const size_t length = Kit_CountPacketBufferItems(buffer, head, tail);
+    const size_t slots = capacity > length ? capacity : length; // Queued items are never dropped
+    void **packets;
+
+    // Allocate everything first, so that a failure leaves the buffer untouched.
+    if((packets = Kit_Calloc(slots, sizeof(void *))) == NULL) {
+        Kit_SetError("Unable to allocate packet buffer");
+        goto exit_0;
+    }
+    for(size_t i = buffer->slots; i < slots; i++) {
+        if((packets[i] = buffer->alloc_cb()) == NULL) {
+            Kit_SetError("Unable to allocate av_packet");
+            goto exit_1;
+        }
+    }
+
+    // Queued items keep their slot objects and move to the front in order, followed by the unused slot objects.
+    // Objects that no longer fit are freed; when growing, the new ones are already in place at the end.
+    int index = tail;
+    for(size_t i = 0; i < buffer->slots; i++) {
+        void *slot = Kit_GetPacketBufferSlot(buffer, index);
+        if(i < slots)
+            packets[i] = slot;
+        else
+            buffer->free_cb(&slot);
+        index = Kit_NextPacketBufferIndex(buffer, index);
+    }
+    free(buffer->packets);
+    buffer->packets = packets;
+    buffer->slots = slots;
+    buffer->capacity = capacity;
+    buffer->byte_limit = byte_limit;
+    SDL_SetAtomicInt(&buffer->tail, 0);
+    SDL_SetAtomicInt(&buffer->head, (int)length);
+    // The writer may be waiting for room that the new capacity now gives it.
+    if(buffer->writers_waiting > 0)
+        SDL_BroadcastCondition(buffer->can_write);
+    Kit_SetPacketBufferFlag(&buffer->resizing, false);
+    SDL_UnlockMutex(buffer->mutex);
+    // The fill level moves with the capacity, possibly up to the wake level.
+    Kit_SignalBufferEvent(buffer->wake_event);
+    return true;
+
+exit_1:
+    for(size_t i = buffer->slots; i < slots; i++) {
+        if(packets[i] != NULL)
+            buffer->free_cb(&packets[i]);
+    }
+    free(packets);
+exit_0:
+    Kit_SetPacketBufferFlag(&buffer->resizing, false);
+    SDL_UnlockMutex(buffer->mutex);
+    return false;
 }
 
 void Kit_AbortPacketBuffer(Kit_PacketBuffer *buffer) {
     if(buffer == NULL)
         return;
+    SDL_SetAtomicInt(&buffer->aborted, 1);
+    // Waiters check the abort flag while holding the mutex, so broadcasting under it cannot be missed.
     SDL_LockMutex(buffer->mutex);
-    buffer->aborted = true;
-    SDL_UnlockMutex(buffer->mutex);
-    // Wake up all waiters so that they notice the abort.
+    buffer->stats.aborts++;
     SDL_BroadcastCondition(buffer->can_write);
     SDL_BroadcastCondition(buffer->can_read);
+    SDL_UnlockMutex(buffer->mutex);
 }
 
-static void advance_read(Kit_PacketBuffer *buffer) {
-    assert(buffer);
-    buffer->full = false;
-    if(++(buffer->tail) == buffer->capacity)
-        buffer->tail = 0;
+/**
+ * Waits until the buffer has at least `wanted` free slots and is within its byte budget. In locked mode the
+ * caller already holds the mutex; in lock-free mode the mutex is only taken here when the buffer is actually
+ * too full, and after spinning for a while if that is enabled.
+ */
+static bool Kit_WaitPacketBufferWritable(Kit_PacketBuffer *buffer, bool locked, size_t wanted) {
+    if(Kit_HasPacketBufferRoom(buffer, wanted))
+        return !Kit_IsPacketBufferAborted(buffer);
+    // Readers need the mutex to make room, so spinning only makes sense for a lock-free writer.
+    if(!locked && Kit_SpinPacketBuffer(buffer, true, wanted, INT_MAX))
+        return !Kit_IsPacketBufferAborted(buffer);
+    if(!locked) {
+        Kit_LeavePacketBufferWrite(buffer);
+        SDL_LockMutex(buffer->mutex);
+    }
+    // Readers only wake us up once enough space has been freed for the whole request, so that a writer
+    // pushing a batch into a full buffer does not get woken up for every single slot.
+    buffer->write_wanted = (buffer->writers_waiting++ == 0) ? wanted : 1;
+    // The wait may also end due to a spurious wakeup, so keep waiting until there is really
+    // free space (or an abort). Failing the write on a spurious wakeup would drop the packet.
+    const Uint64 wait_start = SDL_GetTicksNS();
+    while(!Kit_HasPacketBufferRoom(buffer, wanted) && !Kit_IsPacketBufferAborted(buffer))
+        SDL_WaitCondition(buffer->can_write, buffer->mutex);
+    buffer->stats.write_wait_ns += SDL_GetTicksNS() - wait_start;
+    if(--buffer->writers_waiting == 0)
+        buffer->write_wanted = 0;
+    if(!locked) {
+        SDL_UnlockMutex(buffer->mutex);
+        Kit_EnterPacketBufferWrite(buffer);
+    }
+    return !Kit_IsPacketBufferAborted(buffer);
 }
 
-static void advance_write(Kit_PacketBuffer *buffer) {
-    assert(buffer);
-    if(buffer->full)
-        if(++(buffer->tail) == buffer->capacity)
-            buffer->tail = 0;
-    if(++(buffer->head) == buffer->capacity)
-        buffer->head = 0;
-    buffer->full = (buffer->head == buffer->tail);
+/**
+ * Waits until the buffer has data, for at most timeout milliseconds. Caller must hold the mutex.
+ */
+static bool Kit_WaitPacketBufferReadable(Kit_PacketBuffer *buffer, int timeout) {
+    if(Kit_IsPacketBufferAborted(buffer))
+        return false;
+    if(!Kit_IsPacketBufferEmpty(buffer))
+        return true;
+    if(timeout <= 0)
+        return false;
+    // Lock-free writers only take the mutex to signal if they see a waiting reader. Publishing the
+    // waiter count before re-checking the head guarantees that either we see the new data, or the
+    // writer sees us. Both sides store with a full barrier for this; see Kit_PutPacketBufferBatch().
+    SDL_AddAtomicInt(&buffer->readers_waiting, 1);
+    if(Kit_IsPacketBufferEmpty(buffer) && !Kit_IsPacketBufferAborted(buffer)) {
+        const Uint64 wait_start = SDL_GetTicksNS();
+        SDL_WaitConditionTimeout(buffer->can_read, buffer->mutex, timeout);
+        buffer->stats.read_wait_ns += SDL_GetTicksNS() - wait_start;
+    }
+    SDL_AddAtomicInt(&buffer->readers_waiting, -1);
+    // The wait may have ended due to an abort or a spurious wakeup, so re-check the state.
+    return !Kit_IsPacketBufferAborted(buffer) && !Kit_IsPacketBufferEmpty(buffer);
 }
 
-bool Kit_WritePacketBuffer(Kit_PacketBuffer *buffer, void *src) {
+/**
+ * Wakes up a reader after new data was published. In locked mode the caller holds the mutex.
+ */
+static void Kit_WakePacketBufferReader(Kit_PacketBuffer *buffer, bool locked) {
+    if(locked) {
+        SDL_SignalCondition(buffer->can_read);
+    } else if(SDL_GetAtomicInt(&buffer->readers_waiting) > 0) {
+        Kit_LeavePacketBufferWrite(buffer);
+        SDL_LockMutex(buffer->mutex);
+        SDL_SignalCondition(buffer->can_read);
+        SDL_UnlockMutex(buffer->mutex);
+        Kit_EnterPacketBufferWrite(buffer);
+    }
+}
+
+/**
+ * Reports the buffer going over its high watermark after a write. A lock-free writer steps out of the slots for
+ * the callback, so that nothing waiting on it (such as a resize) is held up by the callback.
+ */
+static void Kit_NotifyPacketBufferWrite(Kit_PacketBuffer *buffer, bool locked) {
+    if(!Kit_CrossPacketBufferWatermark(buffer, true))
+        return;
+    if(!locked)
+        Kit_LeavePacketBufferWrite(buffer);
+    buffer->watermark_cb(buffer->watermark_userdata, true);
+    if(!locked)
+        Kit_EnterPacketBufferWrite(buffer);
+}
+
+/**
+ * Signals the wake event if writing `written` items, ending at `head`, took the fill level up to the wake level.
+ * The tail is read after the write was published, so a reader racing the write can only make the level before the
+ * write look lower, never hide a crossing.
+ */
+static void Kit_WakePacketBufferWaiter(Kit_PacketBuffer *buffer, int head, size_t written) {
+    if(buffer->wake_event == NULL)
+        return;
+    const int percent = SDL_GetAtomicInt(&buffer->wake_level);
+    if(percent != KIT_PACKET_BUFFER_WAKE_ANY) {
+        const size_t after = Kit_CountPacketBufferItems(buffer, head, SDL_GetAtomicInt(&buffer->tail));
+        const size_t before = after > written ? after - written : 0;
+        const size_t mark = buffer->capacity * (size_t)percent;
+        if(before * 100 >= mark || after * 100 < mark)
+            return;
+    }
+    Kit_SignalBufferEvent(buffer->wake_event);
+}
+
+/**
+ * Releases the slots before `tail`, holding `bytes` worth of data, back to the writer. Caller must hold the
+ * mutex and be done with the slots.
+ */
+static void Kit_AdvancePacketBufferRead(Kit_PacketBuffer *buffer, int tail, int bytes) {
+    if(bytes > 0)
+        SDL_AddAtomicInt(&buffer->bytes, -bytes);
+    SDL_SetAtomicInt(&buffer->tail, tail);
+    if(buffer->writers_waiting > 0 && Kit_HasPacketBufferRoom(buffer, buffer->write_wanted))
+        SDL_BroadcastCondition(buffer->can_write);
+}
+
+/**
+ * Identifies the object at the read position. Counts everything that has ever left the buffer, so that it stays the
+ * same across resizes (which renumber the slots) and changes on every read and flush. Caller must hold the mutex.
+ */
+static uint64_t Kit_GetPacketBufferReadTicket(const Kit_PacketBuffer *buffer) {
+    return buffer->stats.reads + buffer->flushed;
+}
+
+/**
+ * Moves objects into the buffer. If wait is set, blocks until all of them fit; otherwise only writes what fits
+ * right away.
+ */
+static size_t Kit_PutPacketBufferBatch(Kit_PacketBuffer *buffer, void **src, size_t count, bool wait) {
     assert(buffer);
     assert(src);
-    SDL_LockMutex(buffer->mutex);
-    // The wait may also end due to a spurious wakeup, so keep waiting until there is really
-    // free space (or an abort). Failing the write on a spurious wakeup would drop the packet.
-    while(Kit_IsPacketBufferFull(buffer) && !buffer->aborted)
-        SDL_WaitCondition(buffer->can_write, buffer->mutex);
-    if(buffer->aborted)
-        goto error;
-    buffer->move_cb(buffer->packets[buffer->head], src);
-    advance_write(buffer);
-    // LOG("WRITE -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
-    // Kit_GetPacketBufferLength(buffer), buffer->capacity);
-    SDL_UnlockMutex(buffer->mutex);
-    SDL_SignalCondition(buffer->can_read);
-    return true;
+    const bool locked = !Kit_IsPacketBufferLockFree(buffer);
+    size_t written = 0;
+    if(locked)
+        SDL_LockMutex(buffer->mutex);
+    else
+        Kit_EnterPacketBufferWrite(buffer);
+    while(written < count) {
+        // Don't ask for more than half of the buffer at once, so the reader is not left to drain it completely
+        // before we get to continue.
+        const size_t left = count - written;
+        const size_t half = buffer->capacity > 1 ? buffer->capacity / 2 : 1;
+        if(wait && !Kit_WaitPacketBufferWritable(buffer, locked, left < half ? left : half))
+            break;
+        if(!wait && (!Kit_HasPacketBufferRoom(buffer, 1) || Kit_IsPacketBufferAborted(buffer)))
+            break;
+        const size_t room = Kit_GetPacketBufferFreeSlots(buffer);
+        const int queued = SDL_GetAtomicInt(&buffer->bytes);
+        const int start = SDL_GetAtomicInt(&buffer->head);
+        int head = start;
+        int bytes = 0;
+        size_t n = 0;
+        for(; n < left && n < room; n++) {
+            // The wait above guarantees room for at least one item; stop once the rest would go over budget.
+            if(n > 0 && buffer->byte_limit > 0 && queued + bytes >= buffer->byte_limit)
+                break;
+            bytes += Kit_GetPacketBufferObjectSize(buffer, src[written + n]);
+            buffer->move_cb(Kit_GetPacketBufferSlot(buffer, head), src[written + n]);
+            head = Kit_NextPacketBufferIndex(buffer, head);
+        }
+        // Account for the bytes before publishing, so that a reader can never subtract them first.
+        if(bytes > 0)
+            SDL_AddAtomicInt(&buffer->bytes, bytes);
+        // Publish with a full barrier: the head store must be visible before Kit_WakePacketBufferReader() reads
+        // readers_waiting, or a reader that just went to sleep would miss the data until its wait times out.
+        // SDL_SetAtomicInt() does not order the two. Only this writer moves the head, so the swap always succeeds.
+        const bool published = SDL_CompareAndSwapAtomicInt(&buffer->head, start, head);
+        assert(published);
+        (void)published;
+        written += n;
+        // LOG("WRITE -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
+        // Kit_GetPacketBufferLength(buffer), buffer->capacity);
+        Kit_WakePacketBufferReader(buffer, locked);
+        Kit_NotifyPacketBufferWrite(buffer, locked);
+        Kit_WakePacketBufferWaiter(buffer, head, n);
+    }
+    if(locked)
+        SDL_UnlockMutex(buffer->mutex);
+    else
+        Kit_LeavePacketBufferWrite(buffer);
+    return written;
+}
 
-error:
-    SDL_UnlockMutex(buffer->mutex);
-    return false;
+size_t Kit_WritePacketBufferBatch(Kit_PacketBuffer *buffer, void **src, size_t count) {
+    return Kit_PutPacketBufferBatch(buffer, src, count, true);
 }
 
-bool Kit_ReadPacketBuffer(Kit_PacketBuffer *buffer, void *dst, int timeout) {
+size_t Kit_TryWritePacketBufferBatch(Kit_PacketBuffer *buffer, void **src, size_t count) {
+    return Kit_PutPacketBufferBatch(buffer, src, count, false);
+}
+
+bool Kit_WritePacketBuffer(Kit_PacketBuffer *buffer, void *src) {
+    return Kit_WritePacketBufferBatch(buffer, &src, 1) == 1;
+}
+
+size_t Kit_ReadPacketBufferBatch(Kit_PacketBuffer *buffer, void **dst, size_t count, size_t max_bytes, int timeout) {
     assert(buffer);
+    assert(dst);
+    size_t n = 0;
+    bool crossed = false;
+    Kit_SpinPacketBuffer(buffer, false, 0, timeout);
     SDL_LockMutex(buffer->mutex);
-    if(buffer->aborted)
-        goto error;
-    if(Kit_IsPacketBufferEmpty(buffer)) {
-        if(timeout <= 0)
-            goto error;
-        if(!SDL_WaitConditionTimeout(buffer->can_read, buffer->mutex, timeout))
-            goto error;
+    if(count == 0 || !Kit_WaitPacketBufferReadable(buffer, timeout))
+        goto exit;
+    int tail = SDL_GetAtomicInt(&buffer->tail);
+    const size_t available = Kit_CountPacketBufferItems(buffer, SDL_GetAtomicInt(&buffer->head), tail);
+    if(available > buffer->stats.peak_length)
+        buffer->stats.peak_length = available;
+    int bytes = 0;
+    for(; n < count && n < available; n++) {
+        if(max_bytes > 0 && n > 0 && (size_t)bytes >= max_bytes)
+            break;
+        void *slot = Kit_GetPacketBufferSlot(buffer, tail);
+        bytes += Kit_GetPacketBufferObjectSize(buffer, slot);
+        buffer->move_cb(dst[n], slot);
+        tail = Kit_NextPacketBufferIndex(buffer, tail);
     }
-    // The wait may have ended due to an abort or a spurious wakeup, so re-check the state.
-    if(buffer->aborted || Kit_IsPacketBufferEmpty(buffer))
-        goto error;
-    buffer->move_cb(dst, buffer->packets[buffer->tail]);
-    advance_read(buffer);
+    buffer->stats.reads += n;
+    Kit_AdvancePacketBufferRead(buffer, tail, bytes);
+    crossed = Kit_CrossPacketBufferWatermark(buffer, false);
     // LOG("READ -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
     // Kit_GetPacketBufferLength(buffer), buffer->capacity);
-    SDL_UnlockMutex(buffer->mutex);
-    SDL_SignalCondition(buffer->can_write);
-    return true;
 
-error:
+exit:
     SDL_UnlockMutex(buffer->mutex);
-    return false;
+    if(crossed)
+        buffer->watermark_cb(buffer->watermark_userdata, false);
+    return n;
+}
+
+bool Kit_ReadPacketBuffer(Kit_PacketBuffer *buffer, void *dst, int timeout) {
+    return Kit_ReadPacketBufferBatch(buffer, &dst, 1, 0, timeout) == 1;
 }
 
 bool Kit_BeginPacketBufferRead(Kit_PacketBuffer *buffer, void *dst, int timeout) {
     assert(buffer);
+    Kit_SpinPacketBuffer(buffer, false, 0, timeout);
     SDL_LockMutex(buffer->mutex);
-    if(buffer->aborted)
+    if(!Kit_WaitPacketBufferReadable(buffer, timeout))
         goto error;
-    if(Kit_IsPacketBufferEmpty(buffer)) {
-        if(timeout <= 0)
-            goto error;
-        if(!SDL_WaitConditionTimeout(buffer->can_read, buffer->mutex, timeout))
-            goto error;
-    }
-    // The wait may have ended due to an abort or a spurious wakeup, so re-check the state.
-    if(buffer->aborted || Kit_IsPacketBufferEmpty(buffer))
-        goto error;
-    buffer->ref_cb(dst, buffer->packets[buffer->tail]);
+    Kit_TrackPacketBufferPeak(buffer);
+    buffer->ref_cb(dst, Kit_GetPacketBufferSlot(buffer, SDL_GetAtomicInt(&buffer->tail)));
     // LOG("BEGIN -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
     // Kit_GetPacketBufferLength(buffer), buffer->capacity);
     return true;
@@ -265,12 +762,18 @@ error:
 
 void Kit_FinishPacketBufferRead(Kit_PacketBuffer *buffer) {
     assert(buffer);
-    buffer->unref_cb(buffer->packets[buffer->tail]);
-    advance_read(buffer);
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    void *slot = Kit_GetPacketBufferSlot(buffer, tail);
+    const int bytes = Kit_GetPacketBufferObjectSize(buffer, slot);
+    buffer->unref_cb(slot);
+    buffer->stats.reads++;
+    Kit_AdvancePacketBufferRead(buffer, Kit_NextPacketBufferIndex(buffer, tail), bytes);
+    const bool crossed = Kit_CrossPacketBufferWatermark(buffer, false);
     SDL_UnlockMutex(buffer->mutex);
+    if(crossed)
+        buffer->watermark_cb(buffer->watermark_userdata, false);
     // LOG("FINISH -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
     // Kit_GetPacketBufferLength(buffer), buffer->capacity);
-    SDL_SignalCondition(buffer->can_write);
 }
 
 void Kit_CancelPacketBufferRead(Kit_PacketBuffer *buffer) {
@@ -278,4 +781,46 @@ void Kit_CancelPacketBufferRead(Kit_PacketBuffer *buffer) {
     // LOG("CANCEL -- HEAD = %lld, TAIL = %lld, USED = %lld/%lld\n", buffer->head, buffer->tail,
     // Kit_GetPacketBufferLength(buffer), buffer->capacity);
     SDL_UnlockMutex(buffer->mutex);
-}
\ No newline at end of file
+}
+
+bool Kit_PeekPacketBuffer(Kit_PacketBuffer *buffer, buf_obj_peek peek_cb, void *dst, uint64_t *ticket, int timeout) {
+    assert(buffer);
+    assert(peek_cb);
+    assert(ticket);
+    Kit_SpinPacketBuffer(buffer, false, 0, timeout);
+    SDL_LockMutex(buffer->mutex);
+    const bool readable = Kit_WaitPacketBufferReadable(buffer, timeout);
+    if(readable) {
+        Kit_TrackPacketBufferPeak(buffer);
+        peek_cb(dst, Kit_GetPacketBufferSlot(buffer, SDL_GetAtomicInt(&buffer->tail)));
+        *ticket = Kit_GetPacketBufferReadTicket(buffer);
+    }
+    SDL_UnlockMutex(buffer->mutex);
+    return readable;
+}
+
+bool Kit_TakePacketBuffer(Kit_PacketBuffer *buffer, void *dst, uint64_t ticket) {
+    assert(buffer);
+    bool taken = false;
+    bool crossed = false;
+    SDL_LockMutex(buffer->mutex);
+    if(Kit_IsPacketBufferEmpty(buffer) || Kit_GetPacketBufferReadTicket(buffer) != ticket)
+        goto exit;
+    const int tail = SDL_GetAtomicInt(&buffer->tail);
+    void *slot = Kit_GetPacketBufferSlot(buffer, tail);
+    const int bytes = Kit_GetPacketBufferObjectSize(buffer, slot);
+    if(dst != NULL)
+        buffer->move_cb(dst, slot);
+    else
+        buffer->unref_cb(slot);
+    buffer->stats.reads++;
+    Kit_AdvancePacketBufferRead(buffer, Kit_NextPacketBufferIndex(buffer, tail), bytes);
+    crossed = Kit_CrossPacketBufferWatermark(buffer, false);
+    taken = true;
+
+exit:
+    SDL_UnlockMutex(buffer->mutex);
+    if(crossed)
+        buffer->watermark_cb(buffer->watermark_userdata, false);
+    return taken;
+}
@@ -0,0 +1,231 @@
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+
+#include "kitchensink3/internal/kitfaultinject.h"
+#include "kitchensink3/internal/kitreadahead.h"
+#include "kitchensink3/internal/utils/kitalloc.h"
+#include "kitchensink3/kiterror.h"
+
+// The ring holds the bytes [pos, pos + fill) of the stream, starting at ring offset `start`. Only the read-ahead
+// thread writes into the ring, and only into the free part of it, so it can run the upstream read without holding
+// the mutex; readers only ever look at the queued part.
+struct Kit_ReadAhead {
+    Kit_ReadCallback read_cb;
+    Kit_SeekCallback seek_cb;
+    Kit_ReadAheadCloseCallback close_cb;
+    void *userdata;
+    SDL_Thread *thread;
+    SDL_Mutex *mutex;
+    SDL_Condition *can_read; ///< Signaled when data or a status gets queued, or an upstream read finishes
+    SDL_Condition *can_fill; ///< Signaled when room is freed up, on seeks and on quit
+    uint8_t *ring;
+    size_t window;  ///< Ring size in bytes
+    size_t start;   ///< Ring offset of the next byte to read
+    size_t fill;    ///< Bytes queued
+    int64_t pos;    ///< Stream position of the next byte to read
+    int status;     ///< Error or AVERROR_EOF to pass on once the queued data has been read; 0 if none
+    bool reading;   ///< Set while the thread is in the upstream read callback
+    bool quit;
+};
+
+/**
+ * Gets the size of the next upstream read, or 0 if it is not worth reading yet. Waits until a good amount of room
+ * has been freed up, so that the upstream sees large reads instead of one per chunk the demuxer happens to take.
+ */
+static size_t Kit_GetReadAheadSize(const Kit_ReadAhead *ra) {
+    const size_t room = ra->window - ra->fill;
+    const size_t quarter = ra->window / 4;
+    if(room == 0 || room < (quarter < KIT_READ_AHEAD_MAX_READ ? quarter : KIT_READ_AHEAD_MAX_READ))
+        return 0;
+    const size_t end = (ra->start + ra->fill) % ra->window;
+    const size_t contiguous = (end < ra->start) ? ra->start - end : ra->window - end;
+    return contiguous < KIT_READ_AHEAD_MAX_READ ? contiguous : KIT_READ_AHEAD_MAX_READ;
+}
+
+static int Kit_ReadAheadMain(void *ptr) {
+    Kit_ReadAhead *ra = ptr;
+    SDL_LockMutex(ra->mutex);
+    while(!ra->quit) {
+        const size_t size = Kit_GetReadAheadSize(ra);
+        if(size == 0 || ra->status != 0) {
+            SDL_WaitCondition(ra->can_fill, ra->mutex);
+            continue;
+        }
+        uint8_t *dst = ra->ring + (ra->start + ra->fill) % ra->window;
+        ra->reading = true;
+        SDL_UnlockMutex(ra->mutex);
+        const int ret = ra->read_cb(ra->userdata, dst, (int)size);
+        SDL_LockMutex(ra->mutex);
+        ra->reading = false;
+        // Seeks wait for the read to finish before they touch the upstream, so the data is always from the
+        // position we expect. Returning 0 is not valid for a read callback; treat it as the end of stream.
+        if(ret > 0)
+            ra->fill += (size_t)ret;
+        else
+            ra->status = ret == 0 ? AVERROR_EOF : ret;
+        SDL_BroadcastCondition(ra->can_read);
+    }
+    SDL_UnlockMutex(ra->mutex);
+    return 0;
+}
+
+Kit_ReadAhead *Kit_CreateReadAhead(
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    Kit_ReadAheadCloseCallback close_cb,
+    void *userdata,
+    size_t window
+) {
+    assert(read_cb != NULL);
+    assert(window >= KIT_READ_AHEAD_MIN_WINDOW);
+    Kit_ReadAhead *ra;
+
+    if((ra = Kit_Calloc(1, sizeof(Kit_ReadAhead))) == NULL) {
+        Kit_SetError("Unable to allocate read-ahead");
+        goto exit_0;
+    }
+    if((ra->ring = Kit_Calloc(1, window)) == NULL) {
+        Kit_SetError("Unable to allocate read-ahead buffer");
+        goto exit_1;
+    }
+    if((ra->mutex = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate read-ahead mutex: %s", SDL_GetError());
+        goto exit_2;
+    }
+    if((ra->can_read = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateCondition())) == NULL) {
+        Kit_SetError("Unable to allocate read-ahead conditional variable: %s", SDL_GetError());
+        goto exit_3;
+    }
+    if((ra->can_fill = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateCondition())) == NULL) {
+        Kit_SetError("Unable to allocate read-ahead conditional variable: %s", SDL_GetError());
+        goto exit_4;
+    }
+
+    ra->read_cb = read_cb;
+    ra->seek_cb = seek_cb;
+    ra->close_cb = close_cb;
+    ra->userdata = userdata;
+    ra->window = window;
+    if((ra->thread = SDL_CreateThread(Kit_ReadAheadMain, "SDL_Kitchensink read-ahead thread", ra)) == NULL) {
+        Kit_SetError("Unable to start read-ahead thread: %s", SDL_GetError());
+        goto exit_5;
+    }
+    return ra;
+
+exit_5:
+    SDL_DestroyCondition(ra->can_fill);
+exit_4:
+    SDL_DestroyCondition(ra->can_read);
+exit_3:
+    SDL_DestroyMutex(ra->mutex);
+exit_2:
+    free(ra->ring);
+exit_1:
+    free(ra);
+exit_0:
+    return NULL;
+}
+
+void Kit_CloseReadAhead(Kit_ReadAhead **ref) {
+    if(!ref || !*ref)
+        return;
+    Kit_ReadAhead *ra = *ref;
+    SDL_LockMutex(ra->mutex);
+    ra->quit = true;
+    SDL_BroadcastCondition(ra->can_fill);
+    SDL_BroadcastCondition(ra->can_read);
+    SDL_UnlockMutex(ra->mutex);
+    SDL_WaitThread(ra->thread, NULL);
+    if(ra->close_cb != NULL)
+        ra->close_cb(ra->userdata);
+    SDL_DestroyCondition(ra->can_fill);
+    SDL_DestroyCondition(ra->can_read);
+    SDL_DestroyMutex(ra->mutex);
+    free(ra->ring);
+    free(ra);
+    *ref = NULL;
+}
+
+/**
+ * Drops `size` bytes from the front of the queued data. Caller must hold the mutex.
+ */
+static void Kit_SkipReadAhead(Kit_ReadAhead *ra, size_t size) {
+    ra->start = (ra->start + size) % ra->window;
+    ra->fill -= size;
+    ra->pos += (int64_t)size;
+    SDL_SignalCondition(ra->can_fill);
+}
+
+int Kit_ReadAheadRead(void *opaque, uint8_t *buf, int size) {
+    Kit_ReadAhead *ra = opaque;
+    int ret;
+    if(size <= 0)
+        return 0;
+    SDL_LockMutex(ra->mutex);
+    while(ra->fill == 0 && ra->status == 0 && !ra->quit)
+        SDL_WaitCondition(ra->can_read, ra->mutex);
+    if(ra->fill > 0) {
+        const size_t count = ra->fill < (size_t)size ? ra->fill : (size_t)size;
+        const size_t first = ra->window - ra->start;
+        if(count <= first) {
+            memcpy(buf, ra->ring + ra->start, count);
+        } else {
+            memcpy(buf, ra->ring + ra->start, first);
+            memcpy(buf + first, ra->ring, count - first);
+        }
+        Kit_SkipReadAhead(ra, count);
+        ret = (int)count;
+    } else if(ra->status != 0) {
+        // Pass the status on once, and let the thread try again after that. This way a reader that retries
+        // after an error gets a fresh upstream read, just like it would without the read-ahead.
+        ret = ra->status;
+        ra->status = 0;
+        SDL_SignalCondition(ra->can_fill);
+    } else {
+        ret = AVERROR_EXIT;
+    }
+    SDL_UnlockMutex(ra->mutex);
+    return ret;
+}
+
+int64_t Kit_ReadAheadSeek(void *opaque, int64_t offset, int whence) {
+    Kit_ReadAhead *ra = opaque;
+    assert(ra->seek_cb != NULL);
+    int64_t ret;
+    SDL_LockMutex(ra->mutex);
+    while(ra->reading)
+        SDL_WaitCondition(ra->can_read, ra->mutex);
+    if(whence & AVSEEK_SIZE) {
+        ret = ra->seek_cb(ra->userdata, offset, whence);
+        goto exit;
+    }
+    // The upstream is ahead of the reader by the queued data, so relative seeks are made absolute here.
+    if((whence & ~AVSEEK_FORCE) == SEEK_CUR) {
+        offset += ra->pos;
+        whence = SEEK_SET | (whence & AVSEEK_FORCE);
+    }
+    if((whence & ~AVSEEK_FORCE) == SEEK_SET && offset >= ra->pos && offset - ra->pos <= (int64_t)ra->fill) {
+        Kit_SkipReadAhead(ra, (size_t)(offset - ra->pos));
+        ret = offset;
+        goto exit;
+    }
+    if((ret = ra->seek_cb(ra->userdata, offset, whence)) >= 0) {
+        ra->start = 0;
+        ra->fill = 0;
+        ra->pos = ret;
+        ra->status = 0;
+        SDL_SignalCondition(ra->can_fill);
+    }
+
+exit:
+    SDL_UnlockMutex(ra->mutex);
+    return ret;
+}
@@ -0,0 +1,288 @@
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavformat/avformat.h>
+
+#include "kitchensink3/internal/kitsourceindex.h"
+#include "kitchensink3/internal/utils/kitalloc.h"
+#include "kitchensink3/internal/utils/kitlog.h"
+#include "kitchensink3/kiterror.h"
+#include "kitchensink3/kitsource.h"
+
+#define INDEX_MAGIC "KITIDX02"
+#define INDEX_MAGIC_SIZE 8
+
+typedef struct Kit_SourceIndexEntry {
+    int64_t pos;       ///< Byte position of the keyframe packet
+    int64_t timestamp; ///< Keyframe dts (or pts, if there is no dts), in stream time base
+} Kit_SourceIndexEntry;
+
+struct Kit_SourceIndex {
+    SDL_Mutex *mutex;              ///< Guards entries, count and capacity
+    SDL_Thread *thread;            ///< Indexer thread, if started
+    SDL_AtomicInt run;             ///< Cleared to stop the indexer thread
+    SDL_AtomicInt complete;        ///< Set when the whole source has been indexed
+    Kit_Source *scan;              ///< Source read by the indexer thread
+    char *path;                    ///< Sidecar path, or NULL
+    int stream_index;              ///< Indexed video stream
+    AVRational time_base;          ///< Time base of the indexed stream
+    int64_t source_size;           ///< Source size in bytes, for checking sidecars
+    int64_t source_time;           ///< Source modification time (local files only, otherwise 0), for checking sidecars
+    Kit_SourceIndexEntry *entries; ///< Keyframes, in the order they were read
+    size_t count;                  ///< Entries in use
+    size_t capacity;               ///< Entries allocated
+    size_t applied;                ///< Entries already added to the demuxed format context
+};
+
+static bool Kit_AddSourceIndexEntry(Kit_SourceIndex *index, int64_t pos, int64_t timestamp) {
+    bool ok = true;
+    SDL_LockMutex(index->mutex);
+    if(index->count == index->capacity) {
+        const size_t capacity = index->capacity > 0 ? index->capacity * 2 : 256;
+        Kit_SourceIndexEntry *entries = realloc(index->entries, capacity * sizeof(Kit_SourceIndexEntry));
+        if(entries == NULL) {
+            ok = false;
+            goto exit;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    index->entries[index->count++] = (Kit_SourceIndexEntry){.pos = pos, .timestamp = timestamp};
+exit:
+    SDL_UnlockMutex(index->mutex);
+    return ok;
+}
+
+/**
+ * Sidecar layout, all little endian: magic, stream index (u32), time base (u32 num, u32 den), source size (s64),
+ * source modification time (s64), entry count (s64), then the entries as position and timestamp pairs (s64, s64).
+ */
+static bool Kit_LoadSourceIndex(Kit_SourceIndex *index) {
+    char magic[INDEX_MAGIC_SIZE];
+    Uint32 stream_index, tb_num, tb_den;
+    Sint64 source_size, source_time, count;
+    Kit_SourceIndexEntry *entries = NULL;
+    SDL_IOStream *io = SDL_IOFromFile(index->path, "rb");
+    if(io == NULL)
+        return false;
+    if(SDL_ReadIO(io, magic, INDEX_MAGIC_SIZE) != INDEX_MAGIC_SIZE || memcmp(magic, INDEX_MAGIC, INDEX_MAGIC_SIZE))
+        goto error;
+    if(!SDL_ReadU32LE(io, &stream_index) || !SDL_ReadU32LE(io, &tb_num) || !SDL_ReadU32LE(io, &tb_den) ||
+       !SDL_ReadS64LE(io, &source_size) || !SDL_ReadS64LE(io, &source_time) || !SDL_ReadS64LE(io, &count))
+        goto error;
+    if((int)stream_index != index->stream_index || (int)tb_num != index->time_base.num ||
+       (int)tb_den != index->time_base.den || source_size != index->source_size || source_time != index->source_time)
+        goto error;
+    // There can't be more keyframes than bytes; this also keeps a damaged count from allocating the world.
+    if(count <= 0 || count > source_size)
+        goto error;
+    if((entries = Kit_Calloc((size_t)count, sizeof(Kit_SourceIndexEntry))) == NULL)
+        goto error;
+    for(Sint64 i = 0; i < count; i++) {
+        if(!SDL_ReadS64LE(io, &entries[i].pos) || !SDL_ReadS64LE(io, &entries[i].timestamp))
+            goto error;
+    }
+    SDL_CloseIO(io);
+    index->entries = entries;
+    index->count = (size_t)count;
+    index->capacity = (size_t)count;
+    return true;
+
+error:
+    LOG("Ignoring index sidecar %s; it is not for this source, or is damaged\n", index->path);
+    free(entries);
+    SDL_CloseIO(io);
+    return false;
+}
+
+/**
+ * Writes the sidecar. Only called by the indexer thread once it is done, so the entries are no longer changing.
+ */
+static void Kit_SaveSourceIndex(const Kit_SourceIndex *index) {
+    bool ok = true;
+    SDL_IOStream *io = SDL_IOFromFile(index->path, "wb");
+    if(io == NULL) {
+        LOG("Unable to save index sidecar %s: %s\n", index->path, SDL_GetError());
+        return;
+    }
+    ok = ok && SDL_WriteIO(io, INDEX_MAGIC, INDEX_MAGIC_SIZE) == INDEX_MAGIC_SIZE;
+    ok = ok && SDL_WriteU32LE(io, (Uint32)index->stream_index);
+    ok = ok && SDL_WriteU32LE(io, (Uint32)index->time_base.num);
+    ok = ok && SDL_WriteU32LE(io, (Uint32)index->time_base.den);
+    ok = ok && SDL_WriteS64LE(io, index->source_size);
+    ok = ok && SDL_WriteS64LE(io, index->source_time);
+    ok = ok && SDL_WriteS64LE(io, (Sint64)index->count);
+    for(size_t i = 0; ok && i < index->count; i++) {
+        ok = SDL_WriteS64LE(io, index->entries[i].pos) && SDL_WriteS64LE(io, index->entries[i].timestamp);
+    }
+    if(!SDL_CloseIO(io) || !ok) {
+        LOG("Unable to save index sidecar %s: %s\n", index->path, SDL_GetError());
+        SDL_RemovePath(index->path);
+    }
+}
+
+static int Kit_IndexMain(void *ptr) {
+    Kit_SourceIndex *index = ptr;
+    AVFormatContext *format_ctx = index->scan->format_ctx;
+    AVPacket *packet = av_packet_alloc();
+    bool eof = false;
+    if(packet == NULL)
+        return 0;
+
+    // Only the indexed stream matters here; let the container skip the rest.
+    for(unsigned int i = 0; i < format_ctx->nb_streams; i++)
+        format_ctx->streams[i]->discard = (int)i == index->stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    while(SDL_GetAtomicInt(&index->run)) {
+        const int ret = av_read_frame(format_ctx, packet);
+        if(ret == AVERROR_EOF) {
+            eof = true;
+            break;
+        }
+        if(ret < 0)
+            break;
+        if(packet->stream_index == index->stream_index && (packet->flags & AV_PKT_FLAG_KEY) && packet->pos >= 0) {
+            const int64_t timestamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            if(timestamp != AV_NOPTS_VALUE && !Kit_AddSourceIndexEntry(index, packet->pos, timestamp)) {
+                av_packet_unref(packet);
+                break;
+            }
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    if(eof) {
+        if(index->path != NULL && index->count > 0)
+            Kit_SaveSourceIndex(index);
+        SDL_SetAtomicInt(&index->complete, 1);
+    }
+    return 0;
+}
+
+/**
+ * Gets the modification time of the source, if its url names a local file. A file rewritten in place often keeps
+ * its size, so sidecars are checked against this as well. Other sources get 0, and are checked by size only.
+ */
+static int64_t Kit_GetSourceTime(const AVFormatContext *format_ctx) {
+    SDL_PathInfo info;
+    if(format_ctx->url == NULL || !SDL_GetPathInfo(format_ctx->url, &info) || info.type != SDL_PATHTYPE_FILE)
+        return 0;
+    return (int64_t)info.modify_time;
+}
+
+Kit_SourceIndex *Kit_CreateSourceIndex(const AVFormatContext *format_ctx, const char *path) {
+    Kit_SourceIndex *index;
+    const int stream_index = av_find_best_stream((AVFormatContext *)format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    const int64_t source_size = format_ctx->pb != NULL ? avio_size(format_ctx->pb) : -1;
+    if(stream_index < 0) {
+        Kit_SetError("Source has no video stream to index");
+        goto exit_0;
+    }
+    if(source_size <= 0) {
+        Kit_SetError("Source size is not known, unable to index it");
+        goto exit_0;
+    }
+    if((index = Kit_Calloc(1, sizeof(Kit_SourceIndex))) == NULL) {
+        Kit_SetError("Unable to allocate source index");
+        goto exit_0;
+    }
+    if((index->mutex = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate source index mutex: %s", SDL_GetError());
+        goto exit_1;
+    }
+    if(path != NULL) {
+        const size_t path_size = strlen(path) + 1;
+        if((index->path = Kit_Malloc(path_size)) == NULL) {
+            Kit_SetError("Unable to allocate source index path");
+            goto exit_2;
+        }
+        memcpy(index->path, path, path_size);
+    }
+    index->stream_index = stream_index;
+    index->time_base = format_ctx->streams[stream_index]->time_base;
+    index->source_size = source_size;
+    index->source_time = Kit_GetSourceTime(format_ctx);
+    if(index->path != NULL && Kit_LoadSourceIndex(index))
+        SDL_SetAtomicInt(&index->complete, 1);
+    return index;
+
+exit_2:
+    SDL_DestroyMutex(index->mutex);
+exit_1:
+    free(index);
+exit_0:
+    return NULL;
+}
+
+bool Kit_StartSourceIndex(Kit_SourceIndex *index, Kit_Source *scan) {
+    assert(index != NULL);
+    assert(index->scan == NULL);
+    if(scan == NULL)
+        return false;
+    index->scan = scan;
+
+    // The scan must see the same stream layout as the source the index is for.
+    const AVFormatContext *format_ctx = scan->format_ctx;
+    if((unsigned int)index->stream_index >= format_ctx->nb_streams) {
+        Kit_SetError("Index scan source has different streams");
+        return false;
+    }
+    const AVStream *stream = format_ctx->streams[index->stream_index];
+    if(stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO || av_cmp_q(stream->time_base, index->time_base) != 0) {
+        Kit_SetError("Index scan source has different streams");
+        return false;
+    }
+
+    SDL_SetAtomicInt(&index->run, 1);
+    if((index->thread = SDL_CreateThread(Kit_IndexMain, "SDL_Kitchensink indexer thread", index)) == NULL) {
+        Kit_SetError("Unable to start indexer thread: %s", SDL_GetError());
+        SDL_SetAtomicInt(&index->run, 0);
+        return false;
+    }
+    return true;
+}
+
+void Kit_CloseSourceIndex(Kit_SourceIndex **ref) {
+    if(!ref || !*ref)
+        return;
+    Kit_SourceIndex *index = *ref;
+    if(index->thread != NULL) {
+        SDL_SetAtomicInt(&index->run, 0);
+        SDL_WaitThread(index->thread, NULL);
+    }
+    Kit_CloseSource(index->scan);
+    SDL_DestroyMutex(index->mutex);
+    free(index->entries);
+    free(index->path);
+    free(index);
+    *ref = NULL;
+}
+
+bool Kit_IsSourceIndexComplete(Kit_SourceIndex *index) {
+    return SDL_GetAtomicInt(&index->complete);
+}
+
+void Kit_ApplySourceIndex(Kit_SourceIndex *index, AVFormatContext *format_ctx) {
+    AVStream *stream = format_ctx->streams[index->stream_index];
+    SDL_LockMutex(index->mutex);
+    for(; index->applied < index->count; index->applied++) {
+        const Kit_SourceIndexEntry *entry = &index->entries[index->applied];
+        av_add_index_entry(stream, entry->pos, entry->timestamp, 0, 0, AVINDEX_KEYFRAME);
+    }
+    SDL_UnlockMutex(index->mutex);
+}
+
+void Kit_GetSourceIndexState(Kit_SourceIndex *index, Kit_SourceIndexStats *stats) {
+    SDL_LockMutex(index->mutex);
+    stats->entries = (unsigned int)index->count;
+    SDL_UnlockMutex(index->mutex);
+    stats->complete = SDL_GetAtomicInt(&index->complete);
+}
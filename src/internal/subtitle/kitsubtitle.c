@@ -150,6 +150,8 @@ Kit_Decoder *Kit_CreateSubtitleDecoder(
             stream,
             sync_timer,
             thread_count,
+            KIT_THREAD_TYPE_AUTO,
+            false,
             KIT_HWDEVICE_TYPE_ALL,
             dec_input_subtitle_cb,
             dec_decode_subtitle_cb,
@@ -157,6 +159,7 @@ Kit_Decoder *Kit_CreateSubtitleDecoder(
             dec_abort_subtitle_cb,
             dec_close_subtitle_cb,
             dec_get_subtitle_buffers_cb,
+            NULL,
             subtitle_decoder
         )) == NULL) {
         // No need to Kit_SetError, it will be set in Kit_CreateDecoder.
@@ -286,7 +286,8 @@ Kit_SubtitleRenderer *Kit_CreateImageSubtitleRenderer(
             (buf_obj_unref)Kit_DelSubtitlePacketRefs,
             (buf_obj_free)Kit_FreeSubtitlePacket,
             (buf_obj_move)Kit_MoveSubtitlePacketRefs,
-            NULL
+            NULL,
+            0
         )) == NULL) {
         Kit_SetError("Unable to create an output buffer for subtitle renderer");
         goto exit_2;
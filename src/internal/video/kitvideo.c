@@ -1,3 +1,5 @@
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_timer.h>
 #include <assert.h>
 
 #include <libavformat/avformat.h>
@@ -16,6 +18,9 @@
 #include "kitchensink3/kitformat.h"
 
 #define KIT_VIDEO_EARLY_FAIL 1.0
+#define KIT_VIDEO_ADAPT_INTERVAL 8    // Packets between decode quality adjustments
+#define KIT_VIDEO_NONKEY_INTERVALS 3  // Late intervals in a row needed before dropping to keyframes only
+#define KIT_VIDEO_RECOVER_TIME 1000   // Time without late frames before raising the decode quality a step, ms
 
 typedef struct Kit_VideoDecoder {
     struct SwsContext *sws;       ///< Video converter context, created lazily when conversion is needed
@@ -27,6 +32,14 @@ typedef struct Kit_VideoDecoder {
     AVFrame *current;             ///< video frame we are currently reading from
     int early_threshold;          ///< Early sync threshold, in milliseconds
     int late_threshold;           ///< Late sync threshold, in milliseconds
+    bool adaptive_skip;           ///< Lower the decode quality while frames are late
+    SDL_AtomicInt late_frames;    ///< Frames dropped as late since the last adjustment
+    SDL_AtomicInt on_time_frames; ///< Frames shown on time by the reader since the last adjustment
+    SDL_AtomicInt skip_level;     ///< Current Kit_VideoSkipLevel; only changed by the decoder thread
+    int adapt_packets;            ///< Packets fed since the last adjustment
+    int late_intervals;           ///< Adjustment intervals in a row with mostly late frames
+    Uint64 last_late;             ///< SDL_GetTicks() of the last adjustment that saw late frames
+    Uint64 last_change;           ///< SDL_GetTicks() of the last skip level change
 } Kit_VideoDecoder;
 
 static struct SwsContext *Kit_GetSwsContext(
@@ -51,10 +64,68 @@ int Kit_GetVideoDecoderOutputFormat(const Kit_Decoder *decoder, Kit_VideoOutputF
     return 0;
 }
 
+static void Kit_SetVideoSkipLevel(const Kit_Decoder *decoder, Kit_VideoSkipLevel level) {
+    Kit_VideoDecoder *video_decoder = decoder->userdata;
+    AVCodecContext *codec_ctx = decoder->codec_ctx;
+    codec_ctx->skip_loop_filter = level >= KIT_VIDEO_SKIP_LOOP_FILTER ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    if(level >= KIT_VIDEO_SKIP_NONKEY) {
+        codec_ctx->skip_frame = AVDISCARD_NONKEY;
+    } else if(level >= KIT_VIDEO_SKIP_NONREF) {
+        codec_ctx->skip_frame = AVDISCARD_NONREF;
+    } else {
+        codec_ctx->skip_frame = AVDISCARD_DEFAULT;
+    }
+    SDL_SetAtomicInt(&video_decoder->skip_level, level);
+}
+
+/**
+ * Called by the decoder thread for every packet the codec takes. Every KIT_VIDEO_ADAPT_INTERVAL packets, looks
+ * at what happened to the frames in the meanwhile. If half of them or more were dropped as late (by the decoder
+ * thread or by the reader), skips more decoding work; keyframe only decoding is drastic, so that step is only
+ * taken once this has gone on for KIT_VIDEO_NONKEY_INTERVALS intervals. Once no frame has been late for
+ * KIT_VIDEO_RECOVER_TIME, skips less. Recovery goes by time rather than by frames shown, because there may be
+ * few of those while frames are skipped. The codec reads the skip settings for each frame, so the changes take
+ * effect from the next packet on.
+ */
+static void Kit_AdaptVideoSkipLevel(const Kit_Decoder *decoder) {
+    Kit_VideoDecoder *video_decoder = decoder->userdata;
+    if(!video_decoder->adaptive_skip || ++video_decoder->adapt_packets < KIT_VIDEO_ADAPT_INTERVAL)
+        return;
+    video_decoder->adapt_packets = 0;
+    const int late = SDL_SetAtomicInt(&video_decoder->late_frames, 0);
+    const int on_time = SDL_SetAtomicInt(&video_decoder->on_time_frames, 0);
+    const Kit_VideoSkipLevel level = SDL_GetAtomicInt(&video_decoder->skip_level);
+    const Uint64 now = SDL_GetTicks();
+    if(late > 0)
+        video_decoder->last_late = now;
+    if(late > 0 && late >= on_time) {
+        const int needed = level + 1 == KIT_VIDEO_SKIP_NONKEY ? KIT_VIDEO_NONKEY_INTERVALS : 1;
+        if(level < KIT_VIDEO_SKIP_COUNT - 1 && ++video_decoder->late_intervals >= needed) {
+            video_decoder->late_intervals = 0;
+            video_decoder->last_change = now;
+            Kit_SetVideoSkipLevel(decoder, level + 1);
+        }
+        return;
+    }
+    video_decoder->late_intervals = 0;
+    if(level > KIT_VIDEO_SKIP_NONE && now - video_decoder->last_late >= KIT_VIDEO_RECOVER_TIME &&
+       now - video_decoder->last_change >= KIT_VIDEO_RECOVER_TIME) {
+        video_decoder->last_change = now;
+        Kit_SetVideoSkipLevel(decoder, level - 1);
+    }
+}
+
 static void dec_flush_video_cb(Kit_Decoder *decoder) {
     assert(decoder);
-    const Kit_VideoDecoder *video_decoder = decoder->userdata;
+    Kit_VideoDecoder *video_decoder = decoder->userdata;
     Kit_FlushPacketBuffer(video_decoder->buffer);
+
+    // Lateness before a seek says nothing about the frames after it; start over at full quality.
+    SDL_SetAtomicInt(&video_decoder->late_frames, 0);
+    SDL_SetAtomicInt(&video_decoder->on_time_frames, 0);
+    video_decoder->adapt_packets = 0;
+    video_decoder->late_intervals = 0;
+    Kit_SetVideoSkipLevel(decoder, KIT_VIDEO_SKIP_NONE);
 }
 
 static void dec_abort_video_cb(Kit_Decoder *decoder) {
@@ -95,6 +166,8 @@ static void dec_read_video(const Kit_Decoder *decoder) {
 static Kit_DecoderInputResult dec_input_video_cb(const Kit_Decoder *decoder, const AVPacket *in_packet) {
     assert(decoder);
     int ret = KIT_FAULT_WRAP_CODE("decode_send", avcodec_send_packet(decoder->codec_ctx, in_packet));
+    if(ret == 0 && in_packet != NULL)
+        Kit_AdaptVideoSkipLevel(decoder);
     switch(ret) {
         case AVERROR_EOF:
             return KIT_DEC_INPUT_EOF;
@@ -106,12 +179,36 @@ static Kit_DecoderInputResult dec_input_video_cb(const Kit_Decoder *decoder, con
     }
 }
 
+/**
+ * Tells whether a freshly decoded frame is already past the late threshold of the sync clock, ie. the reader would
+ * only drop it. Frames from before a seek are left for the reader to discard by serial, and nothing is judged
+ * while the clock is not running or not yet re-based for the latest seek (the first frame after a seek re-bases it).
+ */
+static bool Kit_IsVideoFrameLate(const Kit_Decoder *decoder, const AVFrame *frame, double pts) {
+    const Kit_VideoDecoder *video_decoder = decoder->userdata;
+    if(Kit_GetPacketSerial(frame->opaque) != Kit_GetTimerSerial(decoder->sync_timer))
+        return false;
+    if(!Kit_IsTimerInitialized(decoder->sync_timer) || !Kit_IsTimerSynced(decoder->sync_timer))
+        return false;
+    return pts < Kit_GetTimerElapsed(decoder->sync_timer) - video_decoder->late_threshold / 1000.0;
+}
+
 static bool dec_decode_video_cb(const Kit_Decoder *decoder, double *pts) {
     assert(decoder);
     Kit_VideoDecoder *video_decoder = decoder->userdata;
     int ret =
         KIT_FAULT_WRAP_CODE("decode_receive", avcodec_receive_frame(decoder->codec_ctx, video_decoder->tmp_frame));
     if(ret == 0) {
+        *pts = video_decoder->tmp_frame->best_effort_timestamp * av_q2d(decoder->stream->time_base);
+
+        // Drop frames that are already late here, before the GPU download, the format conversion and the buffer
+        // write; the reader would only throw them away. They still count as late for Kit_AdaptVideoSkipLevel().
+        if(Kit_IsVideoFrameLate(decoder, video_decoder->tmp_frame, *pts)) {
+            SDL_AddAtomicInt(&video_decoder->late_frames, 1);
+            av_frame_unref(video_decoder->tmp_frame);
+            return true;
+        }
+
         // Process the temporary frame, and then make sure result is in in_frame.
         // If the frame is hardware frame, we need to pull it from the hardware device first!
         if(video_decoder->tmp_frame->format == decoder->hw_fmt) {
@@ -125,7 +222,6 @@ static bool dec_decode_video_cb(const Kit_Decoder *decoder, double *pts) {
         }
 
         // Process input frame (if HW decoding is used, it has been pulled from the GPU).
-        *pts = video_decoder->in_frame->best_effort_timestamp * av_q2d(decoder->stream->time_base);
         dec_read_video(decoder);
         av_frame_unref(video_decoder->in_frame);
         return true;
@@ -143,6 +239,13 @@ static void dec_get_video_buffers_cb(const Kit_Decoder *ref, unsigned int *lengt
         *capacity = Kit_GetPacketBufferCapacity(video_decoder->buffer);
 }
 
+static Kit_PacketBuffer *dec_get_video_output_buffer_cb(const Kit_Decoder *ref) {
+    assert(ref);
+    assert(ref->userdata);
+    const Kit_VideoDecoder *video_decoder = ref->userdata;
+    return video_decoder->buffer;
+}
+
 static void dec_close_video_cb(Kit_Decoder *ref) {
     if(ref == NULL)
         return;
@@ -193,7 +296,9 @@ Kit_Decoder *Kit_CreateVideoDecoder(
     if((decoder = Kit_CreateDecoder(
             stream,
             sync_timer,
-            thread_count,
+            config->thread_count >= 0 ? config->thread_count : thread_count,
+            config->thread_type,
+            config->low_delay,
             format_request->hw_device_types,
             dec_input_video_cb,
             dec_decode_video_cb,
@@ -201,6 +306,7 @@ Kit_Decoder *Kit_CreateVideoDecoder(
             dec_abort_video_cb,
             dec_close_video_cb,
             dec_get_video_buffers_cb,
+            dec_get_video_output_buffer_cb,
             video_decoder
         )) == NULL) {
         // No need to Kit_SetError, it will be set in Kit_CreateDecoder.
@@ -228,7 +334,8 @@ Kit_Decoder *Kit_CreateVideoDecoder(
             (buf_obj_unref)av_frame_unref,
             (buf_obj_free)av_frame_free,
             (buf_obj_move)av_frame_move_ref,
-            (buf_obj_ref)av_frame_ref
+            (buf_obj_ref)av_frame_ref,
+            KIT_PACKET_BUFFER_SPSC
         )) == NULL) {
         Kit_SetError("Unable to create an output buffer for stream %d", stream_index);
         goto exit_6;
@@ -266,6 +373,7 @@ Kit_Decoder *Kit_CreateVideoDecoder(
     video_decoder->output = output;
     video_decoder->early_threshold = config->early_threshold;
     video_decoder->late_threshold = config->late_threshold;
+    video_decoder->adaptive_skip = config->adaptive_skip;
     return decoder;
 
 exit_7:
@@ -289,33 +397,32 @@ exit_0:
     return NULL;
 }
 
-static double Kit_GetCurrentPTS(const Kit_Decoder *decoder) {
-    Kit_VideoDecoder *video_decoder = decoder->userdata;
-    return video_decoder->current->best_effort_timestamp * av_q2d(decoder->stream->time_base);
+static double Kit_GetFramePTS(const Kit_Decoder *decoder, const Kit_DecodedFrameInfo *info) {
+    return info->pts * av_q2d(decoder->stream->time_base);
 }
 
 bool Kit_BeginReadFrame(const Kit_Decoder *decoder) {
     assert(decoder != NULL);
-    const Kit_VideoDecoder *video_decoder = decoder->userdata;
+    Kit_VideoDecoder *video_decoder = decoder->userdata;
+    Kit_DecodedFrameInfo info;
+    uint64_t ticket;
 
-    if(!Kit_BeginPacketBufferRead(video_decoder->buffer, video_decoder->current, 0))
+    // Frames are judged by their timing info only, and are left in the buffer until we know what to do with them.
+    // This way the buffer is never held locked while we are busy here, and the decoder thread can keep writing.
+    if(!Kit_PeekPacketBuffer(video_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
         return false;
 
     // Discard any frames that were decoded before the latest seek request.
-    while(Kit_GetPacketSerial(video_decoder->current->opaque) != Kit_GetTimerSerial(decoder->sync_timer)) {
-        // LOG("[VIDEO] DISCARD BY SERIAL: %d != %d\n", Kit_GetPacketSerial(video_decoder->current->opaque),
-        // Kit_GetTimerSerial(decoder->sync_timer));
-        av_frame_unref(video_decoder->current);
-        Kit_FinishPacketBufferRead(video_decoder->buffer);
-        if(!Kit_BeginPacketBufferRead(video_decoder->buffer, video_decoder->current, 0))
+    while(info.serial != Kit_GetTimerSerial(decoder->sync_timer)) {
+        // LOG("[VIDEO] DISCARD BY SERIAL: %d != %d\n", info.serial, Kit_GetTimerSerial(decoder->sync_timer));
+        Kit_TakePacketBuffer(video_decoder->buffer, NULL, ticket);
+        if(!Kit_PeekPacketBuffer(video_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
             return false;
     }
 
     // If the clock has not yet been re-based for the current seek, it still reflects the pre-seek position.
     // Hold on to the frame instead of judging it against a stale clock -- the primary stream will re-base soon.
     if(!Kit_IsTimerPrimary(decoder->sync_timer) && !Kit_IsTimerSynced(decoder->sync_timer)) {
-        av_frame_unref(video_decoder->current);
-        Kit_CancelPacketBufferRead(video_decoder->buffer);
         return false;
     }
 
@@ -323,12 +430,10 @@ bool Kit_BeginReadFrame(const Kit_Decoder *decoder) {
     Kit_InitTimerBase(decoder->sync_timer);
     if(!Kit_IsTimerInitialized(decoder->sync_timer)) {
         // If this was not the sync source and timer is not set, wait for another stream to set it.
-        av_frame_unref(video_decoder->current);
-        Kit_CancelPacketBufferRead(video_decoder->buffer);
         return false;
     }
 
-    double pts = Kit_GetCurrentPTS(decoder);
+    double pts = Kit_GetFramePTS(decoder, &info);
     double sync_ts = Kit_GetTimerElapsed(decoder->sync_timer);
     const double early_threshold = video_decoder->early_threshold / 1000.0;
     const double late_threshold = video_decoder->late_threshold / 1000.0;
@@ -344,38 +449,45 @@ bool Kit_BeginReadFrame(const Kit_Decoder *decoder) {
     } else {
         while(pts > sync_ts + KIT_VIDEO_EARLY_FAIL) {
             // LOG("[VIDEO] FAIL-EARLY pts = %lf > %lf + %lf\n", pts, sync_ts, KIT_VIDEO_EARLY_FAIL);
-            av_frame_unref(video_decoder->current);
-            Kit_FinishPacketBufferRead(video_decoder->buffer);
-            if(!Kit_BeginPacketBufferRead(video_decoder->buffer, video_decoder->current, 0))
+            Kit_TakePacketBuffer(video_decoder->buffer, NULL, ticket);
+            if(!Kit_PeekPacketBuffer(video_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
                 return false;
-            pts = Kit_GetCurrentPTS(decoder);
+            pts = Kit_GetFramePTS(decoder, &info);
         }
     }
 
     // Packet is too early, wait.
     if(pts > sync_ts + early_threshold) {
         // LOG("[VIDEO] EARLY pts = %lf > %lf + %lf\n", pts, sync_ts, early_threshold);
-        av_frame_unref(video_decoder->current);
-        Kit_CancelPacketBufferRead(video_decoder->buffer);
         return false;
     }
 
-    // Packet is too late, skip packets until we see something reasonable.
+    // Packet is too late, skip packets until we see something reasonable. The decoder thread is told about the
+    // dropped frames, so that it can skip decoding work until it is back on time (see Kit_AdaptVideoSkipLevel()).
+    bool dropped = false;
     while(pts < sync_ts - late_threshold) {
         // LOG("[VIDEO] LATE: pts = %lf < %lf + %lf\n", pts, sync_ts, late_threshold);
-        av_frame_unref(video_decoder->current);
-        Kit_FinishPacketBufferRead(video_decoder->buffer);
-        if(!Kit_BeginPacketBufferRead(video_decoder->buffer, video_decoder->current, 0))
+        Kit_TakePacketBuffer(video_decoder->buffer, NULL, ticket);
+        SDL_AddAtomicInt(&video_decoder->late_frames, 1);
+        dropped = true;
+        if(!Kit_PeekPacketBuffer(video_decoder->buffer, Kit_PeekDecodedFrame, &info, &ticket, 0))
             return false;
-        pts = Kit_GetCurrentPTS(decoder);
+        pts = Kit_GetFramePTS(decoder, &info);
     }
+    if(!dropped)
+        SDL_AddAtomicInt(&video_decoder->on_time_frames, 1);
 
     // LOG("[VIDEO] >>> SYNC!: pts = %lf, sync = %lf\n", pts, sync_ts);
 
-    // The frame is in video_decoder->current, so we can drop it from buffer
-    // and release the buffer lock.
-    Kit_FinishPacketBufferRead(video_decoder->buffer);
-    return true;
+    // Move the frame to video_decoder->current. This only fails if a seek flushed the buffer after we peeked;
+    // in that case the frame is stale anyway, and the next call will pick up from the new position.
+    return Kit_TakePacketBuffer(video_decoder->buffer, video_decoder->current, ticket);
+}
+
+Kit_VideoSkipLevel Kit_GetVideoDecoderSkipLevel(const Kit_Decoder *decoder) {
+    assert(decoder != NULL);
+    Kit_VideoDecoder *video_decoder = decoder->userdata;
+    return SDL_GetAtomicInt(&video_decoder->skip_level);
 }
 
 void Kit_EndReadFrame(Kit_Decoder *decoder) {
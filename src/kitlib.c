@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 #ifdef USE_DYNAMIC_LIBASS
 #include <SDL3/SDL_loadso.h>
 #endif
@@ -48,13 +49,32 @@ void Kit_CloseASS(Kit_LibraryState *state) {
 #endif
 }
 
+void Kit_ResetLibraryOptions(Kit_LibraryOptions *options) {
+    assert(options != NULL);
+    memset(options, 0, sizeof(Kit_LibraryOptions));
+    options->decoder_threads = 0;
+}
+
 int Kit_Init(unsigned int flags) {
+    return Kit_InitWithOptions(flags, NULL);
+}
+
+int Kit_InitWithOptions(unsigned int flags, const Kit_LibraryOptions *options) {
     Kit_LibraryState *state = Kit_GetLibraryState();
+    Kit_LibraryOptions defaults;
+    if(options == NULL) {
+        Kit_ResetLibraryOptions(&defaults);
+        options = &defaults;
+    }
 
     if(state->init_flags != 0) {
         Kit_SetError("SDL_kitchensink is already initialized");
         goto exit_0;
     }
+    if(options->decoder_threads < 0) {
+        Kit_SetError("Decoder thread limit must not be negative");
+        goto exit_0;
+    }
     if(flags & KIT_INIT_NETWORK) {
         avformat_network_init();
     }
@@ -69,6 +89,7 @@ int Kit_Init(unsigned int flags) {
     av_log_set_level(AV_LOG_QUIET);
 
     state->init_flags = flags;
+    state->decoder_thread_limit = options->decoder_threads;
     return 0;
 
 exit_1:
@@ -88,6 +109,7 @@ void Kit_Quit(void) {
         Kit_CloseASS(state);
     }
     state->init_flags = 0;
+    state->decoder_thread_limit = 0;
 }
 
 void Kit_GetVersion(Kit_Version *version) {
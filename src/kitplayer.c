@@ -1,11 +1,12 @@
 #include <SDL3/SDL_atomic.h>
-#include <SDL3/SDL_timer.h>
 #include <assert.h>
 
 #include "kitchensink3/internal/audio/kitaudio.h"
+#include "kitchensink3/internal/kitbufferevent.h"
 #include "kitchensink3/internal/kitdecoderthread.h"
 #include "kitchensink3/internal/kitdemuxerthread.h"
 #include "kitchensink3/internal/kitfaultinject.h"
+#include "kitchensink3/internal/kitpackettag.h"
 #include "kitchensink3/internal/kittimer.h"
 #include "kitchensink3/internal/subtitle/kitsubtitle.h"
 #include "kitchensink3/internal/utils/kitalloc.h"
@@ -14,27 +15,55 @@
 #include "kitchensink3/kiterror.h"
 #include "kitchensink3/kitplayer.h"
 
+// Kit_SetPlayerConfigLowLatency() values
+#define LOW_LATENCY_SPIN_TIME 100     // microseconds
+#define LOW_LATENCY_VIDEO_PACKETS 4   // keeps the decoder fed without letting a backlog build up
+#define LOW_LATENCY_AUDIO_BUFFER 24   // packets and frames; smaller can stall the demuxer after seeks
+#define LOW_LATENCY_EARLY_THRESHOLD 2 // milliseconds
+#define LOW_LATENCY_LATE_THRESHOLD 20 // milliseconds
+
 /**
  * Locking rules:
  * - Control lock serializes lifecycle operations (play/stop/pause/seek, stream switch, state check).
  * - Decoder control locks guard the decoder-threads against concurrent stream switching
  * - Lock order is main control lock first, then a decoder control lock. Slot critical sections must stay short.
+ * - Buffer callback lock is only held around the user's buffer callback, and nothing is locked under it.
  */
+
+/**
+ * Identifies a buffer to the watermark callback; passed as the callback userdata of each buffer.
+ */
+typedef struct Kit_WatermarkTarget {
+    Kit_Player *player;  ///< Player owning the buffer
+    Kit_StreamType type; ///< Stream type of the buffer
+    Kit_BufferSide side; ///< Input or output buffer
+} Kit_WatermarkTarget;
+
 struct Kit_Player {
-    SDL_AtomicInt state;               ///< Playback state
-    Kit_Decoder *decoders[3];          ///< Decoder contexts
-    Kit_Demuxer *demuxer;              ///< Demuxer context
-    Kit_DecoderThread *dec_threads[3]; ///< Decoder threads
-    Kit_DemuxerThread *demux_thread;   ///< Demuxer thread
-    Kit_Timer *sync_timer;             ///< Sync timer for the decoders
-    Kit_PlayerConfig config;           ///< Clamped copy of the creation-time configuration
-    Kit_VideoFormatRequest video_req;  ///< Original video format request
-    Kit_AudioFormatRequest audio_req;  ///< Original audio format request
-    const Kit_Source *src;             ///< Reference to Audio/Video source
-    int screen_w;                      ///< Width of the screen surface (for positioning subtitles)
-    int screen_h;                      ///< Height of the screen surface (for positioning subtitles)
-    SDL_Mutex *control_lock;           ///< Serializes lifecycle operations
-    SDL_Mutex *decoder_ctrl_locks[3];  ///< Guard decoders against concurrent getters
+    SDL_AtomicInt state;                         ///< Playback state
+    Kit_Decoder *decoders[3];                    ///< Decoder contexts
+    Kit_Demuxer *demuxer;                        ///< Demuxer context
+    Kit_DecoderThread *dec_threads[3];           ///< Decoder threads
+    Kit_DemuxerThread *demux_thread;             ///< Demuxer thread
+    Kit_Timer *sync_timer;                       ///< Sync timer for the decoders
+    Kit_PlayerConfig config;                     ///< Clamped copy of the creation-time configuration
+    Kit_VideoFormatRequest video_req;            ///< Original video format request
+    Kit_AudioFormatRequest audio_req;            ///< Original audio format request
+    const Kit_Source *src;                       ///< Reference to Audio/Video source
+    int screen_w;                                ///< Width of the screen surface (for positioning subtitles)
+    int screen_h;                                ///< Height of the screen surface (for positioning subtitles)
+    SDL_Mutex *control_lock;                     ///< Serializes lifecycle operations
+    SDL_Mutex *decoder_ctrl_locks[3];            ///< Guard decoders against concurrent getters
+    Kit_BufferEvent *buffer_event;               ///< Signaled as buffers fill up to the waited level
+    SDL_AtomicInt fill_waiters;                  ///< Threads in Kit_WaitBufferFillRate()
+    SDL_Mutex *buffer_cb_lock;                   ///< Serializes buffer callbacks against Kit_SetPlayerBufferCallback()
+    Kit_PlayerBufferCallback buffer_cb;          ///< Buffer watermark callback; protected by buffer_cb_lock
+    void *buffer_cb_userdata;                    ///< Userdata for buffer_cb; protected by buffer_cb_lock
+    Kit_PlayerBufferWatermarks watermarks[3];    ///< Watermarks per stream, also applied to new decoders
+    Kit_WatermarkTarget watermark_targets[3][2]; ///< Callback userdata for each input and output buffer
+    Kit_Demuxer *ext_demuxers[3];                ///< Demuxers of external sources; set under decoder ctrl locks
+    Kit_DemuxerThread *ext_demux_threads[3];     ///< Demuxer threads of external sources
+    bool shared;                                 ///< Demuxer is a tap on the demuxer of another player
 };
 
 static Kit_PlayerState Kit_GetState(const Kit_Player *player) {
@@ -53,10 +82,67 @@ static void Kit_UnlockDecoderCtrl(const Kit_Player *player, int index) {
     SDL_UnlockMutex(player->decoder_ctrl_locks[index]);
 }
 
+static void Kit_OnBufferWatermark(void *userdata, bool high) {
+    const Kit_WatermarkTarget *target = userdata;
+    Kit_Player *player = target->player;
+    const Kit_BufferLevel level = high ? KIT_BUFFER_HIGH : KIT_BUFFER_LOW;
+    SDL_LockMutex(player->buffer_cb_lock);
+    if(player->buffer_cb != NULL)
+        player->buffer_cb(player, target->type, target->side, level, player->buffer_cb_userdata);
+    SDL_UnlockMutex(player->buffer_cb_lock);
+}
+
+/**
+ * Hooks the buffer event up to a buffer of the stream, if Kit_WaitBufferFillRate() looks at the stream. Must be
+ * called before the buffer is used by the pipeline threads.
+ */
+static void Kit_AttachBufferEvent(Kit_Player *player, Kit_BufferIndex index, Kit_PacketBuffer *buffer) {
+    if(index != KIT_SUBTITLE_INDEX)
+        Kit_SetPacketBufferWakeEvent(buffer, player->buffer_event);
+}
+
+/**
+ * Hooks the watermark callback and the buffer event up to the output buffer of a new decoder, and applies the
+ * current watermarks and spin time of the stream to it. Must be called before the decoder thread is started.
+ */
+static void Kit_AttachDecoderOutput(Kit_Player *player, Kit_BufferIndex index, Kit_Decoder *decoder) {
+    Kit_PacketBuffer *buffer = Kit_GetDecoderOutputBuffer(decoder);
+    if(buffer == NULL)
+        return;
+    const Kit_PlayerBufferWatermarks *marks = &player->watermarks[index];
+    Kit_SetPacketBufferWatermarkCallback(buffer, Kit_OnBufferWatermark, &player->watermark_targets[index][1]);
+    Kit_AttachBufferEvent(player, index, buffer);
+    Kit_SetPacketBufferWatermarks(buffer, marks->output_low, marks->output_high);
+    Kit_SetPacketBufferSpin(buffer, player->config.buffer_spin_time);
+}
+
+/**
+ * Gets the demuxer that feeds a stream: the demuxer of its external source if it has one, or the main demuxer.
+ * Caller must hold the control lock or the decoder control lock of the stream.
+ */
+static Kit_Demuxer *Kit_GetStreamDemuxer(const Kit_Player *player, int index) {
+    return player->ext_demuxers[index] != NULL ? player->ext_demuxers[index] : player->demuxer;
+}
+
+/**
+ * Applies a spin time to the input and output buffers of all streams. Caller must hold the control lock.
+ */
+static void Kit_SetStreamBufferSpin(Kit_Player *player, int spin_time) {
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_PacketBuffer *input = Kit_GetDemuxerPacketBuffer(Kit_GetStreamDemuxer(player, i), i);
+        Kit_PacketBuffer *output = Kit_GetDecoderOutputBuffer(player->decoders[i]);
+        if(input != NULL)
+            Kit_SetPacketBufferSpin(input, spin_time);
+        if(output != NULL)
+            Kit_SetPacketBufferSpin(output, spin_time);
+    }
+}
+
 static bool Kit_InitializeAudioDecoder(
     const Kit_Source *src,
     const Kit_Timer *main_timer,
-    const Kit_DemuxerThread *demux_thread,
+    const Kit_Demuxer *demuxer,
+    Kit_BufferEvent *event,
     const Kit_AudioFormatRequest *format_request,
     const Kit_PlayerAudioConfig *config,
     int thread_count,
@@ -68,13 +154,13 @@ static bool Kit_InitializeAudioDecoder(
     Kit_Timer *timer;
     Kit_PacketBuffer *packet_buffer;
 
-    if((packet_buffer = Kit_GetDemuxerThreadPacketBuffer(demux_thread, KIT_AUDIO_INDEX)) == NULL)
+    if((packet_buffer = Kit_GetDemuxerPacketBuffer(demuxer, KIT_AUDIO_INDEX)) == NULL)
         goto exit_0;
     if((timer = Kit_CreateSecondaryTimer(main_timer, is_primary)) == NULL)
         goto exit_0;
     if((*decoder = Kit_CreateAudioDecoder(src, format_request, config, thread_count, timer, stream_index)) == NULL)
         goto exit_0;
-    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder)) == NULL)
+    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder, event)) == NULL)
         goto exit_1;
 
     return true;
@@ -88,7 +174,8 @@ exit_0:
 static bool Kit_InitializeVideoDecoder(
     const Kit_Source *src,
     const Kit_Timer *main_timer,
-    const Kit_DemuxerThread *demux_thread,
+    const Kit_Demuxer *demuxer,
+    Kit_BufferEvent *event,
     const Kit_VideoFormatRequest *format_request,
     const Kit_PlayerVideoConfig *config,
     int thread_count,
@@ -100,13 +187,13 @@ static bool Kit_InitializeVideoDecoder(
     Kit_Timer *timer;
     Kit_PacketBuffer *packet_buffer;
 
-    if((packet_buffer = Kit_GetDemuxerThreadPacketBuffer(demux_thread, KIT_VIDEO_INDEX)) == NULL)
+    if((packet_buffer = Kit_GetDemuxerPacketBuffer(demuxer, KIT_VIDEO_INDEX)) == NULL)
         goto exit_0;
     if((timer = Kit_CreateSecondaryTimer(main_timer, is_primary)) == NULL)
         goto exit_0;
     if((*decoder = Kit_CreateVideoDecoder(src, format_request, config, thread_count, timer, stream_index)) == NULL)
         goto exit_0;
-    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder)) == NULL)
+    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder, event)) == NULL)
         goto exit_1;
 
     return true;
@@ -120,7 +207,8 @@ exit_0:
 static bool Kit_InitializeSubtitleDecoder(
     const Kit_Source *src,
     const Kit_Timer *main_timer,
-    const Kit_DemuxerThread *demux_thread,
+    const Kit_Demuxer *demuxer,
+    Kit_BufferEvent *event,
     const Kit_Decoder *video_decoder,
     const Kit_PlayerSubtitleConfig *config,
     int thread_count,
@@ -135,7 +223,7 @@ static bool Kit_InitializeSubtitleDecoder(
     Kit_VideoOutputFormat output;
 
     Kit_GetVideoDecoderOutputFormat(video_decoder, &output);
-    if((packet_buffer = Kit_GetDemuxerThreadPacketBuffer(demux_thread, KIT_SUBTITLE_INDEX)) == NULL)
+    if((packet_buffer = Kit_GetDemuxerPacketBuffer(demuxer, KIT_SUBTITLE_INDEX)) == NULL)
         goto exit_0;
     if((timer = Kit_CreateSecondaryTimer(main_timer, false)) == NULL)
         goto exit_0;
@@ -143,7 +231,7 @@ static bool Kit_InitializeSubtitleDecoder(
             src, config, thread_count, timer, stream_index, output.width, output.height, screen_w, screen_h
         )) == NULL)
         goto exit_0;
-    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder)) == NULL)
+    if((*thread = Kit_CreateDecoderThread(packet_buffer, *decoder, event)) == NULL)
         goto exit_1;
 
     return true;
@@ -157,40 +245,85 @@ exit_0:
 void Kit_ResetPlayerConfig(Kit_PlayerConfig *config) {
     assert(config != NULL);
     config->thread_count = 0;
+    config->buffer_spin_time = 0;
     config->video.packet_buffer_size = 64;
+    config->video.packet_buffer_bytes = 0;
     config->video.frame_buffer_size = 3;
     config->video.early_threshold = 5;
     config->video.late_threshold = 50;
+    config->video.thread_count = -1;
+    config->video.thread_type = KIT_THREAD_TYPE_AUTO;
+    config->video.low_delay = 0;
+    config->video.adaptive_skip = 0;
     config->audio.packet_buffer_size = 64;
+    config->audio.packet_buffer_bytes = 0;
     config->audio.frame_buffer_size = 64;
     config->audio.early_threshold = 30;
     config->audio.late_threshold = 50;
+    config->audio.thread_count = -1;
+    config->audio.thread_type = KIT_THREAD_TYPE_AUTO;
     config->subtitle.packet_buffer_size = 64;
+    config->subtitle.packet_buffer_bytes = 0;
     config->subtitle.frame_buffer_size = 64;
     config->subtitle.font_hinting = KIT_FONT_HINTING_NONE;
     config->demuxer.read_attempts = 3;
     config->demuxer.read_retry_delay = 10;
+    config->demuxer.packet_batch_size = 1;
+    config->demuxer.overflow_size = 32;
+}
+
+void Kit_SetPlayerConfigLowLatency(Kit_PlayerConfig *config) {
+    assert(config != NULL);
+    config->buffer_spin_time = LOW_LATENCY_SPIN_TIME;
+    config->video.packet_buffer_size = LOW_LATENCY_VIDEO_PACKETS;
+    config->video.frame_buffer_size = 1;
+    config->video.early_threshold = LOW_LATENCY_EARLY_THRESHOLD;
+    config->video.late_threshold = LOW_LATENCY_LATE_THRESHOLD;
+    config->video.thread_type = KIT_THREAD_TYPE_SLICE;
+    config->video.low_delay = 1;
+    config->audio.packet_buffer_size = Kit_min(config->audio.packet_buffer_size, LOW_LATENCY_AUDIO_BUFFER);
+    config->audio.frame_buffer_size = Kit_min(config->audio.frame_buffer_size, LOW_LATENCY_AUDIO_BUFFER);
+    config->audio.early_threshold = LOW_LATENCY_EARLY_THRESHOLD;
+    config->audio.late_threshold = LOW_LATENCY_LATE_THRESHOLD;
+    config->demuxer.packet_batch_size = 1;
 }
 
 static void Kit_ClampPlayerConfig(Kit_PlayerConfig *config) {
     config->thread_count = Kit_max(config->thread_count, 0);
+    config->buffer_spin_time = Kit_clamp(config->buffer_spin_time, 0, KIT_PACKET_BUFFER_MAX_SPIN);
     config->video.packet_buffer_size = Kit_max(config->video.packet_buffer_size, 1);
+    config->video.packet_buffer_bytes = Kit_max(config->video.packet_buffer_bytes, 0);
     config->video.frame_buffer_size = Kit_max(config->video.frame_buffer_size, 1);
     config->video.early_threshold = Kit_max(config->video.early_threshold, 0);
     config->video.late_threshold = Kit_max(config->video.late_threshold, 0);
+    config->video.thread_count = Kit_max(config->video.thread_count, -1);
+    config->video.thread_type = Kit_clamp(config->video.thread_type, 0, KIT_THREAD_TYPE_COUNT - 1);
+    config->video.low_delay = config->video.low_delay ? 1 : 0;
+    config->video.adaptive_skip = config->video.adaptive_skip ? 1 : 0;
     config->audio.packet_buffer_size = Kit_max(config->audio.packet_buffer_size, 1);
+    config->audio.packet_buffer_bytes = Kit_max(config->audio.packet_buffer_bytes, 0);
     config->audio.frame_buffer_size = Kit_max(config->audio.frame_buffer_size, 1);
     config->audio.early_threshold = Kit_max(config->audio.early_threshold, 0);
     config->audio.late_threshold = Kit_max(config->audio.late_threshold, 0);
+    config->audio.thread_count = Kit_max(config->audio.thread_count, -1);
+    config->audio.thread_type = Kit_clamp(config->audio.thread_type, 0, KIT_THREAD_TYPE_COUNT - 1);
     config->subtitle.packet_buffer_size = Kit_max(config->subtitle.packet_buffer_size, 1);
+    config->subtitle.packet_buffer_bytes = Kit_max(config->subtitle.packet_buffer_bytes, 0);
     config->subtitle.frame_buffer_size = Kit_max(config->subtitle.frame_buffer_size, 1);
     config->subtitle.font_hinting = Kit_clamp(config->subtitle.font_hinting, 0, KIT_FONT_HINTING_COUNT - 1);
     config->demuxer.read_attempts = Kit_max(config->demuxer.read_attempts, 1);
     config->demuxer.read_retry_delay = Kit_max(config->demuxer.read_retry_delay, 0);
+    config->demuxer.packet_batch_size = Kit_clamp(config->demuxer.packet_batch_size, 1, KIT_DEMUXER_MAX_BATCH);
+    config->demuxer.overflow_size = Kit_clamp(config->demuxer.overflow_size, 0, KIT_DEMUXER_MAX_OVERFLOW);
 }
 
-Kit_Player *Kit_CreatePlayer(
+/**
+ * Creates a player. If lead_demuxer is set, the player gets a tap on it instead of a demuxer and a demuxer thread
+ * of its own.
+ */
+static Kit_Player *Kit_NewPlayer(
     const Kit_Source *src,
+    Kit_Demuxer *lead_demuxer,
     const int video_stream_index,
     const int audio_stream_index,
     const int subtitle_stream_index,
@@ -216,6 +349,7 @@ Kit_Player *Kit_CreatePlayer(
     Kit_DecoderThread *audio_thread = NULL;
     Kit_DecoderThread *subtitle_thread = NULL;
     Kit_DemuxerThread *demux_thread = NULL;
+    Kit_BufferEvent *event = NULL;
     Kit_Timer *timer = NULL;
     const bool video_primary = video_stream_index > -1;
     const bool audio_primary = !video_primary && audio_stream_index > -1;
@@ -254,19 +388,32 @@ Kit_Player *Kit_CreatePlayer(
             goto exit_1;
         }
     }
+    if((player->buffer_cb_lock = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate player buffer callback lock: %s", SDL_GetError());
+        goto exit_1;
+    }
+    if((event = Kit_CreateBufferEvent()) == NULL)
+        goto exit_1;
     if((timer = Kit_CreateTimer()) == NULL)
         goto exit_1;
-    if((demuxer =
-            Kit_CreateDemuxer(src, video_stream_index, audio_stream_index, subtitle_stream_index, &config, timer)) ==
-       NULL)
+    if(lead_demuxer != NULL) {
+        demuxer = Kit_CreateDemuxerTap(
+            lead_demuxer, video_stream_index, audio_stream_index, subtitle_stream_index, &config, timer
+        );
+    } else {
+        demuxer =
+            Kit_CreateDemuxer(src, video_stream_index, audio_stream_index, subtitle_stream_index, &config, timer);
+    }
+    if(demuxer == NULL)
         goto exit_2;
-    if((demux_thread = Kit_CreateDemuxerThread(demuxer)) == NULL)
+    if(lead_demuxer == NULL && (demux_thread = Kit_CreateDemuxerThread(demuxer, event)) == NULL)
         goto exit_3;
     if(audio_stream_index > -1) {
         if(!Kit_InitializeAudioDecoder(
                src,
                timer,
-               demux_thread,
+               demuxer,
+               event,
                &audio_req,
                &config.audio,
                config.thread_count,
@@ -282,7 +429,8 @@ Kit_Player *Kit_CreatePlayer(
         if(!Kit_InitializeVideoDecoder(
                src,
                timer,
-               demux_thread,
+               demuxer,
+               event,
                &video_req,
                &config.video,
                config.thread_count,
@@ -298,7 +446,8 @@ Kit_Player *Kit_CreatePlayer(
         if(!Kit_InitializeSubtitleDecoder(
                src,
                timer,
-               demux_thread,
+               demuxer,
+               event,
                video_decoder,
                &config.subtitle,
                config.thread_count,
@@ -320,6 +469,9 @@ Kit_Player *Kit_CreatePlayer(
     player->dec_threads[KIT_SUBTITLE_INDEX] = subtitle_thread;
     player->demuxer = demuxer;
     player->demux_thread = demux_thread;
+    player->shared = lead_demuxer != NULL;
+    player->buffer_event = event;
+    SDL_SetAtomicInt(&player->fill_waiters, 0);
     player->src = src;
     player->sync_timer = timer;
     player->config = config;
@@ -327,6 +479,26 @@ Kit_Player *Kit_CreatePlayer(
     player->audio_req = audio_req;
     player->screen_w = screen_w;
     player->screen_h = screen_h;
+
+    // Watermarks are off until the application sets them, but the callbacks are hooked up before any of the
+    // threads run, so that they never see a half-configured buffer.
+    const Kit_StreamType types[KIT_INDEX_COUNT] = {
+        [KIT_VIDEO_INDEX] = KIT_STREAMTYPE_VIDEO,
+        [KIT_AUDIO_INDEX] = KIT_STREAMTYPE_AUDIO,
+        [KIT_SUBTITLE_INDEX] = KIT_STREAMTYPE_SUBTITLE,
+    };
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        player->watermarks[i] = (Kit_PlayerBufferWatermarks){-1, -1, -1, -1};
+        player->watermark_targets[i][0] = (Kit_WatermarkTarget){player, types[i], KIT_BUFFER_INPUT};
+        player->watermark_targets[i][1] = (Kit_WatermarkTarget){player, types[i], KIT_BUFFER_OUTPUT};
+        Kit_PacketBuffer *input = Kit_GetDemuxerPacketBuffer(demuxer, i);
+        if(input != NULL) {
+            Kit_SetPacketBufferWatermarkCallback(input, Kit_OnBufferWatermark, &player->watermark_targets[i][0]);
+            Kit_AttachBufferEvent(player, i, input);
+            Kit_SetPacketBufferSpin(input, config.buffer_spin_time);
+        }
+        Kit_AttachDecoderOutput(player, i, player->decoders[i]);
+    }
     return player;
 
 exit_6:
@@ -342,6 +514,8 @@ exit_3:
 exit_2:
     Kit_CloseTimer(&timer);
 exit_1:
+    Kit_CloseBufferEvent(&event);
+    SDL_DestroyMutex(player->buffer_cb_lock);
     SDL_DestroyMutex(player->control_lock);
     for(int i = 0; i < KIT_INDEX_COUNT; i++)
         SDL_DestroyMutex(player->decoder_ctrl_locks[i]);
@@ -350,6 +524,62 @@ exit_0:
     return NULL;
 }
 
+Kit_Player *Kit_CreatePlayer(
+    const Kit_Source *src,
+    const int video_stream_index,
+    const int audio_stream_index,
+    const int subtitle_stream_index,
+    const Kit_VideoFormatRequest *video_format_request,
+    const Kit_AudioFormatRequest *audio_format_request,
+    const int screen_w,
+    const int screen_h,
+    const Kit_PlayerConfig *input_config
+) {
+    assert(src != NULL);
+    return Kit_NewPlayer(
+        src,
+        NULL,
+        video_stream_index,
+        audio_stream_index,
+        subtitle_stream_index,
+        video_format_request,
+        audio_format_request,
+        screen_w,
+        screen_h,
+        input_config
+    );
+}
+
+Kit_Player *Kit_CreateSharedPlayer(
+    Kit_Player *lead,
+    const int video_stream_index,
+    const int audio_stream_index,
+    const int subtitle_stream_index,
+    const Kit_VideoFormatRequest *video_format_request,
+    const Kit_AudioFormatRequest *audio_format_request,
+    const int screen_w,
+    const int screen_h,
+    const Kit_PlayerConfig *input_config
+) {
+    assert(lead != NULL);
+    if(lead->shared) {
+        Kit_SetError("Player already shares the demuxer of another player");
+        return NULL;
+    }
+    return Kit_NewPlayer(
+        lead->src,
+        lead->demuxer,
+        video_stream_index,
+        audio_stream_index,
+        subtitle_stream_index,
+        video_format_request,
+        audio_format_request,
+        screen_w,
+        screen_h,
+        input_config
+    );
+}
+
 static bool Kit_IsDecoderThreadRunning(const Kit_Player *player, int index) {
     Kit_LockDecoderCtrl(player, index);
     Kit_DecoderThread *thread = player->dec_threads[index];
@@ -414,15 +644,21 @@ static void Kit_StartThreadFor(const Kit_Player *player, Kit_BufferIndex index)
 }
 
 static void Kit_StartThreads(const Kit_Player *player) {
+    Kit_SetDemuxerTapOpen(player->demuxer, true);
     Kit_StartDemuxerThread(player->demux_thread);
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_StartDemuxerThread(player->ext_demux_threads[i]);
+    }
     Kit_StartThreadFor(player, KIT_VIDEO_INDEX);
     Kit_StartThreadFor(player, KIT_AUDIO_INDEX);
     Kit_StartThreadFor(player, KIT_SUBTITLE_INDEX);
 }
 
 static void Kit_StopThreads(const Kit_Player *player) {
+    Kit_SetDemuxerTapOpen(player->demuxer, false);
     Kit_StopDemuxerThread(player->demux_thread);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_StopDemuxerThread(player->ext_demux_threads[i]);
         Kit_StopDecoderThread(player->dec_threads[i]);
     }
 }
@@ -430,6 +666,7 @@ static void Kit_StopThreads(const Kit_Player *player) {
 static void Kit_WaitThreads(const Kit_Player *player) {
     Kit_WaitDemuxerThread(player->demux_thread);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_WaitDemuxerThread(player->ext_demux_threads[i]);
         Kit_WaitDecoderThread(player->dec_threads[i]);
     }
 }
@@ -437,6 +674,7 @@ static void Kit_WaitThreads(const Kit_Player *player) {
 static void Kit_AbortAllBuffers(const Kit_Player *player) {
     Kit_AbortDemuxer(player->demuxer);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_AbortDemuxer(player->ext_demuxers[i]);
         Kit_AbortDecoder(player->decoders[i]);
     }
 }
@@ -444,6 +682,7 @@ static void Kit_AbortAllBuffers(const Kit_Player *player) {
 static void Kit_FlushAllBuffers(const Kit_Player *player) {
     Kit_ClearDemuxerBuffers(player->demuxer);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_ClearDemuxerBuffers(player->ext_demuxers[i]);
         Kit_ClearDecoderBuffers(player->decoders[i]);
     }
 }
@@ -480,25 +719,32 @@ void Kit_ClosePlayer(Kit_Player *player) {
     // Signal all pipeline threads to quit, and unblock any buffer waits so the joins below cannot hang.
     Kit_StopDemuxerThread(player->demux_thread);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_StopDemuxerThread(player->ext_demux_threads[i]);
         Kit_StopDecoderThread(dec_threads[i]);
     }
     Kit_AbortDemuxer(player->demuxer);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_AbortDemuxer(player->ext_demuxers[i]);
         Kit_AbortDecoder(decoders[i]);
     }
 
-    // Join the threads and free everything.
-    Kit_CloseDemuxerThread(&player->demux_thread);
+    // Join the threads and free everything. The external demuxer threads may still refer to the main one for
+    // a pending seek, so they go first.
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_CloseDemuxerThread(&player->ext_demux_threads[i]);
         Kit_CloseDecoderThread(&dec_threads[i]);
     }
+    Kit_CloseDemuxerThread(&player->demux_thread);
     Kit_CloseDemuxer(&player->demuxer);
     for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        Kit_CloseDemuxer(&player->ext_demuxers[i]);
         Kit_CloseDecoder(&decoders[i]);
     }
     Kit_CloseTimer(&player->sync_timer);
+    Kit_CloseBufferEvent(&player->buffer_event);
     SDL_UnlockMutex(player->control_lock);
 
+    SDL_DestroyMutex(player->buffer_cb_lock);
     SDL_DestroyMutex(player->control_lock);
     for(int i = 0; i < KIT_INDEX_COUNT; i++)
         SDL_DestroyMutex(player->decoder_ctrl_locks[i]);
@@ -518,6 +764,93 @@ void Kit_SetPlayerScreenSize(Kit_Player *player, int w, int h) {
     Kit_UnlockDecoderCtrl(player, KIT_SUBTITLE_INDEX);
 }
 
+void Kit_GetPlayerConfig(const Kit_Player *player, Kit_PlayerConfig *config) {
+    assert(player != NULL);
+    assert(config != NULL);
+    SDL_LockMutex(player->control_lock);
+    *config = player->config;
+    SDL_UnlockMutex(player->control_lock);
+}
+
+/**
+ * Resizes the input and output buffers of one stream. The applied sizes are written back to the player
+ * config as they succeed, so that it always matches the buffers. Caller must hold the control lock.
+ */
+static bool Kit_ResizeStreamBuffers(
+    Kit_Player *player,
+    Kit_BufferIndex index,
+    int *packet_buffer_size,
+    int *packet_buffer_bytes,
+    int *frame_buffer_size,
+    int new_packet_buffer_size,
+    int new_packet_buffer_bytes,
+    int new_frame_buffer_size
+) {
+    Kit_PacketBuffer *buffer = Kit_GetDemuxerPacketBuffer(Kit_GetStreamDemuxer(player, index), index);
+    if(buffer != NULL && !Kit_ResizePacketBuffer(buffer, new_packet_buffer_size, new_packet_buffer_bytes))
+        return false;
+    *packet_buffer_size = new_packet_buffer_size;
+    *packet_buffer_bytes = new_packet_buffer_bytes;
+    buffer = Kit_GetDecoderOutputBuffer(player->decoders[index]);
+    if(buffer != NULL && !Kit_ResizePacketBuffer(buffer, new_frame_buffer_size, 0))
+        return false;
+    *frame_buffer_size = new_frame_buffer_size;
+    return true;
+}
+
+int Kit_SetPlayerConfig(Kit_Player *player, const Kit_PlayerConfig *input_config) {
+    assert(player != NULL);
+    assert(input_config != NULL);
+    Kit_PlayerConfig config = *input_config;
+    Kit_ClampPlayerConfig(&config);
+
+    // The control lock keeps the decoders in place; the buffers themselves handle the concurrent readers
+    // and writers, so the pipeline threads can keep running.
+    SDL_LockMutex(player->control_lock);
+    Kit_PlayerConfig *current = &player->config;
+    if(!Kit_ResizeStreamBuffers(
+           player,
+           KIT_VIDEO_INDEX,
+           &current->video.packet_buffer_size,
+           &current->video.packet_buffer_bytes,
+           &current->video.frame_buffer_size,
+           config.video.packet_buffer_size,
+           config.video.packet_buffer_bytes,
+           config.video.frame_buffer_size
+       ))
+        goto error_0;
+    if(!Kit_ResizeStreamBuffers(
+           player,
+           KIT_AUDIO_INDEX,
+           &current->audio.packet_buffer_size,
+           &current->audio.packet_buffer_bytes,
+           &current->audio.frame_buffer_size,
+           config.audio.packet_buffer_size,
+           config.audio.packet_buffer_bytes,
+           config.audio.frame_buffer_size
+       ))
+        goto error_0;
+    if(!Kit_ResizeStreamBuffers(
+           player,
+           KIT_SUBTITLE_INDEX,
+           &current->subtitle.packet_buffer_size,
+           &current->subtitle.packet_buffer_bytes,
+           &current->subtitle.frame_buffer_size,
+           config.subtitle.packet_buffer_size,
+           config.subtitle.packet_buffer_bytes,
+           config.subtitle.frame_buffer_size
+       ))
+        goto error_0;
+    Kit_SetStreamBufferSpin(player, config.buffer_spin_time);
+    current->buffer_spin_time = config.buffer_spin_time;
+    SDL_UnlockMutex(player->control_lock);
+    return 0;
+
+error_0:
+    SDL_UnlockMutex(player->control_lock);
+    return 1;
+}
+
 static int Kit_GetPlayerStreamIndex(const Kit_Player *player, Kit_BufferIndex index) {
     if(player == NULL)
         return -1;
@@ -770,19 +1103,72 @@ int Kit_HasBufferFillRate(
     return 1;
 }
 
+/**
+ * Sets the fill levels at which the input and output buffers of a stream wake up Kit_WaitBufferFillRate().
+ */
+static void Kit_SetStreamWakeLevels(const Kit_Player *player, int index, int input, int output) {
+    Kit_LockDecoderCtrl(player, index);
+    Kit_PacketBuffer *input_buffer = Kit_GetDemuxerPacketBuffer(Kit_GetStreamDemuxer(player, index), index);
+    Kit_PacketBuffer *output_buffer = Kit_GetDecoderOutputBuffer(player->decoders[index]);
+    if(input_buffer != NULL)
+        Kit_SetPacketBufferWakeLevel(input_buffer, input);
+    if(output_buffer != NULL)
+        Kit_SetPacketBufferWakeLevel(output_buffer, output);
+    Kit_UnlockDecoderCtrl(player, index);
+}
+
+static int Kit_GetWakeLevel(int fill_rate) {
+    return fill_rate < 0 ? KIT_PACKET_BUFFER_WAKE_NONE : Kit_clamp(fill_rate, 0, 100);
+}
+
+/**
+ * Makes the buffers signal the buffer event once they fill up to the given rates. The buffers only hold one set of
+ * levels, so while several threads wait at once, they go back to signaling on every write.
+ */
+static void Kit_SetBufferWakeLevels(
+    const Kit_Player *player, int audio_input, int audio_output, int video_input, int video_output
+) {
+    SDL_AtomicInt *waiters = (SDL_AtomicInt *)&player->fill_waiters;
+    if(SDL_AddAtomicInt(waiters, 1) == 0) {
+        const int audio_in = Kit_GetWakeLevel(audio_input);
+        const int video_in = Kit_GetWakeLevel(video_input);
+        Kit_SetStreamWakeLevels(player, KIT_AUDIO_INDEX, audio_in, Kit_GetWakeLevel(audio_output));
+        Kit_SetStreamWakeLevels(player, KIT_VIDEO_INDEX, video_in, Kit_GetWakeLevel(video_output));
+        // Another waiter may have come in while the levels were being set, and have its own set overwritten.
+        if(SDL_GetAtomicInt(waiters) == 1)
+            return;
+    }
+    Kit_SetStreamWakeLevels(player, KIT_AUDIO_INDEX, KIT_PACKET_BUFFER_WAKE_ANY, KIT_PACKET_BUFFER_WAKE_ANY);
+    Kit_SetStreamWakeLevels(player, KIT_VIDEO_INDEX, KIT_PACKET_BUFFER_WAKE_ANY, KIT_PACKET_BUFFER_WAKE_ANY);
+}
+
 int Kit_WaitBufferFillRate(
     const Kit_Player *player, int audio_input, int audio_output, int video_input, int video_output, double timeout
 ) {
     const double start = Kit_GetSystemTime();
-    double now = start;
-    while(now - start < timeout) {
+    int ret = 1;
+
+    // The buffers signal the event when a write brings them up to the level asked for here, and the pipeline
+    // threads when they exit. Registering before the first check, and reading the serial before every check,
+    // makes sure no signal can slip by unseen.
+    Kit_SetBufferWakeLevels(player, audio_input, audio_output, video_input, video_output);
+    Kit_BeginBufferEventWait(player->buffer_event);
+    while(true) {
+        const int serial = Kit_GetBufferEventSerial(player->buffer_event);
         if(Kit_HasBufferFillRate(player, audio_input, audio_output, video_input, video_output)) {
-            return 0;
+            ret = 0;
+            break;
         }
-        SDL_Delay(1);
-        now = Kit_GetSystemTime();
+        const double left = timeout - (Kit_GetSystemTime() - start);
+        if(left <= 0)
+            break;
+        // Long timeouts are waited out in slices, to keep the millisecond count within range.
+        const double wait_ms = left * 1000.0 + 1.0;
+        Kit_WaitBufferEvent(player->buffer_event, serial, wait_ms < 1000.0 ? (int)wait_ms : 1000);
     }
-    return 1;
+    Kit_EndBufferEventWait(player->buffer_event);
+    SDL_AddAtomicInt((SDL_AtomicInt *)&player->fill_waiters, -1);
+    return ret;
 }
 
 bool Kit_GetPlayerVideoBufferState(
@@ -804,8 +1190,9 @@ bool Kit_GetPlayerVideoBufferState(
     Kit_LockDecoderCtrl(player, KIT_VIDEO_INDEX);
     const bool has_stream =
         Kit_GetDecoderBufferState(player->decoders[KIT_VIDEO_INDEX], frames_length, frames_capacity) == 0;
+    const Kit_Demuxer *demuxer = Kit_GetStreamDemuxer(player, KIT_VIDEO_INDEX);
+    Kit_GetDemuxerBufferState(demuxer, KIT_VIDEO_INDEX, packets_length, packets_capacity);
     Kit_UnlockDecoderCtrl(player, KIT_VIDEO_INDEX);
-    Kit_GetDemuxerBufferState(player->demuxer, KIT_VIDEO_INDEX, packets_length, packets_capacity);
     return has_stream;
 }
 
@@ -828,8 +1215,9 @@ bool Kit_GetPlayerAudioBufferState(
     Kit_LockDecoderCtrl(player, KIT_AUDIO_INDEX);
     const bool has_stream =
         Kit_GetDecoderBufferState(player->decoders[KIT_AUDIO_INDEX], frames_length, frames_capacity) == 0;
+    const Kit_Demuxer *demuxer = Kit_GetStreamDemuxer(player, KIT_AUDIO_INDEX);
+    Kit_GetDemuxerBufferState(demuxer, KIT_AUDIO_INDEX, packets_length, packets_capacity);
     Kit_UnlockDecoderCtrl(player, KIT_AUDIO_INDEX);
-    Kit_GetDemuxerBufferState(player->demuxer, KIT_AUDIO_INDEX, packets_length, packets_capacity);
     return has_stream;
 }
 
@@ -852,11 +1240,98 @@ bool Kit_GetPlayerSubtitleBufferState(
     Kit_LockDecoderCtrl(player, KIT_SUBTITLE_INDEX);
     const bool has_stream =
         Kit_GetDecoderBufferState(player->decoders[KIT_SUBTITLE_INDEX], items_length, items_capacity) == 0;
+    const Kit_Demuxer *demuxer = Kit_GetStreamDemuxer(player, KIT_SUBTITLE_INDEX);
+    Kit_GetDemuxerBufferState(demuxer, KIT_SUBTITLE_INDEX, packets_length, packets_capacity);
     Kit_UnlockDecoderCtrl(player, KIT_SUBTITLE_INDEX);
-    Kit_GetDemuxerBufferState(player->demuxer, KIT_SUBTITLE_INDEX, packets_length, packets_capacity);
     return has_stream;
 }
 
+bool Kit_GetPlayerBufferStats(const Kit_Player *player, const Kit_StreamType type, Kit_PlayerBufferStats *stats) {
+    assert(player != NULL);
+    assert(stats != NULL);
+    Kit_BufferIndex buffer_index;
+    Kit_PacketBufferStats buffer_stats;
+    memset(stats, 0, sizeof(Kit_PlayerBufferStats));
+    switch(type) {
+        case KIT_STREAMTYPE_AUDIO:
+            buffer_index = KIT_AUDIO_INDEX;
+            break;
+        case KIT_STREAMTYPE_VIDEO:
+            buffer_index = KIT_VIDEO_INDEX;
+            break;
+        case KIT_STREAMTYPE_SUBTITLE:
+            buffer_index = KIT_SUBTITLE_INDEX;
+            break;
+        default:
+            return false;
+    }
+    Kit_LockDecoderCtrl(player, buffer_index);
+    const bool has_buffer =
+        Kit_GetDemuxerBufferStats(Kit_GetStreamDemuxer(player, buffer_index), buffer_index, &buffer_stats);
+    Kit_UnlockDecoderCtrl(player, buffer_index);
+    if(!has_buffer)
+        return false;
+    stats->writes = buffer_stats.writes;
+    stats->reads = buffer_stats.reads;
+    stats->write_wait_ns = buffer_stats.write_wait_ns;
+    stats->read_wait_ns = buffer_stats.read_wait_ns;
+    stats->aborts = buffer_stats.aborts;
+    stats->peak_length = (unsigned int)buffer_stats.peak_length;
+    return true;
+}
+
+void Kit_SetPlayerBufferCallback(Kit_Player *player, Kit_PlayerBufferCallback callback, void *userdata) {
+    assert(player != NULL);
+    SDL_LockMutex(player->buffer_cb_lock);
+    player->buffer_cb = callback;
+    player->buffer_cb_userdata = userdata;
+    SDL_UnlockMutex(player->buffer_cb_lock);
+}
+
+static bool Kit_IsValidWatermarkPair(int low, int high) {
+    if(low < 0 && high < 0)
+        return low == -1 && high == -1;
+    return low >= 0 && low < high && high <= 100;
+}
+
+int Kit_SetPlayerBufferWatermarks(
+    Kit_Player *player, const Kit_StreamType type, const Kit_PlayerBufferWatermarks *watermarks
+) {
+    assert(player != NULL);
+    assert(watermarks != NULL);
+    Kit_BufferIndex buffer_index;
+    switch(type) {
+        case KIT_STREAMTYPE_AUDIO:
+            buffer_index = KIT_AUDIO_INDEX;
+            break;
+        case KIT_STREAMTYPE_VIDEO:
+            buffer_index = KIT_VIDEO_INDEX;
+            break;
+        case KIT_STREAMTYPE_SUBTITLE:
+            buffer_index = KIT_SUBTITLE_INDEX;
+            break;
+        default:
+            Kit_SetError("Unknown stream type");
+            return 1;
+    }
+    if(!Kit_IsValidWatermarkPair(watermarks->input_low, watermarks->input_high) ||
+       !Kit_IsValidWatermarkPair(watermarks->output_low, watermarks->output_high)) {
+        Kit_SetError("Invalid buffer watermarks");
+        return 1;
+    }
+
+    SDL_LockMutex(player->control_lock);
+    player->watermarks[buffer_index] = *watermarks;
+    Kit_PacketBuffer *input = Kit_GetDemuxerPacketBuffer(Kit_GetStreamDemuxer(player, buffer_index), buffer_index);
+    if(input != NULL)
+        Kit_SetPacketBufferWatermarks(input, watermarks->input_low, watermarks->input_high);
+    Kit_PacketBuffer *output = Kit_GetDecoderOutputBuffer(player->decoders[buffer_index]);
+    if(output != NULL)
+        Kit_SetPacketBufferWatermarks(output, watermarks->output_low, watermarks->output_high);
+    SDL_UnlockMutex(player->control_lock);
+    return 0;
+}
+
 Kit_PlayerState Kit_GetPlayerState(Kit_Player *player) {
     assert(player != NULL);
     // Not just a read -- state verification may stop and join finished pipeline threads.
@@ -931,6 +1406,11 @@ int Kit_PlayerSeek(Kit_Player *player, double seek_set) {
         Kit_SetError("Player is closed");
         return 1;
     }
+    if(player->shared) {
+        SDL_UnlockMutex(player->control_lock);
+        Kit_SetError("Shared players follow the seeks of the player they share the demuxer with");
+        return 1;
+    }
     const double duration = Kit_GetPlayerDuration(player);
     if(seek_set <= 0)
         seek_set = 0;
@@ -945,7 +1425,12 @@ int Kit_PlayerSeek(Kit_Player *player, double seek_set) {
 
     // Request the seek only now that nothing is running. This ensures the seek packet is read
     // immediately on thread start.
+    // The external sources wait for the main seek, and follow along under the serial it installs if it succeeds.
     Kit_SeekDemuxerThread(player->demux_thread, seek_set * AV_TIME_BASE);
+    for(int i = 0; i < KIT_INDEX_COUNT; i++) {
+        if(player->ext_demux_threads[i] != NULL)
+            Kit_FollowDemuxerThreadSeek(player->ext_demux_threads[i], player->demux_thread, seek_set * AV_TIME_BASE);
+    }
     Kit_StartThreads(player);
 
     // A stopped player restarts playback from the seek position. The timer resume matters only
@@ -1028,32 +1513,103 @@ static void Kit_IsStreamPrimary(const Kit_Player *player, bool *video_primary, b
     *audio_primary = audio_decoder && !*video_primary && audio_decoder->stream->index > -1;
 }
 
-int Kit_ClosePlayerStream(Kit_Player *player, const Kit_StreamType type) {
-    assert(player != NULL);
-
-    Kit_BufferIndex buffer_index;
+static bool Kit_GetBufferIndex(const Kit_StreamType type, Kit_BufferIndex *index) {
     switch(type) {
         case KIT_STREAMTYPE_AUDIO:
-            buffer_index = KIT_AUDIO_INDEX;
-            break;
+            *index = KIT_AUDIO_INDEX;
+            return true;
         case KIT_STREAMTYPE_VIDEO:
-            buffer_index = KIT_VIDEO_INDEX;
-            break;
+            *index = KIT_VIDEO_INDEX;
+            return true;
         case KIT_STREAMTYPE_SUBTITLE:
-            buffer_index = KIT_SUBTITLE_INDEX;
-            break;
+            *index = KIT_SUBTITLE_INDEX;
+            return true;
         default:
-            Kit_SetError("Unknown stream type");
-            return 1;
+            return false;
+    }
+}
+
+/**
+ * Creates a demuxer and a demuxer thread that read one stream of an external source. The input buffer gets the
+ * same watermarks and spin time as the main demuxer would give it. Caller must hold the control lock.
+ */
+static bool Kit_CreateExternalDemuxer(
+    Kit_Player *player,
+    Kit_BufferIndex index,
+    const Kit_Source *src,
+    int stream_index,
+    Kit_Demuxer **demuxer,
+    Kit_DemuxerThread **thread
+) {
+    int indexes[KIT_INDEX_COUNT] = {-1, -1, -1};
+    indexes[index] = stream_index;
+    *demuxer = Kit_CreateDemuxer(
+        src,
+        indexes[KIT_VIDEO_INDEX],
+        indexes[KIT_AUDIO_INDEX],
+        indexes[KIT_SUBTITLE_INDEX],
+        &player->config,
+        player->sync_timer
+    );
+    if(*demuxer == NULL)
+        return false;
+    if((*thread = Kit_CreateDemuxerThread(*demuxer, player->buffer_event)) == NULL) {
+        Kit_CloseDemuxer(demuxer);
+        return false;
+    }
+    const Kit_PlayerBufferWatermarks *marks = &player->watermarks[index];
+    Kit_PacketBuffer *input = Kit_GetDemuxerPacketBuffer(*demuxer, index);
+    Kit_SetPacketBufferWatermarkCallback(input, Kit_OnBufferWatermark, &player->watermark_targets[index][0]);
+    Kit_AttachBufferEvent(player, index, input);
+    Kit_SetPacketBufferWatermarks(input, marks->input_low, marks->input_high);
+    Kit_SetPacketBufferSpin(input, player->config.buffer_spin_time);
+    return true;
+}
+
+static void Kit_CloseExternalDemuxer(Kit_Demuxer *demuxer, Kit_DemuxerThread *thread) {
+    Kit_StopDemuxerThread(thread);
+    Kit_AbortDemuxer(demuxer);
+    Kit_CloseDemuxerThread(&thread);
+    Kit_CloseDemuxer(&demuxer);
+}
+
+/**
+ * Detaches the external demuxer of a stream (if any) from the player under the decoder control lock, and sets a
+ * new one in its place. Caller must hold the control lock.
+ */
+static void Kit_SwapExternalDemuxer(
+    Kit_Player *player, int index, Kit_Demuxer **demuxer, Kit_DemuxerThread **thread
+) {
+    Kit_Demuxer *old_demuxer = player->ext_demuxers[index];
+    Kit_DemuxerThread *old_thread = player->ext_demux_threads[index];
+    Kit_LockDecoderCtrl(player, index);
+    player->ext_demuxers[index] = *demuxer;
+    player->ext_demux_threads[index] = *thread;
+    Kit_UnlockDecoderCtrl(player, index);
+    *demuxer = old_demuxer;
+    *thread = old_thread;
+}
+
+int Kit_ClosePlayerStream(Kit_Player *player, const Kit_StreamType type) {
+    assert(player != NULL);
+
+    Kit_BufferIndex buffer_index;
+    if(!Kit_GetBufferIndex(type, &buffer_index)) {
+        Kit_SetError("Unknown stream type");
+        return 1;
     }
 
     // Detach the old decoder first, so that getters on other threads see an empty slot,
     // then stop it and clear the output buffers.
     Kit_Decoder *old_decoder;
     Kit_DecoderThread *old_thread;
+    Kit_Demuxer *old_ext_demuxer = NULL;
+    Kit_DemuxerThread *old_ext_thread = NULL;
     SDL_LockMutex(player->control_lock);
     Kit_StealDecoder(player, buffer_index, &old_decoder, &old_thread);
     Kit_HaltDecoder(old_decoder, old_thread);
+    Kit_SwapExternalDemuxer(player, buffer_index, &old_ext_demuxer, &old_ext_thread);
+    Kit_CloseExternalDemuxer(old_ext_demuxer, old_ext_thread);
 
     // Clear the demuxer packets
     Kit_SetDemuxerStreamIndex(player->demuxer, buffer_index, -1);
@@ -1061,16 +1617,22 @@ int Kit_ClosePlayerStream(Kit_Player *player, const Kit_StreamType type) {
     return 0;
 }
 
-int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index) {
-    assert(player != NULL);
+/**
+ * Switches a stream over to a new decoder. If ext_src is set, the stream is read from it by a new external
+ * demuxer; otherwise by the main demuxer.
+ */
+static int Kit_SwitchPlayerStream(Kit_Player *player, Kit_StreamType type, const Kit_Source *ext_src, int index) {
     Kit_Decoder *new_decoder = NULL;
     Kit_DecoderThread *new_thread = NULL;
+    Kit_Demuxer *ext_demuxer = NULL;
+    Kit_DemuxerThread *ext_thread = NULL;
+    Kit_Demuxer *held_demuxer = NULL;
     Kit_BufferIndex buffer_index;
     bool video_primary, audio_primary;
 
-    // If index is -1, it means we are closing the stream.
-    if(index < 0) {
-        return Kit_ClosePlayerStream(player, type);
+    if(!Kit_GetBufferIndex(type, &buffer_index)) {
+        Kit_SetError("Unknown stream type");
+        return 1;
     }
 
     // Figure out which stream is currently the primary one. This stream is allowed to modify the sync clock.
@@ -1079,15 +1641,40 @@ int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index
     SDL_LockMutex(player->control_lock);
     Kit_IsStreamPrimary(player, &video_primary, &audio_primary);
 
+    // Two demuxers can't read the same source at once. When switching between the streams of one external
+    // source, its old demuxer is stopped first, and only restarted if the switch fails.
+    for(int i = 0; ext_src != NULL && i < KIT_INDEX_COUNT; i++) {
+        if(player->ext_demuxers[i] == NULL || player->ext_demuxers[i]->src != ext_src)
+            continue;
+        if(i != (int)buffer_index) {
+            Kit_SetError("Source is already in use by another stream");
+            goto error_0;
+        }
+        held_demuxer = player->ext_demuxers[i];
+        Kit_StopDemuxerThread(player->ext_demux_threads[i]);
+        Kit_AbortDemuxer(held_demuxer);
+        Kit_WaitDemuxerThread(player->ext_demux_threads[i]);
+    }
+
+    // An external stream gets a demuxer of its own, which the new decoder then reads from.
+    const Kit_Source *src = player->src;
+    const Kit_Demuxer *demuxer = player->demuxer;
+    if(ext_src != NULL) {
+        if(!Kit_CreateExternalDemuxer(player, buffer_index, ext_src, index, &ext_demuxer, &ext_thread))
+            goto error_1;
+        src = ext_src;
+        demuxer = ext_demuxer;
+    }
+
     // First, attempt to start up a new decoder instance. If this fails, we don't want to disturb the
     // currently running decoder.
-    switch(type) {
-        case KIT_STREAMTYPE_AUDIO:
-            buffer_index = KIT_AUDIO_INDEX;
+    switch(buffer_index) {
+        case KIT_AUDIO_INDEX:
             if(!Kit_InitializeAudioDecoder(
-                   player->src,
+                   src,
                    player->sync_timer,
-                   player->demux_thread,
+                   demuxer,
+                   player->buffer_event,
                    &player->audio_req,
                    &player->config.audio,
                    player->config.thread_count,
@@ -1098,12 +1685,12 @@ int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index
                ))
                 goto error_1;
             break;
-        case KIT_STREAMTYPE_VIDEO:
-            buffer_index = KIT_VIDEO_INDEX;
+        case KIT_VIDEO_INDEX:
             if(!Kit_InitializeVideoDecoder(
-                   player->src,
+                   src,
                    player->sync_timer,
-                   player->demux_thread,
+                   demuxer,
+                   player->buffer_event,
                    &player->video_req,
                    &player->config.video,
                    player->config.thread_count,
@@ -1114,12 +1701,12 @@ int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index
                ))
                 goto error_1;
             break;
-        case KIT_STREAMTYPE_SUBTITLE:
-            buffer_index = KIT_SUBTITLE_INDEX;
+        default:
             if(!Kit_InitializeSubtitleDecoder(
-                   player->src,
+                   src,
                    player->sync_timer,
-                   player->demux_thread,
+                   demuxer,
+                   player->buffer_event,
                    player->decoders[KIT_VIDEO_INDEX],
                    &player->config.subtitle,
                    player->config.thread_count,
@@ -1131,61 +1718,108 @@ int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index
                ))
                 goto error_1;
             break;
-        default:
-            SDL_UnlockMutex(player->control_lock);
-            Kit_SetError("Unknown stream type");
-            return 1;
     }
 
+    Kit_AttachDecoderOutput(player, buffer_index, new_decoder);
+
     // If we have a good new decoder, detach the old decoder from the player and stop it.
     Kit_Decoder *old_decoder;
     Kit_DecoderThread *old_thread;
     Kit_StealDecoder(player, buffer_index, &old_decoder, &old_thread);
     Kit_HaltDecoder(old_decoder, old_thread);
 
-    // Switch demuxer to track the new stream index. This will also clear the packet buffer, so that the decoder
-    // will no longer get packets from the old stream.
-    Kit_SetDemuxerStreamIndex(player->demuxer, buffer_index, index);
+    if(ext_src != NULL) {
+        // The main demuxer no longer needs to read this stream. If playback is already going, the external
+        // source starts from the current position, under the current serial.
+        Kit_SetDemuxerStreamIndex(player->demuxer, buffer_index, -1);
+        const Kit_PlayerState state = Kit_GetState(player);
+        if(state == KIT_PLAYING || state == KIT_PAUSED) {
+            const int64_t position = (int64_t)(Kit_GetPlayerPosition(player) * AV_TIME_BASE);
+            Kit_FollowDemuxerThreadSeek(ext_thread, NULL, position);
+        }
+    } else {
+        // Switch demuxer to track the new stream index. This will also clear the packet buffer, so that the
+        // decoder will no longer get packets from the old stream.
+        Kit_SetDemuxerStreamIndex(player->demuxer, buffer_index, index);
+
+        // EOF packet may have been lost in the flush; resend it if needed. The packets of a shared player come
+        // from the demuxer thread of another player, which is not ours to judge.
+        if(!player->shared && !Kit_IsDemuxerThreadAlive(player->demux_thread))
+            Kit_SendDemuxerEOFPacket(player->demuxer, buffer_index);
+    }
 
-    // EOF packet may have been lost in the flush; resend it if needed.
-    if(!Kit_IsDemuxerThreadAlive(player->demux_thread))
-        Kit_SendDemuxerEOFPacket(player->demuxer, buffer_index);
+    // Swap in the external demuxer of the new stream (if any), and stop the one of the old stream (if any).
+    // Closing the old one resets the discard state of its source, so a new demuxer on the same source needs to
+    // set it up again.
+    Kit_SwapExternalDemuxer(player, buffer_index, &ext_demuxer, &ext_thread);
+    Kit_CloseExternalDemuxer(ext_demuxer, ext_thread);
+    if(held_demuxer != NULL)
+        Kit_SetDemuxerStreamIndex(player->ext_demuxers[buffer_index], buffer_index, index);
 
-    // Set the new decoder and thread, and spin up the thread if we were already playing.
+    // Set the new decoder and thread, and spin up the threads if we were already playing.
     Kit_LockDecoderCtrl(player, buffer_index);
     player->decoders[buffer_index] = new_decoder;
     player->dec_threads[buffer_index] = new_thread;
     Kit_UnlockDecoderCtrl(player, buffer_index);
     const Kit_PlayerState state = Kit_GetState(player);
-    if(state == KIT_PLAYING || state == KIT_PAUSED)
+    if(state == KIT_PLAYING || state == KIT_PAUSED) {
+        Kit_StartDemuxerThread(player->ext_demux_threads[buffer_index]);
         Kit_StartThreadFor(player, buffer_index);
+    }
     SDL_UnlockMutex(player->control_lock);
 
     // Et voila!
     return 0;
 
 error_1:
-    SDL_UnlockMutex(player->control_lock);
-    Kit_SetError("Failed to initialize decoder");
     Kit_CloseDecoder(&new_decoder);
     Kit_CloseDecoderThread(&new_thread);
+    Kit_CloseExternalDemuxer(ext_demuxer, ext_thread);
+    if(held_demuxer != NULL) {
+        const int held_index = SDL_GetAtomicInt(&held_demuxer->stream_indexes[buffer_index]);
+        Kit_SetDemuxerStreamIndex(held_demuxer, buffer_index, held_index);
+        Kit_ClearDemuxerBuffers(held_demuxer);
+        const Kit_PlayerState held_state = Kit_GetState(player);
+        if(held_state == KIT_PLAYING || held_state == KIT_PAUSED)
+            Kit_StartDemuxerThread(player->ext_demux_threads[buffer_index]);
+    }
+    SDL_UnlockMutex(player->control_lock);
+    Kit_SetError("Failed to initialize decoder");
     return 1;
+
+error_0:
+    SDL_UnlockMutex(player->control_lock);
+    return 1;
+}
+
+int Kit_SetPlayerStream(Kit_Player *player, const Kit_StreamType type, int index) {
+    assert(player != NULL);
+
+    // If index is -1, it means we are closing the stream.
+    if(index < 0) {
+        return Kit_ClosePlayerStream(player, type);
+    }
+    return Kit_SwitchPlayerStream(player, type, NULL, index);
+}
+
+int Kit_SetPlayerExternalStream(Kit_Player *player, const Kit_StreamType type, const Kit_Source *src, int index) {
+    assert(player != NULL);
+    if(src == NULL || src == player->src || index < 0)
+        return Kit_SetPlayerStream(player, type, index);
+    if(type != KIT_STREAMTYPE_AUDIO && type != KIT_STREAMTYPE_SUBTITLE) {
+        Kit_SetError("External sources are only supported for audio and subtitle streams");
+        return 1;
+    }
+    if(player->shared) {
+        Kit_SetError("Shared players can't take streams from external sources");
+        return 1;
+    }
+    return Kit_SwitchPlayerStream(player, type, src, index);
 }
 
 int Kit_GetPlayerStream(const Kit_Player *player, const Kit_StreamType type) {
     Kit_BufferIndex buffer_index;
-    switch(type) {
-        case KIT_STREAMTYPE_AUDIO:
-            buffer_index = KIT_AUDIO_INDEX;
-            break;
-        case KIT_STREAMTYPE_VIDEO:
-            buffer_index = KIT_VIDEO_INDEX;
-            break;
-        case KIT_STREAMTYPE_SUBTITLE:
-            buffer_index = KIT_SUBTITLE_INDEX;
-            break;
-        default:
-            return -1;
-    }
+    if(!Kit_GetBufferIndex(type, &buffer_index))
+        return -1;
     return Kit_GetPlayerStreamIndex(player, buffer_index);
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_stdinc.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -5,65 +7,175 @@
 #include <libavformat/avformat.h>
 #include <libavutil/opt.h>
 
+#include "kitchensink3/internal/kitfilesource.h"
+#include "kitchensink3/internal/kitreadahead.h"
+#include "kitchensink3/internal/kitsourcecache.h"
+#include "kitchensink3/internal/kitsourceindex.h"
 #include "kitchensink3/internal/utils/kitalloc.h"
 #include "kitchensink3/internal/utils/kitlog.h"
+#include "kitchensink3/internal/utils/kithelpers.h"
 #include "kitchensink3/kiterror.h"
 #include "kitchensink3/kitsource.h"
 
 #define AVIO_BUF_SIZE 32768
+#define AVIO_MIN_BUF_SIZE 4096
+#define AVIO_MAX_BUF_SIZE (16 * 1024 * 1024)
+#define FAST_OPEN_PROBE_SIZE 262144
+#define FAST_OPEN_PROBE_DURATION 500
+#define CACHE_KEY_SIZE 4096
+
+/**
+ * Checks whether the container headers alone gave us enough to set up decoders for every stream, ie. whether
+ * avformat_find_stream_info() would only be confirming what we already know.
+ */
+static bool Kit_HasStreamParameters(const AVFormatContext *format_ctx) {
+    for(unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+        const AVCodecParameters *codecpar = format_ctx->streams[i]->codecpar;
+        if(codecpar->codec_id == AV_CODEC_ID_NONE)
+            return false;
+        switch(codecpar->codec_type) {
+            case AVMEDIA_TYPE_VIDEO:
+                if(codecpar->width <= 0 || codecpar->height <= 0 || codecpar->format < 0)
+                    return false;
+                break;
+            case AVMEDIA_TYPE_AUDIO:
+                if(codecpar->sample_rate <= 0 || codecpar->ch_layout.nb_channels <= 0 || codecpar->format < 0)
+                    return false;
+                break;
+            default:
+                break;
+        }
+    }
+    return format_ctx->nb_streams > 0;
+}
 
-static int _ScanSource(AVFormatContext *format_ctx) {
-    av_opt_set_int(format_ctx, "probesize", INT_MAX, 0);
-    av_opt_set_int(format_ctx, "analyzeduration", INT_MAX, 0);
+/**
+ * Gets the stream information cache key for the source: the user given key if any, otherwise path, size and
+ * modification time if url is a local file. Returns NULL if the source can't be cached.
+ */
+static const char *Kit_GetSourceCacheKey(const char *url, const Kit_SourceOptions *options, char *buf, size_t size) {
+    SDL_PathInfo info;
+    if(options->cache_key != NULL)
+        return options->cache_key;
+    if(!SDL_GetPathInfo(url, &info) || info.type != SDL_PATHTYPE_FILE)
+        return NULL;
+    const int len =
+        SDL_snprintf(buf, size, "%s|%" SDL_PRIu64 "|%" SDL_PRIs64, url, info.size, (Sint64)info.modify_time);
+    return (len > 0 && (size_t)len < size) ? buf : NULL;
+}
+
+static int _ScanSource(AVFormatContext *format_ctx, const char *url, const Kit_SourceOptions *options) {
+    char key_buf[CACHE_KEY_SIZE];
+    const char *key = NULL;
+    if(options->cache != NULL && (key = Kit_GetSourceCacheKey(url, options, key_buf, sizeof(key_buf))) != NULL) {
+        if(Kit_LoadSourceCache(options->cache, key, format_ctx))
+            return 0;
+    }
+    if(options->trust_headers && Kit_HasStreamParameters(format_ctx))
+        return 0;
+    av_opt_set_int(format_ctx, "probesize", options->probe_size > 0 ? options->probe_size : INT_MAX, 0);
+    av_opt_set_int(
+        format_ctx,
+        "analyzeduration",
+        options->probe_duration > 0 ? (int64_t)options->probe_duration * 1000 : INT_MAX,
+        0
+    );
     if(avformat_find_stream_info(format_ctx, NULL) < 0) {
         Kit_SetError("Unable to fetch source information");
         return 1;
     }
+    if(key != NULL)
+        Kit_StoreSourceCache(options->cache, key, format_ctx);
     return 0;
 }
 
-Kit_Source *Kit_CreateSourceFromUrl(const char *url) {
-    if(url == NULL) {
-        Kit_SetError("No source URL provided");
-        return NULL;
-    }
+void Kit_ResetSourceOptions(Kit_SourceOptions *options) {
+    assert(options != NULL);
+    options->read_ahead = 0;
+    options->io_buffer_size = AVIO_BUF_SIZE;
+    options->io_direct = 0;
+    options->probe_size = 0;
+    options->probe_duration = 0;
+    options->trust_headers = 0;
+    options->cache = NULL;
+    options->cache_key = NULL;
+    options->build_index = 0;
+    options->index_path = NULL;
+}
 
-    Kit_Source *src = Kit_Calloc(1, sizeof(Kit_Source));
-    if(src == NULL) {
-        Kit_SetError("Unable to allocate source");
-        return NULL;
-    }
+void Kit_SetSourceOptionsFastOpen(Kit_SourceOptions *options) {
+    assert(options != NULL);
+    options->probe_size = FAST_OPEN_PROBE_SIZE;
+    options->probe_duration = FAST_OPEN_PROBE_DURATION;
+    options->trust_headers = 1;
+}
 
-    // Attempt to open source
-    if(avformat_open_input((AVFormatContext **)&src->format_ctx, url, NULL, NULL) < 0) {
-        Kit_SetError("Unable to open source Url");
-        goto EXIT_0;
-    }
+static void Kit_ClampSourceOptions(Kit_SourceOptions *options) {
+    if(options->read_ahead > 0)
+        options->read_ahead = Kit_max(options->read_ahead, KIT_READ_AHEAD_MIN_WINDOW);
+    else
+        options->read_ahead = 0;
+    options->io_buffer_size = Kit_clamp(options->io_buffer_size, AVIO_MIN_BUF_SIZE, AVIO_MAX_BUF_SIZE);
+    options->probe_size = Kit_max(options->probe_size, 0);
+    options->probe_duration = Kit_max(options->probe_duration, 0);
+}
 
-    // Scan source information (may seek forwards)
-    if(_ScanSource(src->format_ctx)) {
-        goto EXIT_1;
+static void Kit_GetSourceOptions(Kit_SourceOptions *dst, const Kit_SourceOptions *options) {
+    if(options == NULL) {
+        Kit_ResetSourceOptions(dst);
+    } else {
+        *dst = *options;
+        Kit_ClampSourceOptions(dst);
     }
+}
 
-    return src;
+/**
+ * Gets the options for the second source that the indexer reads through. It only needs to know the streams, not
+ * everything about them, and must not start an indexer of its own.
+ */
+static void Kit_GetIndexScanOptions(Kit_SourceOptions *dst, const Kit_SourceOptions *options) {
+    *dst = *options;
+    dst->build_index = 0;
+    dst->index_path = NULL;
+    Kit_SetSourceOptionsFastOpen(dst);
+}
 
-EXIT_1:
-    avformat_close_input((AVFormatContext **)&src->format_ctx);
-EXIT_0:
-    free(src);
-    return NULL;
+/**
+ * Sets up the keyframe index, if the options ask for one. Returns true if the media still needs to be scanned, in
+ * which case the caller opens a second source on it for Kit_StartIndex(). Indexing is best effort, so failures
+ * only get logged, and the source is used without an index.
+ */
+static bool Kit_CreateIndex(Kit_Source *src, const Kit_SourceOptions *options) {
+    if(!options->build_index)
+        return false;
+    if((src->index = Kit_CreateSourceIndex(src->format_ctx, options->index_path)) == NULL) {
+        LOG("Not indexing source: %s\n", Kit_GetError());
+        return false;
+    }
+    return !Kit_IsSourceIndexComplete(src->index);
 }
 
-Kit_Source *Kit_CreateSourceFromCustom(Kit_ReadCallback read_cb, Kit_SeekCallback seek_cb, void *userdata) {
-    assert(read_cb != NULL);
+static void Kit_StartIndex(Kit_Source *src, Kit_Source *scan) {
+    if(!Kit_StartSourceIndex(src->index, scan)) {
+        LOG("Not indexing source: %s\n", Kit_GetError());
+        Kit_CloseSourceIndex((Kit_SourceIndex **)&src->index);
+    }
+}
 
+static Kit_Source *Kit_OpenCustomSource(
+    const char *url,
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    void *userdata,
+    const Kit_SourceOptions *options
+) {
     Kit_Source *src = Kit_Calloc(1, sizeof(Kit_Source));
     if(src == NULL) {
         Kit_SetError("Unable to allocate source");
         return NULL;
     }
 
-    uint8_t *avio_buf = av_malloc(AVIO_BUF_SIZE);
+    uint8_t *avio_buf = av_malloc(options->io_buffer_size);
     if(avio_buf == NULL) {
         Kit_SetError("Unable to allocate avio buffer");
         goto EXIT_0;
@@ -75,24 +187,28 @@ Kit_Source *Kit_CreateSourceFromCustom(Kit_ReadCallback read_cb, Kit_SeekCallbac
         goto EXIT_1;
     }
 
-    AVIOContext *avio_ctx = avio_alloc_context(avio_buf, AVIO_BUF_SIZE, 0, userdata, read_cb, 0, seek_cb);
+    AVIOContext *avio_ctx = avio_alloc_context(avio_buf, options->io_buffer_size, 0, userdata, read_cb, 0, seek_cb);
     if(avio_ctx == NULL) {
         Kit_SetError("Unable to allocate avio context");
         goto EXIT_2;
     }
     // avio_alloc_context takes ownership of avio_buf, so don't free it separately after this point
 
+    // In direct mode, reads of at least the buffer size go straight into the caller's memory with a single
+    // callback, instead of being chopped up into buffer-sized reads and copied again.
+    avio_ctx->direct = options->io_direct ? 1 : 0;
+
     // Set the format as AVIO format
     format_ctx->pb = avio_ctx;
 
-    // Attempt to open source
-    if(avformat_open_input(&format_ctx, "", NULL, NULL) < 0) {
+    // Attempt to open source. The url is only used as a format probing hint here.
+    if(avformat_open_input(&format_ctx, url, NULL, NULL) < 0) {
         Kit_SetError("Unable to open custom source");
         goto EXIT_3;
     }
 
     // Scan source information (may seek forwards)
-    if(_ScanSource(format_ctx)) {
+    if(_ScanSource(format_ctx, url, options)) {
         goto EXIT_4;
     }
 
@@ -122,6 +238,140 @@ EXIT_0:
     return NULL;
 }
 
+/**
+ * Opens a custom source that reads through a read-ahead stage. On failure the upstream is released via close_cb,
+ * so the caller does not need to care about whether the stage got created or not.
+ */
+static Kit_Source *Kit_OpenReadAheadSource(
+    const char *url,
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    Kit_ReadAheadCloseCallback close_cb,
+    void *userdata,
+    const Kit_SourceOptions *options
+) {
+    Kit_ReadAhead *read_ahead = Kit_CreateReadAhead(read_cb, seek_cb, close_cb, userdata, options->read_ahead);
+    if(read_ahead == NULL) {
+        if(close_cb != NULL)
+            close_cb(userdata);
+        return NULL;
+    }
+    Kit_Source *src =
+        Kit_OpenCustomSource(url, Kit_ReadAheadRead, seek_cb != NULL ? Kit_ReadAheadSeek : NULL, read_ahead, options);
+    if(src == NULL) {
+        Kit_CloseReadAhead(&read_ahead);
+        return NULL;
+    }
+    src->read_ahead = read_ahead;
+    return src;
+}
+
+static int Kit_ReadURLIO(void *userdata, uint8_t *buf, int size) {
+    const int ret = avio_read_partial(userdata, buf, size);
+    return ret == 0 ? AVERROR_EOF : ret;
+}
+
+static int64_t Kit_SeekURLIO(void *userdata, int64_t offset, int whence) {
+    if(whence & AVSEEK_SIZE)
+        return avio_size(userdata);
+    return avio_seek(userdata, offset, whence);
+}
+
+static void Kit_CloseURLIO(void *userdata) {
+    avio_close(userdata);
+}
+
+static Kit_Source *Kit_OpenUrlSource(const char *url, const Kit_SourceOptions *options) {
+    // For read-ahead, open the url as a byte stream ourselves and demux it as a custom source. Protocols that
+    // can't be opened like this (demuxers that do their own I/O, like RTSP) are opened without read-ahead.
+    if(options->read_ahead > 0) {
+        AVIOContext *io = NULL;
+        if(avio_open2(&io, url, AVIO_FLAG_READ, NULL, NULL) >= 0) {
+            Kit_SeekCallback seek_cb = (io->seekable & AVIO_SEEKABLE_NORMAL) ? Kit_SeekURLIO : NULL;
+            return Kit_OpenReadAheadSource(url, Kit_ReadURLIO, seek_cb, Kit_CloseURLIO, io, options);
+        }
+        LOG("Unable to open %s for read-ahead, opening without\n", url);
+    }
+
+    Kit_Source *src = Kit_Calloc(1, sizeof(Kit_Source));
+    if(src == NULL) {
+        Kit_SetError("Unable to allocate source");
+        return NULL;
+    }
+
+    // Attempt to open source
+    if(avformat_open_input((AVFormatContext **)&src->format_ctx, url, NULL, NULL) < 0) {
+        Kit_SetError("Unable to open source Url");
+        goto EXIT_0;
+    }
+
+    // Scan source information (may seek forwards)
+    if(_ScanSource(src->format_ctx, url, options)) {
+        goto EXIT_1;
+    }
+
+    return src;
+
+EXIT_1:
+    avformat_close_input((AVFormatContext **)&src->format_ctx);
+EXIT_0:
+    free(src);
+    return NULL;
+}
+
+Kit_Source *Kit_CreateSourceFromUrl(const char *url) {
+    return Kit_CreateSourceFromUrlWithOptions(url, NULL);
+}
+
+Kit_Source *Kit_CreateSourceFromUrlWithOptions(const char *url, const Kit_SourceOptions *input_options) {
+    Kit_SourceOptions options;
+    Kit_Source *src;
+    if(url == NULL) {
+        Kit_SetError("No source URL provided");
+        return NULL;
+    }
+    Kit_GetSourceOptions(&options, input_options);
+    if((src = Kit_OpenUrlSource(url, &options)) == NULL)
+        return NULL;
+    if(Kit_CreateIndex(src, &options)) {
+        Kit_SourceOptions scan_options;
+        Kit_GetIndexScanOptions(&scan_options, &options);
+        Kit_StartIndex(src, Kit_OpenUrlSource(url, &scan_options));
+    }
+    return src;
+}
+
+/**
+ * Opens a custom source, through a read-ahead stage if one is wanted.
+ */
+static Kit_Source *Kit_OpenSource(
+    const char *url,
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    void *userdata,
+    const Kit_SourceOptions *options
+) {
+    if(options->read_ahead > 0)
+        return Kit_OpenReadAheadSource(url, read_cb, seek_cb, NULL, userdata, options);
+    return Kit_OpenCustomSource(url, read_cb, seek_cb, userdata, options);
+}
+
+Kit_Source *Kit_CreateSourceFromCustom(Kit_ReadCallback read_cb, Kit_SeekCallback seek_cb, void *userdata) {
+    return Kit_CreateSourceFromCustomWithOptions(read_cb, seek_cb, userdata, NULL);
+}
+
+Kit_Source *Kit_CreateSourceFromCustomWithOptions(
+    Kit_ReadCallback read_cb,
+    Kit_SeekCallback seek_cb,
+    void *userdata,
+    const Kit_SourceOptions *input_options
+) {
+    assert(read_cb != NULL);
+    Kit_SourceOptions options;
+    Kit_GetSourceOptions(&options, input_options);
+    return Kit_OpenSource("", read_cb, seek_cb, userdata, &options);
+}
+
 static int _IOReadCallback(void *userdata, uint8_t *buf, int size) {
     SDL_IOStream *io_stream = userdata;
     const size_t bytes_read = SDL_ReadIO(io_stream, buf, size);
@@ -146,19 +396,105 @@ static int64_t _IOSeekCallback(void *userdata, int64_t offset, int whence) {
 }
 
 Kit_Source *Kit_CreateSourceFromIO(SDL_IOStream *io_stream) {
-    return Kit_CreateSourceFromCustom(_IOReadCallback, _IOSeekCallback, io_stream);
+    return Kit_CreateSourceFromIOWithOptions(io_stream, NULL);
+}
+
+Kit_Source *Kit_CreateSourceFromIOWithOptions(SDL_IOStream *io_stream, const Kit_SourceOptions *options) {
+    return Kit_CreateSourceFromCustomWithOptions(_IOReadCallback, _IOSeekCallback, io_stream, options);
+}
+
+Kit_Source *Kit_CreateSourceFromFile(const char *path, unsigned int flags) {
+    return Kit_CreateSourceFromFileWithOptions(path, flags, NULL);
+}
+
+Kit_Source *
+Kit_CreateSourceFromFileWithOptions(const char *path, unsigned int flags, const Kit_SourceOptions *input_options) {
+    Kit_SourceOptions options;
+    Kit_FileSource *file;
+    Kit_Source *src;
+    if(path == NULL) {
+        Kit_SetError("No source file provided");
+        return NULL;
+    }
+    Kit_GetSourceOptions(&options, input_options);
+    if((file = Kit_OpenFileSource(path, flags)) == NULL)
+        return NULL;
+
+    // Reading from a mapping costs no system calls, so the only thing the AVIO buffer would add is a copy.
+    if(Kit_IsFileSourceInMemory(file))
+        options.io_direct = 1;
+
+    // The path is passed on as the url, so that it works as a format probing hint and a cache key.
+    if((src = Kit_OpenSource(path, Kit_ReadFileSource, Kit_SeekFileSource, file, &options)) == NULL) {
+        Kit_CloseFileSource(&file);
+        return NULL;
+    }
+    src->file = file;
+    if(Kit_CreateIndex(src, &options)) {
+        Kit_SourceOptions scan_options;
+        Kit_GetIndexScanOptions(&scan_options, &options);
+        Kit_StartIndex(src, Kit_CreateSourceFromFileWithOptions(path, flags, &scan_options));
+    }
+    return src;
+}
+
+Kit_Source *Kit_CreateSourceFromMemory(const void *data, size_t size, Kit_FreeCallback free_cb) {
+    return Kit_CreateSourceFromMemoryWithOptions(data, size, free_cb, NULL);
+}
+
+Kit_Source *Kit_CreateSourceFromMemoryWithOptions(
+    const void *data,
+    size_t size,
+    Kit_FreeCallback free_cb,
+    const Kit_SourceOptions *input_options
+) {
+    Kit_SourceOptions options;
+    Kit_FileSource *file;
+    Kit_Source *src;
+    if(data == NULL) {
+        Kit_SetError("No source memory provided");
+        return NULL;
+    }
+    Kit_GetSourceOptions(&options, input_options);
+    if((file = Kit_OpenMemorySource(data, size, free_cb)) == NULL)
+        return NULL;
+
+    // Same as for mapped files; the AVIO buffer would only add a copy. A read-ahead thread would add two.
+    options.io_direct = 1;
+    options.read_ahead = 0;
+
+    // Closing the file on failure also hands the memory to free_cb, as documented.
+    if((src = Kit_OpenSource("", Kit_ReadFileSource, Kit_SeekFileSource, file, &options)) == NULL) {
+        Kit_CloseFileSource(&file);
+        return NULL;
+    }
+    src->file = file;
+    if(Kit_CreateIndex(src, &options)) {
+        // The scan reads the same memory; it must not release it.
+        Kit_SourceOptions scan_options;
+        Kit_GetIndexScanOptions(&scan_options, &options);
+        Kit_StartIndex(src, Kit_CreateSourceFromMemoryWithOptions(data, size, NULL, &scan_options));
+    }
+    return src;
 }
 
 void Kit_CloseSource(Kit_Source *src) {
     if(src == NULL)
         return;
+    // The indexer thread reads the media through a source of its own, so it goes first.
+    Kit_SourceIndex *index = src->index;
+    Kit_CloseSourceIndex(&index);
     AVFormatContext *format_ctx = src->format_ctx;
     AVIOContext *avio_ctx = src->avio_ctx;
+    Kit_ReadAhead *read_ahead = src->read_ahead;
+    Kit_FileSource *file = src->file;
     avformat_close_input(&format_ctx);
     if(avio_ctx) {
         av_freep(&avio_ctx->buffer);
         av_freep(&avio_ctx);
     }
+    Kit_CloseReadAhead(&read_ahead);
+    Kit_CloseFileSource(&file);
     free(src);
 }
 
@@ -179,6 +515,17 @@ static Kit_StreamType Kit_GetKitStreamType(const enum AVMediaType type) {
     }
 }
 
+int Kit_GetSourceIndexStats(const Kit_Source *src, Kit_SourceIndexStats *stats) {
+    assert(src != NULL);
+    assert(stats != NULL);
+    if(src->index == NULL) {
+        Kit_SetError("Source has no keyframe index");
+        return 1;
+    }
+    Kit_GetSourceIndexState(src->index, stats);
+    return 0;
+}
+
 int Kit_GetSourceStreamInfo(const Kit_Source *src, Kit_SourceStreamInfo *info, int index) {
     assert(src != NULL);
     assert(info != NULL);
@@ -0,0 +1,243 @@
+#include <SDL3/SDL_mutex.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavformat/avformat.h>
+
+#include "kitchensink3/internal/kitsourcecache.h"
+#include "kitchensink3/internal/utils/kitalloc.h"
+#include "kitchensink3/kiterror.h"
+#include "kitchensink3/kitsource.h"
+
+typedef struct Kit_SourceCacheStream {
+    AVCodecParameters *codecpar;
+    AVRational time_base;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    int64_t start_time;
+    int64_t duration;
+} Kit_SourceCacheStream;
+
+typedef struct Kit_SourceCacheEntry {
+    char *key;
+    uint64_t last_used; ///< Value of the cache use counter on last store or hit; smallest is evicted first
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+    unsigned int nb_streams;
+    Kit_SourceCacheStream *streams;
+} Kit_SourceCacheEntry;
+
+struct Kit_SourceCache {
+    SDL_Mutex *mutex;
+    Kit_SourceCacheEntry **entries; ///< max_entries slots; NULL if free
+    int max_entries;
+    uint64_t use_counter;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static void Kit_FreeSourceCacheEntry(Kit_SourceCacheEntry **ref) {
+    Kit_SourceCacheEntry *entry = *ref;
+    if(entry == NULL)
+        return;
+    if(entry->streams != NULL) {
+        for(unsigned int i = 0; i < entry->nb_streams; i++)
+            avcodec_parameters_free(&entry->streams[i].codecpar);
+        free(entry->streams);
+    }
+    free(entry->key);
+    free(entry);
+    *ref = NULL;
+}
+
+static Kit_SourceCacheEntry *Kit_CreateSourceCacheEntry(const char *key, const AVFormatContext *format_ctx) {
+    Kit_SourceCacheEntry *entry;
+    const size_t key_size = strlen(key) + 1;
+
+    if((entry = Kit_Calloc(1, sizeof(Kit_SourceCacheEntry))) == NULL)
+        goto error;
+    if((entry->key = Kit_Malloc(key_size)) == NULL)
+        goto error;
+    memcpy(entry->key, key, key_size);
+    if((entry->streams = Kit_Calloc(format_ctx->nb_streams, sizeof(Kit_SourceCacheStream))) == NULL)
+        goto error;
+    entry->nb_streams = format_ctx->nb_streams;
+    entry->start_time = format_ctx->start_time;
+    entry->duration = format_ctx->duration;
+    entry->bit_rate = format_ctx->bit_rate;
+    for(unsigned int i = 0; i < format_ctx->nb_streams; i++) {
+        const AVStream *stream = format_ctx->streams[i];
+        Kit_SourceCacheStream *cached = &entry->streams[i];
+        if((cached->codecpar = avcodec_parameters_alloc()) == NULL)
+            goto error;
+        if(avcodec_parameters_copy(cached->codecpar, stream->codecpar) < 0)
+            goto error;
+        cached->time_base = stream->time_base;
+        cached->avg_frame_rate = stream->avg_frame_rate;
+        cached->r_frame_rate = stream->r_frame_rate;
+        cached->start_time = stream->start_time;
+        cached->duration = stream->duration;
+    }
+    return entry;
+
+error:
+    Kit_FreeSourceCacheEntry(&entry);
+    return NULL;
+}
+
+/**
+ * Checks that the streams found from the headers are the ones the entry was made from. Headers that don't know
+ * the codec yet are fine; that is what the analysis would have found out.
+ */
+static bool Kit_MatchSourceCacheEntry(const Kit_SourceCacheEntry *entry, const AVFormatContext *format_ctx) {
+    if(entry->nb_streams != format_ctx->nb_streams)
+        return false;
+    for(unsigned int i = 0; i < entry->nb_streams; i++) {
+        const AVStream *stream = format_ctx->streams[i];
+        const Kit_SourceCacheStream *cached = &entry->streams[i];
+        if(stream->codecpar->codec_type != cached->codecpar->codec_type)
+            return false;
+        if(stream->codecpar->codec_id != AV_CODEC_ID_NONE && stream->codecpar->codec_id != cached->codecpar->codec_id)
+            return false;
+        if(av_cmp_q(stream->time_base, cached->time_base) != 0)
+            return false;
+    }
+    return true;
+}
+
+static int Kit_FindSourceCacheEntry(const Kit_SourceCache *cache, const char *key) {
+    for(int i = 0; i < cache->max_entries; i++) {
+        if(cache->entries[i] != NULL && strcmp(cache->entries[i]->key, key) == 0)
+            return i;
+    }
+    return -1;
+}
+
+Kit_SourceCache *Kit_CreateSourceCache(int max_entries) {
+    Kit_SourceCache *cache;
+    if(max_entries < 1) {
+        Kit_SetError("Source cache must have room for at least one entry");
+        goto exit_0;
+    }
+    if((cache = Kit_Calloc(1, sizeof(Kit_SourceCache))) == NULL) {
+        Kit_SetError("Unable to allocate source cache");
+        goto exit_0;
+    }
+    if((cache->entries = Kit_Calloc(max_entries, sizeof(Kit_SourceCacheEntry *))) == NULL) {
+        Kit_SetError("Unable to allocate source cache entries");
+        goto exit_1;
+    }
+    if((cache->mutex = KIT_FAULT_WRAP_PTR("sdl_mutex", SDL_CreateMutex())) == NULL) {
+        Kit_SetError("Unable to allocate source cache mutex: %s", SDL_GetError());
+        goto exit_2;
+    }
+    cache->max_entries = max_entries;
+    return cache;
+
+exit_2:
+    free(cache->entries);
+exit_1:
+    free(cache);
+exit_0:
+    return NULL;
+}
+
+void Kit_CloseSourceCache(Kit_SourceCache *cache) {
+    if(cache == NULL)
+        return;
+    for(int i = 0; i < cache->max_entries; i++)
+        Kit_FreeSourceCacheEntry(&cache->entries[i]);
+    SDL_DestroyMutex(cache->mutex);
+    free(cache->entries);
+    free(cache);
+}
+
+void Kit_ClearSourceCache(Kit_SourceCache *cache) {
+    assert(cache != NULL);
+    SDL_LockMutex(cache->mutex);
+    for(int i = 0; i < cache->max_entries; i++)
+        Kit_FreeSourceCacheEntry(&cache->entries[i]);
+    SDL_UnlockMutex(cache->mutex);
+}
+
+void Kit_GetSourceCacheStats(Kit_SourceCache *cache, Kit_SourceCacheStats *stats) {
+    assert(cache != NULL);
+    assert(stats != NULL);
+    SDL_LockMutex(cache->mutex);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->entries = 0;
+    for(int i = 0; i < cache->max_entries; i++) {
+        if(cache->entries[i] != NULL)
+            stats->entries++;
+    }
+    SDL_UnlockMutex(cache->mutex);
+}
+
+bool Kit_LoadSourceCache(Kit_SourceCache *cache, const char *key, AVFormatContext *format_ctx) {
+    bool found = false;
+    SDL_LockMutex(cache->mutex);
+    const int index = Kit_FindSourceCacheEntry(cache, key);
+    if(index < 0 || !Kit_MatchSourceCacheEntry(cache->entries[index], format_ctx)) {
+        cache->misses++;
+        goto exit;
+    }
+
+    Kit_SourceCacheEntry *entry = cache->entries[index];
+    for(unsigned int i = 0; i < entry->nb_streams; i++) {
+        AVStream *stream = format_ctx->streams[i];
+        const Kit_SourceCacheStream *cached = &entry->streams[i];
+        if(avcodec_parameters_copy(stream->codecpar, cached->codecpar) < 0) {
+            cache->misses++;
+            goto exit;
+        }
+        stream->avg_frame_rate = cached->avg_frame_rate;
+        stream->r_frame_rate = cached->r_frame_rate;
+        if(stream->start_time == AV_NOPTS_VALUE)
+            stream->start_time = cached->start_time;
+        if(stream->duration == AV_NOPTS_VALUE)
+            stream->duration = cached->duration;
+    }
+    if(format_ctx->start_time == AV_NOPTS_VALUE)
+        format_ctx->start_time = entry->start_time;
+    if(format_ctx->duration == AV_NOPTS_VALUE)
+        format_ctx->duration = entry->duration;
+    if(format_ctx->bit_rate <= 0)
+        format_ctx->bit_rate = entry->bit_rate;
+    entry->last_used = ++cache->use_counter;
+    cache->hits++;
+    found = true;
+
+exit:
+    SDL_UnlockMutex(cache->mutex);
+    return found;
+}
+
+void Kit_StoreSourceCache(Kit_SourceCache *cache, const char *key, const AVFormatContext *format_ctx) {
+    // Copy the parameters before taking the lock; this is the slow part.
+    Kit_SourceCacheEntry *entry = Kit_CreateSourceCacheEntry(key, format_ctx);
+    if(entry == NULL)
+        return;
+
+    SDL_LockMutex(cache->mutex);
+    int index = Kit_FindSourceCacheEntry(cache, key);
+    if(index < 0) {
+        // Take a free slot, or the least recently used one.
+        index = 0;
+        for(int i = 0; i < cache->max_entries; i++) {
+            if(cache->entries[i] == NULL) {
+                index = i;
+                break;
+            }
+            if(cache->entries[i]->last_used < cache->entries[index]->last_used)
+                index = i;
+        }
+    }
+    Kit_FreeSourceCacheEntry(&cache->entries[index]);
+    entry->last_used = ++cache->use_counter;
+    cache->entries[index] = entry;
+    SDL_UnlockMutex(cache->mutex);
+}
@@ -1,6 +1,8 @@
 /**
- * Tests for the top-level library lifecycle in kitchensink.h (Kit_Init/Kit_Quit)
- * and the Kit_ResetPlayerConfig() defaults contract.
+ * Tests for the top-level library lifecycle in kitchensink.h (Kit_Init/Kit_Quit,
+ * Kit_InitWithOptions), the library-wide decoder thread budget, the
+ * Kit_ResetPlayerConfig() and Kit_ResetLibraryOptions() defaults contracts,
+ * and the Kit_SetPlayerConfigLowLatency() preset.
  *
  * @author Tuomas Virtanen
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
@@ -15,6 +17,8 @@
 
 #include "kitchensink3/kitchensink.h"
 
+#define VIDEO_FILE KIT_TEST_DATA_DIR "/video_audio.mp4" // H.264, which has frame threading
+
 /**
  * @brief Kit_Init/Kit_Quit must support repeated init/quit cycles in one process.
  */
@@ -46,24 +50,155 @@ static void test_player_config_defaults(void **state) {
     // Assert
     assert_int_equal(config.thread_count, 0);
     assert_int_equal(config.video.packet_buffer_size, 64);
+    assert_int_equal(config.video.packet_buffer_bytes, 0);
     assert_int_equal(config.video.frame_buffer_size, 3);
     assert_int_equal(config.video.early_threshold, 5);
     assert_int_equal(config.video.late_threshold, 50);
+    assert_int_equal(config.video.thread_count, -1);
+    assert_int_equal(config.video.thread_type, KIT_THREAD_TYPE_AUTO);
+    assert_int_equal(config.video.low_delay, 0);
+    assert_int_equal(config.video.adaptive_skip, 0);
     assert_int_equal(config.audio.packet_buffer_size, 64);
+    assert_int_equal(config.audio.packet_buffer_bytes, 0);
     assert_int_equal(config.audio.frame_buffer_size, 64);
     assert_int_equal(config.audio.early_threshold, 30);
     assert_int_equal(config.audio.late_threshold, 50);
+    assert_int_equal(config.audio.thread_count, -1);
+    assert_int_equal(config.audio.thread_type, KIT_THREAD_TYPE_AUTO);
     assert_int_equal(config.subtitle.packet_buffer_size, 64);
+    assert_int_equal(config.subtitle.packet_buffer_bytes, 0);
     assert_int_equal(config.subtitle.frame_buffer_size, 64);
     assert_int_equal(config.subtitle.font_hinting, KIT_FONT_HINTING_NONE);
     assert_int_equal(config.demuxer.read_attempts, 3);
     assert_int_equal(config.demuxer.read_retry_delay, 10);
+    assert_int_equal(config.demuxer.packet_batch_size, 1);
+    assert_int_equal(config.demuxer.overflow_size, 32);
+}
+
+/**
+ * @brief Kit_ResetLibraryOptions() must fill in the documented default values.
+ */
+static void test_library_options_defaults(void **state) {
+    (void)state;
+    // Arrange: poison the struct so untouched fields would be caught.
+    Kit_LibraryOptions options;
+    memset(&options, 0xFF, sizeof(options));
+
+    // Act
+    Kit_ResetLibraryOptions(&options);
+
+    // Assert
+    assert_int_equal(options.decoder_threads, 0);
+}
+
+/**
+ * @brief Kit_InitWithOptions() must reject a negative thread limit without initializing anything, and accept
+ * valid options and NULL.
+ */
+static void test_init_with_options(void **state) {
+    (void)state;
+    // Arrange
+    Kit_LibraryOptions options;
+    Kit_ResetLibraryOptions(&options);
+    options.decoder_threads = -1;
+
+    // Act / Assert
+    assert_int_equal(Kit_InitWithOptions(0, &options), 1);
+    assert_non_null(Kit_GetError());
+    options.decoder_threads = 4;
+    assert_int_equal(Kit_InitWithOptions(0, &options), 0);
+    Kit_Quit();
+    assert_int_equal(Kit_InitWithOptions(0, NULL), 0);
+    Kit_Quit();
+}
+
+/** @brief Creates a video only player, and returns the thread count of its video codec. */
+static Kit_Player *open_video_player(Kit_Source *src, const Kit_PlayerConfig *config, unsigned int *threads) {
+    Kit_PlayerInfo info;
+    Kit_Player *player =
+        Kit_CreatePlayer(src, Kit_GetBestSourceStream(src, KIT_STREAMTYPE_VIDEO), -1, -1, NULL, NULL, 0, 0, config);
+    assert_non_null(player);
+    Kit_GetPlayerInfo(player, &info);
+    *threads = info.video_codec.threads;
+    return player;
+}
+
+/**
+ * @brief With a decoder thread limit, decoders get what is left of the budget (or run single threaded once
+ * fewer than two are left), and closed decoders give their threads back.
+ */
+static void test_decoder_thread_budget(void **state) {
+    (void)state;
+    // Arrange
+    Kit_LibraryOptions options;
+    Kit_PlayerConfig config;
+    Kit_Player *players[4] = {NULL};
+    unsigned int threads[4];
+    Kit_ResetLibraryOptions(&options);
+    options.decoder_threads = 5;
+    assert_int_equal(Kit_InitWithOptions(0, &options), 0);
+    Kit_ResetPlayerConfig(&config);
+    config.thread_count = 3;
+    Kit_Source *src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(src);
+
+    // Act
+    players[0] = open_video_player(src, &config, &threads[0]);
+    players[1] = open_video_player(src, &config, &threads[1]);
+    players[2] = open_video_player(src, &config, &threads[2]);
+    Kit_ClosePlayer(players[0]);
+    players[3] = open_video_player(src, &config, &threads[3]);
+
+    // Assert
+    assert_int_equal(threads[0], 3);
+    assert_int_equal(threads[1], 2); // Only two left
+    assert_int_equal(threads[2], 1); // None left
+    assert_int_equal(threads[3], 3); // The first player gave its threads back
+
+    for(int i = 1; i < 4; i++)
+        Kit_ClosePlayer(players[i]);
+    Kit_CloseSource(src);
+    Kit_Quit();
+}
+
+/**
+ * @brief Kit_SetPlayerConfigLowLatency() must set the documented low latency values, keep the audio buffers at a
+ * size that can't stall seeks, and leave the other fields alone.
+ */
+static void test_player_config_low_latency(void **state) {
+    (void)state;
+    // Arrange
+    Kit_PlayerConfig config;
+    Kit_ResetPlayerConfig(&config);
+    config.thread_count = 2;
+    config.demuxer.packet_batch_size = 8;
+
+    // Act
+    Kit_SetPlayerConfigLowLatency(&config);
+
+    // Assert
+    assert_int_equal(config.video.frame_buffer_size, 1);
+    assert_true(config.video.packet_buffer_size < 64);
+    assert_int_equal(config.video.thread_type, KIT_THREAD_TYPE_SLICE);
+    assert_int_equal(config.video.low_delay, 1);
+    assert_true(config.video.early_threshold < 5);
+    assert_true(config.video.late_threshold < 50);
+    assert_true(config.audio.packet_buffer_size >= 24);
+    assert_true(config.audio.frame_buffer_size >= 24);
+    assert_int_equal(config.demuxer.packet_batch_size, 1);
+    assert_true(config.buffer_spin_time > 0);
+    assert_int_equal(config.thread_count, 2);
+    assert_int_equal(config.subtitle.packet_buffer_size, 64);
 }
 
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_init_quit_cycle),
         cmocka_unit_test(test_player_config_defaults),
+        cmocka_unit_test(test_player_config_low_latency),
+        cmocka_unit_test(test_library_options_defaults),
+        cmocka_unit_test(test_init_with_options),
+        cmocka_unit_test(test_decoder_thread_budget),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -18,6 +18,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_timer.h>
+
 #include "kit_assert.h"
 #include "kit_lifecycle.h"
 #include "kit_memsource.h"
@@ -28,6 +31,8 @@
 #define MANY_SUBS_FILE KIT_TEST_DATA_DIR "/many_subs.mkv"
 #define AUDIO_FIRST_FILE KIT_TEST_DATA_DIR "/audio_first.mkv"
 #define NO_DURATION_FILE KIT_TEST_DATA_DIR "/no_duration.h264"
+#define AUDIO_ONLY_FILE KIT_TEST_DATA_DIR "/audio_only.m4a"
+#define INDEX_SIDECAR "test_source_index.kitidx" // written to the working directory, removed by the test
 
 /** @brief Per-test resources, heap-allocated by test_setup() and released by test_teardown(),
  * so a mid-test assert failure cannot leak them or cascade into the remaining tests in the
@@ -38,6 +43,7 @@ typedef struct {
     SDL_IOStream *io;
     unsigned char *data;
     MemFile mem;
+    Kit_SourceCache *cache;
 } TestState;
 
 /** @brief Per-test setup: heap-allocates the zeroed TestState that test_teardown() always receives. */
@@ -46,9 +52,9 @@ static int test_setup(void **state) {
     return *state == NULL ? -1 : 0;
 }
 
-/** @brief Per-test teardown: releases whatever the TestState still holds (source, IOStream, file
- * buffer), then the state itself. Tests NULL each member right after their own close, so only
- * what an assert-longjmp left behind is released here. The IOStream is never owned by the source
+/** @brief Per-test teardown: releases whatever the TestState still holds (source, source cache,
+ * IOStream, file buffer), then the state itself. Tests NULL each member right after their own close,
+ * so only what an assert-longjmp left behind is released here. The IOStream is never owned by the source
  * (Kit_CreateSourceFromIO only stores it as callback userdata), so closing it after the source
  * is always safe. */
 static int test_teardown(void **state) {
@@ -56,6 +62,7 @@ static int test_teardown(void **state) {
     if(ts == NULL)
         return 0;
     Kit_CloseSource(ts->src);
+    Kit_CloseSourceCache(ts->cache);
     if(ts->io != NULL)
         SDL_CloseIO(ts->io);
     free(ts->data);
@@ -239,6 +246,303 @@ static void test_source_from_custom(void **state) {
     ts->data = NULL;
 }
 
+/**
+ * @brief With read-ahead enabled, custom and URL sources open through the read-ahead thread and report the same
+ * streams and duration as without.
+ */
+static void test_source_read_ahead(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    int64_t size = 0;
+    assert_int_equal(load_file(VIDEO_AUDIO_FILE, &ts->data, &size), 0);
+    ts->mem = (MemFile){.data = ts->data, .size = size, .pos = 0};
+    Kit_SourceOptions options;
+    Kit_ResetSourceOptions(&options);
+    options.read_ahead = 1; // Rounded up to the minimum window
+
+    // Act / Assert: custom source
+    ts->src = Kit_CreateSourceFromCustomWithOptions(mem_read, mem_seek, &ts->mem, &options);
+    assert_non_null(ts->src);
+    assert_non_null(ts->src->read_ahead);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+
+    // Act / Assert: URL source
+    ts->src = Kit_CreateSourceFromUrlWithOptions(VIDEO_AUDIO_FILE, &options);
+    assert_non_null(ts->src);
+    assert_non_null(ts->src->read_ahead);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+    free(ts->data);
+    ts->data = NULL;
+}
+
+/**
+ * @brief Custom sources open with a tiny (clamped) AVIO buffer and with direct reads, as well as with a large one.
+ */
+static void test_source_io_options(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    int64_t size = 0;
+    assert_int_equal(load_file(VIDEO_AUDIO_FILE, &ts->data, &size), 0);
+    const int buffer_sizes[] = {1, 1024 * 1024};
+    Kit_SourceOptions options;
+    Kit_ResetSourceOptions(&options);
+
+    for(int i = 0; i < 2; i++) {
+        for(int direct = 0; direct <= 1; direct++) {
+            // Act
+            options.io_buffer_size = buffer_sizes[i];
+            options.io_direct = direct;
+            ts->mem = (MemFile){.data = ts->data, .size = size, .pos = 0};
+            ts->src = Kit_CreateSourceFromCustomWithOptions(mem_read, mem_seek, &ts->mem, &options);
+
+            // Assert
+            assert_non_null(ts->src);
+            assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+            assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+            Kit_CloseSource(ts->src);
+            ts->src = NULL;
+        }
+    }
+    free(ts->data);
+    ts->data = NULL;
+}
+
+/**
+ * @brief The fast open preset and a tight probe budget still find both streams and the duration of a file with
+ * complete headers.
+ */
+static void test_source_fast_open(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_SourceOptions options;
+    Kit_ResetSourceOptions(&options);
+    Kit_SetSourceOptionsFastOpen(&options);
+
+    // Act / Assert: headers trusted
+    ts->src = Kit_CreateSourceFromUrlWithOptions(VIDEO_AUDIO_FILE, &options);
+    assert_non_null(ts->src);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+    assert_true(Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO) >= 0);
+    assert_true(Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO) >= 0);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+
+    // Act / Assert: analysis with a small budget
+    options.trust_headers = 0;
+    options.probe_size = 32768;
+    options.probe_duration = 100;
+    ts->src = Kit_CreateSourceFromUrlWithOptions(VIDEO_AUDIO_FILE, &options);
+    assert_non_null(ts->src);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/**
+ * @brief A second open of the same file or cache key is served from the stream information cache, and reports the
+ * same streams and duration as the analyzed open. Custom sources without a key are not cached.
+ */
+static void test_source_cache(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_SourceCacheStats stats;
+    Kit_SourceOptions options;
+    Kit_ResetSourceOptions(&options);
+    assert_null(Kit_CreateSourceCache(0));
+    ts->cache = options.cache = Kit_CreateSourceCache(4);
+    assert_non_null(ts->cache);
+    int64_t size = 0;
+    assert_int_equal(load_file(VIDEO_AUDIO_FILE, &ts->data, &size), 0);
+
+    // Act / Assert: cold and warm open by file path
+    ts->src = Kit_CreateSourceFromUrlWithOptions(VIDEO_AUDIO_FILE, &options);
+    assert_non_null(ts->src);
+    const double duration = Kit_GetSourceDuration(ts->src);
+    Kit_CloseSource(ts->src);
+    ts->src = Kit_CreateSourceFromUrlWithOptions(VIDEO_AUDIO_FILE, &options);
+    assert_non_null(ts->src);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_double_in_range(Kit_GetSourceDuration(ts->src), duration - 0.001, duration + 0.001);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+    Kit_GetSourceCacheStats(options.cache, &stats);
+    assert_int_equal(stats.misses, 1);
+    assert_int_equal(stats.hits, 1);
+    assert_int_equal(stats.entries, 1);
+
+    // Act / Assert: custom source, first without a key, then with one
+    ts->mem = (MemFile){.data = ts->data, .size = size, .pos = 0};
+    ts->src = Kit_CreateSourceFromCustomWithOptions(mem_read, mem_seek, &ts->mem, &options);
+    assert_non_null(ts->src);
+    Kit_CloseSource(ts->src);
+    options.cache_key = "video_audio";
+    for(int i = 0; i < 2; i++) {
+        ts->mem = (MemFile){.data = ts->data, .size = size, .pos = 0};
+        ts->src = Kit_CreateSourceFromCustomWithOptions(mem_read, mem_seek, &ts->mem, &options);
+        assert_non_null(ts->src);
+        assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+        Kit_CloseSource(ts->src);
+    }
+    ts->src = NULL;
+    Kit_GetSourceCacheStats(options.cache, &stats);
+    assert_int_equal(stats.misses, 2);
+    assert_int_equal(stats.hits, 2);
+    assert_int_equal(stats.entries, 2);
+
+    // Act / Assert: clearing drops the entries
+    Kit_ClearSourceCache(options.cache);
+    Kit_GetSourceCacheStats(options.cache, &stats);
+    assert_int_equal(stats.entries, 0);
+
+    Kit_CloseSourceCache(ts->cache);
+    ts->cache = NULL;
+    free(ts->data);
+    ts->data = NULL;
+}
+
+/**
+ * @brief Kit_CreateSourceFromFile() opens the fixture both mapped and through SDL I/O, and fails cleanly for a
+ * missing file and for an empty one (which can't be mapped, and has no streams).
+ */
+static void test_source_from_file(void **state) {
+    TestState *ts = *state;
+    const unsigned int flags[] = {0, KIT_SOURCE_FILE_NO_ADVISE, KIT_SOURCE_FILE_NO_MMAP};
+
+    for(size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        // Act
+        ts->src = Kit_CreateSourceFromFile(VIDEO_AUDIO_FILE, flags[i]);
+
+        // Assert
+        assert_non_null(ts->src);
+        assert_non_null(ts->src->file);
+        assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+        assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+        Kit_CloseSource(ts->src);
+        ts->src = NULL;
+    }
+
+    // Act / Assert: failures
+    Kit_ClearError();
+    assert_null(Kit_CreateSourceFromFile("/nonexistent/no_such_file.mp4", 0));
+    assert_non_null(Kit_GetError());
+    Kit_ClearError();
+    assert_null(Kit_CreateSourceFromFile(KIT_TEST_DATA_DIR "/empty.mp4", 0));
+    assert_non_null(Kit_GetError());
+}
+
+/** @brief Polls the source's keyframe index until it is complete, for at most 5 seconds. */
+static void wait_index(const Kit_Source *src, Kit_SourceIndexStats *stats) {
+    for(int i = 0; i < 500; i++) {
+        assert_int_equal(Kit_GetSourceIndexStats(src, stats), 0);
+        if(stats->complete)
+            return;
+        SDL_Delay(10);
+    }
+    fail_msg("keyframe index did not complete");
+}
+
+/**
+ * @brief With build_index, a raw H.264 stream gets its keyframes indexed in the background. The finished index is
+ * saved to the sidecar, and a second open loads it from there. Sources without video get no index.
+ */
+static void test_source_index(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_SourceOptions options;
+    Kit_ResetSourceOptions(&options);
+    options.build_index = 1;
+    options.index_path = INDEX_SIDECAR;
+    Kit_SourceIndexStats stats;
+    SDL_RemovePath(INDEX_SIDECAR);
+
+    // Act / Assert: first open scans the file
+    ts->src = Kit_CreateSourceFromUrlWithOptions(NO_DURATION_FILE, &options);
+    assert_non_null(ts->src);
+    wait_index(ts->src, &stats);
+    const unsigned int entries = stats.entries;
+    assert_true(entries > 0);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+
+    // Act / Assert: second open loads the sidecar, and is complete right away
+    ts->src = Kit_CreateSourceFromFileWithOptions(NO_DURATION_FILE, 0, &options);
+    assert_non_null(ts->src);
+    assert_int_equal(Kit_GetSourceIndexStats(ts->src, &stats), 0);
+    assert_int_equal(stats.complete, 1);
+    assert_int_equal(stats.entries, entries);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+    SDL_RemovePath(INDEX_SIDECAR);
+
+    // Act / Assert: no video, no index; the source still opens
+    ts->src = Kit_CreateSourceFromUrlWithOptions(AUDIO_ONLY_FILE, &options);
+    assert_non_null(ts->src);
+    Kit_ClearError();
+    assert_int_equal(Kit_GetSourceIndexStats(ts->src, &stats), 1);
+    assert_non_null(Kit_GetError());
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+static int freed_count = 0;
+
+/** @brief Kit_FreeCallback that counts its calls. */
+static void count_free(void *data) {
+    free(data);
+    freed_count++;
+}
+
+/**
+ * @brief Kit_CreateSourceFromMemory() opens the fixture from memory both with and without handing it over, calls
+ * the free callback exactly once on close, and also calls it when opening fails.
+ */
+static void test_source_from_memory(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    int64_t size = 0;
+    assert_int_equal(load_file(VIDEO_AUDIO_FILE, &ts->data, &size), 0);
+    freed_count = 0;
+
+    // Act / Assert: memory stays with the caller
+    ts->src = Kit_CreateSourceFromMemory(ts->data, (size_t)size, NULL);
+    assert_non_null(ts->src);
+    assert_non_null(ts->src->file);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_double_in_range(Kit_GetSourceDuration(ts->src), 1.5, 2.5);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+
+    // Act / Assert: memory is handed over, and released on close
+    unsigned char *data = ts->data;
+    ts->data = NULL;
+    ts->src = Kit_CreateSourceFromMemory(data, (size_t)size, count_free);
+    assert_non_null(ts->src);
+    assert_int_equal(Kit_GetSourceStreamCount(ts->src), 2);
+    assert_int_equal(freed_count, 0);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+    assert_int_equal(freed_count, 1);
+
+    // Act / Assert: failures; the memory is released even then
+    Kit_ClearError();
+    assert_null(Kit_CreateSourceFromMemory(NULL, 0, count_free));
+    assert_non_null(Kit_GetError());
+    assert_int_equal(freed_count, 1);
+    data = calloc(1, 64);
+    assert_non_null(data);
+    Kit_ClearError();
+    assert_null(Kit_CreateSourceFromMemory(data, 64, count_free));
+    assert_non_null(Kit_GetError());
+    assert_int_equal(freed_count, 2);
+}
+
 /**
  * @brief Kit_GetSourceStreamInfo() rejects out-of-range indices (past-the-end and negative)
  * with the documented error return and a Kit_GetError() message, never an out-of-bounds read.
@@ -299,6 +603,13 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_next_stream_iteration, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_source_from_io, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_source_from_custom, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_read_ahead, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_io_options, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_fast_open, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_cache, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_from_file, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_from_memory, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_source_index, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_stream_info_invalid_index, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_audio_first_stream_order, test_setup, test_teardown),
     };
@@ -0,0 +1,251 @@
+/**
+ * Benchmark for the decoder threading modes (Kit_PlayerVideoConfig thread_count
+ * and thread_type): decodes the video stream of each fixture single threaded,
+ * with frame threads, with slice threads and with the low latency config
+ * (Kit_SetPlayerConfigLowLatency()), and reports
+ *
+ * - first frame: the time and the number of packets fed from the first packet
+ *   to the first decoded frame. Frame threads hold back frames until every
+ *   thread has one, which shows up here.
+ * - throughput: decoded frames per second over the whole stream.
+ *
+ * The decoder is driven directly, without a decoder thread, so that the times
+ * are not mixed up with thread wakeups. Each mode runs a few times and the
+ * best is reported.
+ *
+ * The results are printed, not asserted on; the test only checks that every
+ * run decodes the same number of frames.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+#include <libavcodec/avcodec.h>
+
+#include "kit_lifecycle.h"
+
+#include "kitchensink3/internal/kitdecoder.h"
+#include "kitchensink3/internal/kitdemuxer.h"
+#include "kitchensink3/internal/video/kitvideo.h"
+#include "kitchensink3/kitchensink.h"
+
+#define THREADS 4     // threads for the threaded modes
+#define REPEATS 3     // runs per mode; the best is reported
+#define MAX_RUNS 1000 // demuxer runs to wait for a video packet before giving up
+
+static const char *const files[] = {
+    KIT_TEST_DATA_DIR "/video_vp9.webm",
+    KIT_TEST_DATA_DIR "/video_audio.mp4",
+};
+
+typedef struct {
+    const char *name;
+    int thread_count;
+    Kit_ThreadType thread_type;
+    bool low_latency; ///< Start from Kit_SetPlayerConfigLowLatency() instead of the default config
+} Mode;
+
+static const Mode modes[] = {
+    {"single", 1, KIT_THREAD_TYPE_AUTO, false},
+    {"frame", THREADS, KIT_THREAD_TYPE_FRAME, false},
+    {"slice", THREADS, KIT_THREAD_TYPE_SLICE, false},
+    {"low latency", THREADS, KIT_THREAD_TYPE_SLICE, true},
+};
+
+/** @brief Measurements of a single decode run. */
+typedef struct {
+    double first_ms;      ///< Time from the first packet to the first frame
+    int first_packets;    ///< Packets fed before the first frame came out
+    double fps;           ///< Decoded frames per second
+    int frames;           ///< Decoded frames
+    unsigned int threads; ///< Threads the codec actually runs
+} Result;
+
+/** @brief Default player config for direct decoder construction; filled in group setup. */
+static Kit_PlayerConfig g_config;
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_Source *src;
+    Kit_Timer *timer;
+    Kit_Demuxer *demuxer;
+    Kit_Decoder *decoder;
+    AVPacket *pkt;
+    AVFrame *frame;
+} TestState;
+
+static int test_setup(void **state) {
+    TestState *ts = calloc(1, sizeof(TestState));
+    if(ts == NULL)
+        return -1;
+    ts->pkt = av_packet_alloc();
+    ts->frame = av_frame_alloc();
+    *state = ts;
+    return ts->pkt == NULL || ts->frame == NULL ? -1 : 0;
+}
+
+static void close_file(TestState *ts) {
+    Kit_CloseDecoder(&ts->decoder);
+    Kit_CloseDemuxer(&ts->demuxer);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    close_file(ts);
+    av_frame_free(&ts->frame);
+    av_packet_free(&ts->pkt);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+static int group_setup(void **state) {
+    Kit_ResetPlayerConfig(&g_config);
+    g_config.demuxer.packet_batch_size = 1;
+    return kit_lifecycle_setup(state);
+}
+
+/** @brief Opens the file for video only demuxing, and a video decoder configured as the mode says. */
+static void open_file(TestState *ts, const char *path, const Mode *mode) {
+    Kit_VideoFormatRequest request;
+    Kit_PlayerConfig config = g_config;
+    if(mode->low_latency)
+        Kit_SetPlayerConfigLowLatency(&config);
+    config.video.thread_count = mode->thread_count;
+    config.video.thread_type = mode->thread_type;
+    Kit_ResetVideoFormatRequest(&request);
+    ts->src = Kit_CreateSourceFromUrl(path);
+    assert_non_null(ts->src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    ts->timer = Kit_CreateTimer();
+    assert_non_null(ts->timer);
+    ts->demuxer = Kit_CreateDemuxer(ts->src, video_index, -1, -1, &config, ts->timer);
+    assert_non_null(ts->demuxer);
+    Kit_Timer *timer = Kit_CreateTimer();
+    assert_non_null(timer);
+    // Kit_CreateVideoDecoder() takes ownership of the timer even on failure.
+    ts->decoder = Kit_CreateVideoDecoder(ts->src, &request, &config.video, config.thread_count, timer, video_index);
+    assert_non_null(ts->decoder);
+}
+
+/** @brief Takes all frames the codec has ready, and drops them. Returns the number of frames. */
+static int drain_frames(TestState *ts) {
+    Kit_PacketBuffer *output = Kit_GetDecoderOutputBuffer(ts->decoder);
+    double pts;
+    int frames = 0;
+    while(Kit_RunDecoder(ts->decoder, &pts)) {
+        assert_true(Kit_ReadPacketBuffer(output, ts->frame, 0));
+        av_frame_unref(ts->frame);
+        frames++;
+    }
+    return frames;
+}
+
+/**
+ * @brief Runs the demuxer until a video packet is queued, and feeds it to the decoder, taking out frames while the
+ * decoder is full. Returns false on EOF.
+ */
+static bool feed_packet(TestState *ts, int *frames) {
+    Kit_PacketBuffer *input = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_VIDEO_INDEX);
+    for(int i = 0; i < MAX_RUNS && Kit_GetPacketBufferLength(input) == 0; i++) {
+        if(!Kit_RunDemuxer(ts->demuxer))
+            return false;
+    }
+    if(!Kit_ReadPacketBuffer(input, ts->pkt, 0))
+        return false;
+    while(Kit_AddDecoderPacket(ts->decoder, ts->pkt) == KIT_DEC_INPUT_RETRY)
+        *frames += drain_frames(ts);
+    av_packet_unref(ts->pkt);
+    return true;
+}
+
+/** @brief Decodes the whole video stream of the file. */
+static void time_decode(TestState *ts, const char *path, const Mode *mode, Result *result) {
+    Kit_Codec codec;
+    int packets = 0, frames = 0;
+    open_file(ts, path, mode);
+    result->first_packets = 0;
+
+    const Uint64 start = SDL_GetTicksNS();
+    while(feed_packet(ts, &frames)) {
+        packets++;
+        frames += drain_frames(ts);
+        if(frames > 0 && result->first_packets == 0) {
+            result->first_ms = (double)(SDL_GetTicksNS() - start) / 1000000.0;
+            result->first_packets = packets;
+        }
+    }
+    Kit_AddDecoderPacket(ts->decoder, NULL); // Flush out the frames the threads still hold
+    frames += drain_frames(ts);
+    const Uint64 elapsed = SDL_GetTicksNS() - start;
+
+    assert_true(result->first_packets > 0);
+    result->frames = frames;
+    result->fps = (double)frames * 1000000000.0 / (double)SDL_max(elapsed, 1);
+    assert_int_equal(Kit_GetDecoderCodecInfo(ts->decoder, &codec), 0);
+    result->threads = codec.threads;
+    close_file(ts);
+}
+
+/**
+ * @brief First frame latency and throughput for each fixture and threading mode.
+ */
+static void test_decode_threads(void **state) {
+    TestState *ts = *state;
+    printf("video decode, best of %d runs each:\n", REPEATS);
+    printf("  %-18s %-11s %7s %11s %8s %9s\n", "fixture", "mode", "threads", "first frame", "packets", "fps");
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        int frames = -1;
+        for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            // Act
+            Result best, result;
+            for(int r = 0; r < REPEATS; r++) {
+                time_decode(ts, files[i], &modes[m], &result);
+                if(r == 0 || result.first_ms < best.first_ms)
+                    best.first_ms = result.first_ms;
+                if(r == 0 || result.fps > best.fps)
+                    best.fps = result.fps;
+                best.first_packets = result.first_packets;
+                best.threads = result.threads;
+
+                // Assert: every mode must decode the whole stream
+                if(frames < 0)
+                    frames = result.frames;
+                assert_int_equal(result.frames, frames);
+            }
+            printf(
+                "  %-18s %-11s %7u %8.2f ms %8d %9.1f\n",
+                SDL_strrchr(files[i], '/') + 1,
+                modes[m].name,
+                best.threads,
+                best.first_ms,
+                best.first_packets,
+                best.fps
+            );
+        }
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_decode_threads, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, group_setup, kit_lifecycle_teardown);
+}
@@ -0,0 +1,156 @@
+/**
+ * Benchmark for the keyframe index (Kit_SourceOptions build_index): measures
+ * the time from a demuxer seek to the first video packet after it, on media
+ * without a seek index of its own (raw H.264 and MPEG-TS), with and without
+ * the keyframe index. Each seek target is repeated a few times and the best
+ * time is reported, to keep disk cache warm-up out of the way.
+ *
+ * The results are printed, not asserted on; the test only checks that every
+ * seek succeeds and is followed by video.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+#include <libavutil/avutil.h>
+
+#include "kit_lifecycle.h"
+
+#include "kitchensink3/internal/kitdemuxer.h"
+#include "kitchensink3/kitchensink.h"
+
+#define REPEATS 5     // seeks per target; the best is reported
+#define MAX_RUNS 1000 // demuxer runs to wait for video after a seek before giving up
+
+static const char *const files[] = {
+    KIT_TEST_DATA_DIR "/no_duration.h264",
+    KIT_TEST_DATA_DIR "/video_mpeg2.ts",
+};
+static const double targets[] = {1.5, 0.5, 1.0, 0.2}; // seconds; the fixtures are about 2 s long
+
+/** @brief Default player config for direct Kit_CreateDemuxer() construction; filled in group setup. */
+static Kit_PlayerConfig g_config;
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_Source *src;
+    Kit_Timer *timer;
+    Kit_Demuxer *demuxer;
+} TestState;
+
+static int test_setup(void **state) {
+    *state = calloc(1, sizeof(TestState));
+    return *state == NULL ? -1 : 0;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    Kit_CloseDemuxer(&ts->demuxer);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+static int group_setup(void **state) {
+    Kit_ResetPlayerConfig(&g_config);
+    g_config.demuxer.packet_batch_size = 1;
+    return kit_lifecycle_setup(state);
+}
+
+/** @brief Opens the file for video only demuxing, and waits for its keyframe index if one is built. */
+static void open_file(TestState *ts, const char *path, bool build_index) {
+    Kit_SourceOptions options;
+    Kit_SourceIndexStats stats;
+    Kit_ResetSourceOptions(&options);
+    options.build_index = build_index ? 1 : 0;
+    ts->src = Kit_CreateSourceFromUrlWithOptions(path, &options);
+    assert_non_null(ts->src);
+    for(int i = 0; build_index && i < 500; i++) {
+        assert_int_equal(Kit_GetSourceIndexStats(ts->src, &stats), 0);
+        if(stats.complete)
+            break;
+        SDL_Delay(10);
+    }
+    ts->timer = Kit_CreateTimer();
+    assert_non_null(ts->timer);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    ts->demuxer = Kit_CreateDemuxer(ts->src, video_index, -1, -1, &g_config, ts->timer);
+    assert_non_null(ts->demuxer);
+}
+
+static void close_file(TestState *ts) {
+    Kit_CloseDemuxer(&ts->demuxer);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/**
+ * @brief Seeks to each target REPEATS times, and runs the demuxer until a video packet follows the seek packet.
+ * Returns the sum of the best times per target in milliseconds.
+ */
+static double time_seeks(TestState *ts) {
+    Kit_PacketBuffer *buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_VIDEO_INDEX);
+    double total = 0.0;
+    for(size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        Uint64 best = 0;
+        for(int i = 0; i < REPEATS; i++) {
+            const Uint64 start = SDL_GetTicksNS();
+            assert_true(Kit_DemuxerSeek(ts->demuxer, (int64_t)(targets[t] * AV_TIME_BASE)));
+            int runs = 0;
+            while(Kit_GetPacketBufferLength(buffer) < 2 && runs < MAX_RUNS && Kit_RunDemuxer(ts->demuxer))
+                runs++;
+            const Uint64 elapsed = SDL_GetTicksNS() - start;
+            assert_true(Kit_GetPacketBufferLength(buffer) >= 2); // seek packet, then video
+            Kit_ClearDemuxerBuffers(ts->demuxer);
+            if(i == 0 || elapsed < best)
+                best = elapsed;
+        }
+        total += (double)best / 1000000.0;
+    }
+    return total;
+}
+
+/**
+ * @brief Seek time for each fixture, with and without the keyframe index.
+ */
+static void test_seek_time(void **state) {
+    TestState *ts = *state;
+    const int seeks = (int)(sizeof(targets) / sizeof(targets[0]));
+    printf("time to first video packet for %d seeks, best of %d each:\n", seeks, REPEATS);
+    printf("  %-24s %10s %10s\n", "fixture", "no index", "index");
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        // Act
+        open_file(ts, files[i], false);
+        const double plain_ms = time_seeks(ts);
+        close_file(ts);
+        open_file(ts, files[i], true);
+        const double index_ms = time_seeks(ts);
+        close_file(ts);
+
+        // Assert: done by time_seeks(); just report
+        printf("  %-24s %7.2f ms %7.2f ms\n", SDL_strrchr(files[i], '/') + 1, plain_ms, index_ms);
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_seek_time, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, group_setup, kit_lifecycle_teardown);
+}
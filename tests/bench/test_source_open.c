@@ -0,0 +1,129 @@
+/**
+ * Benchmark for source stream analysis (Kit_SourceOptions probe_size,
+ * probe_duration and trust_headers): measures the time to open every fixture
+ * under test-data/media with the default unbounded analysis, and with the
+ * Kit_SetSourceOptionsFastOpen() preset. Each open is repeated a few times
+ * and the best time is reported, to keep disk cache warm-up out of the way.
+ *
+ * The results are printed, not asserted on; the test only checks that the
+ * fast preset opens every fixture the default options do, with the same
+ * number of streams.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#include "kit_lifecycle.h"
+
+#include "kitchensink3/kitchensink.h"
+
+#define REPEATS 5 // opens per fixture and option set; the best is reported
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_Source *src;
+    char **files;
+} TestState;
+
+static int test_setup(void **state) {
+    *state = calloc(1, sizeof(TestState));
+    return *state == NULL ? -1 : 0;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    Kit_CloseSource(ts->src);
+    SDL_free(ts->files);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/**
+ * @brief Opens the file REPEATS times with the given options. Returns the best time in milliseconds, or a
+ * negative value if the file does not open; stream count of the last open goes to streams.
+ */
+static double time_open(TestState *ts, const char *path, const Kit_SourceOptions *options, int *streams) {
+    Uint64 best = 0;
+    for(int i = 0; i < REPEATS; i++) {
+        const Uint64 start = SDL_GetTicksNS();
+        ts->src = Kit_CreateSourceFromUrlWithOptions(path, options);
+        const Uint64 elapsed = SDL_GetTicksNS() - start;
+        if(ts->src == NULL)
+            return -1.0;
+        *streams = Kit_GetSourceStreamCount(ts->src);
+        Kit_CloseSource(ts->src);
+        ts->src = NULL;
+        if(i == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return (double)best / 1000000.0;
+}
+
+/**
+ * @brief Time to open each fixture, with the default options and with the fast open preset.
+ */
+static void test_open_time(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    int count = 0;
+    ts->files = SDL_GlobDirectory(KIT_TEST_DATA_DIR, "*", 0, &count);
+    assert_non_null(ts->files);
+    Kit_SourceOptions defaults;
+    Kit_SourceOptions fast;
+    Kit_ResetSourceOptions(&defaults);
+    Kit_ResetSourceOptions(&fast);
+    Kit_SetSourceOptionsFastOpen(&fast);
+    double total_defaults = 0.0;
+    double total_fast = 0.0;
+    int opened = 0;
+
+    printf("time to open, best of %d:\n", REPEATS);
+    printf("  %-24s %10s %10s\n", "fixture", "default", "fast");
+    for(int i = 0; i < count; i++) {
+        char path[1024];
+        SDL_snprintf(path, sizeof(path), "%s/%s", KIT_TEST_DATA_DIR, ts->files[i]);
+
+        // Act
+        int default_streams = 0;
+        int fast_streams = 0;
+        const double default_ms = time_open(ts, path, &defaults, &default_streams);
+        if(default_ms < 0) {
+            printf("  %-24s %10s\n", ts->files[i], "(invalid)");
+            continue;
+        }
+        const double fast_ms = time_open(ts, path, &fast, &fast_streams);
+
+        // Assert
+        assert_true(fast_ms >= 0);
+        assert_int_equal(fast_streams, default_streams);
+        printf("  %-24s %7.2f ms %7.2f ms\n", ts->files[i], default_ms, fast_ms);
+        total_defaults += default_ms;
+        total_fast += fast_ms;
+        opened++;
+    }
+    assert_true(opened > 0);
+    printf("  %-24s %7.2f ms %7.2f ms\n", "total", total_defaults, total_fast);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_open_time, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, kit_lifecycle_setup, kit_lifecycle_teardown);
+}
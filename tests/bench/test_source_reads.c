@@ -0,0 +1,225 @@
+/**
+ * Benchmark for the source I/O options (Kit_SourceOptions io_buffer_size and
+ * io_direct): counts how many times the read callback gets called to open a
+ * source and demux every packet of a high bitrate fixture, once for each
+ * option set. Runs both over a custom source (Kit_CreateSourceFromCustom-
+ * WithOptions()) and over an SDL_IOStream (Kit_CreateSourceFromIOWithOptions()),
+ * where the reads are counted by a pass-through SDL_IOStream interface.
+ *
+ * The results are printed, not asserted on; the tests only check that every
+ * option set demuxes the same number of packets.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_timer.h>
+#include <libavformat/avformat.h>
+
+#include "kit_lifecycle.h"
+#include "kit_memsource.h"
+
+#include "kitchensink3/kitchensink.h"
+
+#define BENCH_FILE KIT_TEST_DATA_DIR "/video_oddsize.nut" // rawvideo; large packets
+
+typedef struct io_config {
+    const char *name;
+    int buffer_size;
+    int direct;
+} io_config;
+
+static const io_config configs[] = {
+    {"32k buffered", 32768, 0},
+    {"256k buffered", 262144, 0},
+    {"32k direct", 32768, 1},
+    {"256k direct", 262144, 1},
+};
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_Source *src;
+    SDL_IOStream *inner;
+    SDL_IOStream *io;
+    unsigned char *data;
+    int64_t size;
+    MemFile mem;
+    int reads;
+    int64_t bytes;
+} TestState;
+
+static int test_setup(void **state) {
+    TestState *ts = calloc(1, sizeof(TestState));
+    if(ts == NULL)
+        return -1;
+    if(load_file(BENCH_FILE, &ts->data, &ts->size) != 0) {
+        free(ts);
+        return -1;
+    }
+    *state = ts;
+    return 0;
+}
+
+static void release_state(TestState *ts) {
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+    if(ts->io != NULL)
+        SDL_CloseIO(ts->io);
+    ts->io = NULL;
+    if(ts->inner != NULL)
+        SDL_CloseIO(ts->inner);
+    ts->inner = NULL;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    release_state(ts);
+    free(ts->data);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/** @brief mem_read() that also counts the calls. */
+static int counting_mem_read(void *userdata, uint8_t *buf, int size) {
+    TestState *ts = userdata;
+    const int ret = mem_read(&ts->mem, buf, size);
+    ts->reads++;
+    if(ret > 0)
+        ts->bytes += ret;
+    return ret;
+}
+
+static int64_t counting_mem_seek(void *userdata, int64_t offset, int whence) {
+    TestState *ts = userdata;
+    return mem_seek(&ts->mem, offset, whence);
+}
+
+static Sint64 SDLCALL counting_io_size(void *userdata) {
+    TestState *ts = userdata;
+    return SDL_GetIOSize(ts->inner);
+}
+
+static Sint64 SDLCALL counting_io_seek(void *userdata, Sint64 offset, SDL_IOWhence whence) {
+    TestState *ts = userdata;
+    return SDL_SeekIO(ts->inner, offset, whence);
+}
+
+static size_t SDLCALL counting_io_read(void *userdata, void *ptr, size_t size, SDL_IOStatus *status) {
+    TestState *ts = userdata;
+    const size_t ret = SDL_ReadIO(ts->inner, ptr, size);
+    if(ret == 0)
+        *status = SDL_GetIOStatus(ts->inner);
+    ts->reads++;
+    ts->bytes += (int64_t)ret;
+    return ret;
+}
+
+/** @brief Opens an SDL_IOStream over the fixture that counts its reads into ts. */
+static SDL_IOStream *open_counting_io(TestState *ts) {
+    SDL_IOStreamInterface iface;
+    SDL_INIT_INTERFACE(&iface);
+    iface.size = counting_io_size;
+    iface.seek = counting_io_seek;
+    iface.read = counting_io_read;
+    if((ts->inner = SDL_IOFromConstMem(ts->data, (size_t)ts->size)) == NULL)
+        return NULL;
+    return SDL_OpenIO(&iface, ts);
+}
+
+/** @brief Reads every packet from the source, and returns the packet count. */
+static int demux_all(Kit_Source *src) {
+    AVPacket *packet = av_packet_alloc();
+    assert_non_null(packet);
+    int count = 0;
+    while(av_read_frame(src->format_ctx, packet) >= 0) {
+        count++;
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    return count;
+}
+
+/**
+ * @brief Runs every option set over a custom or IOStream source. Prints the reads to open, and in total.
+ */
+static void run_configs(TestState *ts, bool use_io) {
+    int expected_packets = -1;
+    for(size_t n = 0; n < sizeof(configs) / sizeof(configs[0]); n++) {
+        // Arrange
+        Kit_SourceOptions options;
+        Kit_ResetSourceOptions(&options);
+        options.io_buffer_size = configs[n].buffer_size;
+        options.io_direct = configs[n].direct;
+        ts->mem = (MemFile){.data = ts->data, .size = ts->size, .pos = 0};
+        ts->reads = 0;
+        ts->bytes = 0;
+        if(use_io) {
+            ts->io = open_counting_io(ts);
+            assert_non_null(ts->io);
+        }
+
+        // Act
+        const Uint64 start = SDL_GetTicksNS();
+        if(use_io)
+            ts->src = Kit_CreateSourceFromIOWithOptions(ts->io, &options);
+        else
+            ts->src = Kit_CreateSourceFromCustomWithOptions(counting_mem_read, counting_mem_seek, ts, &options);
+        assert_non_null(ts->src);
+        const int open_reads = ts->reads;
+        const int packets = demux_all(ts->src);
+        const Uint64 elapsed = SDL_GetTicksNS() - start;
+
+        // Assert
+        if(expected_packets < 0)
+            expected_packets = packets;
+        assert_true(packets > 0);
+        assert_int_equal(packets, expected_packets);
+        printf(
+            "  %-14s: %6d reads to open, %6d in total, %8.1f KiB/read, %6.2f ms\n",
+            configs[n].name,
+            open_reads,
+            ts->reads,
+            ts->reads > 0 ? (double)ts->bytes / ts->reads / 1024.0 : 0.0,
+            (double)elapsed / 1000000.0
+        );
+        release_state(ts);
+    }
+}
+
+/**
+ * @brief Read callback count of a custom source.
+ */
+static void test_custom_reads(void **state) {
+    printf("custom source, %s:\n", BENCH_FILE);
+    run_configs(*state, false);
+}
+
+/**
+ * @brief Read callback count of an SDL_IOStream source.
+ */
+static void test_io_reads(void **state) {
+    printf("IOStream source, %s:\n", BENCH_FILE);
+    run_configs(*state, true);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_custom_reads, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_io_reads, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, kit_lifecycle_setup, kit_lifecycle_teardown);
+}
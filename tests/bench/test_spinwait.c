@@ -0,0 +1,225 @@
+/**
+ * Benchmark for packet buffer spinning (Kit_SetPacketBufferSpin()): measures the
+ * latency/CPU trade-off of busy-waiting before blocking on a buffer, on the
+ * kind of tiny SPSC buffers a low-latency player uses. Two threads hand items
+ * to each other over capacity-1 buffers, once for each spin time:
+ *
+ * - ping-pong: one item in flight at a time, so every transfer wakes up a
+ *   waiting reader; reports the mean round trip time.
+ * - stream: the writer pushes items as fast as the reader takes them, so the
+ *   writer waits on a full buffer for every item; reports the throughput.
+ *
+ * Both report the process CPU time used. The results are printed, not
+ * asserted on; the tests only check that every item gets through in order.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+#include "kitchensink3/internal/kitpacketbuffer.h"
+
+#define ROUND_TRIPS 2000  // ping-pong round trips per spin time
+#define STREAM_ITEMS 5000 // items streamed per spin time
+#define IO_TIMEOUT_MS 1000
+
+static const int spin_times[] = {0, 10, 50, 200}; // microseconds
+
+typedef struct test_obj {
+    int value;
+} test_obj;
+
+static void *obj_alloc(void) {
+    return calloc(1, sizeof(test_obj));
+}
+
+static void obj_unref(void *obj) {
+    ((test_obj *)obj)->value = 0;
+}
+
+static void obj_free(void **obj) {
+    free(*obj);
+    *obj = NULL;
+}
+
+static void obj_move(void *dst, void *src) {
+    ((test_obj *)dst)->value = ((test_obj *)src)->value;
+    ((test_obj *)src)->value = 0;
+}
+
+static void obj_ref(void *dst, void *src) {
+    ((test_obj *)dst)->value = ((test_obj *)src)->value;
+}
+
+static Kit_PacketBuffer *create_buffer(int spin_us) {
+    Kit_PacketBuffer *buffer =
+        Kit_CreatePacketBuffer(1, obj_alloc, obj_unref, obj_free, obj_move, obj_ref, KIT_PACKET_BUFFER_SPSC);
+    if(buffer != NULL)
+        Kit_SetPacketBufferSpin(buffer, spin_us);
+    return buffer;
+}
+
+typedef struct worker_ctx {
+    Kit_PacketBuffer *in;  ///< Buffer the worker reads from (NULL for the stream writer)
+    Kit_PacketBuffer *out; ///< Buffer the worker writes to
+    int count;
+} worker_ctx;
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_PacketBuffer *ping;
+    Kit_PacketBuffer *pong;
+    SDL_Thread *thread;
+    worker_ctx ctx;
+} TestState;
+
+static int test_setup(void **state) {
+    *state = calloc(1, sizeof(TestState));
+    return *state == NULL ? -1 : 0;
+}
+
+/** @brief Joins the worker (the aborts wake it up if it is parked), and frees the buffers. */
+static void release_state(TestState *ts) {
+    Kit_AbortPacketBuffer(ts->ping);
+    Kit_AbortPacketBuffer(ts->pong);
+    if(ts->thread != NULL) {
+        SDL_WaitThread(ts->thread, NULL);
+        ts->thread = NULL;
+    }
+    Kit_FreePacketBuffer(&ts->ping);
+    Kit_FreePacketBuffer(&ts->pong);
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    release_state(ts);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/** @brief Worker thread body: echoes items from `in` back to `out`, or just writes `count` items if `in` is NULL. */
+static int worker_thread(void *data) {
+    worker_ctx *ctx = data;
+    test_obj obj;
+    for(int i = 1; i <= ctx->count; i++) {
+        obj.value = i;
+        if(ctx->in != NULL && !Kit_ReadPacketBuffer(ctx->in, &obj, IO_TIMEOUT_MS))
+            return i;
+        if(!Kit_WritePacketBuffer(ctx->out, &obj))
+            return i;
+    }
+    return 0;
+}
+
+static double cpu_ms_since(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * @brief Round trip latency of a single item bounced between two threads.
+ */
+static void test_spin_ping_pong(void **state) {
+    TestState *ts = *state;
+    printf("ping-pong, %d round trips:\n", ROUND_TRIPS);
+    for(size_t n = 0; n < sizeof(spin_times) / sizeof(spin_times[0]); n++) {
+        // Arrange
+        ts->ping = create_buffer(spin_times[n]);
+        ts->pong = create_buffer(spin_times[n]);
+        assert_non_null(ts->ping);
+        assert_non_null(ts->pong);
+        ts->ctx = (worker_ctx){.in = ts->ping, .out = ts->pong, .count = ROUND_TRIPS};
+        ts->thread = SDL_CreateThread(worker_thread, "spinwait_echo", &ts->ctx);
+        assert_non_null(ts->thread);
+        test_obj obj;
+
+        // Act
+        const clock_t cpu_start = clock();
+        const Uint64 start = SDL_GetTicksNS();
+        for(int i = 1; i <= ROUND_TRIPS; i++) {
+            obj.value = i;
+            assert_true(Kit_WritePacketBuffer(ts->ping, &obj));
+            assert_true(Kit_ReadPacketBuffer(ts->pong, &obj, IO_TIMEOUT_MS));
+            assert_int_equal(obj.value, i);
+        }
+        const Uint64 elapsed = SDL_GetTicksNS() - start;
+        const double cpu_ms = cpu_ms_since(cpu_start);
+
+        // Assert
+        int status = -1;
+        SDL_WaitThread(ts->thread, &status);
+        ts->thread = NULL;
+        assert_int_equal(status, 0);
+        printf(
+            "  spin %4d us: %8.2f us/round trip, %8.1f ms wall, %8.1f ms cpu\n",
+            spin_times[n],
+            (double)elapsed / ROUND_TRIPS / 1000.0,
+            (double)elapsed / 1000000.0,
+            cpu_ms
+        );
+        release_state(ts);
+    }
+}
+
+/**
+ * @brief Throughput of a writer streaming items into a full buffer as fast as the reader takes them.
+ */
+static void test_spin_stream(void **state) {
+    TestState *ts = *state;
+    printf("stream, %d items:\n", STREAM_ITEMS);
+    for(size_t n = 0; n < sizeof(spin_times) / sizeof(spin_times[0]); n++) {
+        // Arrange
+        ts->ping = create_buffer(spin_times[n]);
+        assert_non_null(ts->ping);
+        ts->ctx = (worker_ctx){.in = NULL, .out = ts->ping, .count = STREAM_ITEMS};
+        test_obj obj;
+
+        // Act
+        const clock_t cpu_start = clock();
+        const Uint64 start = SDL_GetTicksNS();
+        ts->thread = SDL_CreateThread(worker_thread, "spinwait_writer", &ts->ctx);
+        assert_non_null(ts->thread);
+        for(int i = 1; i <= STREAM_ITEMS; i++) {
+            assert_true(Kit_ReadPacketBuffer(ts->ping, &obj, IO_TIMEOUT_MS));
+            assert_int_equal(obj.value, i);
+        }
+        const Uint64 elapsed = SDL_GetTicksNS() - start;
+        const double cpu_ms = cpu_ms_since(cpu_start);
+
+        // Assert
+        int status = -1;
+        SDL_WaitThread(ts->thread, &status);
+        ts->thread = NULL;
+        assert_int_equal(status, 0);
+        printf(
+            "  spin %4d us: %8.0f items/s, %8.1f ms wall, %8.1f ms cpu\n",
+            spin_times[n],
+            STREAM_ITEMS / ((double)elapsed / 1000000000.0),
+            (double)elapsed / 1000000.0,
+            cpu_ms
+        );
+        release_state(ts);
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_spin_ping_pong, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spin_stream, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
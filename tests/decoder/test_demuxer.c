@@ -1,9 +1,11 @@
 /**
  * Test for Kit_Demuxer (kitdemuxer.h): reading packets off a real container
- * into the per-stream packet buffers, buffer-state reporting, and flushing.
- * WARNING for maintainers: writes to a full packet buffer block forever, so
- * this test stays well below the input packet buffers' default capacity and
- * never fills one.
+ * into the per-stream packet buffers, buffer-state reporting, flushing, and
+ * container-level discarding of unselected streams, and the side queues that
+ * keep a full buffer from stalling the other streams.
+ * WARNING for maintainers: writes to a full packet buffer block forever once
+ * its side queue is full too, so this test stays well below the input packet
+ * buffers' default capacity, or sizes the side queue to fit the whole file.
  *
  * @author Tuomas Virtanen
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
@@ -16,6 +18,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <libavformat/avformat.h>
+
 #include "kit_lifecycle.h"
 
 #include "kitchensink3/internal/kitdemuxer.h"
@@ -55,9 +59,12 @@ static int test_teardown(void **state) {
     return 0;
 }
 
-/** @brief Test lifecycle setup: reset the default config and bring the library up. */
+/** @brief Test lifecycle setup: reset the default config and bring the library up. Packet batching is
+ * turned off, so that every Kit_RunDemuxer() call routes exactly one packet; the batching test enables
+ * it on its own copy of the config. */
 static int group_setup(void **state) {
     Kit_ResetPlayerConfig(&g_config);
+    g_config.demuxer.packet_batch_size = 1;
     return kit_lifecycle_setup(state);
 }
 
@@ -105,9 +112,138 @@ static void test_demuxer_reads_packets(void **state) {
     ts->src = NULL;
 }
 
+/**
+ * @brief With packet batching enabled, a single Kit_RunDemuxer() call may route several packets, but never
+ * more than the configured batch size, and nothing is lost or held back between calls.
+ */
+static void test_demuxer_batches_packets(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_PlayerConfig config = g_config;
+    config.demuxer.packet_batch_size = 4;
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(ts->src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO);
+    ts->timer = Kit_CreateTimer();
+    assert_non_null(ts->timer);
+    ts->demuxer = Kit_CreateDemuxer(ts->src, video_index, audio_index, -1, &config, ts->timer);
+    assert_non_null(ts->demuxer);
+    Kit_PacketBuffer *video_buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_VIDEO_INDEX);
+    Kit_PacketBuffer *audio_buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_AUDIO_INDEX);
+
+    // Act / Assert: each call routes between 1 and batch size packets (stays well below buffer capacity)
+    size_t total = 0;
+    for(int i = 0; i < 4; i++) {
+        assert_true(Kit_RunDemuxer(ts->demuxer));
+        const size_t now = Kit_GetPacketBufferLength(video_buffer) + Kit_GetPacketBufferLength(audio_buffer);
+        assert_in_range(now - total, 1, 4);
+        total = now;
+    }
+
+    Kit_CloseDemuxer(&ts->demuxer);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/**
+ * @brief Unselected streams are set to AVDISCARD_ALL, a stream switch is applied on the next Kit_RunDemuxer(),
+ * and closing the demuxer resets the source streams back to AVDISCARD_DEFAULT.
+ */
+static void test_demuxer_discards_unselected(void **state) {
+    TestState *ts = *state;
+    // Arrange: demux only the video stream
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(ts->src);
+    AVFormatContext *format_ctx = ts->src->format_ctx;
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO);
+    ts->timer = Kit_CreateTimer();
+    assert_non_null(ts->timer);
+    ts->demuxer = Kit_CreateDemuxer(ts->src, video_index, -1, -1, &g_config, ts->timer);
+    assert_non_null(ts->demuxer);
+    Kit_PacketBuffer *audio_buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_AUDIO_INDEX);
+    assert_null(audio_buffer);
+
+    // Assert: audio is skipped by the container, so everything read is video
+    assert_int_equal(format_ctx->streams[video_index]->discard, AVDISCARD_DEFAULT);
+    assert_int_equal(format_ctx->streams[audio_index]->discard, AVDISCARD_ALL);
+    for(int i = 0; i < 4; i++)
+        assert_true(Kit_RunDemuxer(ts->demuxer));
+    assert_int_equal(Kit_GetPacketBufferLength(Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_VIDEO_INDEX)), 4);
+
+    // Act / Assert: dropping video discards it too, once the demuxer runs again
+    Kit_SetDemuxerStreamIndex(ts->demuxer, KIT_VIDEO_INDEX, -1);
+    assert_int_equal(format_ctx->streams[video_index]->discard, AVDISCARD_DEFAULT);
+    Kit_RunDemuxer(ts->demuxer);
+    assert_int_equal(format_ctx->streams[video_index]->discard, AVDISCARD_ALL);
+
+    // Act / Assert: closing leaves the source as it was
+    Kit_CloseDemuxer(&ts->demuxer);
+    assert_int_equal(format_ctx->streams[video_index]->discard, AVDISCARD_DEFAULT);
+    assert_int_equal(format_ctx->streams[audio_index]->discard, AVDISCARD_DEFAULT);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/**
+ * @brief A full video buffer does not stop audio: the video packets go to the side queue while audio keeps being
+ * routed, and the queued video packets are written in order once the video buffer has room again.
+ */
+static void test_demuxer_overflow_keeps_streams_going(void **state) {
+    TestState *ts = *state;
+    // Arrange: a two packet video buffer, and a side queue larger than the whole file
+    Kit_PlayerConfig config = g_config;
+    config.video.packet_buffer_size = 2;
+    config.demuxer.overflow_size = KIT_DEMUXER_MAX_OVERFLOW;
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(ts->src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO);
+    ts->timer = Kit_CreateTimer();
+    assert_non_null(ts->timer);
+    ts->demuxer = Kit_CreateDemuxer(ts->src, video_index, audio_index, -1, &config, ts->timer);
+    assert_non_null(ts->demuxer);
+    Kit_PacketBuffer *video_buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_VIDEO_INDEX);
+    Kit_PacketBuffer *audio_buffer = Kit_GetDemuxerPacketBuffer(ts->demuxer, KIT_AUDIO_INDEX);
+
+    // Act: demux without reading anything out, until some audio has made it past the full video buffer
+    for(int i = 0; i < 200 && Kit_GetPacketBufferLength(audio_buffer) < 4; i++)
+        assert_true(Kit_RunDemuxer(ts->demuxer));
+
+    // Assert
+    assert_int_equal(Kit_GetPacketBufferLength(video_buffer), 2);
+    assert_true(Kit_GetPacketBufferLength(audio_buffer) >= 4);
+
+    // Act / Assert: once there is room, the next run moves the queued video packets over, oldest first
+    AVPacket *first = av_packet_alloc();
+    AVPacket *second = av_packet_alloc();
+    assert_non_null(first);
+    assert_non_null(second);
+    assert_true(Kit_ReadPacketBuffer(video_buffer, first, 0));
+    av_packet_unref(first);
+    assert_true(Kit_ReadPacketBuffer(video_buffer, first, 0));
+    assert_true(Kit_RunDemuxer(ts->demuxer));
+    assert_int_equal(Kit_GetPacketBufferLength(video_buffer), 2);
+    assert_true(Kit_ReadPacketBuffer(video_buffer, second, 0));
+    assert_true(second->dts > first->dts);
+    av_packet_free(&first);
+    av_packet_free(&second);
+
+    Kit_CloseDemuxer(&ts->demuxer);
+    Kit_CloseTimer(&ts->timer);
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_demuxer_reads_packets, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_demuxer_batches_packets, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_demuxer_discards_unselected, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_demuxer_overflow_keeps_streams_going, test_setup, test_teardown),
     };
     return cmocka_run_group_tests(tests, group_setup, kit_lifecycle_teardown);
 }
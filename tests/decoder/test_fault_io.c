@@ -2,8 +2,8 @@
  * Deterministic I/O-failure tests for the demuxer, via the "demux_read" and
  * "demux_seek" fault points (src/internal/kitdemuxer.c): transient read
  * errors are retried then treated as EOF, and a failed seek silently keeps
- * playing from the old position. Error surfacing to the caller is deferred
- * to the SDL3-era error API rework.
+ * playing from the old position, along with any external stream. Error
+ * surfacing to the caller is deferred to the SDL3-era error API rework.
  * Built only when KIT_FAULT_INJECTION is enabled; the #else branch keeps the
  * binary buildable/runnable (empty) otherwise.
  *
@@ -29,6 +29,12 @@
 #include "kit_lifecycle.h"
 #include "kit_playback.h"
 
+#define VIDEO_ONLY_FILE KIT_TEST_DATA_DIR "/video_only.mp4"
+#define AUDIO_ONLY_FILE KIT_TEST_DATA_DIR "/audio_only.m4a"
+
+/** @brief External source of test_seek_error_keeps_external_audio; closed by test_teardown() after the player. */
+static Kit_Source *g_ext_src = NULL;
+
 /** @brief Test lifecycle setup: reset fail points and initialize the library plus SDL video. */
 static int group_setup(void **state) {
     Kit_ResetFailPoints();
@@ -48,7 +54,10 @@ static int group_teardown(void **state) {
  * so the close is clean) and frees it. */
 static int test_teardown(void **state) {
     Kit_ResetFailPoints();
-    return kit_playback_teardown(state);
+    const int ret = kit_playback_teardown(state);
+    Kit_CloseSource(g_ext_src);
+    g_ext_src = NULL;
+    return ret;
 }
 
 // -- test_read_error_mid_playback --------------------------------------
@@ -142,6 +151,55 @@ static void test_seek_error_keeps_playing(void **state) {
     close_fixture(fx);
 }
 
+// -- test_seek_error_keeps_external_audio ------------------------------
+
+/** @brief Pumps video and audio until an audio read returns data; returns whether it did within the bound. */
+static bool wait_for_audio(PlayerFixture *fx) {
+    unsigned char buffer[8192];
+    const Uint64 wait_start = SDL_GetTicks();
+    while(SDL_GetTicks() - wait_start < WAIT_BOUND_MS) {
+        pump_video_once(fx->player, fx->texture);
+        if(pump_audio_once(fx->player, buffer, sizeof(buffer)) > 0)
+            return true;
+        SDL_Delay(10);
+    }
+    return false;
+}
+
+/**
+ * @brief A failed seek of the main source leaves an external audio stream playing too: the external demuxer only
+ * follows a main seek that succeeded, so it neither seeks nor relabels its packets with a serial the clock never
+ * takes.
+ */
+static void test_seek_error_keeps_external_audio(void **state) {
+    PlayerFixture *fx = *state;
+    // Arrange: video from the main source, audio from an external one.
+    fx->src = Kit_CreateSourceFromUrl(VIDEO_ONLY_FILE);
+    assert_non_null(fx->src);
+    g_ext_src = Kit_CreateSourceFromUrl(AUDIO_ONLY_FILE);
+    assert_non_null(g_ext_src);
+    const int video_index = Kit_GetBestSourceStream(fx->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(g_ext_src, KIT_STREAMTYPE_AUDIO);
+    fx->player = Kit_CreatePlayer(fx->src, video_index, -1, -1, NULL, NULL, 160, 120, NULL);
+    assert_non_null(fx->player);
+    create_headless_renderer(160, 120, &fx->screen, &fx->renderer);
+    fx->texture = Kit_CreatePlayerVideoSDLTexture(fx->player, fx->renderer, 0, 0);
+    assert_non_null(fx->texture);
+    assert_int_equal(Kit_SetPlayerExternalStream(fx->player, KIT_STREAMTYPE_AUDIO, g_ext_src, audio_index), 0);
+    Kit_PlayerPlay(fx->player);
+    assert_true(wait_for_audio(fx));
+
+    // Act: only the first seek attempt fails, which is the one of the main source.
+    Kit_SetFailPoint("demux_seek", 1, 1, AVERROR(EIO));
+    assert_int_equal(Kit_PlayerSeek(fx->player, 1.0), 0);
+
+    // Assert: external audio keeps flowing, and the external demuxer never tried to seek.
+    assert_true(wait_for_audio(fx));
+    assert_int_equal(Kit_GetFailPointCount("demux_seek"), 1);
+
+    close_fixture(fx);
+}
+
 // -- test_close_during_read_retry --------------------------------------
 
 /**
@@ -230,6 +288,7 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_read_error_mid_playback, kit_playback_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_read_error_transient, kit_playback_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_seek_error_keeps_playing, kit_playback_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_seek_error_keeps_external_audio, kit_playback_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_close_during_read_retry, kit_playback_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_eof_vs_error_code, kit_playback_setup, test_teardown),
     };
@@ -38,9 +38,11 @@
 typedef struct {
     Kit_Source *src;
     Kit_Player *player;
+    Kit_Player *shared;
     SDL_Surface *screen;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    SDL_Texture *shared_texture;
 } TestState;
 
 /** @brief Per-test setup: heap-allocates the zeroed TestState that test_teardown() always receives. */
@@ -56,9 +58,12 @@ static int test_teardown(void **state) {
     TestState *ts = *state;
     if(ts == NULL)
         return 0;
+    Kit_ClosePlayer(ts->shared);
     Kit_ClosePlayer(ts->player);
     if(ts->texture != NULL)
         SDL_DestroyTexture(ts->texture);
+    if(ts->shared_texture != NULL)
+        SDL_DestroyTexture(ts->shared_texture);
     if(ts->renderer != NULL)
         SDL_DestroyRenderer(ts->renderer);
     if(ts->screen != NULL)
@@ -614,6 +619,235 @@ static void test_fill_rate_ignores_missing_audio(void **state) {
     ts->src = NULL;
 }
 
+/**
+ * @brief Pumps the audio and video of both players until both have shown a video frame at or past min_position,
+ * bounded by wall clock. Both are always drained, so that neither holds up the shared demuxer.
+ */
+static bool pump_shared_players(TestState *ts, double min_position) {
+    unsigned char buffer[8192];
+    bool shown[2] = {false, false};
+    Kit_Player *players[2] = {ts->player, ts->shared};
+    SDL_Texture *textures[2] = {ts->texture, ts->shared_texture};
+    const Uint64 wait_start = SDL_GetTicks();
+    while(SDL_GetTicks() - wait_start < WAIT_BOUND_MS && !(shown[0] && shown[1])) {
+        for(int i = 0; i < 2; i++) {
+            pump_audio_once(players[i], buffer, sizeof(buffer));
+            if(pump_video_once(players[i], textures[i]) && Kit_GetPlayerPosition(players[i]) >= min_position)
+                shown[i] = true;
+        }
+        SDL_Delay(5);
+    }
+    return shown[0] && shown[1];
+}
+
+/**
+ * @brief A shared player decodes the packets read by the demuxer of another player, and follows its seeks; it
+ * can't be seeked or shared itself.
+ */
+static void test_shared_player(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(ts->src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO);
+    ts->player = Kit_CreatePlayer(ts->src, video_index, audio_index, -1, NULL, NULL, 160, 120, NULL);
+    assert_non_null(ts->player);
+    ts->shared = Kit_CreateSharedPlayer(ts->player, video_index, audio_index, -1, NULL, NULL, 160, 120, NULL);
+    assert_non_null(ts->shared);
+    create_headless_renderer(160, 120, &ts->screen, &ts->renderer);
+    ts->texture = Kit_CreatePlayerVideoSDLTexture(ts->player, ts->renderer, 0, 0);
+    ts->shared_texture = Kit_CreatePlayerVideoSDLTexture(ts->shared, ts->renderer, 0, 0);
+    assert_non_null(ts->texture);
+    assert_non_null(ts->shared_texture);
+
+    // Act / Assert: both players get the stream from the one demuxer.
+    assert_null(Kit_CreateSharedPlayer(ts->shared, video_index, -1, -1, NULL, NULL, 160, 120, NULL));
+    assert_int_equal(Kit_GetPlayerStream(ts->shared, KIT_STREAMTYPE_VIDEO), video_index);
+    Kit_PlayerPlay(ts->shared);
+    Kit_PlayerPlay(ts->player);
+    assert_true(pump_shared_players(ts, 0.0));
+
+    // Act / Assert: seeks go through the player that owns the demuxer, and the shared player follows.
+    assert_int_equal(Kit_PlayerSeek(ts->shared, 1.0), 1);
+    assert_int_equal(Kit_PlayerSeek(ts->player, 1.0), 0);
+    assert_true(pump_shared_players(ts, 0.9));
+
+    Kit_ClosePlayer(ts->shared);
+    ts->shared = NULL;
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+}
+
+/**
+ * @brief The player that owns the demuxer can be closed before the players sharing it, which then run out of
+ * packets and can still be used and closed.
+ */
+static void test_shared_player_outlives_lead(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    unsigned char buffer[8192];
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
+    assert_non_null(ts->src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_AUDIO);
+    ts->player = Kit_CreatePlayer(ts->src, video_index, audio_index, -1, NULL, NULL, 160, 120, NULL);
+    assert_non_null(ts->player);
+    ts->shared = Kit_CreateSharedPlayer(ts->player, video_index, audio_index, -1, NULL, NULL, 160, 120, NULL);
+    assert_non_null(ts->shared);
+    create_headless_renderer(160, 120, &ts->screen, &ts->renderer);
+    ts->texture = Kit_CreatePlayerVideoSDLTexture(ts->player, ts->renderer, 0, 0);
+    ts->shared_texture = Kit_CreatePlayerVideoSDLTexture(ts->shared, ts->renderer, 0, 0);
+    assert_non_null(ts->texture);
+    assert_non_null(ts->shared_texture);
+    Kit_PlayerPlay(ts->shared);
+    Kit_PlayerPlay(ts->player);
+    assert_true(pump_shared_players(ts, 0.0));
+
+    // Act
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+    for(int i = 0; i < 20; i++) {
+        pump_audio_once(ts->shared, buffer, sizeof(buffer));
+        pump_video_once(ts->shared, ts->shared_texture);
+        SDL_Delay(5);
+    }
+
+    // Assert
+    assert_int_equal(Kit_GetPlayerStream(ts->shared, KIT_STREAMTYPE_VIDEO), video_index);
+    Kit_PlayerStop(ts->shared);
+    Kit_PlayerPlay(ts->shared);
+    Kit_ClosePlayer(ts->shared);
+    ts->shared = NULL;
+}
+
+/**
+ * @brief Kit_GetPlayerBufferStats() reports packet traffic for the selected streams once playback has run,
+ * and reports zeroed counters for stream types the player has no buffer for.
+ */
+static void test_player_buffer_stats(void **state) {
+    TestState *ts = *state;
+    // Arrange: video-only player
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_ONLY_FILE);
+    assert_non_null(ts->src);
+    ts->player = Kit_CreatePlayer(
+        ts->src, Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO), -1, -1, NULL, NULL, 160, 120, NULL
+    );
+    assert_non_null(ts->player);
+    Kit_PlayerBufferStats stats;
+
+    // Act
+    Kit_PlayerPlay(ts->player);
+    assert_int_equal(Kit_WaitBufferFillRate(ts->player, -1, -1, -1, 50, 5.0), 0);
+
+    // Assert: the decoder has consumed packets, and never more than the demuxer wrote
+    assert_true(Kit_GetPlayerBufferStats(ts->player, KIT_STREAMTYPE_VIDEO, &stats));
+    assert_true(stats.reads > 0);
+    assert_true(stats.writes >= stats.reads);
+    assert_true(stats.peak_length > 0);
+    assert_false(Kit_GetPlayerBufferStats(ts->player, KIT_STREAMTYPE_AUDIO, &stats));
+    assert_int_equal(stats.writes, 0);
+    assert_false(Kit_GetPlayerBufferStats(ts->player, KIT_STREAMTYPE_DATA, &stats));
+
+    Kit_PlayerStop(ts->player);
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/**
+ * @brief Kit_SetPlayerConfig() resizes the buffers of a playing player in place; fields that are fixed at creation
+ * are left alone, and playback keeps filling the resized buffers.
+ */
+static void test_player_set_config(void **state) {
+    TestState *ts = *state;
+    // Arrange: video-only player with primed buffers
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_ONLY_FILE);
+    assert_non_null(ts->src);
+    ts->player = Kit_CreatePlayer(
+        ts->src, Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO), -1, -1, NULL, NULL, 160, 120, NULL
+    );
+    assert_non_null(ts->player);
+    Kit_PlayerPlay(ts->player);
+    assert_int_equal(Kit_WaitBufferFillRate(ts->player, -1, -1, -1, 50, 5.0), 0);
+    Kit_PlayerConfig config;
+    Kit_GetPlayerConfig(ts->player, &config);
+    const int thread_count = config.thread_count;
+
+    // Act
+    config.video.packet_buffer_size = 8;
+    config.video.frame_buffer_size = 1;
+    config.thread_count = thread_count + 1;
+    config.buffer_spin_time = 1000000; // clamped to the max
+    assert_int_equal(Kit_SetPlayerConfig(ts->player, &config), 0);
+
+    // Assert
+    unsigned int frames_capacity = 0, packets_capacity = 0;
+    assert_true(Kit_GetPlayerVideoBufferState(ts->player, NULL, &frames_capacity, NULL, &packets_capacity));
+    assert_int_equal(frames_capacity, 1);
+    assert_int_equal(packets_capacity, 8);
+    Kit_GetPlayerConfig(ts->player, &config);
+    assert_int_equal(config.video.packet_buffer_size, 8);
+    assert_int_equal(config.video.frame_buffer_size, 1);
+    assert_int_equal(config.thread_count, thread_count);
+    assert_int_equal(config.buffer_spin_time, 1000);
+    assert_int_equal(Kit_WaitBufferFillRate(ts->player, -1, -1, 100, 100, 5.0), 0);
+
+    Kit_PlayerStop(ts->player);
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
+/** @brief Buffer callback for test_player_buffer_watermarks: counts input-buffer high reports for video. */
+static void on_buffer_level(
+    Kit_Player *player, Kit_StreamType type, Kit_BufferSide side, Kit_BufferLevel level, void *userdata
+) {
+    if(type == KIT_STREAMTYPE_VIDEO && side == KIT_BUFFER_INPUT && level == KIT_BUFFER_HIGH)
+        SDL_AddAtomicInt(userdata, 1);
+}
+
+/**
+ * @brief Input buffer watermarks report the demuxer filling the buffer, without the test polling the buffer state;
+ * invalid watermarks are rejected.
+ */
+static void test_player_buffer_watermarks(void **state) {
+    TestState *ts = *state;
+    // Arrange: video-only player
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_ONLY_FILE);
+    assert_non_null(ts->src);
+    ts->player = Kit_CreatePlayer(
+        ts->src, Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO), -1, -1, NULL, NULL, 160, 120, NULL
+    );
+    assert_non_null(ts->player);
+    SDL_AtomicInt highs;
+    SDL_SetAtomicInt(&highs, 0);
+    Kit_PlayerBufferWatermarks marks = {.input_low = 10, .input_high = 50, .output_low = -1, .output_high = -1};
+    Kit_PlayerBufferWatermarks bad = {.input_low = 50, .input_high = 10, .output_low = -1, .output_high = -1};
+    assert_int_equal(Kit_SetPlayerBufferWatermarks(ts->player, KIT_STREAMTYPE_VIDEO, &bad), 1);
+    assert_int_equal(Kit_SetPlayerBufferWatermarks(ts->player, KIT_STREAMTYPE_DATA, &marks), 1);
+    assert_int_equal(Kit_SetPlayerBufferWatermarks(ts->player, KIT_STREAMTYPE_VIDEO, &marks), 0);
+    Kit_SetPlayerBufferCallback(ts->player, on_buffer_level, &highs);
+
+    // Act
+    Kit_PlayerPlay(ts->player);
+    const Uint64 start = SDL_GetTicks();
+    while(SDL_GetAtomicInt(&highs) == 0 && SDL_GetTicks() - start < 5000)
+        SDL_Delay(1);
+
+    // Assert
+    Kit_SetPlayerBufferCallback(ts->player, NULL, NULL);
+    assert_true(SDL_GetAtomicInt(&highs) >= 1);
+
+    Kit_PlayerStop(ts->player);
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
 /**
  * @brief Every state-transition call is idempotent from a no-op state (Pause/Stop from STOPPED, repeated
  * Play/Pause/Stop). No sleeps or data pumping here: the fixture's lazy EOF-driven STOPPED flip must not fire mid-table
@@ -930,6 +1164,11 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_audio_only_player, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_fill_rate_ignores_missing_video, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_fill_rate_ignores_missing_audio, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_player_buffer_stats, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_shared_player, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_shared_player_outlives_lead, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_player_set_config, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_player_buffer_watermarks, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_state_transition_table, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_audio_data_zero_length, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_audio_data_odd_length, test_setup, test_teardown),
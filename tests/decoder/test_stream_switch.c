@@ -4,7 +4,8 @@
  * stream's playback untouched (new decoder built before the old is torn
  * down); a switch after demuxer EOF re-sends the EOF sentinel so the new
  * decoder winds down cleanly -- resuming playback on the new track still
- * requires a seek.
+ * requires a seek. Also covers Kit_SetPlayerExternalStream(), which takes a
+ * stream from a second source.
  *
  * @author Tuomas Virtanen
  * @copyright Tuomas Virtanen; MIT license (see LICENSE)
@@ -28,6 +29,8 @@
 
 #define DUAL_AUDIO_FILE KIT_TEST_DATA_DIR "/dual_audio.mkv"
 #define SUBTITLED_FILE KIT_TEST_DATA_DIR "/subtitled.mkv"
+#define VIDEO_ONLY_FILE KIT_TEST_DATA_DIR "/video_only.mp4"
+#define AUDIO_ONLY_FILE KIT_TEST_DATA_DIR "/audio_only.m4a"
 
 #define SCREEN_W 160
 #define SCREEN_H 120
@@ -46,6 +49,7 @@
  * cascade into (and leak across) the remaining tests in the group. */
 typedef struct {
     Kit_Source *src;
+    Kit_Source *ext_src;
     Kit_Player *player;
     SDL_Surface *screen;
     SDL_Renderer *renderer;
@@ -75,6 +79,7 @@ static int test_teardown(void **state) {
         SDL_DestroyRenderer(ts->renderer);
     if(ts->screen != NULL)
         SDL_DestroySurface(ts->screen);
+    Kit_CloseSource(ts->ext_src);
     Kit_CloseSource(ts->src);
     free(ts);
     *state = NULL;
@@ -347,6 +352,76 @@ static void test_close_subtitle_stream_mid_play(void **state) {
     ts->src = NULL;
 }
 
+// -- test_external_audio_stream ---------------------------------------
+
+/** @brief Pumps video and audio until an audio read returns data; returns whether it did within the budget. */
+static bool pump_until_av_audio_flows(TestState *ts) {
+    unsigned char buffer[8192];
+    for(int i = 0; i < PUMP_ITERS; i++) {
+        pump_video_once(ts->player, ts->video_tex);
+        if(pump_audio_once(ts->player, buffer, sizeof(buffer)) > 0)
+            return true;
+        SDL_Delay(PUMP_DELAY_MS);
+    }
+    return false;
+}
+
+/**
+ * @brief Audio taken from a second source plays along with the video of the main source, and keeps flowing after
+ * a seek. The external source can't be shared with another stream, and closing the stream releases it.
+ */
+static void test_external_audio_stream(void **state) {
+    TestState *ts = *state;
+
+    // Arrange: video from one file, audio from another
+    ts->src = Kit_CreateSourceFromUrl(VIDEO_ONLY_FILE);
+    assert_non_null(ts->src);
+    ts->ext_src = Kit_CreateSourceFromUrl(AUDIO_ONLY_FILE);
+    assert_non_null(ts->ext_src);
+    const int video_index = Kit_GetBestSourceStream(ts->src, KIT_STREAMTYPE_VIDEO);
+    const int audio_index = Kit_GetBestSourceStream(ts->ext_src, KIT_STREAMTYPE_AUDIO);
+    assert_true(video_index >= 0);
+    assert_true(audio_index >= 0);
+    ts->player = Kit_CreatePlayer(ts->src, video_index, -1, -1, NULL, NULL, SCREEN_W, SCREEN_H, NULL);
+    assert_non_null(ts->player);
+    create_headless_renderer(SCREEN_W, SCREEN_H, &ts->screen, &ts->renderer);
+    ts->video_tex = Kit_CreatePlayerVideoSDLTexture(ts->player, ts->renderer, 0, 0);
+    assert_non_null(ts->video_tex);
+
+    // Act
+    assert_int_equal(Kit_SetPlayerExternalStream(ts->player, KIT_STREAMTYPE_AUDIO, ts->ext_src, audio_index), 0);
+    Kit_PlayerPlay(ts->player);
+
+    // Assert: the index is the one within the external source, and audio flows before and after a seek
+    assert_int_equal(Kit_GetPlayerStream(ts->player, KIT_STREAMTYPE_AUDIO), audio_index);
+    assert_true(pump_until_av_audio_flows(ts));
+    assert_int_equal(Kit_PlayerSeek(ts->player, 0.5), 0);
+    assert_true(pump_until_av_audio_flows(ts));
+
+    // Act / Assert: no external video, and no second stream from the same external source
+    assert_int_equal(Kit_SetPlayerExternalStream(ts->player, KIT_STREAMTYPE_VIDEO, ts->ext_src, audio_index), 1);
+    assert_int_equal(Kit_SetPlayerExternalStream(ts->player, KIT_STREAMTYPE_SUBTITLE, ts->ext_src, 0), 1);
+    assert_int_equal(Kit_GetPlayerStream(ts->player, KIT_STREAMTYPE_AUDIO), audio_index);
+
+    // Act / Assert: closing the stream stops the external demuxer; the source can then be closed before the player
+    assert_int_equal(Kit_ClosePlayerStream(ts->player, KIT_STREAMTYPE_AUDIO), 0);
+    assert_int_equal(Kit_GetPlayerStream(ts->player, KIT_STREAMTYPE_AUDIO), -1);
+    Kit_CloseSource(ts->ext_src);
+    ts->ext_src = NULL;
+
+    Kit_PlayerStop(ts->player);
+    Kit_ClosePlayer(ts->player);
+    ts->player = NULL;
+    SDL_DestroyTexture(ts->video_tex);
+    ts->video_tex = NULL;
+    SDL_DestroyRenderer(ts->renderer);
+    ts->renderer = NULL;
+    SDL_DestroySurface(ts->screen);
+    ts->screen = NULL;
+    Kit_CloseSource(ts->src);
+    ts->src = NULL;
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_get_player_stream, test_setup, test_teardown),
@@ -354,6 +429,7 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_switch_after_eof, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_switch_to_invalid_track, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_close_subtitle_stream_mid_play, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_external_audio_stream, test_setup, test_teardown),
     };
     return cmocka_run_group_tests(tests, kit_lifecycle_setup_video_ass, kit_lifecycle_teardown_video);
 }
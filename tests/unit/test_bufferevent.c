@@ -0,0 +1,120 @@
+/**
+ * Unit tests for Kit_BufferEvent (kitbufferevent.h), the wake-up event the
+ * pipeline threads signal as they fill buffers. The wake-up test runs the
+ * signaler on a real SDL thread, so TSan also gets to look at the handshake.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+#include "kitchensink3/internal/kitbufferevent.h"
+
+#define SIGNAL_DELAY_MS 50 // how long the signaler thread sleeps before signaling
+#define WAIT_BOUND_MS 5000 // wait timeout; a working wake-up returns long before this
+
+/** @brief Per-test resources, heap-allocated by test_setup() and released by test_teardown(),
+ * so a mid-test assert failure cannot leak them or strand a live signaler thread. */
+typedef struct {
+    Kit_BufferEvent *event;
+    SDL_Thread *thread;
+} TestState;
+
+/** @brief Per-test setup: heap-allocates the zeroed TestState that test_teardown() always receives. */
+static int test_setup(void **state) {
+    *state = calloc(1, sizeof(TestState));
+    return *state == NULL ? -1 : 0;
+}
+
+/** @brief Per-test teardown: joins any signaler thread (it always finishes on its own), then closes
+ * the event and frees the state. */
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    if(ts->thread != NULL) {
+        SDL_WaitThread(ts->thread, NULL);
+        ts->thread = NULL;
+    }
+    Kit_CloseBufferEvent(&ts->event); // NULL-safe; NULLs the pointer
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/**
+ * @brief Signals are dropped while nobody is registered, and change the serial once a waiter is registered.
+ */
+static void test_signal_needs_waiter(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->event = Kit_CreateBufferEvent();
+    assert_non_null(ts->event);
+    const int serial = Kit_GetBufferEventSerial(ts->event);
+
+    // Act / Assert: nobody waiting, so the signal is a no-op and a wait times out
+    Kit_SignalBufferEvent(ts->event);
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial);
+    Kit_BeginBufferEventWait(ts->event);
+    assert_false(Kit_WaitBufferEvent(ts->event, serial, 1));
+
+    // A signal after registering is seen even before the wait starts
+    Kit_SignalBufferEvent(ts->event);
+    assert_true(Kit_WaitBufferEvent(ts->event, serial, 0));
+    Kit_EndBufferEventWait(ts->event);
+
+    Kit_CloseBufferEvent(&ts->event);
+    assert_null(ts->event);
+}
+
+/** @brief Signaler thread body: sleeps a bit so that the main thread is already waiting, then signals. */
+static int signaler_thread(void *data) {
+    SDL_Delay(SIGNAL_DELAY_MS);
+    Kit_SignalBufferEvent(data);
+    return 0;
+}
+
+/**
+ * @brief A signal from another thread wakes up a blocked waiter well before its timeout.
+ */
+static void test_signal_wakes_waiter(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->event = Kit_CreateBufferEvent();
+    assert_non_null(ts->event);
+    Kit_BeginBufferEventWait(ts->event);
+    const int serial = Kit_GetBufferEventSerial(ts->event);
+
+    // Act
+    const Uint64 start = SDL_GetTicks();
+    ts->thread = SDL_CreateThread(signaler_thread, "bufferevent_signaler", ts->event);
+    assert_non_null(ts->thread);
+    const bool signaled = Kit_WaitBufferEvent(ts->event, serial, WAIT_BOUND_MS);
+    const Uint64 elapsed = SDL_GetTicks() - start;
+    Kit_EndBufferEventWait(ts->event);
+
+    // Assert
+    assert_true(signaled);
+    assert_true(elapsed < WAIT_BOUND_MS);
+    SDL_WaitThread(ts->thread, NULL);
+    ts->thread = NULL;
+
+    Kit_CloseBufferEvent(&ts->event);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_signal_needs_waiter, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_signal_wakes_waiter, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,8 +1,11 @@
 /**
  * Direct unit tests for Kit_Decoder (kitdecoder.h): codec info reporting,
- * feeding real demuxed packets and running the decoder, buffer clearing, and
- * resuming decode after a clear. Uses the real video decoder/demuxer against
- * video_audio.mp4, bypassing the decoder thread entirely.
+ * feeding real demuxed packets and running the decoder, buffer clearing,
+ * resuming decode after a clear, the output delay of the low latency config,
+ * the adaptive skipping of decoding work while frames are late, and dropping
+ * frames that are late before they are buffered. Uses the real video
+ * decoder/demuxer against video_audio.mp4, bypassing the decoder thread
+ * entirely.
  *
  * Kit_CreateVideoDecoder's output buffer defaults to only a few frames and
  * nothing here drains it, so Kit_WritePacketBuffer() would block forever once
@@ -19,6 +22,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <SDL3/SDL_stdinc.h>
 #include <libavcodec/avcodec.h>
 
 #include "kit_lifecycle.h"
@@ -88,16 +92,16 @@ static int test_teardown(void **state) {
 }
 
 /**
- * @brief Opens a video source, demuxer, and decoder for a test fixture.
+ * @brief Opens a video source, demuxer, and decoder for a test fixture, with the given player config.
  */
-static void fixture_open(decoder_fixture *fx) {
+static void fixture_open_with(decoder_fixture *fx, const Kit_PlayerConfig *config) {
     fx->src = Kit_CreateSourceFromUrl(VIDEO_FILE);
     assert_non_null(fx->src);
     fx->video_index = Kit_GetBestSourceStream(fx->src, KIT_STREAMTYPE_VIDEO);
     assert_true(fx->video_index >= 0);
     fx->timer = Kit_CreateTimer();
     assert_non_null(fx->timer);
-    fx->demuxer = Kit_CreateDemuxer(fx->src, fx->video_index, -1, -1, &g_config, fx->timer);
+    fx->demuxer = Kit_CreateDemuxer(fx->src, fx->video_index, -1, -1, config, fx->timer);
     assert_non_null(fx->demuxer);
 
     Kit_VideoFormatRequest request;
@@ -106,10 +110,17 @@ static void fixture_open(decoder_fixture *fx) {
     assert_non_null(timer);
     // Kit_CreateVideoDecoder() takes ownership of the timer even on failure.
     fx->decoder =
-        Kit_CreateVideoDecoder(fx->src, &request, &g_config.video, g_config.thread_count, timer, fx->video_index);
+        Kit_CreateVideoDecoder(fx->src, &request, &config->video, config->thread_count, timer, fx->video_index);
     assert_non_null(fx->decoder);
 }
 
+/**
+ * @brief Opens a video source, demuxer, and decoder for a test fixture, with the fixture's player config.
+ */
+static void fixture_open(decoder_fixture *fx) {
+    fixture_open_with(fx, &g_config);
+}
+
 /**
  * @brief Closes a decoder_fixture's decoder, demuxer, demuxer timer, and source.
  */
@@ -161,6 +172,21 @@ static void feed_until_decoded(decoder_fixture *fx, AVPacket *pkt, double *pts)
     fail_msg("decoder never produced a frame within %d demux/decode iterations", PUMP_LIMIT);
 }
 
+/**
+ * @brief Feeds packets until the decoder outputs its first frame, and returns the number of packets that took.
+ */
+static int count_packets_to_first_frame(decoder_fixture *fx, AVPacket *pkt) {
+    double pts;
+    for(int i = 1; i <= PUMP_LIMIT; i++) {
+        if(!pump_and_feed(fx->demuxer, fx->decoder, pkt))
+            break;
+        if(Kit_RunDecoder(fx->decoder, &pts))
+            return i;
+    }
+    fail_msg("decoder never produced a frame within %d demux/decode iterations", PUMP_LIMIT);
+    return -1;
+}
+
 /**
  * @brief Widens the config's video output buffer (see file header) and initializes the library.
  */
@@ -292,12 +318,142 @@ static void test_flush_then_decode_again(void **state) {
     ts->fx.src = NULL;
 }
 
+/**
+ * @brief With Kit_SetPlayerConfigLowLatency(), the decoder puts out its first frame after at most as many packets
+ * as with the default config, which uses frame threads and reorders B-frames. The times are measured by the
+ * decode_threads benchmark.
+ */
+static void test_low_latency_first_frame(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_PlayerConfig config = g_config;
+    Kit_SetPlayerConfigLowLatency(&config);
+    config.video.frame_buffer_size = g_config.video.frame_buffer_size; // See file header
+    ts->pkt = av_packet_alloc();
+    assert_non_null(ts->pkt);
+
+    // Act
+    fixture_open(&ts->fx);
+    const int default_packets = count_packets_to_first_frame(&ts->fx, ts->pkt);
+    fixture_close(&ts->fx);
+    fixture_open_with(&ts->fx, &config);
+    const int low_latency_packets = count_packets_to_first_frame(&ts->fx, ts->pkt);
+    fixture_close(&ts->fx);
+
+    // Assert
+    assert_true(low_latency_packets >= 1);
+    assert_true(low_latency_packets <= default_packets);
+}
+
+/**
+ * @brief Feeds the whole clip to the decoder, reading out the frames as they come like the application thread
+ * does, and returns the highest decode skip level seen.
+ */
+static Kit_VideoSkipLevel play_through(decoder_fixture *fx, AVPacket *pkt) {
+    Kit_VideoSkipLevel max_level = KIT_VIDEO_SKIP_NONE;
+    double pts;
+    while(pump_and_feed(fx->demuxer, fx->decoder, pkt)) {
+        while(Kit_RunDecoder(fx->decoder, &pts)) {
+            if(Kit_LockVideoDecoderRaw(fx->decoder, NULL, NULL, NULL) == 0)
+                Kit_UnlockVideoDecoderRaw(fx->decoder);
+        }
+        max_level = SDL_max(max_level, Kit_GetVideoDecoderSkipLevel(fx->decoder));
+    }
+    return max_level;
+}
+
+/**
+ * @brief When every frame gets dropped as late, the decoder steps down to keyframe only decoding, and a buffer
+ * clear (as on seek) restores full quality.
+ */
+static void test_adaptive_skip(void **state) {
+    TestState *ts = *state;
+    // Arrange: single threaded, so that frames come out right away, and a clock far past the end of the clip.
+    Kit_PlayerConfig config = g_config;
+    config.thread_count = 1;
+    config.video.adaptive_skip = 1;
+    fixture_open_with(&ts->fx, &config);
+    ts->pkt = av_packet_alloc();
+    assert_non_null(ts->pkt);
+    Kit_Timer *timer = ts->fx.decoder->sync_timer;
+    Kit_AdjustTimerBase(timer, 10.0, Kit_GetTimerSerial(timer));
+
+    // Act
+    const Kit_VideoSkipLevel level = play_through(&ts->fx, ts->pkt);
+    Kit_ClearDecoderBuffers(ts->fx.decoder);
+
+    // Assert
+    assert_int_equal(level, KIT_VIDEO_SKIP_NONKEY);
+    assert_int_equal(Kit_GetVideoDecoderSkipLevel(ts->fx.decoder), KIT_VIDEO_SKIP_NONE);
+    assert_int_equal(ts->fx.decoder->codec_ctx->skip_frame, AVDISCARD_DEFAULT);
+    assert_int_equal(ts->fx.decoder->codec_ctx->skip_loop_filter, AVDISCARD_DEFAULT);
+}
+
+/**
+ * @brief With adaptive_skip off, late frames are dropped but the decoder keeps decoding at full quality.
+ */
+static void test_adaptive_skip_disabled(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    Kit_PlayerConfig config = g_config;
+    config.thread_count = 1;
+    config.video.adaptive_skip = 0;
+    fixture_open_with(&ts->fx, &config);
+    ts->pkt = av_packet_alloc();
+    assert_non_null(ts->pkt);
+    Kit_Timer *timer = ts->fx.decoder->sync_timer;
+    Kit_AdjustTimerBase(timer, 10.0, Kit_GetTimerSerial(timer));
+
+    // Act
+    const Kit_VideoSkipLevel level = play_through(&ts->fx, ts->pkt);
+
+    // Assert
+    assert_int_equal(level, KIT_VIDEO_SKIP_NONE);
+    assert_int_equal(ts->fx.decoder->codec_ctx->skip_frame, AVDISCARD_DEFAULT);
+}
+
+/**
+ * @brief Frames that are already late when they come out of the codec are dropped by the decoder, and never reach
+ * the output buffer; once the clock is no longer running, frames are buffered again.
+ */
+static void test_late_frames_dropped_before_buffering(void **state) {
+    TestState *ts = *state;
+    // Arrange: single threaded, so that frames come out right away, and a clock far past the end of the clip.
+    Kit_PlayerConfig config = g_config;
+    config.thread_count = 1;
+    config.video.adaptive_skip = 0;
+    fixture_open_with(&ts->fx, &config);
+    ts->pkt = av_packet_alloc();
+    assert_non_null(ts->pkt);
+    Kit_Timer *timer = ts->fx.decoder->sync_timer;
+    Kit_AdjustTimerBase(timer, 10.0, Kit_GetTimerSerial(timer));
+    unsigned int length = 0;
+    double pts;
+
+    // Act: feed_until_decoded() fails the test unless the decoder keeps reporting frames.
+    for(int i = 0; i < 4; i++)
+        feed_until_decoded(&ts->fx, ts->pkt, &pts);
+    assert_int_equal(Kit_GetDecoderBufferState(ts->fx.decoder, &length, NULL), 0);
+    const unsigned int late_length = length;
+    Kit_ResetTimerBase(timer);
+    feed_until_decoded(&ts->fx, ts->pkt, &pts);
+    assert_int_equal(Kit_GetDecoderBufferState(ts->fx.decoder, &length, NULL), 0);
+
+    // Assert
+    assert_int_equal(late_length, 0);
+    assert_int_equal(length, 1);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_decoder_codec_info, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_add_packet_and_run, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_clear_decoder_buffers, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_flush_then_decode_again, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_low_latency_first_frame, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_adaptive_skip, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_adaptive_skip_disabled, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_late_frames_dropped_before_buffering, test_setup, test_teardown),
     };
     return cmocka_run_group_tests(tests, group_setup, kit_lifecycle_teardown);
 }
@@ -151,7 +151,7 @@ static void fixture_open(demux_fixture *fx) {
     assert_non_null(fx->timer);
     fx->demuxer = Kit_CreateDemuxer(fx->src, fx->video_index, -1, -1, &g_config, fx->timer);
     assert_non_null(fx->demuxer);
-    fx->demux_thread = Kit_CreateDemuxerThread(fx->demuxer);
+    fx->demux_thread = Kit_CreateDemuxerThread(fx->demuxer, NULL);
     assert_non_null(fx->demux_thread);
 }
 
@@ -269,7 +269,7 @@ static void test_decoder_thread_lifecycle(void **state) {
     );
     ts->video_timer = NULL;
     assert_non_null(ts->decoder);
-    ts->decoder_thread = Kit_CreateDecoderThread(video_input, ts->decoder);
+    ts->decoder_thread = Kit_CreateDecoderThread(video_input, ts->decoder, NULL);
     assert_non_null(ts->decoder_thread);
 
     // Act: start both threads
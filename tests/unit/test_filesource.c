@@ -0,0 +1,161 @@
+/**
+ * Unit tests for Kit_FileSource (kitfilesource.h), the local file reader
+ * behind Kit_CreateSourceFromFile() and Kit_CreateSourceFromMemory(). Reads a
+ * fixture through the mapped, the SDL I/O and the caller memory paths, and
+ * checks the bytes and seeks against the file as loaded with load_file().
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "kit_memsource.h"
+
+#include "kitchensink3/internal/kitfilesource.h"
+
+#define TEST_FILE KIT_TEST_DATA_DIR "/video_oddsize.nut" // over 1 MiB, so reads cross advise windows
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_FileSource *file;
+    unsigned char *data;
+    int64_t size;
+    uint8_t *buf;
+} TestState;
+
+static int test_setup(void **state) {
+    TestState *ts = calloc(1, sizeof(TestState));
+    if(ts == NULL)
+        return -1;
+    if(load_file(TEST_FILE, &ts->data, &ts->size) != 0 || (ts->buf = malloc((size_t)ts->size)) == NULL) {
+        free(ts->data);
+        free(ts);
+        return -1;
+    }
+    *state = ts;
+    return 0;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    Kit_CloseFileSource(&ts->file);
+    free(ts->buf);
+    free(ts->data);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/** @brief Reads the file through in 4000 byte chunks, then checks it matches the fixture and ends with EOF. */
+static void assert_reads_whole_file(TestState *ts) {
+    int64_t pos = 0;
+    int ret;
+    while((ret = Kit_ReadFileSource(ts->file, ts->buf + pos, (int)SDL_min(4000, ts->size - pos))) > 0)
+        pos += ret;
+    assert_int_equal(pos, ts->size);
+    assert_memory_equal(ts->buf, ts->data, (size_t)ts->size);
+    assert_int_equal(Kit_ReadFileSource(ts->file, ts->buf, 16), AVERROR_EOF);
+}
+
+/** @brief Checks size queries and seeks, with a read after each. */
+static void assert_seeks(TestState *ts) {
+    uint8_t buf[64];
+    assert_int_equal(Kit_SeekFileSource(ts->file, 0, AVSEEK_SIZE), ts->size);
+    assert_int_equal(Kit_SeekFileSource(ts->file, 1000, SEEK_SET), 1000);
+    assert_int_equal(Kit_ReadFileSource(ts->file, buf, sizeof(buf)), sizeof(buf));
+    assert_memory_equal(buf, ts->data + 1000, sizeof(buf));
+    assert_int_equal(Kit_SeekFileSource(ts->file, 100, SEEK_CUR), 1000 + sizeof(buf) + 100);
+    assert_int_equal(Kit_SeekFileSource(ts->file, -64, SEEK_END | AVSEEK_FORCE), ts->size - 64);
+    assert_int_equal(Kit_ReadFileSource(ts->file, buf, sizeof(buf)), sizeof(buf));
+    assert_memory_equal(buf, ts->data + ts->size - 64, sizeof(buf));
+    assert_true(Kit_SeekFileSource(ts->file, -1, SEEK_SET) < 0);
+}
+
+/**
+ * @brief Mapped reads and seeks return the file contents.
+ */
+static void test_mapped(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->file = Kit_OpenFileSource(TEST_FILE, 0);
+    assert_non_null(ts->file);
+
+    // Act / Assert
+#if defined(__unix__) || defined(__APPLE__)
+    assert_true(Kit_IsFileSourceInMemory(ts->file));
+#endif
+    assert_reads_whole_file(ts);
+    assert_seeks(ts);
+}
+
+/**
+ * @brief Reads and seeks through SDL I/O return the file contents.
+ */
+static void test_unmapped(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->file = Kit_OpenFileSource(TEST_FILE, KIT_SOURCE_FILE_NO_MMAP);
+    assert_non_null(ts->file);
+
+    // Act / Assert
+    assert_false(Kit_IsFileSourceInMemory(ts->file));
+    assert_reads_whole_file(ts);
+    assert_seeks(ts);
+}
+
+/**
+ * @brief Reads and seeks from caller memory return the memory contents, and the memory is left alone on close
+ * when there is no free callback.
+ */
+static void test_memory(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->file = Kit_OpenMemorySource(ts->data, (size_t)ts->size, NULL);
+    assert_non_null(ts->file);
+
+    // Act / Assert
+    assert_true(Kit_IsFileSourceInMemory(ts->file));
+    assert_reads_whole_file(ts);
+    assert_seeks(ts);
+    Kit_CloseFileSource(&ts->file);
+    assert_null(ts->file);
+    assert_int_equal(ts->data[0], 'n'); // NUT files start with "nut/multimedia container"; still readable
+}
+
+/**
+ * @brief Empty files can't be mapped, so they are opened through SDL I/O, and read as EOF right away.
+ */
+static void test_empty(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    uint8_t buf[16];
+
+    // Act
+    ts->file = Kit_OpenFileSource(KIT_TEST_DATA_DIR "/empty.mp4", 0);
+
+    // Assert
+    assert_non_null(ts->file);
+    assert_false(Kit_IsFileSourceInMemory(ts->file));
+    assert_int_equal(Kit_ReadFileSource(ts->file, buf, sizeof(buf)), AVERROR_EOF);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_mapped, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_unmapped, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_memory, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_empty, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
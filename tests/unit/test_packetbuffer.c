@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 
+#include "kitchensink3/internal/kitbufferevent.h"
 #include "kitchensink3/internal/kitpacketbuffer.h"
 
 /** @brief Simple payload object standing in for AVPacket in buffer tests. */
@@ -46,8 +47,16 @@ static void obj_ref(void *dst, void *src) {
     ((test_obj *)dst)->value = ((test_obj *)src)->value;
 }
 
-static Kit_PacketBuffer *create_buffer(size_t capacity) {
-    return Kit_CreatePacketBuffer(capacity, obj_alloc, obj_unref, obj_free, obj_move, obj_ref);
+static void obj_peek(void *dst, const void *obj) {
+    *(int *)dst = ((const test_obj *)obj)->value;
+}
+
+static size_t obj_size(const void *obj) {
+    return (size_t)((const test_obj *)obj)->value;
+}
+
+static Kit_PacketBuffer *create_buffer(size_t capacity, unsigned int flags) {
+    return Kit_CreatePacketBuffer(capacity, obj_alloc, obj_unref, obj_free, obj_move, obj_ref, flags);
 }
 
 /** @brief Per-test resources, heap-allocated by test_setup() and released by test_teardown(),
@@ -56,6 +65,7 @@ static Kit_PacketBuffer *create_buffer(size_t capacity) {
  * resets the member. */
 typedef struct {
     Kit_PacketBuffer *buffer;
+    Kit_BufferEvent *event;
 } TestState;
 
 /** @brief Per-test setup: heap-allocates the zeroed TestState that test_teardown() always receives. */
@@ -71,6 +81,7 @@ static int test_teardown(void **state) {
     if(ts == NULL)
         return 0;
     Kit_FreePacketBuffer(&ts->buffer);
+    Kit_CloseBufferEvent(&ts->event);
     free(ts);
     *state = NULL;
     return 0;
@@ -83,7 +94,7 @@ static int test_teardown(void **state) {
 static void test_create_and_free(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
 
     // Act / Assert: creation state
     assert_non_null(ts->buffer);
@@ -102,7 +113,7 @@ static void test_create_and_free(void **state) {
 static void test_write_then_read_fifo(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src, dst;
 
     // Act: write 1, 2, 3 in order
@@ -127,7 +138,7 @@ static void test_write_then_read_fifo(void **state) {
  */
 static void test_read_empty_returns_false(void **state) {
     TestState *ts = *state;
-    ts->buffer = create_buffer(2);
+    ts->buffer = create_buffer(2, 0);
     test_obj dst;
 
     assert_false(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));  // no timeout
@@ -143,7 +154,7 @@ static void test_read_empty_returns_false(void **state) {
 static void test_fill_to_capacity(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src;
 
     // Act
@@ -162,7 +173,7 @@ static void test_fill_to_capacity(void **state) {
  */
 static void test_flush_empties_buffer(void **state) {
     TestState *ts = *state;
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src = {42};
     assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
     src.value = 43;
@@ -180,7 +191,7 @@ static void test_flush_empties_buffer(void **state) {
 static void test_abort_stops_io(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src = {1}, dst;
     assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
 
@@ -201,7 +212,7 @@ static void test_abort_stops_io(void **state) {
 static void test_flush_clears_abort(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src = {1}, dst;
     assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
     Kit_AbortPacketBuffer(ts->buffer);
@@ -224,7 +235,7 @@ static void test_flush_clears_abort(void **state) {
 static void test_begin_finish_read(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src = {7}, dst = {0};
     assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
 
@@ -245,7 +256,7 @@ static void test_begin_finish_read(void **state) {
 static void test_cancel_read_leaves_item(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(4);
+    ts->buffer = create_buffer(4, 0);
     test_obj src = {8}, dst = {0};
     assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
 
@@ -261,6 +272,459 @@ static void test_cancel_read_leaves_item(void **state) {
     Kit_FreePacketBuffer(&ts->buffer);
 }
 
+/**
+ * @brief In SPSC mode the buffer stays a FIFO across many wraparounds of the read/write positions.
+ */
+static void test_spsc_wraparound_fifo(void **state) {
+    TestState *ts = *state;
+    // Arrange: odd capacity, so slot indexing does not line up with any power of two
+    ts->buffer = create_buffer(3, KIT_PACKET_BUFFER_SPSC);
+    test_obj src, dst;
+
+    // Act / Assert: cycle well past 2 * capacity, keeping the buffer partly filled
+    int next_read = 1;
+    for(int i = 1; i <= 20; i++) {
+        src.value = i;
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+        if(i % 2 == 0) {
+            assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+            assert_int_equal(dst.value, next_read++);
+        }
+    }
+    while(Kit_ReadPacketBuffer(ts->buffer, &dst, 0))
+        assert_int_equal(dst.value, next_read++);
+    assert_int_equal(next_read, 21);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief In SPSC mode a full buffer reports full length, and flush/abort behave as in the locked mode.
+ */
+static void test_spsc_flush_and_abort(void **state) {
+    TestState *ts = *state;
+    // Arrange: fill to capacity
+    ts->buffer = create_buffer(2, KIT_PACKET_BUFFER_SPSC);
+    test_obj src = {1}, dst;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 2);
+
+    // Act / Assert: abort fails writes without blocking, flush empties and clears the abort
+    Kit_AbortPacketBuffer(ts->buffer);
+    assert_false(Kit_WritePacketBuffer(ts->buffer, &src));
+    Kit_FlushPacketBuffer(ts->buffer);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 0);
+    src.value = 5;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_int_equal(dst.value, 5);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Batched writes and reads keep FIFO order across wraparound, and a batch read returns only what is queued.
+ */
+static void test_batch_write_read_fifo(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(5, KIT_PACKET_BUFFER_SPSC);
+    test_obj src[4], dst[4];
+    void *src_ptrs[4] = {&src[0], &src[1], &src[2], &src[3]};
+    void *dst_ptrs[4] = {&dst[0], &dst[1], &dst[2], &dst[3]};
+
+    // Act / Assert: write 4, read 3, write 4 more (wraps), then drain in batches of at most 4
+    for(int i = 0; i < 4; i++)
+        src[i].value = i + 1;
+    assert_int_equal(Kit_WritePacketBufferBatch(ts->buffer, src_ptrs, 4), 4);
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 3, 0, 0), 3);
+    for(int i = 0; i < 3; i++)
+        assert_int_equal(dst[i].value, i + 1);
+    for(int i = 0; i < 4; i++)
+        src[i].value = i + 5;
+    assert_int_equal(Kit_WritePacketBufferBatch(ts->buffer, src_ptrs, 4), 4);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 5);
+
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 4, 0, 0), 4);
+    for(int i = 0; i < 4; i++)
+        assert_int_equal(dst[i].value, i + 4);
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 4, 0, 0), 1);
+    assert_int_equal(dst[0].value, 8);
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 4, 0, 0), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief A byte capped batch read stops once the objects taken reach the cap, but always takes the first one.
+ */
+static void test_batch_read_byte_cap(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    Kit_SetPacketBufferByteLimit(ts->buffer, obj_size, 0);
+    test_obj src[3], dst[3];
+    void *src_ptrs[3] = {&src[0], &src[1], &src[2]};
+    void *dst_ptrs[3] = {&dst[0], &dst[1], &dst[2]};
+    for(int i = 0; i < 3; i++)
+        src[i].value = i + 4;
+    assert_int_equal(Kit_WritePacketBufferBatch(ts->buffer, src_ptrs, 3), 3);
+
+    // Act / Assert: 4 is under the cap of 8, and 4 + 5 reaches it
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 3, 8, 0), 2);
+    assert_int_equal(dst[0].value, 4);
+    assert_int_equal(dst[1].value, 5);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 6);
+
+    // Act / Assert: the first object is taken even if it alone is over the cap
+    assert_int_equal(Kit_ReadPacketBufferBatch(ts->buffer, dst_ptrs, 3, 1, 0), 1);
+    assert_int_equal(dst[0].value, 6);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief A batch write on an aborted buffer writes nothing and leaves the source objects untouched.
+ */
+static void test_batch_write_aborted(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, 0);
+    test_obj src[2] = {{1}, {2}};
+    void *src_ptrs[2] = {&src[0], &src[1]};
+    Kit_AbortPacketBuffer(ts->buffer);
+
+    // Act / Assert
+    assert_int_equal(Kit_WritePacketBufferBatch(ts->buffer, src_ptrs, 2), 0);
+    assert_int_equal(src[0].value, 1);
+    assert_int_equal(src[1].value, 2);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief A non-blocking batch write writes only what fits by slots and by byte budget, leaves the rest untouched,
+ * and writes nothing into a full or aborted buffer.
+ */
+static void test_try_write_batch(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(3, KIT_PACKET_BUFFER_SPSC);
+    test_obj src[4] = {{1}, {2}, {3}, {4}};
+    void *src_ptrs[4] = {&src[0], &src[1], &src[2], &src[3]};
+    test_obj dst;
+
+    // Act / Assert: slot limit
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, src_ptrs, 4), 3);
+    assert_int_equal(src[3].value, 4);
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, &src_ptrs[3], 1), 0);
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_int_equal(dst.value, 1);
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, &src_ptrs[3], 1), 1);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 3);
+
+    // Act / Assert: byte budget; the first object always fits, and the write stops once the budget is used up
+    Kit_FlushPacketBuffer(ts->buffer);
+    Kit_SetPacketBufferByteLimit(ts->buffer, obj_size, 5);
+    for(int i = 0; i < 4; i++)
+        src[i].value = 4;
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, src_ptrs, 4), 2);
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, &src_ptrs[2], 2), 0);
+
+    // Act / Assert: aborted
+    Kit_FlushPacketBuffer(ts->buffer);
+    Kit_AbortPacketBuffer(ts->buffer);
+    assert_int_equal(Kit_TryWritePacketBufferBatch(ts->buffer, &src_ptrs[2], 2), 0);
+    assert_int_equal(src[2].value, 4);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief The queued byte count follows writes, reads and flushes. Test objects report their value as their size.
+ */
+static void test_byte_limit_accounting(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    Kit_SetPacketBufferByteLimit(ts->buffer, obj_size, 10);
+    test_obj src, dst;
+
+    // Act / Assert: writes are accepted while under the budget, and the last one may overshoot it
+    src.value = 4;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    src.value = 5;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    src.value = 100;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 109);
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 105);
+    assert_true(Kit_BeginPacketBufferRead(ts->buffer, &dst, 0));
+    Kit_FinishPacketBufferRead(ts->buffer);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 100);
+    Kit_FlushPacketBuffer(ts->buffer);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 0);
+
+    // An empty buffer takes an item larger than the whole budget
+    src.value = 50;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 50);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief The usage counters track reads, writes (including flushed items), aborts and the peak fill level.
+ */
+static void test_stats_counters(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    Kit_PacketBufferStats stats;
+    test_obj src = {1}, dst;
+
+    // Act: 3 writes, 1 read, 1 more write, flush (drops 3), abort
+    for(int i = 0; i < 3; i++)
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    Kit_GetPacketBufferStats(ts->buffer, &stats);
+    assert_int_equal(stats.writes, 4);
+    assert_int_equal(stats.reads, 1);
+    Kit_FlushPacketBuffer(ts->buffer);
+    Kit_AbortPacketBuffer(ts->buffer);
+    assert_false(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+
+    // Assert: nothing ever blocked, so no wait time was recorded
+    Kit_GetPacketBufferStats(ts->buffer, &stats);
+    assert_int_equal(stats.writes, 4);
+    assert_int_equal(stats.reads, 1);
+    assert_int_equal(stats.aborts, 1);
+    assert_int_equal(stats.peak_length, 3);
+    assert_int_equal(stats.write_wait_ns, 0);
+    assert_int_equal(stats.read_wait_ns, 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Growing a buffer keeps the queued items in order, including ones that had wrapped around the slot array.
+ */
+static void test_resize_grow_keeps_items(void **state) {
+    TestState *ts = *state;
+    // Arrange: wrap the positions, then fill to capacity with 3, 4, 5
+    ts->buffer = create_buffer(3, KIT_PACKET_BUFFER_SPSC);
+    test_obj src, dst;
+    for(int i = 1; i <= 5; i++) {
+        src.value = i;
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+        if(i <= 2)
+            assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    }
+
+    // Act: grow, then use the new room
+    assert_true(Kit_ResizePacketBuffer(ts->buffer, 5, 0));
+    assert_int_equal(Kit_GetPacketBufferCapacity(ts->buffer), 5);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 3);
+    for(int i = 6; i <= 7; i++) {
+        src.value = i;
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    }
+
+    // Assert
+    for(int i = 3; i <= 7; i++) {
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+        assert_int_equal(dst.value, i);
+    }
+    assert_false(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Shrinking a buffer below its fill level keeps every queued item; the excess is read out normally, and
+ * writing resumes once the buffer is back under the new capacity. The byte limit is replaced as well.
+ */
+static void test_resize_shrink_keeps_items(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    Kit_SetPacketBufferByteLimit(ts->buffer, obj_size, 0);
+    test_obj src, dst;
+    for(int i = 1; i <= 4; i++) {
+        src.value = i;
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    }
+
+    // Act: shrink to 2 slots and a 100 byte budget while holding 4 items (10 bytes)
+    assert_true(Kit_ResizePacketBuffer(ts->buffer, 2, 100));
+
+    // Assert: all items are still there, and byte accounting carries over
+    assert_int_equal(Kit_GetPacketBufferCapacity(ts->buffer), 2);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 4);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 10);
+    for(int i = 1; i <= 3; i++) {
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+        assert_int_equal(dst.value, i);
+    }
+    src.value = 5;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src)); // one item queued, one slot free
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 2);
+    for(int i = 4; i <= 5; i++) {
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+        assert_int_equal(dst.value, i);
+    }
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/** @brief Watermark callback for test_watermark_crossings: counts high and low reports. */
+static void on_watermark(void *userdata, bool high) {
+    int *counts = userdata;
+    counts[high ? 1 : 0]++;
+}
+
+/**
+ * @brief Watermark callbacks fire once when the fill level reaches the high watermark and once when it drops to the
+ * low one, not for every item in between; a flush counts as a drop.
+ */
+static void test_watermark_crossings(void **state) {
+    TestState *ts = *state;
+    // Arrange: 4 slots, low at 25% (1 item), high at 75% (3 items)
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    int counts[2] = {0, 0};
+    Kit_SetPacketBufferWatermarkCallback(ts->buffer, on_watermark, counts);
+    Kit_SetPacketBufferWatermarks(ts->buffer, 25, 75);
+    test_obj src = {1}, dst;
+
+    // Act / Assert: rising to 4 items reports high once
+    for(int i = 0; i < 4; i++)
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(counts[1], 1);
+    assert_int_equal(counts[0], 0);
+
+    // Draining to 1 item reports low once, both through plain and begin/finish reads
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_true(Kit_BeginPacketBufferRead(ts->buffer, &dst, 0));
+    Kit_FinishPacketBufferRead(ts->buffer);
+    assert_int_equal(counts[0], 0);
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_int_equal(counts[0], 1);
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_int_equal(counts[0], 1);
+
+    // Refill past high, then flush: one more of each
+    for(int i = 0; i < 3; i++)
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    Kit_FlushPacketBuffer(ts->buffer);
+    assert_int_equal(counts[1], 2);
+    assert_int_equal(counts[0], 2);
+
+    // Disabled watermarks report nothing
+    Kit_SetPacketBufferWatermarks(ts->buffer, -1, -1);
+    for(int i = 0; i < 4; i++)
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(counts[1], 2);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief With a wake level set, only the write that brings the fill level up to it signals the wake event; without
+ * one, every write does.
+ */
+static void test_wake_level_crossings(void **state) {
+    TestState *ts = *state;
+    // Arrange: 4 slots, wake at 50% (2 items)
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    ts->event = Kit_CreateBufferEvent();
+    assert_non_null(ts->event);
+    Kit_SetPacketBufferWakeEvent(ts->buffer, ts->event);
+    Kit_SetPacketBufferWakeLevel(ts->buffer, 50);
+    Kit_BeginBufferEventWait(ts->event);
+    const int serial = Kit_GetBufferEventSerial(ts->event);
+    test_obj src = {1}, dst;
+
+    // Act / Assert: rising to 4 items signals once, at the second item
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial);
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial + 1);
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial + 1);
+
+    // Dropping under the level and refilling signals again
+    for(int i = 0; i < 3; i++)
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial + 2);
+
+    // Without a level every write signals, and an unreachable one never does
+    Kit_SetPacketBufferWakeLevel(ts->buffer, KIT_PACKET_BUFFER_WAKE_ANY);
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial + 3);
+    Kit_FlushPacketBuffer(ts->buffer);
+    Kit_SetPacketBufferWakeLevel(ts->buffer, KIT_PACKET_BUFFER_WAKE_NONE);
+    for(int i = 0; i < 4; i++)
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_int_equal(Kit_GetBufferEventSerial(ts->event), serial + 3);
+
+    Kit_EndBufferEventWait(ts->event);
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Peek copies out the head item without removing it; Take then consumes exactly that item, either moving it
+ * out or dropping it, and a ticket is only good for the item it was handed out for.
+ */
+static void test_peek_take(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(4, KIT_PACKET_BUFFER_SPSC);
+    test_obj src, dst = {0};
+    for(int i = 1; i <= 3; i++) {
+        src.value = i;
+        assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    }
+    uint64_t ticket;
+    int peeked = 0;
+
+    // Act / Assert: peeking does not consume, and dropping by ticket does
+    assert_true(Kit_PeekPacketBuffer(ts->buffer, obj_peek, &peeked, &ticket, 0));
+    assert_int_equal(peeked, 1);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 3);
+    assert_true(Kit_TakePacketBuffer(ts->buffer, NULL, ticket));
+    assert_false(Kit_TakePacketBuffer(ts->buffer, NULL, ticket)); // already consumed
+
+    // Act / Assert: a resize keeps the ticket valid, and taking moves the item out
+    assert_true(Kit_PeekPacketBuffer(ts->buffer, obj_peek, &peeked, &ticket, 0));
+    assert_int_equal(peeked, 2);
+    assert_true(Kit_ResizePacketBuffer(ts->buffer, 8, 0));
+    assert_true(Kit_TakePacketBuffer(ts->buffer, &dst, ticket));
+    assert_int_equal(dst.value, 2);
+
+    // Act / Assert: a flush in between invalidates the ticket
+    assert_true(Kit_PeekPacketBuffer(ts->buffer, obj_peek, &peeked, &ticket, 0));
+    assert_int_equal(peeked, 3);
+    Kit_FlushPacketBuffer(ts->buffer);
+    src.value = 4;
+    assert_true(Kit_WritePacketBuffer(ts->buffer, &src));
+    assert_false(Kit_TakePacketBuffer(ts->buffer, &dst, ticket));
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 1);
+
+    // Assert: empty buffer cannot be peeked
+    assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 0));
+    assert_false(Kit_PeekPacketBuffer(ts->buffer, obj_peek, &peeked, &ticket, 0));
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_create_and_free, test_setup, test_teardown),
@@ -272,6 +736,19 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_flush_clears_abort, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_begin_finish_read, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_cancel_read_leaves_item, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_peek_take, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spsc_wraparound_fifo, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spsc_flush_and_abort, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_batch_write_read_fifo, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_batch_read_byte_cap, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_batch_write_aborted, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_try_write_batch, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_byte_limit_accounting, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_stats_counters, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_resize_grow_keeps_items, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_resize_shrink_keeps_items, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_watermark_crossings, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_wake_level_crossings, test_setup, test_teardown),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -49,13 +49,18 @@ static void obj_ref(void *dst, void *src) {
     ((test_obj *)dst)->value = ((test_obj *)src)->value;
 }
 
-static Kit_PacketBuffer *create_buffer(size_t capacity) {
-    return Kit_CreatePacketBuffer(capacity, obj_alloc, obj_unref, obj_free, obj_move, obj_ref);
+static size_t obj_size(const void *obj) {
+    return (size_t)((const test_obj *)obj)->value;
+}
+
+static Kit_PacketBuffer *create_buffer(size_t capacity, unsigned int flags) {
+    return Kit_CreatePacketBuffer(capacity, obj_alloc, obj_unref, obj_free, obj_move, obj_ref, flags);
 }
 
 #define FIFO_ITEM_COUNT 64
 #define FIFO_BUFFER_CAPACITY 4  // smaller than FIFO_ITEM_COUNT, so the writer must block on a full buffer
 #define FULL_WAIT_BOUND_MS 5000 // wall-clock bound for waiting on the buffer-full condition
+#define SPSC_ITEM_COUNT 20000   // enough to hit both the full and the empty wait paths many times
 
 typedef struct producer_ctx {
     Kit_PacketBuffer *buffer;
@@ -118,7 +123,7 @@ static int producer_thread(void *data) {
 static void test_producer_consumer_fifo(void **state) {
     TestState *ts = *state;
     // Arrange
-    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY);
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, 0);
     ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = FIFO_ITEM_COUNT};
     test_obj dst;
 
@@ -147,7 +152,7 @@ static void test_producer_consumer_fifo(void **state) {
 static void test_abort_unblocks_writer(void **state) {
     TestState *ts = *state;
     // Arrange: fill the buffer to capacity so the next write blocks
-    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY);
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, 0);
     ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = FIFO_BUFFER_CAPACITY + 1};
 
     // Act: writer fills the buffer and then blocks on the (capacity+1)th write
@@ -191,7 +196,7 @@ static int reader_thread(void *data) {
 static void test_abort_unblocks_reader(void **state) {
     TestState *ts = *state;
     // Arrange: empty buffer, nothing ever written to it
-    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY);
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, 0);
 
     // Act: reader blocks on the empty buffer, then abort releases it
     ts->thread = SDL_CreateThread(reader_thread, "packetbuffer_mt_reader", ts->buffer);
@@ -209,11 +214,144 @@ static void test_abort_unblocks_reader(void **state) {
     Kit_FreePacketBuffer(&ts->buffer);
 }
 
+/**
+ * @brief Same as test_producer_consumer_fifo, but with a lock-free single-producer buffer, and with enough items
+ * that the reader also has to block on an empty buffer and get woken up by the writer.
+ */
+static void test_spsc_producer_consumer_fifo(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, KIT_PACKET_BUFFER_SPSC);
+    ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = SPSC_ITEM_COUNT};
+    test_obj dst;
+
+    // Act: start the writer, then drain everything from the main thread, alternating both read styles
+    ts->thread = SDL_CreateThread(producer_thread, "packetbuffer_mt_spsc", &ts->ctx);
+    assert_non_null(ts->thread);
+    for(int i = 1; i <= SPSC_ITEM_COUNT; i++) {
+        if(i % 2) {
+            assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 1000));
+        } else {
+            assert_true(Kit_BeginPacketBufferRead(ts->buffer, &dst, 1000));
+            Kit_FinishPacketBufferRead(ts->buffer);
+        }
+        assert_int_equal(dst.value, i);
+    }
+
+    // Assert: writer finished cleanly and the buffer is empty
+    int writer_status = -1;
+    SDL_WaitThread(ts->thread, &writer_status);
+    ts->thread = NULL;
+    assert_int_equal(writer_status, 0);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Kit_AbortPacketBuffer() wakes a lock-free writer blocked on a full buffer.
+ */
+static void test_spsc_abort_unblocks_writer(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, KIT_PACKET_BUFFER_SPSC);
+    ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = FIFO_BUFFER_CAPACITY + 1};
+
+    // Act: see test_abort_unblocks_writer
+    ts->thread = SDL_CreateThread(producer_thread, "packetbuffer_mt_spsc_writer", &ts->ctx);
+    assert_non_null(ts->thread);
+    const Uint32 wait_start = SDL_GetTicks();
+    while(SDL_GetTicks() - wait_start < FULL_WAIT_BOUND_MS &&
+          Kit_GetPacketBufferLength(ts->buffer) < FIFO_BUFFER_CAPACITY)
+        SDL_Delay(1);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), FIFO_BUFFER_CAPACITY);
+    Kit_AbortPacketBuffer(ts->buffer);
+
+    // Assert
+    int writer_status = 0;
+    SDL_WaitThread(ts->thread, &writer_status);
+    ts->thread = NULL;
+    assert_int_equal(writer_status, FIFO_BUFFER_CAPACITY + 1);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief A writer blocks once the buffer holds its byte budget, even with free slots left, and continues once a
+ * read brings the buffer back under the budget. Test objects report their value as their size.
+ */
+static void test_byte_limit_blocks_writer(void **state) {
+    TestState *ts = *state;
+    // Arrange: items 1 and 2 fill the 3-byte budget of a buffer with plenty of slots
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, KIT_PACKET_BUFFER_SPSC);
+    Kit_SetPacketBufferByteLimit(ts->buffer, obj_size, 3);
+    ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = 3};
+    test_obj dst;
+
+    // Act: the writer stops after two items
+    ts->thread = SDL_CreateThread(producer_thread, "packetbuffer_mt_bytes", &ts->ctx);
+    assert_non_null(ts->thread);
+    const Uint32 wait_start = SDL_GetTicks();
+    while(SDL_GetTicks() - wait_start < FULL_WAIT_BOUND_MS && Kit_GetPacketBufferLength(ts->buffer) < 2)
+        SDL_Delay(1);
+    SDL_Delay(50); // give the writer time to (wrongly) write the third item
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 2);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 3);
+
+    // Assert: draining the buffer lets the writer finish, in order
+    for(int i = 1; i <= 3; i++) {
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 1000));
+        assert_int_equal(dst.value, i);
+    }
+    int writer_status = -1;
+    SDL_WaitThread(ts->thread, &writer_status);
+    ts->thread = NULL;
+    assert_int_equal(writer_status, 0);
+    assert_int_equal(Kit_GetPacketBufferBytes(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
+/**
+ * @brief Resizing a lock-free buffer back and forth while the writer is streaming into it neither loses nor
+ * reorders items.
+ */
+static void test_spsc_resize_while_writing(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->buffer = create_buffer(FIFO_BUFFER_CAPACITY, KIT_PACKET_BUFFER_SPSC);
+    ts->ctx = (producer_ctx){.buffer = ts->buffer, .count = SPSC_ITEM_COUNT};
+    test_obj dst;
+
+    // Act: drain everything, resizing between 1 and 16 slots as we go
+    ts->thread = SDL_CreateThread(producer_thread, "packetbuffer_mt_resize", &ts->ctx);
+    assert_non_null(ts->thread);
+    for(int i = 1; i <= SPSC_ITEM_COUNT; i++) {
+        if(i % 100 == 0)
+            assert_true(Kit_ResizePacketBuffer(ts->buffer, 1 + (i / 100) % 16, 0));
+        assert_true(Kit_ReadPacketBuffer(ts->buffer, &dst, 1000));
+        assert_int_equal(dst.value, i);
+    }
+
+    // Assert
+    int writer_status = -1;
+    SDL_WaitThread(ts->thread, &writer_status);
+    ts->thread = NULL;
+    assert_int_equal(writer_status, 0);
+    assert_int_equal(Kit_GetPacketBufferLength(ts->buffer), 0);
+
+    Kit_FreePacketBuffer(&ts->buffer);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_producer_consumer_fifo, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_abort_unblocks_writer, test_setup, test_teardown),
         cmocka_unit_test_setup_teardown(test_abort_unblocks_reader, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spsc_producer_consumer_fifo, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spsc_abort_unblocks_writer, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_byte_limit_blocks_writer, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_spsc_resize_while_writing, test_setup, test_teardown),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,166 @@
+/**
+ * Unit tests for Kit_ReadAhead (kitreadahead.h), the I/O read-ahead stage
+ * sources can read through. The stage is run over an in-memory MemFile with
+ * a byte pattern, so every read can be checked against the offset it should
+ * have come from, including after seeks inside and outside the window.
+ *
+ * @author Tuomas Virtanen
+ * @copyright Tuomas Virtanen; MIT license (see LICENSE)
+ */
+
+#include <cmocka.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "kit_memsource.h"
+
+#include "kitchensink3/internal/kitreadahead.h"
+
+#define DATA_SIZE (1024 * 1024 + 123) // not a multiple of the window, so the ring wraps unevenly
+#define WINDOW KIT_READ_AHEAD_MIN_WINDOW
+
+/** @brief Per-test resources, released by test_teardown() even if an assert fails mid-test. */
+typedef struct {
+    Kit_ReadAhead *ra;
+    unsigned char *data;
+    MemFile mem;
+} TestState;
+
+static int close_count; // close_cb() calls, reset by test_setup()
+
+static unsigned char pattern_at(int64_t pos) {
+    return (unsigned char)((pos * 7) ^ (pos >> 8));
+}
+
+static void close_cb(void *userdata) {
+    (void)userdata;
+    close_count++;
+}
+
+static int test_setup(void **state) {
+    TestState *ts = calloc(1, sizeof(TestState));
+    if(ts == NULL)
+        return -1;
+    if((ts->data = malloc(DATA_SIZE)) == NULL) {
+        free(ts);
+        return -1;
+    }
+    for(int64_t i = 0; i < DATA_SIZE; i++)
+        ts->data[i] = pattern_at(i);
+    ts->mem = (MemFile){.data = ts->data, .size = DATA_SIZE, .pos = 0};
+    close_count = 0;
+    *state = ts;
+    return 0;
+}
+
+static int test_teardown(void **state) {
+    TestState *ts = *state;
+    if(ts == NULL)
+        return 0;
+    Kit_CloseReadAhead(&ts->ra);
+    free(ts->data);
+    free(ts);
+    *state = NULL;
+    return 0;
+}
+
+/** @brief Reads `size` bytes and checks that they match the pattern from `pos` on. */
+static void assert_read_at(Kit_ReadAhead *ra, int64_t pos, int size) {
+    uint8_t buf[4096];
+    assert_true(size <= (int)sizeof(buf));
+    int got = 0;
+    while(got < size) {
+        const int ret = Kit_ReadAheadRead(ra, buf + got, size - got);
+        assert_true(ret > 0);
+        got += ret;
+    }
+    for(int i = 0; i < size; i++)
+        assert_int_equal(buf[i], pattern_at(pos + i));
+}
+
+/**
+ * @brief Reading through the whole stream in odd-sized chunks returns every byte in order, then AVERROR_EOF.
+ */
+static void test_read_all(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->ra = Kit_CreateReadAhead(mem_read, mem_seek, close_cb, &ts->mem, WINDOW);
+    assert_non_null(ts->ra);
+    uint8_t buf[1000];
+    int64_t pos = 0;
+
+    // Act
+    int ret;
+    while((ret = Kit_ReadAheadRead(ts->ra, buf, sizeof(buf))) > 0) {
+        for(int i = 0; i < ret; i++)
+            assert_int_equal(buf[i], pattern_at(pos + i));
+        pos += ret;
+    }
+
+    // Assert
+    assert_int_equal(ret, AVERROR_EOF);
+    assert_int_equal(pos, DATA_SIZE);
+}
+
+/**
+ * @brief Seeks, both inside the queued data and outside of it, land on the right byte. Relative seeks are
+ * relative to what the reader has consumed, not to how far the thread has read ahead.
+ */
+static void test_seek(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->ra = Kit_CreateReadAhead(mem_read, mem_seek, close_cb, &ts->mem, WINDOW);
+    assert_non_null(ts->ra);
+    assert_read_at(ts->ra, 0, 100);
+
+    // Act / Assert: short forward skip, likely served from the ring
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, 50, SEEK_CUR), 150);
+    assert_read_at(ts->ra, 150, 100);
+
+    // Act / Assert: far past the window
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, 500000, SEEK_SET), 500000);
+    assert_read_at(ts->ra, 500000, 4096);
+
+    // Act / Assert: backwards, and relative to the end
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, 10, SEEK_SET | AVSEEK_FORCE), 10);
+    assert_read_at(ts->ra, 10, 10);
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, -20, SEEK_END), DATA_SIZE - 20);
+    assert_read_at(ts->ra, DATA_SIZE - 20, 20);
+    uint8_t buf[16];
+    assert_int_equal(Kit_ReadAheadRead(ts->ra, buf, sizeof(buf)), AVERROR_EOF);
+
+    // Act / Assert: size query passes through, and reading works again after a seek from EOF
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, 0, AVSEEK_SIZE), DATA_SIZE);
+    assert_int_equal(Kit_ReadAheadSeek(ts->ra, 0, SEEK_SET), 0);
+    assert_read_at(ts->ra, 0, 4096);
+}
+
+/**
+ * @brief Closing calls the close callback once, also while the thread is parked on a full window.
+ */
+static void test_close(void **state) {
+    TestState *ts = *state;
+    // Arrange
+    ts->ra = Kit_CreateReadAhead(mem_read, mem_seek, close_cb, &ts->mem, WINDOW);
+    assert_non_null(ts->ra);
+    assert_read_at(ts->ra, 0, 10);
+
+    // Act
+    Kit_CloseReadAhead(&ts->ra);
+
+    // Assert
+    assert_null(ts->ra);
+    assert_int_equal(close_count, 1);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_read_all, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_seek, test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_close, test_setup, test_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}